@@ -0,0 +1,439 @@
+/**
+ * @file bench.c
+ *
+ * Microbenchmarks for the parts of the interpreter the performance work targets: the lexer, the parser, preparing a
+ * whole script, the timestamp queue and one scheduler tick. Every benchmark is repeated until it has run for at least
+ * BENCH_MIN_TIME_US, then its cost is reported as one JSON object per line:
+ *
+ *     {"benchmark": "parse_line_into_instruction", "iterations": 65536, "ns_per_op": 812.4, "allocations_per_op": 6.0}
+ *
+ * allocations_per_op counts calls to malloc, calloc, realloc and aligned_alloc made by the interpreter. It is -1 where
+ * the linker cannot route them through this file (see CMakeLists.txt). Frees are not counted.
+ *
+ * Usage: beanscript_bench [filter]. Only benchmarks whose name contains the filter are run. Preparing a script writes
+ * its source and image to the working directory and removes them afterwards.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/main.h"
+#include "src/runtime.h"
+#include "src/keyboard/emitter.h"
+#include "src/parser/instruction.h"
+#include "src/parser/lexer.h"
+#include "src/parser/parser.h"
+#include "src/utility/clock.h"
+#include "src/utility/timestamp_queue.h"
+
+#define BENCH_MIN_TIME_US 100000
+#define BENCH_MAX_LINE_LENGTH 256
+
+static const char* BENCH_LINE = "key k0 with button a, duration 10 20, after 10, before 5 10";
+static const char* BENCH_DELIMITERS = " \r\n";
+
+#ifdef BEANSCRIPT_BENCH_COUNT_ALLOCATIONS
+static atomic_long num_allocations = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    atomic_fetch_add_explicit(&num_allocations, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&num_allocations, 1, memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    atomic_fetch_add_explicit(&num_allocations, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+    atomic_fetch_add_explicit(&num_allocations, 1, memory_order_relaxed);
+    return __real_aligned_alloc(alignment, size);
+}
+
+static long get_num_allocations() {
+    return atomic_load_explicit(&num_allocations, memory_order_relaxed);
+}
+#else
+static long get_num_allocations() {
+    return -1;
+}
+#endif
+
+/**
+ * @brief One benchmark.
+ * - setup: Called once before the benchmark is timed, with the number of iterations it will run. May be NULL.
+ * - run: Runs one operation. Only this is timed.
+ * - teardown: Called once after the benchmark is timed. May be NULL.
+ * - size: Passed to every call, e.g., the number of lines or routines.
+ */
+typedef struct {
+    const char* name;
+    void (*setup)(int size, long num_iterations);
+    void (*run)(int size);
+    void (*teardown)(int size);
+    int size;
+} Benchmark;
+
+// Lexer and Parser
+
+static char line_buffer[BENCH_MAX_LINE_LENGTH];
+static InstructionMap* bench_instruction_map = NULL;
+
+static void bench_tokenize(int size) {
+    (void) size;
+
+    strcpy(line_buffer, BENCH_LINE);
+    StrBucket* buckets = tokenize_to_buckets(line_buffer, BENCH_DELIMITERS, NULL);
+    str_bucket_delete(&buckets);
+}
+
+static void setup_parse(int size, long num_iterations) {
+    (void) size;
+    (void) num_iterations;
+
+    bench_instruction_map = instruction_map_new();
+    instruction_map_bind(bench_instruction_map);
+}
+
+static void bench_parse(int size) {
+    (void) size;
+
+    // The instruction borrows its id from the line, so it is freed before the line is overwritten.
+    strcpy(line_buffer, BENCH_LINE);
+    Instruction* instruction = instruction_new();
+    parse_line_into_instruction(instruction, line_buffer);
+    instruction_delete(&instruction);
+}
+
+static void teardown_parse(int size) {
+    (void) size;
+
+    instruction_map_delete(&bench_instruction_map);
+}
+
+// Preparing a Script
+
+static char script_name[64];
+static char image_name[64];
+
+/**
+ * Writes a script of the given number of lines. The script defines a key and a group of two strokes on it, then
+ * starts every group, so it exercises definitions, aliases, nesting and the execution list.
+ */
+static void write_script(int num_lines) {
+    snprintf(script_name, sizeof(script_name), "bench_%d.bs", num_lines);
+    snprintf(image_name, sizeof(image_name), "bench_%d.bsc", num_lines);
+
+    FILE* file = fopen(script_name, "w");
+    assert(file != NULL, "Failed to create benchmark script %s.", script_name);
+
+    const int num_blocks = num_lines / 5;
+    for (int block = 0; block < num_blocks; block++) {
+        fprintf(file, "key k%d with button a, duration 10 20, after 10\n", block);
+        fprintf(file, "group g%d with after 0\n", block);
+        fprintf(file, "    press k%d with after 0\n", block);
+        fprintf(file, "    release k%d with after 0\n", block);
+        fprintf(file, "start g%d\n", block);
+    }
+
+    fclose(file);
+    remove(image_name);
+}
+
+static void setup_prepare_cached(int size, long num_iterations) {
+    (void) num_iterations;
+
+    write_script(size);
+
+    // Compile once so every timed run loads the image.
+    Runtime* runtime = runtime_new(script_name, 0, 1);
+    runtime_delete(&runtime);
+}
+
+static void setup_prepare_compile(int size, long num_iterations) {
+    (void) num_iterations;
+
+    write_script(size);
+}
+
+static void bench_prepare(int size) {
+    (void) size;
+
+    Runtime* runtime = runtime_new(script_name, 0, 1);
+    runtime_delete(&runtime);
+}
+
+static void bench_prepare_compile(int size) {
+    // Removing the image is part of the timed operation, but costs far less than compiling.
+    remove(image_name);
+    bench_prepare(size);
+}
+
+static void teardown_prepare(int size) {
+    (void) size;
+
+    remove(script_name);
+    remove(image_name);
+}
+
+// Timestamp Queue
+
+static TimestampQueue* bench_queue = NULL;
+static time_t bench_timestamp = 0;
+static int bench_queue_size = 0;
+
+/**
+ * Returns pseudo-random timestamps that mostly land behind the front of the queue, as deadlines do.
+ */
+static time_t next_timestamp() {
+    bench_timestamp += 1 + rand() % 64;
+    return bench_timestamp + rand() % 4096;
+}
+
+static void setup_queue(int size, long num_iterations) {
+    (void) num_iterations;
+
+    srand(1);
+    bench_timestamp = 0;
+    bench_queue = timestamp_queue_new(size);
+
+    for (int handle = 0; handle < size; handle++) {
+        timestamp_queue_push(bench_queue, next_timestamp(), handle);
+    }
+}
+
+static void bench_queue_push(int size) {
+    // The queue cannot remove entries, so it is refilled once full. The reset is amortized over size pushes.
+    if (bench_queue_size == size) {
+        timestamp_queue_delete(&bench_queue);
+        bench_queue = timestamp_queue_new(size);
+        bench_queue_size = 0;
+    }
+
+    timestamp_queue_push(bench_queue, next_timestamp(), bench_queue_size);
+    bench_queue_size++;
+}
+
+static void setup_queue_push(int size, long num_iterations) {
+    (void) num_iterations;
+
+    srand(1);
+    bench_timestamp = 0;
+    bench_queue = timestamp_queue_new(size);
+    bench_queue_size = 0;
+}
+
+static void bench_queue_pop(int size) {
+    (void) size;
+
+    timestamp_queue_pop(bench_queue, next_timestamp());
+}
+
+static void teardown_queue(int size) {
+    (void) size;
+
+    timestamp_queue_delete(&bench_queue);
+}
+
+static int* bench_ready_handles = NULL;
+
+static void setup_queue_pop_ready(int size, long num_iterations) {
+    (void) num_iterations;
+
+    // The entries are spread evenly over the next size * 32 us.
+    srand(1);
+    bench_timestamp = 0;
+    bench_queue = timestamp_queue_new(size);
+
+    for (int handle = 0; handle < size; handle++) {
+        timestamp_queue_push(bench_queue, (time_t) handle * 32 + rand() % 32, handle);
+    }
+
+    bench_ready_handles = (int*) malloc(sizeof(int) * size);
+    assert(bench_ready_handles != NULL, "Failed to allocate memory for benchmark handles.");
+}
+
+static void bench_queue_pop_ready(int size) {
+    // Time moves on by the spacing of the entries, and every ready entry is rescheduled behind all the others, so
+    // about one entry is ready per operation.
+    bench_timestamp += 32;
+
+    const int num_ready = timestamp_queue_pop_ready(bench_queue, bench_timestamp, bench_ready_handles, size);
+    for (int idx = 0; idx < num_ready; idx++) {
+        timestamp_queue_push(bench_queue, bench_timestamp + (time_t) size * 32 + rand() % 32, bench_ready_handles[idx]);
+    }
+}
+
+static void teardown_queue_pop_ready(int size) {
+    teardown_queue(size);
+
+    free(bench_ready_handles);
+    bench_ready_handles = NULL;
+}
+
+// Scheduler Tick
+
+static Runtime* bench_runtime = NULL;
+static time_t bench_horizon = 0;
+
+/**
+ * Writes a script that starts the given number of routines, each pressing its own key every millisecond.
+ */
+static void write_routine_script(int num_routines) {
+    snprintf(script_name, sizeof(script_name), "bench_routines_%d.bs", num_routines);
+    snprintf(image_name, sizeof(image_name), "bench_routines_%d.bsc", num_routines);
+
+    FILE* file = fopen(script_name, "w");
+    assert(file != NULL, "Failed to create benchmark script %s.", script_name);
+
+    for (int routine = 0; routine < num_routines; routine++) {
+        fprintf(file, "key k%d with button a, duration 0, after 1\n", routine);
+        fprintf(file, "routine r%d with after 0\n", routine);
+        fprintf(file, "    press k%d\n", routine);
+    }
+
+    for (int routine = 0; routine < num_routines; routine++) {
+        fprintf(file, "start r%d\n", routine);
+    }
+
+    fclose(file);
+    remove(image_name);
+}
+
+static void setup_tick(int size, long num_iterations) {
+    (void) num_iterations;
+
+    write_routine_script(size);
+
+    // The script starts at time 0, so every stroke is already due when it reaches the emitter and is sent at once.
+    emitter_open(1, 1 << 16);
+    bench_runtime = runtime_new(script_name, 0, 1);
+    bench_horizon = runtime_start(bench_runtime, 0);
+}
+
+static void bench_tick(int size) {
+    (void) size;
+
+    bench_horizon += CLOCK_US_PER_MS;
+    runtime_step(bench_runtime, bench_horizon);
+}
+
+static void teardown_tick(int size) {
+    runtime_delete(&bench_runtime);
+    emitter_close();
+    teardown_prepare(size);
+}
+
+static const Benchmark BENCHMARKS[] = {
+    { "tokenize_to_buckets", NULL, bench_tokenize, NULL, 0 },
+    { "parse_line_into_instruction", setup_parse, bench_parse, teardown_parse, 0 },
+    { "runtime_prepare_compile/1000", setup_prepare_compile, bench_prepare_compile, teardown_prepare, 1000 },
+    { "runtime_prepare_compile/10000", setup_prepare_compile, bench_prepare_compile, teardown_prepare, 10000 },
+    { "runtime_prepare_compile/100000", setup_prepare_compile, bench_prepare_compile, teardown_prepare, 100000 },
+    { "runtime_prepare_cached/1000", setup_prepare_cached, bench_prepare, teardown_prepare, 1000 },
+    { "runtime_prepare_cached/10000", setup_prepare_cached, bench_prepare, teardown_prepare, 10000 },
+    { "runtime_prepare_cached/100000", setup_prepare_cached, bench_prepare, teardown_prepare, 100000 },
+    { "timestamp_queue_push/16", setup_queue_push, bench_queue_push, teardown_queue, 16 },
+    { "timestamp_queue_push/256", setup_queue_push, bench_queue_push, teardown_queue, 256 },
+    { "timestamp_queue_push/4096", setup_queue_push, bench_queue_push, teardown_queue, 4096 },
+    { "timestamp_queue_push/65536", setup_queue_push, bench_queue_push, teardown_queue, 65536 },
+    { "timestamp_queue_pop/16", setup_queue, bench_queue_pop, teardown_queue, 16 },
+    { "timestamp_queue_pop/256", setup_queue, bench_queue_pop, teardown_queue, 256 },
+    { "timestamp_queue_pop/4096", setup_queue, bench_queue_pop, teardown_queue, 4096 },
+    { "timestamp_queue_pop/65536", setup_queue, bench_queue_pop, teardown_queue, 65536 },
+    { "timestamp_queue_pop_ready/16", setup_queue_pop_ready, bench_queue_pop_ready, teardown_queue_pop_ready, 16 },
+    { "timestamp_queue_pop_ready/256", setup_queue_pop_ready, bench_queue_pop_ready, teardown_queue_pop_ready, 256 },
+    { "timestamp_queue_pop_ready/4096", setup_queue_pop_ready, bench_queue_pop_ready, teardown_queue_pop_ready, 4096 },
+    { "timestamp_queue_pop_ready/65536", setup_queue_pop_ready, bench_queue_pop_ready, teardown_queue_pop_ready, 65536 },
+    { "scheduler_tick/1", setup_tick, bench_tick, teardown_tick, 1 },
+    { "scheduler_tick/16", setup_tick, bench_tick, teardown_tick, 16 },
+    { "scheduler_tick/256", setup_tick, bench_tick, teardown_tick, 256 },
+};
+
+static const int NUM_BENCHMARKS = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+/**
+ * Times the given number of iterations of a benchmark. Setup and teardown are neither timed nor counted.
+ *
+ * @param benchmark
+ * @param num_iterations
+ * @param num_allocations The allocations made by the timed operations, or -1 if they are not counted.
+ * @return The elapsed time in microseconds.
+ */
+static time_t time_benchmark(const Benchmark* benchmark, long num_iterations, long* num_allocations) {
+    if (benchmark->setup != NULL) {
+        benchmark->setup(benchmark->size, num_iterations);
+    }
+
+    const long start_allocations = get_num_allocations();
+    const time_t start_time = clock_get_time_us();
+
+    for (long iteration = 0; iteration < num_iterations; iteration++) {
+        benchmark->run(benchmark->size);
+    }
+
+    const time_t elapsed_time = clock_get_time_us() - start_time;
+    *num_allocations = start_allocations < 0 ? -1 : get_num_allocations() - start_allocations;
+
+    if (benchmark->teardown != NULL) {
+        benchmark->teardown(benchmark->size);
+    }
+
+    return elapsed_time;
+}
+
+/**
+ * Runs a benchmark with ever more iterations until it takes at least BENCH_MIN_TIME_US, then prints the last run.
+ */
+static void run_benchmark(const Benchmark* benchmark) {
+    long num_iterations = 1;
+    long num_allocations = 0;
+    time_t elapsed_time = time_benchmark(benchmark, num_iterations, &num_allocations);
+
+    while (elapsed_time < BENCH_MIN_TIME_US) {
+        // Aim past the minimum so the next run is usually the last, but never grow by more than 100x at once.
+        long next_iterations = elapsed_time > 0 ? num_iterations * BENCH_MIN_TIME_US * 3 / (2 * elapsed_time) : 0;
+        if (next_iterations > num_iterations * 100) {
+            next_iterations = num_iterations * 100;
+        }
+        if (next_iterations <= num_iterations) {
+            next_iterations = num_iterations * 2;
+        }
+
+        num_iterations = next_iterations;
+        elapsed_time = time_benchmark(benchmark, num_iterations, &num_allocations);
+    }
+
+    const double ns_per_op = (double) elapsed_time * 1000.0 / (double) num_iterations;
+    const double allocations_per_op = num_allocations < 0 ? -1.0 : (double) num_allocations / (double) num_iterations;
+
+    printf("{\"benchmark\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.1f, \"allocations_per_op\": %.2f}\n",
+           benchmark->name, num_iterations, ns_per_op, allocations_per_op);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : NULL;
+
+    for (int idx = 0; idx < NUM_BENCHMARKS; idx++) {
+        if (filter != NULL && strstr(BENCHMARKS[idx].name, filter) == NULL) {
+            continue;
+        }
+
+        run_benchmark(&BENCHMARKS[idx]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file assert.c
+ *
+ * The assertion every module reports errors through (see main.h). It lives apart from main so the benchmarks can link
+ * every module without the interpreter's entry point.
+ *
+ * A failed assertion prints its message and exits, unless the thread set a trap for it: the message is then kept in
+ * the trap and the thread jumps back to it. Whatever the failed call had allocated is left behind, so a trap is only
+ * worth setting around work whose owner can still be freed, such as compiling a script (see runtime_try_load).
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main.h"
+
+// The trap of the calling thread, or NULL if a failed assertion exits.
+static _Thread_local AssertTrap* trap = NULL;
+
+void assert(bool condition, const char* message, ...) {
+#if DISABLE_ASSERTS
+    return;
+# else
+    if(condition == true) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, message);
+
+    if (trap != NULL) {
+        AssertTrap* caught_trap = trap;
+        trap = NULL;
+
+        vsnprintf(caught_trap->message, sizeof(caught_trap->message), message, args);
+        va_end(args);
+        longjmp(caught_trap->jump, 1);
+    }
+
+    vfprintf(stderr, message, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+
+    exit(EXIT_FAILURE);
+#endif
+}
+
+/**
+ * Makes the next failed assertion on the calling thread jump back to the given trap instead of exiting, or makes it
+ * exit again if the trap is NULL. The trap is cleared once it catches an assertion. setjmp must have been called on
+ * the trap's jump by a function that is still running when the assertion fails.
+ */
+void assert_set_trap(AssertTrap* new_trap) {
+    trap = new_trap;
+}
@@ -0,0 +1,513 @@
+/**
+ * @file emitter.c
+ *
+ * The emitter thread. It is the only code that talks to the keyboard driver. Every running script hands it strokes in
+ * due-time order through its own channel, a lock-free single-producer/single-consumer ring; the emitter merges the
+ * channels, waits for each stroke's due time with the precise wait, and submits every stroke that is due at that
+ * instant as one batch. A slow driver call therefore only delays later strokes on the emitter and never the scheduling
+ * of routines.
+ *
+ * Besides its strokes, each channel publishes a time before which it will push nothing more. The emitter only commits
+ * to waiting for a stroke once every channel has promised past that stroke's due time, so a stroke from one script can
+ * never be held up behind a later stroke from another. Producers work ahead of their deadlines (see runtime_pool.c), so
+ * the promise normally runs well ahead of the stroke being waited on.
+ *
+ * The emitter thread runs at a raised priority, or as configured (see tuning.c).
+ *
+ * When nothing can be sent yet the emitter parks on a condition variable instead of spinning. Producers only take the
+ * lock to wake it, and only when the emitter has announced that it is parked.
+ *
+ * If timing is open (see timing.c), the emitter records the due time, send time and driver call time of every stroke
+ * it sends. The records of a batch are collected in a buffer preallocated for the largest possible batch and handed
+ * off after the driver call, so the strokes themselves are not delayed.
+ *
+ * Strokes can be cancelled at once (emitter_cancel), for a panic stop: from then on every stroke is dropped and every
+ * key the emitter holds down is released. While cancelling is enabled (emitter_set_cancellable), the emitter sleeps
+ * toward a stroke on a wake event that a cancel signals, so a cancel takes effect at once even while it is waiting,
+ * however coarse the system timer is.
+ *
+ * The keyboard only exists on Windows. Elsewhere, due strokes are discarded so scripts can be run and timed without
+ * the driver.
+ */
+
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "emitter.h"
+
+#define EMITTER_CACHE_LINE 64
+
+// One more than the highest keycode, counting keycodes sent with the E0 prefix (see keyboard.c).
+#define EMITTER_NUM_KEYCODES 2048
+
+/**
+ * @brief The producer side of one script.
+ * - ring: The strokes handed over by the producer, in due-time order.
+ * - promised_time: The producer will push no stroke due before this time.
+ */
+typedef struct {
+    alignas(EMITTER_CACHE_LINE) SpscRing* ring;
+    _Atomic(time_t) promised_time;
+} EmitterChannel;
+
+static EmitterChannel* channels = NULL;
+static int num_channels = 0;
+static pthread_t thread;
+
+static atomic_bool is_closing = false;
+static atomic_bool is_parked = false;
+static pthread_mutex_t park_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t park_cond = PTHREAD_COND_INITIALIZER;
+
+static atomic_bool is_cancellable = false;
+static atomic_bool is_cancelled = false;
+static atomic_bool is_cancel_pending = false;
+static WakeEvent* wait_event = NULL;
+
+// The keys the emitter has sent down and not yet up, so a cancel can release them. Only the emitter thread touches it.
+static bool held_keys[EMITTER_NUM_KEYCODES];
+
+#ifdef _WIN32
+static Keyboard* keyboard = NULL;
+#endif
+
+// The timing records of the batch being sent, or NULL if timing is not open. Only the emitter thread touches these.
+static TimingRecord* timing_batch = NULL;
+
+/**
+ * Returns the earliest time at which any channel may still push a stroke.
+ */
+static time_t get_promised_time() {
+    time_t promised_time = EMITTER_NEVER;
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        const time_t channel_time = atomic_load_explicit(&channels[channel].promised_time, memory_order_acquire);
+        if (channel_time < promised_time) {
+            promised_time = channel_time;
+        }
+    }
+
+    return promised_time;
+}
+
+/**
+ * Finds the channel whose next stroke is due first. Returns -1 if every channel is empty.
+ *
+ * @param event The next stroke of the returned channel.
+ * @return
+ */
+static int peek_earliest_channel(EmitterEvent* event) {
+    int earliest_channel = -1;
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        EmitterEvent channel_event;
+        if (spsc_ring_try_peek(channels[channel].ring, &channel_event) == false) {
+            continue;
+        }
+
+        if (earliest_channel < 0 || channel_event.due_time < event->due_time) {
+            earliest_channel = channel;
+            *event = channel_event;
+        }
+    }
+
+    return earliest_channel;
+}
+
+/**
+ * Returns true if there is a stroke the emitter can commit to waiting for: the earliest pushed stroke is due no later
+ * than every channel's promise. The promises are read before the rings, so a stroke pushed after the check is due at or
+ * after the promise that was read.
+ *
+ * @param event The stroke to wait for, if true is returned.
+ * @return
+ */
+static bool try_get_next_event(EmitterEvent* event) {
+    const time_t promised_time = get_promised_time();
+
+    if (peek_earliest_channel(event) < 0) {
+        return false;
+    }
+
+    return event->due_time <= promised_time;
+}
+
+/**
+ * Blocks until a producer pushes or promises something, or the emitter is closed.
+ */
+static void park() {
+    pthread_mutex_lock(&park_mutex);
+    atomic_store(&is_parked, true);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    // Check again after announcing, so a push that raced with the announcement is not missed.
+    EmitterEvent event;
+    while (try_get_next_event(&event) == false && atomic_load(&is_closing) == false &&
+           atomic_load(&is_cancel_pending) == false) {
+        pthread_cond_wait(&park_cond, &park_mutex);
+    }
+
+    atomic_store(&is_parked, false);
+    pthread_mutex_unlock(&park_mutex);
+}
+
+static void wake() {
+    // Orders the push or promise before reading the flag; pairs with the fence in park.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&is_parked) == false) {
+        return;
+    }
+
+    pthread_mutex_lock(&park_mutex);
+    pthread_cond_signal(&park_cond);
+    pthread_mutex_unlock(&park_mutex);
+}
+
+/**
+ * Sends every stroke that is due at the given time, across all channels and in due-time order, as a single batch.
+ *
+ * @param current_time
+ */
+static void emit_due_events(time_t current_time) {
+    EmitterEvent event;
+    int channel = peek_earliest_channel(&event);
+    int num_timed = 0;
+
+    while (channel >= 0 && event.due_time <= current_time) {
+#ifdef _WIN32
+        keyboard_queue_stroke(keyboard, event.keycode, event.is_key_down);
+#endif
+        if (event.keycode < EMITTER_NUM_KEYCODES) {
+            held_keys[event.keycode] = event.is_key_down;
+        }
+
+        if (timing_batch != NULL) {
+            timing_batch[num_timed++] = (TimingRecord) {
+                .due_time = event.due_time,
+                .channel = channel,
+                .handle = event.handle,
+            };
+        }
+
+        spsc_ring_try_pop(channels[channel].ring, NULL);
+        channel = peek_earliest_channel(&event);
+    }
+
+    const time_t send_time = timing_batch != NULL ? clock_get_time_us() : 0;
+
+#ifdef _WIN32
+    keyboard_flush(keyboard);
+#endif
+
+    if (num_timed > 0) {
+        const int driver_time_us = (int) (clock_get_time_us() - send_time);
+
+        for (int idx = 0; idx < num_timed; idx++) {
+            timing_batch[idx].send_time = send_time;
+            timing_batch[idx].driver_time_us = driver_time_us;
+            timing_record(&timing_batch[idx]);
+        }
+    }
+}
+
+/**
+ * Drops every stroke pushed so far and, the first time after a cancel, releases every key the emitter holds down.
+ * Strokes are dropped until the emitter is closed, since a push may have passed its check just before the cancel.
+ *
+ * @param should_release_keys
+ */
+static void cancel_events(bool should_release_keys) {
+    for (int keycode = 0; should_release_keys && keycode < EMITTER_NUM_KEYCODES; keycode++) {
+        if (held_keys[keycode] == false) {
+            continue;
+        }
+
+#ifdef _WIN32
+        keyboard_queue_stroke(keyboard, (unsigned short) keycode, false);
+#endif
+        held_keys[keycode] = false;
+    }
+
+#ifdef _WIN32
+    keyboard_flush(keyboard);
+#endif
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        while (spsc_ring_try_pop(channels[channel].ring, NULL)) {
+        }
+    }
+}
+
+/**
+ * Sleeps toward the due time of the given stroke until the deadline or until the wait event is signaled. Returns true
+ * if the wait should end: strokes were cancelled, or a reopened channel has pushed an earlier stroke, which then
+ * replaces the given one (see emitter_reopen_channel).
+ *
+ * @param deadline_us
+ * @param context The stroke being waited for.
+ * @return
+ */
+static bool sleep_until_woken(time_t deadline_us, void* context) {
+    EmitterEvent* event = (EmitterEvent*) context;
+    wake_event_wait_until_us(wait_event, deadline_us);
+
+    if (atomic_load(&is_cancelled)) {
+        return true;
+    }
+
+    EmitterEvent earliest_event;
+    if (try_get_next_event(&earliest_event) && earliest_event.due_time < event->due_time) {
+        *event = earliest_event;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Waits for the due time of the given stroke. While cancelling is enabled the wait can be woken, and the stroke is
+ * replaced by an earlier one if a reopened channel has pushed it. Returns false if strokes were cancelled during the
+ * wait.
+ *
+ * @param event
+ * @return
+ */
+static bool wait_for_event(EmitterEvent* event) {
+    if (atomic_load(&is_cancellable) == false) {
+        clock_wait_until_us(event->due_time);
+        return atomic_load(&is_cancelled) == false;
+    }
+
+    while (clock_wait_until_us_or_woken(event->due_time, sleep_until_woken, event) == false) {
+        if (atomic_load(&is_cancelled)) {
+            return false;
+        }
+    }
+
+    return atomic_load(&is_cancelled) == false;
+}
+
+static bool is_drained() {
+    for (int channel = 0; channel < num_channels; channel++) {
+        if (spsc_ring_is_empty(channels[channel].ring) == false) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void* emitter_run(void* argument) {
+    (void) argument;
+    tuning_tune_emitter_thread();
+
+    EmitterEvent event;
+    while (true) {
+        if (atomic_load(&is_cancelled)) {
+            cancel_events(atomic_exchange(&is_cancel_pending, false));
+        }
+
+        if (try_get_next_event(&event) == false) {
+            if (atomic_load(&is_closing) && is_drained()) {
+                break;
+            }
+
+            park();
+            continue;
+        }
+
+        if (wait_for_event(&event)) {
+            emit_due_events(clock_get_time_us());
+        }
+    }
+
+    tuning_release_thread();
+    return NULL;
+}
+
+/**
+ * Starts the emitter thread with the given number of channels, each holding up to capacity strokes. On Windows this
+ * opens the keyboard, which stays open until emitter_close. Strokes are only timed if timing was opened first.
+ *
+ * @param channel_count
+ * @param capacity
+ */
+void emitter_open(int channel_count, int capacity) {
+    assert(channels == NULL, "Attempting to open emitter that is already open.");
+    assert(channel_count > 0, "Attempting to open emitter with no channels.");
+
+    channels = (EmitterChannel*) mem_aligned_alloc(EMITTER_CACHE_LINE, sizeof(EmitterChannel) * channel_count);
+    assert(channels != NULL, "Failed to allocate memory for emitter channels.");
+    num_channels = channel_count;
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        channels[channel].ring = spsc_ring_new(capacity, sizeof(EmitterEvent));
+        atomic_init(&channels[channel].promised_time, 0);
+    }
+
+    atomic_store(&is_closing, false);
+    atomic_store(&is_parked, false);
+    atomic_store(&is_cancellable, false);
+    atomic_store(&is_cancelled, false);
+    atomic_store(&is_cancel_pending, false);
+    memset(held_keys, 0, sizeof(held_keys));
+    wait_event = wake_event_new();
+
+#ifdef _WIN32
+    keyboard = keyboard_new(capacity);
+#endif
+
+    // A batch holds at most every stroke in every ring.
+    if (timing_is_open()) {
+        const size_t max_batch_size = (size_t) num_channels * spsc_ring_get_capacity(channels[0].ring);
+        timing_batch = (TimingRecord*) malloc(sizeof(TimingRecord) * max_batch_size);
+        assert(timing_batch != NULL, "Failed to allocate memory for emitter timing records.");
+    }
+
+    const int result = pthread_create(&thread, NULL, emitter_run, NULL);
+    assert(result == 0, "Failed to create emitter thread (error %d).", result);
+}
+
+/**
+ * Stops the emitter thread once every stroke already pushed has been sent, then releases the channels and the
+ * keyboard. Channels that were not closed with emitter_close_channel are closed here.
+ */
+void emitter_close() {
+    if (channels == NULL) {
+        return;
+    }
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        atomic_store(&channels[channel].promised_time, EMITTER_NEVER);
+    }
+
+    pthread_mutex_lock(&park_mutex);
+    atomic_store(&is_closing, true);
+    pthread_cond_signal(&park_cond);
+    pthread_mutex_unlock(&park_mutex);
+
+    pthread_join(thread, NULL);
+    wake_event_delete(&wait_event);
+
+#ifdef _WIN32
+    if (keyboard != NULL) {
+        keyboard_delete(&keyboard);
+    }
+#endif
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        spsc_ring_delete(&channels[channel].ring);
+    }
+
+    mem_aligned_free(channels);
+    channels = NULL;
+    num_channels = 0;
+
+    free(timing_batch);
+    timing_batch = NULL;
+}
+
+/**
+ * Promises that the given channel will push no stroke due before the given time. Promises only move forward, and only
+ * the channel's producer may make them.
+ *
+ * @param channel
+ * @param promised_time
+ */
+void emitter_promise(int channel, time_t promised_time) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to promise on invalid emitter channel %d.", channel);
+
+    _Atomic(time_t)* channel_time = &channels[channel].promised_time;
+    if (promised_time <= atomic_load_explicit(channel_time, memory_order_relaxed)) {
+        return;
+    }
+
+    atomic_store_explicit(channel_time, promised_time, memory_order_release);
+    wake();
+}
+
+/**
+ * Reopens a channel that was closed, promising nothing before the given time. This is the one promise that may move
+ * backward, so it is only for scripts restarted by a hotkey (see hotkeys.c): the restarted script pushes nothing due
+ * before the current time, and with cancelling enabled the emitter switches to its strokes at once if it was already
+ * waiting on a later stroke of another channel.
+ *
+ * @param channel
+ * @param promised_time
+ */
+void emitter_reopen_channel(int channel, time_t promised_time) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to reopen invalid emitter channel %d.", channel);
+
+    atomic_store_explicit(&channels[channel].promised_time, promised_time, memory_order_release);
+    wake();
+
+    if (atomic_load(&is_cancellable)) {
+        wake_event_signal(wait_event);
+    }
+}
+
+/**
+ * Enables or disables waiting on the wake event, so a cancel or a reopened channel cuts the wait for a stroke short.
+ * Disabled when the emitter is opened, since only a hotkey listener (see hotkeys.c) ever cancels or reopens.
+ *
+ * @param should_be_cancellable
+ */
+void emitter_set_cancellable(bool should_be_cancellable) {
+    atomic_store(&is_cancellable, should_be_cancellable);
+}
+
+/**
+ * Cancels every stroke from now on and releases every key held down by a sent stroke. Strokes pushed afterwards are
+ * dropped, until the emitter is closed. May be called from any thread.
+ */
+void emitter_cancel() {
+    if (channels == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&park_mutex);
+    atomic_store(&is_cancelled, true);
+    atomic_store(&is_cancel_pending, true);
+    pthread_cond_signal(&park_cond);
+    pthread_mutex_unlock(&park_mutex);
+
+    wake_event_signal(wait_event);
+}
+
+/**
+ * Promises that the given channel will push nothing more.
+ *
+ * @param channel
+ */
+void emitter_close_channel(int channel) {
+    emitter_promise(channel, EMITTER_NEVER);
+}
+
+/**
+ * Hands a stroke to the emitter thread on the given channel. Strokes on a channel must be pushed in due-time order, so
+ * pushing a stroke also promises that the channel will push nothing due before it. If the ring is full the caller
+ * yields until the emitter makes room, so strokes are never dropped.
+ *
+ * @param channel
+ * @param event
+ */
+void emitter_push(int channel, const EmitterEvent* event) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to push event to invalid emitter channel %d.", channel);
+
+    if (atomic_load_explicit(&is_cancelled, memory_order_relaxed)) {
+        return;
+    }
+
+    SpscRing* ring = channels[channel].ring;
+    if (spsc_ring_try_push(ring, event) == false) {
+        // Promise up to this stroke first, so an emitter parked on this channel's promise can drain the full ring.
+        emitter_promise(channel, event->due_time);
+
+        while (spsc_ring_try_push(ring, event) == false) {
+            sched_yield();
+        }
+    }
+
+    emitter_promise(channel, event->due_time);
+}
@@ -0,0 +1,55 @@
+#ifndef BEANSCRIPT_EMITTER_H
+#define BEANSCRIPT_EMITTER_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include "src/keyboard/keyboard.h"
+#include "src/keyboard/timing.h"
+#include "src/utility/clock.h"
+#include "src/utility/spsc_ring.h"
+#include "src/utility/tuning.h"
+#include "src/utility/utility.h"
+#include "src/utility/wake_event.h"
+#include "src/main.h"
+
+/**
+ * @brief A stroke handed to the emitter thread.
+ * - due_time: The monotonic time (us) at which the stroke should be sent.
+ * - handle: The instruction that produced the stroke, for timing.
+ */
+typedef struct {
+    time_t due_time;
+    unsigned short keycode;
+    bool is_key_down;
+    int handle;
+} EmitterEvent;
+
+#define EMITTER_NEVER ((time_t) INT64_MAX)
+
+// Constructor and Destructor
+void    emitter_open(int channel_count, int capacity);
+void    emitter_close();
+
+// Mutator Functions
+void    emitter_set_cancellable(bool should_be_cancellable);
+void    emitter_cancel();
+
+// Producer Functions
+void    emitter_push(int channel, const EmitterEvent* event);
+void    emitter_promise(int channel, time_t promised_time);
+void    emitter_close_channel(int channel);
+void    emitter_reopen_channel(int channel, time_t promised_time);
+
+#endif //BEANSCRIPT_EMITTER_H
@@ -0,0 +1,328 @@
+/**
+ * @file hotkeys.c
+ *
+ * Buttons that control running scripts. A `script` with a button toggles the whole script, a `start` or `stop` with a
+ * button starts or stops its targets when the button is pressed, and the panic button (see main.c) stops everything.
+ *
+ * A listener thread keeps its own Interception context, filtered to key downs and key ups, and blocks in the driver
+ * until a stroke arrives. A stroke of a button nothing is bound to is passed straight back to its device after one
+ * table lookup, so normal typing is only delayed by the round trip through the driver. Bound buttons are swallowed, and
+ * act once per press however long they are held.
+ *
+ * A press is handed to the bound script through a lock-free ring per emitter channel, and the worker running the
+ * script is woken through its wake event, so it reacts at once instead of at its next deadline. The panic button
+ * cancels the emitter directly from the listener thread (see emitter_cancel), so nothing more is typed from the press
+ * on, and wakes every worker to stop its scripts.
+ *
+ * Buttons are intercepted only on Windows. Elsewhere nothing listens, and scripts run as if no button were bound.
+ */
+
+#include "hotkeys.h"
+
+// One more than the highest keycode, counting keycodes sent with the E0 prefix (see keyboard.c).
+#define HOTKEYS_NUM_KEYCODES 2048
+
+static const int HOTKEYS_COMMAND_CAPACITY = 64;
+
+/**
+ * @brief A button bound in a script.
+ * - channel: The emitter channel of the script the button is bound in.
+ */
+typedef struct {
+    unsigned short keycode;
+    int channel;
+    HotkeyAction action;
+    int handle;
+} HotkeyBinding;
+
+static SpscRing** commands = NULL;
+static WakeEvent** wake_events = NULL;
+static int num_channels = 0;
+
+// Guards the bindings and the wake events. is_bound mirrors the bindings so unbound strokes never take the lock.
+static HotkeyBinding* bindings = NULL;
+static int num_bindings = 0;
+static int bindings_capacity = 0;
+static atomic_bool is_bound[HOTKEYS_NUM_KEYCODES];
+static pthread_mutex_t bindings_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned short panic_button = 0;
+static atomic_bool is_listening = false;
+static atomic_bool is_panicked = false;
+
+#ifdef _WIN32
+static const unsigned long HOTKEYS_CLOSE_POLL_MS = 100;
+
+static Keyboard* keyboard = NULL;
+static pthread_t thread;
+static atomic_bool is_closing = false;
+
+// Whether each bound button is down. Only the listener thread touches it.
+static bool is_held[HOTKEYS_NUM_KEYCODES];
+
+/**
+ * Hands a press of a bound button to every script it is bound in.
+ */
+static void dispatch_press(unsigned short keycode) {
+    if (keycode == panic_button) {
+        hotkeys_panic();
+        return;
+    }
+
+    pthread_mutex_lock(&bindings_mutex);
+
+    for (int idx = 0; idx < num_bindings; idx++) {
+        const HotkeyBinding* binding = &bindings[idx];
+        if (binding->keycode != keycode) {
+            continue;
+        }
+
+        const HotkeyCommand command = { .action = binding->action, .handle = binding->handle };
+        spsc_ring_try_push(commands[binding->channel], &command);
+
+        if (wake_events[binding->channel] != NULL) {
+            wake_event_signal(wake_events[binding->channel]);
+        }
+    }
+
+    pthread_mutex_unlock(&bindings_mutex);
+}
+
+static void* hotkeys_listen(void* argument) {
+    (void) argument;
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    // The timeout only bounds how long closing takes; every stroke ends the wait as soon as it arrives.
+    while (atomic_load(&is_closing) == false) {
+        unsigned short keycode;
+        bool is_key_down;
+        if (keyboard_intercept_stroke(keyboard, HOTKEYS_CLOSE_POLL_MS, &keycode, &is_key_down) == false) {
+            continue;
+        }
+
+        if (keycode >= HOTKEYS_NUM_KEYCODES) {
+            keyboard_pass_stroke(keyboard);
+            continue;
+        }
+
+        const bool is_panic_button = panic_button != 0 && keycode == panic_button;
+        if (is_panic_button == false && atomic_load_explicit(&is_bound[keycode], memory_order_relaxed) == false) {
+            keyboard_pass_stroke(keyboard);
+            continue;
+        }
+
+        if (is_key_down && is_held[keycode] == false) {
+            dispatch_press(keycode);
+        }
+
+        is_held[keycode] = is_key_down;
+    }
+
+    return NULL;
+}
+#endif
+
+/**
+ * Starts listening for the buttons of scripts sent on the given number of emitter channels, and for the given panic
+ * button (0 for none). Must be called after the emitter is opened, since it makes the emitter cancellable.
+ *
+ * @param channel_count
+ * @param panic_keycode
+ */
+void hotkeys_open(int channel_count, unsigned short panic_keycode) {
+    assert(commands == NULL, "Attempting to open hotkeys that are already open.");
+    assert(channel_count > 0, "Attempting to open hotkeys with no channels.");
+
+    commands = (SpscRing**) malloc(sizeof(SpscRing*) * channel_count);
+    wake_events = (WakeEvent**) calloc(channel_count, sizeof(WakeEvent*));
+    assert(commands != NULL && wake_events != NULL, "Failed to allocate memory for hotkey channels.");
+
+    for (int channel = 0; channel < channel_count; channel++) {
+        commands[channel] = spsc_ring_new(HOTKEYS_COMMAND_CAPACITY, sizeof(HotkeyCommand));
+    }
+
+    num_channels = channel_count;
+    panic_button = panic_keycode;
+
+    for (int keycode = 0; keycode < HOTKEYS_NUM_KEYCODES; keycode++) {
+        atomic_init(&is_bound[keycode], false);
+    }
+
+    atomic_store(&is_panicked, false);
+    atomic_store(&is_listening, false);
+
+#ifdef _WIN32
+    keyboard = keyboard_new(1);
+    keyboard_listen(keyboard);
+    memset(is_held, 0, sizeof(is_held));
+
+    atomic_store(&is_closing, false);
+    atomic_store(&is_listening, true);
+    emitter_set_cancellable(true);
+
+    const int result = pthread_create(&thread, NULL, hotkeys_listen, NULL);
+    assert(result == 0, "Failed to create hotkey listener thread (error %d).", result);
+#endif
+}
+
+/**
+ * Stops listening and frees every binding. Buttons typed afterwards reach the system again.
+ */
+void hotkeys_close() {
+    if (commands == NULL) {
+        return;
+    }
+
+#ifdef _WIN32
+    if (atomic_load(&is_listening)) {
+        atomic_store(&is_closing, true);
+        pthread_join(thread, NULL);
+        keyboard_delete(&keyboard);
+    }
+#endif
+
+    atomic_store(&is_listening, false);
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        spsc_ring_delete(&commands[channel]);
+    }
+
+    free(commands);
+    free(wake_events);
+    free(bindings);
+
+    commands = NULL;
+    wake_events = NULL;
+    num_channels = 0;
+    bindings = NULL;
+    num_bindings = 0;
+    bindings_capacity = 0;
+}
+
+/**
+ * Returns true if buttons are being listened for. Scripts that bind buttons wait for them only if so.
+ */
+bool hotkeys_is_listening() {
+    return atomic_load(&is_listening);
+}
+
+/**
+ * Returns true once the panic button has been pressed.
+ */
+bool hotkeys_is_panicked() {
+    return atomic_load(&is_panicked);
+}
+
+/**
+ * Binds a button to an instruction of the script sent on the given channel. Pressing the button hands the script a
+ * command (see hotkeys_poll).
+ *
+ * @param channel
+ * @param keycode
+ * @param action
+ * @param handle
+ */
+void hotkeys_bind(int channel, unsigned short keycode, HotkeyAction action, int handle) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to bind button on invalid hotkey channel %d.", channel);
+    assert(keycode > 0 && keycode < HOTKEYS_NUM_KEYCODES, "Attempting to bind invalid button %d.", keycode);
+    assert(keycode != panic_button, "Attempting to bind the panic button in a script.");
+
+    pthread_mutex_lock(&bindings_mutex);
+
+    if (num_bindings == bindings_capacity) {
+        bindings_capacity = bindings_capacity > 0 ? 2 * bindings_capacity : 8;
+        bindings = (HotkeyBinding*) realloc(bindings, sizeof(HotkeyBinding) * bindings_capacity);
+        assert(bindings != NULL, "Failed to allocate memory for hotkey bindings.");
+    }
+
+    bindings[num_bindings++] = (HotkeyBinding) {
+        .keycode = keycode,
+        .channel = channel,
+        .action = action,
+        .handle = handle,
+    };
+    atomic_store(&is_bound[keycode], true);
+
+    pthread_mutex_unlock(&bindings_mutex);
+}
+
+/**
+ * Unbinds every button bound in the script sent on the given channel and drops the presses it has not polled yet, so a
+ * reloaded script can bind its buttons afresh (see runtime.c). Only the worker running the script may unbind it.
+ *
+ * @param channel
+ */
+void hotkeys_unbind(int channel) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to unbind buttons of invalid hotkey channel %d.",
+           channel);
+
+    pthread_mutex_lock(&bindings_mutex);
+
+    int num_kept = 0;
+    for (int idx = 0; idx < num_bindings; idx++) {
+        if (bindings[idx].channel != channel) {
+            bindings[num_kept++] = bindings[idx];
+            continue;
+        }
+
+        atomic_store(&is_bound[bindings[idx].keycode], false);
+    }
+
+    num_bindings = num_kept;
+    for (int idx = 0; idx < num_bindings; idx++) {
+        atomic_store(&is_bound[bindings[idx].keycode], true);
+    }
+
+    pthread_mutex_unlock(&bindings_mutex);
+
+    HotkeyCommand command;
+    while (spsc_ring_try_pop(commands[channel], &command)) {
+    }
+}
+
+/**
+ * Makes presses bound on the given channel signal the given wake event, so the worker running the script wakes up to
+ * handle them. May be NULL, and must be reset to NULL before the event is deleted.
+ *
+ * @param channel
+ * @param wake_event
+ */
+void hotkeys_set_wake_event(int channel, WakeEvent* wake_event) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to set wake event of invalid hotkey channel %d.",
+           channel);
+
+    pthread_mutex_lock(&bindings_mutex);
+    wake_events[channel] = wake_event;
+    pthread_mutex_unlock(&bindings_mutex);
+}
+
+/**
+ * Stops everything: cancels every stroke not yet sent, releases every held key and wakes every worker so it stops its
+ * scripts. Called by the listener thread when the panic button is pressed.
+ */
+void hotkeys_panic() {
+    atomic_store(&is_panicked, true);
+    emitter_cancel();
+
+    pthread_mutex_lock(&bindings_mutex);
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        if (wake_events[channel] != NULL) {
+            wake_event_signal(wake_events[channel]);
+        }
+    }
+
+    pthread_mutex_unlock(&bindings_mutex);
+}
+
+/**
+ * Takes the next press handed to the script sent on the given channel. Returns false if there is none. Only the worker
+ * running the script may poll its channel.
+ *
+ * @param channel
+ * @param command
+ * @return
+ */
+bool hotkeys_poll(int channel, HotkeyCommand* command) {
+    return spsc_ring_try_pop(commands[channel], command);
+}
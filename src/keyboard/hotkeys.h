@@ -0,0 +1,53 @@
+#ifndef BEANSCRIPT_HOTKEYS_H
+#define BEANSCRIPT_HOTKEYS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/keyboard/emitter.h"
+#include "src/keyboard/keyboard.h"
+#include "src/utility/spsc_ring.h"
+#include "src/utility/wake_event.h"
+#include "src/main.h"
+
+/**
+ * @brief What pressing a bound button does to the script it is bound in.
+ * - HOTKEY_TOGGLE: Stops the script, or starts its body again from the top (a `script` with a button).
+ * - HOTKEY_START, HOTKEY_STOP: Starts or stops the targets of a `start` or `stop` with a button.
+ */
+typedef enum {
+    HOTKEY_TOGGLE,
+    HOTKEY_START,
+    HOTKEY_STOP,
+} HotkeyAction;
+
+/**
+ * @brief A button press handed to the script it is bound in.
+ * - handle: The instruction the button is bound to.
+ */
+typedef struct {
+    HotkeyAction action;
+    int handle;
+} HotkeyCommand;
+
+// Constructor and Destructor
+void    hotkeys_open(int channel_count, unsigned short panic_keycode);
+void    hotkeys_close();
+
+// Accessor Functions
+bool    hotkeys_is_listening();
+bool    hotkeys_is_panicked();
+
+// Mutator Functions
+void    hotkeys_bind(int channel, unsigned short keycode, HotkeyAction action, int handle);
+void    hotkeys_unbind(int channel);
+void    hotkeys_set_wake_event(int channel, WakeEvent* wake_event);
+void    hotkeys_panic();
+
+// Consumer Functions
+bool    hotkeys_poll(int channel, HotkeyCommand* command);
+
+#endif //BEANSCRIPT_HOTKEYS_H
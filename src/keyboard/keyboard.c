@@ -1,81 +1,230 @@
-//
-//#include "keyboard.h"
-//
-//static int keyboard_detect_id() {
-//    InterceptionDevice current_keyboard = INTERCEPTION_KEYBOARD(1);
-//
-//    while (current_keyboard <= INTERCEPTION_KEYBOARD(INTERCEPTION_MAX_KEYBOARD)) {
-//        if (interception_is_keyboard(current_keyboard)) {
-//            return current_keyboard;
-//        }
-//
-//        current_keyboard++;
-//    }
-//
-//    assert(false, "Could not detect any keyboards.");
-//}
-//
-//Keyboard* keyboard_new() {
-//    Keyboard* keyboard = (Keyboard*) malloc(sizeof(Keyboard));
-//    assert(keyboard == NULL, "Could not allocate memory for keyboard.");
-//
-//    keyboard->id = keyboard_detect_id();
-//    keyboard->stroke = (InterceptionKeyStroke) { 0 };
-//
-//    keyboard->context = interception_create_context();
-//    interception_set_filter(keyboard->context, interception_is_keyboard, INTERCEPTION_FILTER_KEY_DOWN | INTERCEPTION_FILTER_KEY_UP);
-//
-//    return keyboard;
-//}
-//
-//void keyboard_delete(Keyboard** ptr_keyboard) {
-//    assert(ptr_keyboard != NULL, "Attempting to delete keyboard behind NULL pointer.");
-//    assert(*ptr_keyboard != NULL, "Attempting to delete NULL keyboard.");
-//
-//    Keyboard* keyboard = *ptr_keyboard;
-//    free(keyboard);
-//    *ptr_keyboard = NULL;
-//}
-//
-//bool keyboard_send(Keyboard* keyboard, const char* key_id) {
-//    assert(keyboard != NULL, "Attempting to send key to NULL keyboard.");
-//    assert(key_id != NULL, "Attempting to send NULL key to keyboard.");
-//
-//    Key* key = key_map_get(key_id);
-//    assert(key != NULL, "Attempting to send invalid key to keyboard.");
-//
-//    InterceptionContext context;
-//    InterceptionDevice device;
-//
-//    InterceptionKeyStroke stroke;
-//
-//    context = interception_create_context();
-//
-//    interception_set_filter(context, interception_is_keyboard, INTERCEPTION_FILTER_KEY_DOWN | INTERCEPTION_FILTER_KEY_UP);
-//
-//    while (interception_receive(context, device = interception_wait(context), (InterceptionStroke *)&stroke, 1) > 0) {
-//
-//        // This code simulates pressing the 'A' key once
-//        stroke.code = key->code;
-//        stroke.state = INTERCEPTION_KEY_DOWN;
-//        interception_send(context, device, (InterceptionStroke *)&stroke, 1);
-//
-//        stroke.state = INTERCEPTION_KEY_UP;
-//        interception_send(context, device, (InterceptionStroke *)&stroke, 1);
-//
-//        stroke.state = INTERCEPTION_KEY_DOWN;
-//        interception_send(context, device, (InterceptionStroke *)&stroke, 1);
-//
-//        stroke.state = INTERCEPTION_KEY_UP;
-//        interception_send(context, device, (InterceptionStroke *)&stroke, 1);
-//
-//        // Be careful with this infinite loop and the A key simulation.
-//        // It will simulate pressing A key continuously.
-//        // You might want to include a condition to break the loop.
-//        break;
-//    }
-//
-//    interception_destroy_context(context);
-//
-//    return true;
-//}
\ No newline at end of file
+/**
+ * @file keyboard.c
+ *
+ * The Interception output backend. A Keyboard keeps one InterceptionContext and one target device open for the whole
+ * run. Strokes are queued into a batch and submitted with a single interception_send call, so strokes due at the same
+ * time (chords, simultaneous releases, zero-duration taps) cost one driver round-trip.
+ *
+ * A keyboard can also capture the strokes typed on every keyboard (see trace.c). Each captured stroke is passed on to
+ * its device before anything else is done with it, so capturing adds no input latency beyond the driver's own. A
+ * keyboard can also listen for key presses (see hotkeys.c), in which case it decides for each intercepted stroke
+ * whether to pass it on (keyboard_pass_stroke) or to swallow it.
+ */
+
+#ifdef _WIN32
+
+#include "keyboard.h"
+
+// Keycodes above this offset are DirectInput codes for keys sent with the E0 prefix (see keycodes.c).
+static const unsigned short KEYCODE_EXTENDED_OFFSET = 1024;
+
+/**
+ * Returns the first keyboard device that is present on the system.
+ *
+ * @param context
+ * @return
+ */
+static InterceptionDevice keyboard_detect_id(InterceptionContext context) {
+    char hardware_id[512];
+
+    for (int idx = 0; idx < INTERCEPTION_MAX_KEYBOARD; idx++) {
+        const InterceptionDevice current_keyboard = INTERCEPTION_KEYBOARD(idx);
+
+        if (interception_get_hardware_id(context, current_keyboard, hardware_id, sizeof(hardware_id)) > 0) {
+            return current_keyboard;
+        }
+    }
+
+    assert(false, "Could not detect any keyboards.");
+    return INTERCEPTION_KEYBOARD(0);
+}
+
+/**
+ * Creates a keyboard with an open Interception context and a stroke batch of the given initial capacity.
+ *
+ * @param capacity
+ * @return
+ */
+Keyboard* keyboard_new(int capacity) {
+    assert(capacity > 0, "Attempting to create keyboard with capacity less than 1.");
+
+    Keyboard* keyboard = (Keyboard*) malloc(sizeof(Keyboard));
+    assert(keyboard != NULL, "Could not allocate memory for keyboard.");
+
+    keyboard->context = interception_create_context();
+    assert(keyboard->context != NULL, "Could not create interception context. Is the interception driver installed?");
+
+    keyboard->id = keyboard_detect_id(keyboard->context);
+
+    keyboard->strokes = (InterceptionKeyStroke*) malloc(sizeof(InterceptionKeyStroke) * capacity);
+    assert(keyboard->strokes != NULL, "Could not allocate memory for keyboard strokes.");
+
+    keyboard->num_strokes = 0;
+    keyboard->capacity = capacity;
+
+    return keyboard;
+}
+
+void keyboard_delete(Keyboard** ptr_keyboard) {
+    assert(ptr_keyboard != NULL, "Attempting to delete keyboard behind NULL pointer.");
+    assert(*ptr_keyboard != NULL, "Attempting to delete NULL keyboard.");
+
+    Keyboard* keyboard = *ptr_keyboard;
+
+    interception_destroy_context(keyboard->context);
+    keyboard->context = NULL;
+
+    free(keyboard->strokes);
+    keyboard->strokes = NULL;
+
+    free(keyboard);
+    *ptr_keyboard = NULL;
+}
+
+/**
+ * Appends a stroke to the pending batch. Nothing is sent until keyboard_flush is called.
+ *
+ * @param keyboard
+ * @param keycode
+ * @param is_key_down
+ */
+void keyboard_queue_stroke(Keyboard* keyboard, unsigned short keycode, bool is_key_down) {
+    assert(keyboard != NULL, "Attempting to queue stroke to NULL keyboard.");
+
+    if (keyboard->num_strokes >= keyboard->capacity) {
+        keyboard->capacity *= 2;
+        keyboard->strokes = (InterceptionKeyStroke*) realloc(keyboard->strokes, sizeof(InterceptionKeyStroke) * keyboard->capacity);
+        assert(keyboard->strokes != NULL, "Could not allocate memory for keyboard strokes.");
+    }
+
+    InterceptionKeyStroke* stroke = &keyboard->strokes[keyboard->num_strokes++];
+    stroke->information = 0;
+    stroke->state = is_key_down ? INTERCEPTION_KEY_DOWN : INTERCEPTION_KEY_UP;
+
+    if (keycode >= KEYCODE_EXTENDED_OFFSET) {
+        stroke->code = (keycode - KEYCODE_EXTENDED_OFFSET) & 0x7F;
+        stroke->state |= INTERCEPTION_KEY_E0;
+    } else {
+        stroke->code = keycode;
+    }
+}
+
+/**
+ * Submits every queued stroke with a single interception_send call and empties the batch. Returns the number of
+ * strokes the driver accepted.
+ *
+ * @param keyboard
+ * @return
+ */
+int keyboard_flush(Keyboard* keyboard) {
+    assert(keyboard != NULL, "Attempting to flush NULL keyboard.");
+
+    if (keyboard->num_strokes == 0) {
+        return 0;
+    }
+
+    const int num_sent = interception_send(keyboard->context, keyboard->id,
+                                           (const InterceptionStroke*) keyboard->strokes, keyboard->num_strokes);
+    keyboard->num_strokes = 0;
+
+    return num_sent;
+}
+
+/**
+ * Starts capturing every stroke typed on any keyboard. Captured strokes are withheld from the system until they are
+ * received (see keyboard_receive_stroke), so a capturing keyboard must keep receiving.
+ *
+ * @param keyboard
+ */
+void keyboard_capture(Keyboard* keyboard) {
+    assert(keyboard != NULL, "Attempting to capture with NULL keyboard.");
+
+    interception_set_filter(keyboard->context, interception_is_keyboard, INTERCEPTION_FILTER_KEY_ALL);
+}
+
+/**
+ * Starts intercepting every key down and key up, plain or extended, typed on any keyboard. Intercepted strokes are
+ * withheld from the system until they are passed on (see keyboard_pass_stroke).
+ *
+ * @param keyboard
+ */
+void keyboard_listen(Keyboard* keyboard) {
+    assert(keyboard != NULL, "Attempting to listen with NULL keyboard.");
+
+    interception_set_filter(keyboard->context, interception_is_keyboard,
+                            INTERCEPTION_FILTER_KEY_DOWN | INTERCEPTION_FILTER_KEY_UP |
+                            INTERCEPTION_FILTER_KEY_E0 | INTERCEPTION_FILTER_KEY_E1);
+}
+
+/**
+ * Waits up to the given time for an intercepted stroke and returns it in the keycode convention of
+ * keyboard_queue_stroke. The stroke is held back until keyboard_pass_stroke is called, and is swallowed otherwise.
+ * Returns false if no keyboard stroke arrived in time.
+ *
+ * @param keyboard
+ * @param timeout_ms
+ * @param keycode
+ * @param is_key_down
+ * @return
+ */
+bool keyboard_intercept_stroke(Keyboard* keyboard, unsigned long timeout_ms, unsigned short* keycode,
+                               bool* is_key_down) {
+    assert(keyboard != NULL, "Attempting to intercept stroke from NULL keyboard.");
+
+    const InterceptionDevice device = interception_wait_with_timeout(keyboard->context, timeout_ms);
+    if (interception_is_invalid(device) || interception_is_keyboard(device) == false) {
+        return false;
+    }
+
+    if (interception_receive(keyboard->context, device, &keyboard->held_stroke, 1) <= 0) {
+        return false;
+    }
+
+    keyboard->held_device = device;
+
+    const InterceptionKeyStroke* key_stroke = (const InterceptionKeyStroke*) &keyboard->held_stroke;
+    const bool is_extended = (key_stroke->state & INTERCEPTION_KEY_E0) != 0;
+
+    *keycode = is_extended ? (unsigned short) (key_stroke->code + KEYCODE_EXTENDED_OFFSET) : key_stroke->code;
+    *is_key_down = (key_stroke->state & INTERCEPTION_KEY_UP) == 0;
+
+    return true;
+}
+
+/**
+ * Passes the last intercepted stroke on to the device it came from, as if it had never been intercepted.
+ *
+ * @param keyboard
+ */
+void keyboard_pass_stroke(Keyboard* keyboard) {
+    assert(keyboard != NULL, "Attempting to pass stroke of NULL keyboard.");
+
+    interception_send(keyboard->context, keyboard->held_device, (const InterceptionStroke*) &keyboard->held_stroke, 1);
+}
+
+/**
+ * Waits up to the given time for a captured stroke, passes it on to the device it came from and returns it in the
+ * keycode convention of keyboard_queue_stroke. Returns false if no keyboard stroke arrived in time.
+ *
+ * @param keyboard
+ * @param timeout_ms
+ * @param keycode
+ * @param is_key_down
+ * @param receive_time The monotonic time (us) the stroke was received at.
+ * @return
+ */
+bool keyboard_receive_stroke(Keyboard* keyboard, unsigned long timeout_ms, unsigned short* keycode, bool* is_key_down,
+                             time_t* receive_time) {
+    if (keyboard_intercept_stroke(keyboard, timeout_ms, keycode, is_key_down) == false) {
+        return false;
+    }
+
+    *receive_time = clock_get_time_us();
+
+    // Forward at once, so the stroke reaches the system as if it had never been captured.
+    keyboard_pass_stroke(keyboard);
+
+    return true;
+}
+
+#endif
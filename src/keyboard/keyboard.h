@@ -5,20 +5,41 @@
 
 #include <errno.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include "interception.h"
 #include "./keycodes.h"
+#include "src/utility/clock.h"
 
+/**
+ * @brief An open Interception keyboard and its pending stroke batch.
+ * - id: The device strokes are sent to.
+ * - context: The Interception context, kept open for the lifetime of the keyboard.
+ * - strokes: The pending batch, submitted by keyboard_flush.
+ * - held_device, held_stroke: The last intercepted stroke and the device it came from (see keyboard_intercept_stroke).
+ */
 typedef struct {
     InterceptionDevice id;
     InterceptionContext context;
-    InterceptionKeyStroke stroke;
+    InterceptionKeyStroke* strokes;
+    int num_strokes;
+    int capacity;
+    InterceptionDevice held_device;
+    InterceptionStroke held_stroke;
 } Keyboard;
 
-Keyboard* keyboard_new();
+Keyboard* keyboard_new(int capacity);
 void keyboard_delete(Keyboard** ptr_keyboard);
-bool keyboard_send(Keyboard* keyboard, const char* key_id);
+void keyboard_queue_stroke(Keyboard* keyboard, unsigned short keycode, bool is_key_down);
+int keyboard_flush(Keyboard* keyboard);
+void keyboard_capture(Keyboard* keyboard);
+void keyboard_listen(Keyboard* keyboard);
+bool keyboard_intercept_stroke(Keyboard* keyboard, unsigned long timeout_ms, unsigned short* keycode,
+                               bool* is_key_down);
+void keyboard_pass_stroke(Keyboard* keyboard);
+bool keyboard_receive_stroke(Keyboard* keyboard, unsigned long timeout_ms, unsigned short* keycode, bool* is_key_down,
+                             time_t* receive_time);
 
 #endif
 
-#endif //BEANSCRIPT_KEYBOARD_H
\ No newline at end of file
+#endif //BEANSCRIPT_KEYBOARD_H
@@ -1,167 +1,298 @@
+/**
+ * @file keycodes.c
+ *
+ * The scancode of every button a script can name. The tables are static and constant, so lookups need no setup and
+ * never allocate. A single-character button is found by indexing a table with its character; any other button is found
+ * by switching on its length and first character, which narrows it to one candidate, and comparing the candidate once.
+ */
 
 #include "keycodes.h"
 
-static Key* keys = NULL;
-
-static void key_map_insert(const char* id, unsigned short code) {
-    Key* current_key = NULL;
-
-    HASH_FIND_STR(keys, id, current_key);
-    assert(current_key == NULL, "Attempting to insert duplicate key into keycodes.");
-
-    current_key = (Key*) malloc(sizeof(Key));
-    assert(current_key != NULL, "Could not allocate memory for key.");
-    current_key->id = id;
-    current_key->code = code;
-
-    HASH_ADD_STR(keys, id, current_key);
-}
-
-void key_map_create() {
-    assert(keys == NULL, "Attempting to create key map when one already exists.");
-    key_map_insert("none", 0x00);
-    key_map_insert("escape", 0x01);
-    key_map_insert("f1", 0x3B);
-    key_map_insert("f2", 0x3C);
-    key_map_insert("f3", 0x3D);
-    key_map_insert("f4", 0x3E);
-    key_map_insert("f5", 0x3F);
-    key_map_insert("f6", 0x40);
-    key_map_insert("f7", 0x41);
-    key_map_insert("f8", 0x42);
-    key_map_insert("f9", 0x43);
-    key_map_insert("f10", 0x44);
-    key_map_insert("f11", 0x57);
-    key_map_insert("f12", 0x58);
-    key_map_insert("printscreen", 0xB7);
-    key_map_insert("scrolllock", 0x46);
-    key_map_insert("pause", 0xC5);
-    key_map_insert("`", 0x29);
-    key_map_insert("1", 0x02);
-    key_map_insert("2", 0x03);
-    key_map_insert("3", 0x04);
-    key_map_insert("4", 0x05);
-    key_map_insert("5", 0x06);
-    key_map_insert("6", 0x07);
-    key_map_insert("7", 0x08);
-    key_map_insert("8", 0x09);
-    key_map_insert("9", 0x0A);
-    key_map_insert("0", 0x0B);
-    key_map_insert("-", 0x0C);
-    key_map_insert("=", 0x0D);
-    key_map_insert("backspace", 0x0E);
-    key_map_insert("insert", 0xD2 + 1024);
-    key_map_insert("home", 0xC7 + 1024);
-    key_map_insert("pageup", 0xC9 + 1024);
-    key_map_insert("pagedown", 0xD1 + 1024);
-    key_map_insert("numberlock", 0x45);
-    key_map_insert("divide", 0xB5 + 1024);
-    key_map_insert("multiply", 0x37);
-    key_map_insert("subtract", 0x4A);
-    key_map_insert("add", 0x4E);
-    key_map_insert("decimal", 0x53);
-    key_map_insert("tab", 0x0F);
-    key_map_insert("q", 0x10);
-    key_map_insert("w", 0x11);
-    key_map_insert("e", 0x12);
-    key_map_insert("r", 0x13);
-    key_map_insert("t", 0x14);
-    key_map_insert("y", 0x2C);
-    key_map_insert("u", 0x16);
-    key_map_insert("i", 0x17);
-    key_map_insert("o", 0x18);
-    key_map_insert("p", 0x19);
-    key_map_insert("[", 0x1A);
-    key_map_insert("]", 0x1B);
-    key_map_insert("\\", 0x2B);
-    key_map_insert("delete", 0xD3 + 1024);
-    key_map_insert("end", 0xCF + 1024);
-    key_map_insert("capslock", 0x3A);
-    key_map_insert("a", 0x1E);
-    key_map_insert("s", 0x1F);
-    key_map_insert("d", 0x20);
-    key_map_insert("f", 0x21);
-    key_map_insert("g", 0x22);
-    key_map_insert("h", 0x23);
-    key_map_insert("j", 0x24);
-    key_map_insert("k", 0x25);
-    key_map_insert("l", 0x26);
-    key_map_insert(";", 0x27);
-    key_map_insert("'", 0x28);
-    key_map_insert("enter", 0x1C);
-    key_map_insert("return", 0x1C);
-    key_map_insert("shift", 0x2A);
-    key_map_insert("z", 0x15);
-    key_map_insert("x", 0x2D);
-    key_map_insert("c", 0x2E);
-    key_map_insert("v", 0x2F);
-    key_map_insert("b", 0x30);
-    key_map_insert("n", 0x31);
-    key_map_insert("m", 0x32);
-    key_map_insert(",", 0x33);
-    key_map_insert(".", 0x34);
-    key_map_insert("/", 0x35);
-    key_map_insert("shiftright", 0x36);
-    key_map_insert("ctrl", 0x1D);
-    key_map_insert("window", 0xDB + 1024);
-    key_map_insert("alt", 0x38);
-    key_map_insert("space", 0x39);
-    key_map_insert("altright", 0xB8 + 1024);
-    key_map_insert("windowright", 0xDC + 1024);
-    key_map_insert("apps", 0xDD + 1024);
-    key_map_insert("ctrlright", 0x9D + 1024);
-
 #ifdef __linux__
     // These actually are incorrect, however are placeholder since
     // we use WSL  for debugging / memory checking.
-    key_map_insert("up", 0x9D + 1025);
-    key_map_insert("left", 0x9D + 1025);
-    key_map_insert("down", 0x9D + 1025);
-    key_map_insert("right", 0x9D + 1025);
+    #define KEY_CODE_UP (0x9D + 1025)
+    #define KEY_CODE_LEFT (0x9D + 1025)
+    #define KEY_CODE_DOWN (0x9D + 1025)
+    #define KEY_CODE_RIGHT (0x9D + 1025)
 #else
-    key_map_insert("up", MapVirtualKeyW(0x26, 0));
-    key_map_insert("left", MapVirtualKeyW(0x25, 0));
-    key_map_insert("down", MapVirtualKeyW(0x28, 0));
-    key_map_insert("right", MapVirtualKeyW(0x27, 0));
+    // The scancodes MapVirtualKeyW gives for VK_UP, VK_LEFT, VK_DOWN and VK_RIGHT.
+    #define KEY_CODE_UP 0x48
+    #define KEY_CODE_LEFT 0x4B
+    #define KEY_CODE_DOWN 0x50
+    #define KEY_CODE_RIGHT 0x4D
 #endif
-}
 
-void key_map_clear() {
-    Key* current_key, *tmp;
+/**
+ * The buttons whose names are longer than one character. F1 to F9 and F10 to F12 must stay consecutive.
+ */
+typedef enum {
+    KEY_NONE,
+    KEY_ESCAPE,
+    KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9,
+    KEY_F10, KEY_F11, KEY_F12,
+    KEY_PRINTSCREEN,
+    KEY_SCROLLLOCK,
+    KEY_PAUSE,
+    KEY_BACKSPACE,
+    KEY_INSERT,
+    KEY_HOME,
+    KEY_PAGEUP,
+    KEY_PAGEDOWN,
+    KEY_NUMBERLOCK,
+    KEY_DIVIDE,
+    KEY_MULTIPLY,
+    KEY_SUBTRACT,
+    KEY_ADD,
+    KEY_DECIMAL,
+    KEY_TAB,
+    KEY_DELETE,
+    KEY_END,
+    KEY_CAPSLOCK,
+    KEY_ENTER,
+    KEY_RETURN,
+    KEY_SHIFT,
+    KEY_SHIFTRIGHT,
+    KEY_CTRL,
+    KEY_WINDOW,
+    KEY_ALT,
+    KEY_SPACE,
+    KEY_ALTRIGHT,
+    KEY_WINDOWRIGHT,
+    KEY_APPS,
+    KEY_CTRLRIGHT,
+    KEY_UP,
+    KEY_LEFT,
+    KEY_DOWN,
+    KEY_RIGHT,
+    NUM_NAMED_KEYS,
+} NamedKey;
 
-    HASH_ITER(hh, keys, current_key, tmp) {
-        HASH_DEL(keys, current_key);
-        free(current_key);
-    }
+static const Key NAMED_KEYS[NUM_NAMED_KEYS] = {
+    [KEY_NONE] = { "none", 0x00 },
+    [KEY_ESCAPE] = { "escape", 0x01 },
+    [KEY_F1] = { "f1", 0x3B },
+    [KEY_F2] = { "f2", 0x3C },
+    [KEY_F3] = { "f3", 0x3D },
+    [KEY_F4] = { "f4", 0x3E },
+    [KEY_F5] = { "f5", 0x3F },
+    [KEY_F6] = { "f6", 0x40 },
+    [KEY_F7] = { "f7", 0x41 },
+    [KEY_F8] = { "f8", 0x42 },
+    [KEY_F9] = { "f9", 0x43 },
+    [KEY_F10] = { "f10", 0x44 },
+    [KEY_F11] = { "f11", 0x57 },
+    [KEY_F12] = { "f12", 0x58 },
+    [KEY_PRINTSCREEN] = { "printscreen", 0xB7 },
+    [KEY_SCROLLLOCK] = { "scrolllock", 0x46 },
+    [KEY_PAUSE] = { "pause", 0xC5 },
+    [KEY_BACKSPACE] = { "backspace", 0x0E },
+    [KEY_INSERT] = { "insert", 0xD2 + 1024 },
+    [KEY_HOME] = { "home", 0xC7 + 1024 },
+    [KEY_PAGEUP] = { "pageup", 0xC9 + 1024 },
+    [KEY_PAGEDOWN] = { "pagedown", 0xD1 + 1024 },
+    [KEY_NUMBERLOCK] = { "numberlock", 0x45 },
+    [KEY_DIVIDE] = { "divide", 0xB5 + 1024 },
+    [KEY_MULTIPLY] = { "multiply", 0x37 },
+    [KEY_SUBTRACT] = { "subtract", 0x4A },
+    [KEY_ADD] = { "add", 0x4E },
+    [KEY_DECIMAL] = { "decimal", 0x53 },
+    [KEY_TAB] = { "tab", 0x0F },
+    [KEY_DELETE] = { "delete", 0xD3 + 1024 },
+    [KEY_END] = { "end", 0xCF + 1024 },
+    [KEY_CAPSLOCK] = { "capslock", 0x3A },
+    [KEY_ENTER] = { "enter", 0x1C },
+    [KEY_RETURN] = { "return", 0x1C },
+    [KEY_SHIFT] = { "shift", 0x2A },
+    [KEY_SHIFTRIGHT] = { "shiftright", 0x36 },
+    [KEY_CTRL] = { "ctrl", 0x1D },
+    [KEY_WINDOW] = { "window", 0xDB + 1024 },
+    [KEY_ALT] = { "alt", 0x38 },
+    [KEY_SPACE] = { "space", 0x39 },
+    [KEY_ALTRIGHT] = { "altright", 0xB8 + 1024 },
+    [KEY_WINDOWRIGHT] = { "windowright", 0xDC + 1024 },
+    [KEY_APPS] = { "apps", 0xDD + 1024 },
+    [KEY_CTRLRIGHT] = { "ctrlright", 0x9D + 1024 },
+    [KEY_UP] = { "up", KEY_CODE_UP },
+    [KEY_LEFT] = { "left", KEY_CODE_LEFT },
+    [KEY_DOWN] = { "down", KEY_CODE_DOWN },
+    [KEY_RIGHT] = { "right", KEY_CODE_RIGHT },
+};
 
-    keys = NULL;
+/**
+ * The buttons named by a single character, indexed by that character. Characters that are not buttons have no id.
+ */
+static const Key CHAR_KEYS[128] = {
+    ['`'] = { "`", 0x29 },
+    ['1'] = { "1", 0x02 },
+    ['2'] = { "2", 0x03 },
+    ['3'] = { "3", 0x04 },
+    ['4'] = { "4", 0x05 },
+    ['5'] = { "5", 0x06 },
+    ['6'] = { "6", 0x07 },
+    ['7'] = { "7", 0x08 },
+    ['8'] = { "8", 0x09 },
+    ['9'] = { "9", 0x0A },
+    ['0'] = { "0", 0x0B },
+    ['-'] = { "-", 0x0C },
+    ['='] = { "=", 0x0D },
+    ['q'] = { "q", 0x10 },
+    ['w'] = { "w", 0x11 },
+    ['e'] = { "e", 0x12 },
+    ['r'] = { "r", 0x13 },
+    ['t'] = { "t", 0x14 },
+    ['y'] = { "y", 0x2C },
+    ['u'] = { "u", 0x16 },
+    ['i'] = { "i", 0x17 },
+    ['o'] = { "o", 0x18 },
+    ['p'] = { "p", 0x19 },
+    ['['] = { "[", 0x1A },
+    [']'] = { "]", 0x1B },
+    ['\\'] = { "\\", 0x2B },
+    ['a'] = { "a", 0x1E },
+    ['s'] = { "s", 0x1F },
+    ['d'] = { "d", 0x20 },
+    ['f'] = { "f", 0x21 },
+    ['g'] = { "g", 0x22 },
+    ['h'] = { "h", 0x23 },
+    ['j'] = { "j", 0x24 },
+    ['k'] = { "k", 0x25 },
+    ['l'] = { "l", 0x26 },
+    [';'] = { ";", 0x27 },
+    ['\''] = { "'", 0x28 },
+    ['z'] = { "z", 0x15 },
+    ['x'] = { "x", 0x2D },
+    ['c'] = { "c", 0x2E },
+    ['v'] = { "v", 0x2F },
+    ['b'] = { "b", 0x30 },
+    ['n'] = { "n", 0x31 },
+    ['m'] = { "m", 0x32 },
+    [','] = { ",", 0x33 },
+    ['.'] = { ".", 0x34 },
+    ['/'] = { "/", 0x35 },
+};
+
+/**
+ * Returns the only named button the id can be, going by its length and first characters, or -1 if it can be none.
+ * The candidate still has to be compared with the id.
+ */
+static int find_named_key_candidate(const char* id, size_t length) {
+    switch (length) {
+        case 2:
+            if (id[0] == 'f' && id[1] >= '1' && id[1] <= '9') {
+                return KEY_F1 + (id[1] - '1');
+            }
+            return id[0] == 'u' ? KEY_UP : -1;
+        case 3:
+            switch (id[0]) {
+                case 'f': return id[1] == '1' && id[2] >= '0' && id[2] <= '2' ? KEY_F10 + (id[2] - '0') : -1;
+                case 'a': return id[2] == 'd' ? KEY_ADD : KEY_ALT;
+                case 't': return KEY_TAB;
+                case 'e': return KEY_END;
+                default: return -1;
+            }
+        case 4:
+            switch (id[0]) {
+                case 'n': return KEY_NONE;
+                case 'h': return KEY_HOME;
+                case 'c': return KEY_CTRL;
+                case 'a': return KEY_APPS;
+                case 'l': return KEY_LEFT;
+                case 'd': return KEY_DOWN;
+                default: return -1;
+            }
+        case 5:
+            switch (id[0]) {
+                case 'p': return KEY_PAUSE;
+                case 'e': return KEY_ENTER;
+                case 's': return id[1] == 'h' ? KEY_SHIFT : KEY_SPACE;
+                case 'r': return KEY_RIGHT;
+                default: return -1;
+            }
+        case 6:
+            switch (id[0]) {
+                case 'e': return KEY_ESCAPE;
+                case 'i': return KEY_INSERT;
+                case 'p': return KEY_PAGEUP;
+                case 'd': return id[2] == 'v' ? KEY_DIVIDE : KEY_DELETE;
+                case 'r': return KEY_RETURN;
+                case 'w': return KEY_WINDOW;
+                default: return -1;
+            }
+        case 7:
+            return id[0] == 'd' ? KEY_DECIMAL : -1;
+        case 8:
+            switch (id[0]) {
+                case 'p': return KEY_PAGEDOWN;
+                case 'm': return KEY_MULTIPLY;
+                case 's': return KEY_SUBTRACT;
+                case 'c': return KEY_CAPSLOCK;
+                case 'a': return KEY_ALTRIGHT;
+                default: return -1;
+            }
+        case 9:
+            switch (id[0]) {
+                case 'b': return KEY_BACKSPACE;
+                case 'c': return KEY_CTRLRIGHT;
+                default: return -1;
+            }
+        case 10:
+            switch (id[0]) {
+                case 's': return id[1] == 'c' ? KEY_SCROLLLOCK : KEY_SHIFTRIGHT;
+                case 'n': return KEY_NUMBERLOCK;
+                default: return -1;
+            }
+        case 11:
+            switch (id[0]) {
+                case 'p': return KEY_PRINTSCREEN;
+                case 'w': return KEY_WINDOWRIGHT;
+                default: return -1;
+            }
+        default:
+            return -1;
+    }
 }
 
-Key* key_map_get(const char* id) {
-    // assert(keys != NULL, "Attempting to get key from key map when one does not exist.");
-    if (keys == NULL) {
-        key_map_create();
+/**
+ * Returns the button with the given id, or NULL if there is no such button.
+ */
+const Key* key_map_get(const char* id) {
+    assert(id != NULL, "Attempting to get key with NULL id.");
+
+    const size_t length = strlen(id);
+    if (length == 1) {
+        const unsigned char character = (unsigned char) id[0];
+        if (character >= sizeof(CHAR_KEYS) / sizeof(CHAR_KEYS[0]) || CHAR_KEYS[character].id == NULL) {
+            return NULL;
+        }
+
+        return &CHAR_KEYS[character];
     }
 
-    Key* current_key = NULL;
-    HASH_FIND_STR(keys, id, current_key);
+    const int candidate = find_named_key_candidate(id, length);
+    if (candidate < 0 || strcmp(NAMED_KEYS[candidate].id, id) != 0) {
+        return NULL;
+    }
 
-    return current_key;
+    return &NAMED_KEYS[candidate];
 }
 
+/**
+ * Returns the id of a button with the given code, or NULL if there is none. Where several buttons share a code, the
+ * first named button is returned.
+ */
 const char* key_map_get_id(unsigned short code) {
-    // assert(keys != NULL, "Attempting to get key from key map when one does not exist.");
-    if (keys == NULL) {
-        key_map_create();
+    for (int idx = 0; idx < NUM_NAMED_KEYS; idx++) {
+        if (NAMED_KEYS[idx].code == code) {
+            return NAMED_KEYS[idx].id;
+        }
     }
 
-    Key* current_key = NULL, *tmp;
-    HASH_ITER(hh, keys, current_key, tmp) {
-        if (current_key->code == code) {
-            return current_key->id;
+    for (size_t character = 0; character < sizeof(CHAR_KEYS) / sizeof(CHAR_KEYS[0]); character++) {
+        if (CHAR_KEYS[character].id != NULL && CHAR_KEYS[character].code == code) {
+            return CHAR_KEYS[character].id;
         }
     }
 
     return NULL;
 }
-
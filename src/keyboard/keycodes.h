@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -14,18 +15,14 @@
 #endif
 
 #include "src/main.h"
-#include "src/utility/uthash.h"
 
 typedef struct {
     const char *id;
     unsigned short code;
-    UT_hash_handle hh;
 } Key;
 
 
-void key_map_create();
-void key_map_clear();
-Key* key_map_get(const char* id);
+const Key* key_map_get(const char* id);
 const char* key_map_get_id(unsigned short code);
 
-#endif //BEANSCRIPT_KEYCODES_H
\ No newline at end of file
+#endif //BEANSCRIPT_KEYCODES_H
@@ -0,0 +1,136 @@
+/**
+ * @file null_sink.c
+ *
+ * An output sink that sends nothing. Strokes flushed to it (see output.c) are summarized per instruction instead of
+ * being handed to the emitter, so a script can run against a virtual clock with no driver and no emitter thread (see
+ * runtime_pool_simulate) and still be checked for what it would have typed.
+ */
+
+#include "null_sink.h"
+
+/**
+ * @brief The strokes received so far.
+ * - summaries, num_summaries: The summary of each instruction by handle. Summaries of instructions that sent nothing
+ *   have no key downs or ups.
+ * - num_strokes: The number of strokes of every instruction.
+ */
+struct NullSinkStruct {
+    NullSinkSummary* summaries;
+    int num_summaries;
+    long long num_strokes;
+};
+
+static const NullSinkSummary NULL_SINK_EMPTY_SUMMARY = {
+    .num_key_downs = 0,
+    .num_key_ups = 0,
+    .first_down_time = -1,
+    .last_down_time = -1,
+    .min_down_gap = -1,
+};
+
+NullSink* null_sink_new() {
+    NullSink* sink = (NullSink*) malloc(sizeof(NullSink));
+    assert(sink != NULL, "Failed to allocate memory for null sink.");
+
+    sink->summaries = NULL;
+    sink->num_summaries = 0;
+    sink->num_strokes = 0;
+
+    return sink;
+}
+
+void null_sink_delete(NullSink** ptr_sink) {
+    assert(ptr_sink != NULL, "Attempting to delete null sink behind NULL pointer.");
+    assert(*ptr_sink != NULL, "Attempting to delete NULL null sink.");
+
+    NullSink* sink = *ptr_sink;
+    free(sink->summaries);
+
+    free(sink);
+    *ptr_sink = NULL;
+}
+
+/**
+ * Returns the number of strokes received.
+ */
+long long null_sink_get_num_strokes(NullSink* sink) {
+    assert(sink != NULL, "Attempting to get number of strokes of NULL null sink.");
+
+    return sink->num_strokes;
+}
+
+/**
+ * Returns one more than the highest handle a stroke was received from.
+ */
+int null_sink_get_num_handles(NullSink* sink) {
+    assert(sink != NULL, "Attempting to get number of handles of NULL null sink.");
+
+    return sink->num_summaries;
+}
+
+/**
+ * Copies what the instruction with the given handle sent. Returns false if it sent nothing.
+ *
+ * @param sink
+ * @param handle
+ * @param summary
+ * @return
+ */
+bool null_sink_get_summary(NullSink* sink, int handle, NullSinkSummary* summary) {
+    assert(sink != NULL, "Attempting to get summary of NULL null sink.");
+
+    if (handle < 0 || handle >= sink->num_summaries) {
+        return false;
+    }
+
+    *summary = sink->summaries[handle];
+    return summary->num_key_downs > 0 || summary->num_key_ups > 0;
+}
+
+/**
+ * Receives a stroke in place of the emitter. Strokes must arrive in due-time order, as the emitter receives them.
+ *
+ * @param sink
+ * @param event
+ */
+void null_sink_record(NullSink* sink, const EmitterEvent* event) {
+    sink->num_strokes++;
+
+    if (event->handle < 0) {
+        return;
+    }
+
+    if (event->handle >= sink->num_summaries) {
+        int new_size = sink->num_summaries > 0 ? sink->num_summaries : 16;
+        while (new_size <= event->handle) {
+            new_size *= 2;
+        }
+
+        sink->summaries = (NullSinkSummary*) realloc(sink->summaries, sizeof(NullSinkSummary) * new_size);
+        assert(sink->summaries != NULL, "Failed to allocate memory for null sink summaries.");
+
+        for (int handle = sink->num_summaries; handle < new_size; handle++) {
+            sink->summaries[handle] = NULL_SINK_EMPTY_SUMMARY;
+        }
+
+        sink->num_summaries = new_size;
+    }
+
+    NullSinkSummary* summary = &sink->summaries[event->handle];
+    if (event->is_key_down == false) {
+        summary->num_key_ups++;
+        return;
+    }
+
+    if (summary->last_down_time >= 0) {
+        const time_t gap = event->due_time - summary->last_down_time;
+        if (summary->min_down_gap < 0 || gap < summary->min_down_gap) {
+            summary->min_down_gap = gap;
+        }
+    } else {
+        summary->first_down_time = event->due_time;
+    }
+
+    summary->last_down_time = event->due_time;
+    summary->num_key_downs++;
+}
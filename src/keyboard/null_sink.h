@@ -0,0 +1,41 @@
+#ifndef BEANSCRIPT_NULL_SINK_H
+#define BEANSCRIPT_NULL_SINK_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/keyboard/emitter.h"
+#include "src/main.h"
+
+typedef struct NullSinkStruct NullSink;
+
+/**
+ * @brief What one instruction sent to a null sink.
+ * - num_key_downs, num_key_ups: The number of strokes of each kind.
+ * - first_down_time, last_down_time: The due times (us) of the first and last key down, or -1 without any.
+ * - min_down_gap: The shortest time (us) between two consecutive key downs, or -1 with fewer than two.
+ */
+typedef struct {
+    long long num_key_downs;
+    long long num_key_ups;
+    time_t first_down_time;
+    time_t last_down_time;
+    time_t min_down_gap;
+} NullSinkSummary;
+
+// Constructor and Destructor
+NullSink*   null_sink_new();
+void        null_sink_delete(NullSink** ptr_sink);
+
+// Accessor Functions
+long long   null_sink_get_num_strokes(NullSink* sink);
+int         null_sink_get_num_handles(NullSink* sink);
+bool        null_sink_get_summary(NullSink* sink, int handle, NullSinkSummary* summary);
+
+// Mutator Functions
+void        null_sink_record(NullSink* sink, const EmitterEvent* event);
+
+#endif //BEANSCRIPT_NULL_SINK_H
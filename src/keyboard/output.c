@@ -0,0 +1,249 @@
+/**
+ * @file output.c
+ *
+ * The output stage of a script. Executing an instruction computes when each of its keys goes down and up; those strokes
+ * are pushed here with their due time, in whatever order the scheduler produces them. The runtime flushes the stage
+ * ahead of each deadline: every stroke due before the flush horizon is handed to the script's emitter channel, and the
+ * emitter thread waits for the exact due time and talks to the driver.
+ *
+ * Strokes are ordered by due time and then by push order, so a zero-duration tap is always sent down before up even
+ * though both are due at the same instant, and the emitter always receives strokes in due-time order.
+ *
+ * An output stage may be given a null sink instead (output_set_sink), in which case flushed strokes are recorded there
+ * and the emitter is never touched.
+ */
+
+#include "output.h"
+
+/**
+ * @brief A stroke waiting to be sent.
+ * - due_time: The monotonic time (us) at which the stroke should be sent.
+ * - sequence: The push order, used to keep strokes with the same due time in order.
+ * - handle: The instruction that produced the stroke.
+ */
+typedef struct {
+    time_t due_time;
+    unsigned long long sequence;
+    unsigned short keycode;
+    bool is_key_down;
+    int handle;
+} OutputStroke;
+
+static const int OUTPUT_INITIAL_CAPACITY = 64;
+
+/**
+ * @brief The output stage of one script.
+ * - strokes: A binary min-heap of pending strokes ordered by (due_time, sequence).
+ * - channel: The emitter channel strokes are handed to.
+ * - sink: Where strokes are handed to instead of the emitter, or NULL. Not owned.
+ */
+struct OutputStruct {
+    OutputStroke* strokes;
+    int num_strokes;
+    int capacity;
+    unsigned long long next_sequence;
+    int channel;
+    NullSink* sink;
+};
+
+// The output stage the calling thread is working on. See output_bind.
+static _Thread_local Output* output = NULL;
+
+static bool stroke_is_less(const OutputStroke* a, const OutputStroke* b) {
+    if (a->due_time != b->due_time) {
+        return a->due_time < b->due_time;
+    }
+
+    return a->sequence < b->sequence;
+}
+
+static void stroke_swap(int idx_a, int idx_b) {
+    const OutputStroke tmp = output->strokes[idx_a];
+    output->strokes[idx_a] = output->strokes[idx_b];
+    output->strokes[idx_b] = tmp;
+}
+
+static void sift_up(int idx) {
+    while (idx > 0) {
+        const int parent_idx = (idx - 1) / 2;
+        if (stroke_is_less(&output->strokes[idx], &output->strokes[parent_idx]) == false) {
+            return;
+        }
+
+        stroke_swap(idx, parent_idx);
+        idx = parent_idx;
+    }
+}
+
+static void sift_down(int idx) {
+    const OutputStroke* strokes = output->strokes;
+
+    while (true) {
+        const int left_child_idx = 2 * idx + 1;
+        const int right_child_idx = left_child_idx + 1;
+        int min_idx = idx;
+
+        if (left_child_idx < output->num_strokes && stroke_is_less(&strokes[left_child_idx], &strokes[min_idx])) {
+            min_idx = left_child_idx;
+        }
+
+        if (right_child_idx < output->num_strokes && stroke_is_less(&strokes[right_child_idx], &strokes[min_idx])) {
+            min_idx = right_child_idx;
+        }
+
+        if (min_idx == idx) {
+            return;
+        }
+
+        stroke_swap(idx, min_idx);
+        idx = min_idx;
+    }
+}
+
+/**
+ * Creates an empty output stage that hands its strokes to the given emitter channel.
+ *
+ * @param channel
+ * @return
+ */
+Output* output_new(int channel) {
+    Output* new_output = (Output*) malloc(sizeof(Output));
+    assert(new_output != NULL, "Failed to allocate memory for output.");
+
+    new_output->capacity = OUTPUT_INITIAL_CAPACITY;
+    new_output->strokes = (OutputStroke*) malloc(sizeof(OutputStroke) * new_output->capacity);
+    assert(new_output->strokes != NULL, "Failed to allocate memory for output strokes.");
+
+    new_output->num_strokes = 0;
+    new_output->next_sequence = 0;
+    new_output->channel = channel;
+    new_output->sink = NULL;
+
+    return new_output;
+}
+
+/**
+ * Deletes the output stage. Strokes already handed to the emitter are still sent; strokes that are still pending here
+ * are dropped.
+ *
+ * @param ptr_output
+ */
+void output_delete(Output** ptr_output) {
+    assert(ptr_output != NULL, "Attempting to delete output behind NULL pointer.");
+    assert(*ptr_output != NULL, "Attempting to delete NULL output.");
+
+    Output* old_output = *ptr_output;
+    if (output == old_output) {
+        output = NULL;
+    }
+
+    free(old_output->strokes);
+    free(old_output);
+    *ptr_output = NULL;
+}
+
+/**
+ * Makes the given output stage the one every other output function on the calling thread works on. May be NULL.
+ *
+ * @param bound_output
+ */
+void output_bind(Output* bound_output) {
+    output = bound_output;
+}
+
+/**
+ * Makes the given output stage hand its strokes to the given null sink instead of the emitter. The sink is not owned
+ * and must outlive the stage. May be NULL to hand strokes to the emitter again.
+ *
+ * @param target_output
+ * @param sink
+ */
+void output_set_sink(Output* target_output, NullSink* sink) {
+    assert(target_output != NULL, "Attempting to set sink of NULL output.");
+
+    target_output->sink = sink;
+}
+
+/**
+ * Returns the emitter channel of the bound output stage.
+ */
+int output_get_channel() {
+    assert(output != NULL, "Attempting to get channel without a bound output.");
+
+    return output->channel;
+}
+
+/**
+ * Schedules a stroke to be sent at the given time.
+ *
+ * @param due_time
+ * @param keycode
+ * @param is_key_down
+ * @param handle The instruction that produced the stroke, for timing.
+ */
+void output_push_stroke(time_t due_time, unsigned short keycode, bool is_key_down, int handle) {
+    assert(output != NULL, "Attempting to push stroke without a bound output.");
+
+    if (output->num_strokes >= output->capacity) {
+        output->capacity *= 2;
+        output->strokes = (OutputStroke*) realloc(output->strokes, sizeof(OutputStroke) * output->capacity);
+        assert(output->strokes != NULL, "Failed to allocate memory for output strokes.");
+    }
+
+    output->strokes[output->num_strokes] = (OutputStroke) {
+        .due_time = due_time,
+        .sequence = output->next_sequence++,
+        .keycode = keycode,
+        .is_key_down = is_key_down,
+        .handle = handle,
+    };
+    output->num_strokes++;
+
+    sift_up(output->num_strokes - 1);
+}
+
+/**
+ * Returns the due time of the earliest pending stroke, or -1 if no stroke is pending.
+ */
+time_t output_get_next_deadline() {
+    if (output->num_strokes == 0) {
+        return -1;
+    }
+
+    return output->strokes[0].due_time;
+}
+
+/**
+ * Hands every stroke that is due at or before the horizon to the emitter (or the sink), in due-time order. Returns the
+ * number of strokes handed off.
+ *
+ * @param horizon
+ * @return
+ */
+int output_flush(time_t horizon) {
+    int num_flushed = 0;
+
+    while (output->num_strokes > 0 && output->strokes[0].due_time <= horizon) {
+        const EmitterEvent event = {
+            .due_time = output->strokes[0].due_time,
+            .keycode = output->strokes[0].keycode,
+            .is_key_down = output->strokes[0].is_key_down,
+            .handle = output->strokes[0].handle,
+        };
+        if (output->sink != NULL) {
+            null_sink_record(output->sink, &event);
+        } else {
+            emitter_push(output->channel, &event);
+        }
+
+        output->num_strokes--;
+        if (output->num_strokes > 0) {
+            output->strokes[0] = output->strokes[output->num_strokes];
+            sift_down(0);
+        }
+
+        num_flushed++;
+    }
+
+    return num_flushed;
+}
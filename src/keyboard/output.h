@@ -0,0 +1,30 @@
+#ifndef BEANSCRIPT_OUTPUT_H
+#define BEANSCRIPT_OUTPUT_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "src/keyboard/emitter.h"
+#include "src/keyboard/null_sink.h"
+#include "src/main.h"
+
+typedef struct OutputStruct Output;
+
+// Constructor and Destructor
+Output* output_new(int channel);
+void    output_delete(Output** ptr_output);
+void    output_bind(Output* bound_output);
+
+// Mutator Functions
+void    output_set_sink(Output* target_output, NullSink* sink);
+void    output_push_stroke(time_t due_time, unsigned short keycode, bool is_key_down, int handle);
+
+// Accessor Functions
+int     output_get_channel();
+time_t  output_get_next_deadline();
+
+// Executors
+int     output_flush(time_t horizon);
+
+#endif //BEANSCRIPT_OUTPUT_H
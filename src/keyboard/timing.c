@@ -0,0 +1,317 @@
+/**
+ * @file timing.c
+ *
+ * Timing instrumentation of sent strokes. For every stroke it sends, the emitter records when the script asked for the
+ * stroke, when the stroke was handed to the driver and how long the driver call took. Recording only pushes the record
+ * to a preallocated lock-free ring, so it costs the emitter a few nanoseconds per stroke and never blocks or allocates.
+ * If the ring is full the record is dropped and counted instead.
+ *
+ * A background thread drains the ring every TIMING_DRAIN_PERIOD_US into per-instruction histograms of how late each
+ * stroke was sent and how long its driver call took. The histograms are written to the dump file as JSON lines on
+ * request (timing_request_dump) and once more when timing is closed. Each dump starts with the timer resolution in
+ * effect (see tuning.c), which bounds how late a sleeping thread can wake.
+ *
+ * Records name their instruction by handle; the runtimes name their channel and handles before they start, because the
+ * names are freed with the runtime and the final dump happens after every runtime is gone.
+ */
+
+#include "timing.h"
+
+static const int TIMING_RING_CAPACITY = 1 << 14;
+static const time_t TIMING_DRAIN_PERIOD_US = 10000;
+
+/**
+ * @brief The histograms of one instruction.
+ * - lateness: How far after its due time (us) each stroke was handed to the driver.
+ * - driver_time: How long (us) the driver call that sent each stroke took.
+ */
+typedef struct {
+    Histogram* lateness;
+    Histogram* driver_time;
+} TimingSummary;
+
+/**
+ * @brief What is known about one channel.
+ * - script_name, ids: The names of the script and of its instructions by handle. Guarded by names_mutex.
+ * - summaries: The histograms of each instruction by handle, NULL until the instruction sends a stroke. Only the timing
+ *   thread touches these while timing is open.
+ */
+typedef struct {
+    char* script_name;
+    char** ids;
+    int num_ids;
+    TimingSummary** summaries;
+    int num_summaries;
+} TimingChannel;
+
+static TimingChannel* channels = NULL;
+static int num_channels = 0;
+static char* dump_path = NULL;
+
+static SpscRing* records = NULL;
+static atomic_long num_dropped = 0;
+static long long num_summarized = 0;
+static int num_dumps = 0;
+
+static pthread_t thread;
+static atomic_bool is_closing = false;
+static atomic_bool is_dump_requested = false;
+static pthread_mutex_t names_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Grows an array of pointers to hold at least the given index, zeroing the new entries.
+ */
+static void** grow_to_index(void** array, int* size, int index) {
+    if (index < *size) {
+        return array;
+    }
+
+    int new_size = *size > 0 ? *size : 16;
+    while (new_size <= index) {
+        new_size *= 2;
+    }
+
+    array = (void**) realloc(array, sizeof(void*) * new_size);
+    assert(array != NULL, "Failed to allocate memory for timing entries.");
+
+    memset(array + *size, 0, sizeof(void*) * (new_size - *size));
+    *size = new_size;
+
+    return array;
+}
+
+static TimingSummary* get_summary(int channel, int handle) {
+    TimingChannel* timing_channel = &channels[channel];
+    timing_channel->summaries = (TimingSummary**) grow_to_index((void**) timing_channel->summaries,
+                                                                &timing_channel->num_summaries, handle);
+
+    TimingSummary* summary = timing_channel->summaries[handle];
+    if (summary == NULL) {
+        summary = (TimingSummary*) malloc(sizeof(TimingSummary));
+        assert(summary != NULL, "Failed to allocate memory for timing summary.");
+
+        summary->lateness = histogram_new();
+        summary->driver_time = histogram_new();
+        timing_channel->summaries[handle] = summary;
+    }
+
+    return summary;
+}
+
+/**
+ * Moves every record in the ring into the histograms. Only called by the consumer of the ring.
+ */
+static void drain_records() {
+    TimingRecord record;
+    while (spsc_ring_try_pop(records, &record)) {
+        if (record.channel < 0 || record.channel >= num_channels || record.handle < 0) {
+            continue;
+        }
+
+        TimingSummary* summary = get_summary(record.channel, record.handle);
+        histogram_record(summary->lateness, record.send_time - record.due_time);
+        histogram_record(summary->driver_time, record.driver_time_us);
+        num_summarized++;
+    }
+}
+
+/**
+ * Appends the histograms of every instruction that has sent a stroke to the dump file: first a line describing the
+ * dump, then one line per instruction.
+ */
+static void dump_summaries() {
+    FILE* file = fopen(dump_path, "a");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open timing dump %s.\n", dump_path);
+        return;
+    }
+
+    fprintf(file, "{\"timing_dump\": %d, \"time_us\": %lld, \"strokes\": %lld, \"dropped\": %ld, "
+            "\"timer_resolution_us\": %lld}\n", num_dumps++, (long long) clock_get_time_us(), num_summarized,
+            atomic_load(&num_dropped), (long long) tuning_get_timer_resolution_us());
+
+    pthread_mutex_lock(&names_mutex);
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        const TimingChannel* timing_channel = &channels[channel];
+
+        for (int handle = 0; handle < timing_channel->num_summaries; handle++) {
+            TimingSummary* summary = timing_channel->summaries[handle];
+            if (summary == NULL) {
+                continue;
+            }
+
+            const char* id = handle < timing_channel->num_ids ? timing_channel->ids[handle] : NULL;
+
+            fprintf(file, "{\"script\": ");
+            str_print_json(file, timing_channel->script_name);
+            fprintf(file, ", \"channel\": %d, \"handle\": %d, \"instruction\": ", channel, handle);
+            str_print_json(file, id);
+            fprintf(file, ", \"lateness_us\": ");
+            histogram_print_json(summary->lateness, file);
+            fprintf(file, ", \"driver_us\": ");
+            histogram_print_json(summary->driver_time, file);
+            fprintf(file, "}\n");
+        }
+    }
+
+    pthread_mutex_unlock(&names_mutex);
+    fclose(file);
+}
+
+static void* timing_run(void* argument) {
+    (void) argument;
+
+    while (atomic_load(&is_closing) == false) {
+        clock_sleep_until_us(clock_get_time_us() + TIMING_DRAIN_PERIOD_US);
+        drain_records();
+
+        if (atomic_exchange(&is_dump_requested, false)) {
+            dump_summaries();
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Starts recording the strokes sent on the given number of emitter channels. The histograms are appended to the file
+ * at the given path. Must be called before the emitter is opened.
+ *
+ * @param channel_count
+ * @param str_dump_path
+ */
+void timing_open(int channel_count, const char* str_dump_path) {
+    assert(channels == NULL, "Attempting to open timing that is already open.");
+    assert(channel_count > 0, "Attempting to open timing with no channels.");
+    assert(str_dump_path != NULL, "Attempting to open timing with NULL dump path.");
+
+    channels = (TimingChannel*) calloc(channel_count, sizeof(TimingChannel));
+    assert(channels != NULL, "Failed to allocate memory for timing channels.");
+    num_channels = channel_count;
+
+    dump_path = strdup(str_dump_path);
+    assert(dump_path != NULL, "Failed to allocate memory for timing dump path.");
+
+    records = spsc_ring_new(TIMING_RING_CAPACITY, sizeof(TimingRecord));
+    atomic_store(&num_dropped, 0);
+    num_summarized = 0;
+    num_dumps = 0;
+
+    atomic_store(&is_closing, false);
+    atomic_store(&is_dump_requested, false);
+
+    const int result = pthread_create(&thread, NULL, timing_run, NULL);
+    assert(result == 0, "Failed to create timing thread (error %d).", result);
+}
+
+/**
+ * Stops recording, summarizes every record still in the ring and writes the final dump. Must be called after the
+ * emitter is closed, so every sent stroke is included.
+ */
+void timing_close() {
+    if (channels == NULL) {
+        return;
+    }
+
+    atomic_store(&is_closing, true);
+    pthread_join(thread, NULL);
+
+    drain_records();
+    dump_summaries();
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        TimingChannel* timing_channel = &channels[channel];
+
+        for (int handle = 0; handle < timing_channel->num_summaries; handle++) {
+            TimingSummary* summary = timing_channel->summaries[handle];
+            if (summary != NULL) {
+                histogram_delete(&summary->lateness);
+                histogram_delete(&summary->driver_time);
+                free(summary);
+            }
+        }
+
+        for (int handle = 0; handle < timing_channel->num_ids; handle++) {
+            free(timing_channel->ids[handle]);
+        }
+
+        free(timing_channel->summaries);
+        free(timing_channel->ids);
+        free(timing_channel->script_name);
+    }
+
+    spsc_ring_delete(&records);
+    free(channels);
+    free(dump_path);
+
+    channels = NULL;
+    num_channels = 0;
+    dump_path = NULL;
+}
+
+bool timing_is_open() {
+    return channels != NULL;
+}
+
+/**
+ * Names the script whose strokes are sent on the given channel, for the dump.
+ *
+ * @param channel
+ * @param str_script_name
+ */
+void timing_name_channel(int channel, const char* str_script_name) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to name invalid timing channel %d.", channel);
+
+    char* script_name = strdup(str_script_name);
+    assert(script_name != NULL, "Failed to allocate memory for timing script name.");
+
+    pthread_mutex_lock(&names_mutex);
+    free(channels[channel].script_name);
+    channels[channel].script_name = script_name;
+    pthread_mutex_unlock(&names_mutex);
+}
+
+/**
+ * Names the instruction with the given handle on the given channel, for the dump. The id is copied.
+ *
+ * @param channel
+ * @param handle
+ * @param id
+ */
+void timing_name_instruction(int channel, int handle, const char* id) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to name instruction on invalid timing channel %d.", channel);
+    assert(handle >= 0, "Attempting to name instruction with invalid handle %d.", handle);
+
+    char* id_copy = strdup(id);
+    assert(id_copy != NULL, "Failed to allocate memory for timing instruction id.");
+
+    pthread_mutex_lock(&names_mutex);
+
+    TimingChannel* timing_channel = &channels[channel];
+    timing_channel->ids = (char**) grow_to_index((void**) timing_channel->ids, &timing_channel->num_ids, handle);
+    free(timing_channel->ids[handle]);
+    timing_channel->ids[handle] = id_copy;
+
+    pthread_mutex_unlock(&names_mutex);
+}
+
+/**
+ * Records how a stroke was sent. Only the emitter thread may record. Never blocks; the record is dropped if the timing
+ * thread has fallen behind.
+ *
+ * @param record
+ */
+void timing_record(const TimingRecord* record) {
+    if (spsc_ring_try_push(records, record) == false) {
+        atomic_fetch_add_explicit(&num_dropped, 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * Asks the timing thread to write a dump of the histograms so far. Only sets a flag, so it may be called from a signal
+ * handler.
+ */
+void timing_request_dump() {
+    atomic_store(&is_dump_requested, true);
+}
@@ -0,0 +1,51 @@
+#ifndef BEANSCRIPT_TIMING_H
+#define BEANSCRIPT_TIMING_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/utility/clock.h"
+#include "src/utility/histogram.h"
+#include "src/utility/spsc_ring.h"
+#include "src/utility/tuning.h"
+#include "src/utility/utility.h"
+#include "src/main.h"
+
+/**
+ * @brief How one stroke was sent.
+ * - due_time: The monotonic time (us) the script asked for the stroke to be sent at.
+ * - send_time: The monotonic time (us) the stroke was handed to the driver.
+ * - driver_time_us: How long the driver call that sent the stroke took.
+ * - channel, handle: The script and the instruction that produced the stroke.
+ */
+typedef struct {
+    time_t due_time;
+    time_t send_time;
+    int driver_time_us;
+    int channel;
+    int handle;
+} TimingRecord;
+
+// Constructor and Destructor
+void    timing_open(int channel_count, const char* str_dump_path);
+void    timing_close();
+
+// Accessor Functions
+bool    timing_is_open();
+
+// Mutator Functions
+void    timing_name_channel(int channel, const char* str_script_name);
+void    timing_name_instruction(int channel, int handle, const char* id);
+
+// Producer Functions
+void    timing_record(const TimingRecord* record);
+
+// Executors
+void    timing_request_dump();
+
+#endif //BEANSCRIPT_TIMING_H
@@ -0,0 +1,473 @@
+/**
+ * @file trace.c
+ *
+ * Keystroke traces: real keystrokes recorded with their times, to be replayed or turned into scripts.
+ *
+ * A trace file is an 8 byte header ("BSTR" and a little-endian version) followed by one record per stroke, in the
+ * order the strokes happened. A record is the time (us) since the previous stroke as an unsigned LEB128 varint and a
+ * little-endian 16-bit code: the keycode (see keycodes.c) in the low 15 bits, and the top bit set for a key up. A
+ * typed stroke therefore takes 4 to 5 bytes. The first stroke of a trace has a delta of 0. A trace is written front to
+ * back and never rewritten, so a recording that is cut short still reads back up to its last complete record.
+ *
+ * Recording never waits on the file. The capturing thread only pushes each stroke to a lock-free ring; a writer thread
+ * drains the ring every TRACE_DRAIN_PERIOD_US, encodes the records into a buffered stream and flushes it. If the ring
+ * is full the stroke is dropped from the trace and counted (it still reaches the system). Both the drain period and
+ * the capture poll are counted in milliseconds, so the recorder asks for a timer resolution of at least
+ * TRACE_CAPTURE_RESOLUTION_US while it records (see tuning.c); at the default Windows tick of about 15.6 ms either
+ * would run several times too long.
+ *
+ * Replay maps the trace instead of reading it and hands its strokes to the emitter a little ahead of their due times,
+ * so a trace of any length replays in constant memory with the emitter's precise timing.
+ */
+
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "trace.h"
+
+#define TRACE_HEADER_SIZE 8
+#define TRACE_MAX_RECORD_SIZE 12
+#define TRACE_KEY_UP_BIT 0x8000
+#define TRACE_KEYCODE_MASK 0x7FFF
+
+static const unsigned char TRACE_MAGIC[4] = { 'B', 'S', 'T', 'R' };
+static const uint32_t TRACE_VERSION = 1;
+
+static const int TRACE_RING_CAPACITY = 1 << 14;
+static const size_t TRACE_WRITE_BUFFER_SIZE = 1 << 16;
+static const time_t TRACE_DRAIN_PERIOD_US = 10000;
+#ifdef _WIN32
+static const unsigned long TRACE_CAPTURE_POLL_MS = 50;
+static const time_t TRACE_CAPTURE_RESOLUTION_US = 1000;
+#endif
+
+static const int TRACE_REPLAY_CAPACITY = 1024;
+static const time_t TRACE_REPLAY_LEAD_US = 100000;
+static const time_t TRACE_REPLAY_AHEAD_US = 50000;
+
+/**
+ * @brief A trace being recorded.
+ * - file, buffer: The trace file and its stream buffer. Only the writer thread writes to the file.
+ * - strokes: The strokes recorded but not yet written.
+ * - num_dropped: The number of strokes that found the ring full.
+ * - last_time, has_stroke: The time of the last stroke written, if any. Only the writer thread touches these.
+ */
+struct TraceWriterStruct {
+    FILE* file;
+    char* buffer;
+    SpscRing* strokes;
+    atomic_long num_dropped;
+
+    time_t last_time;
+    bool has_stroke;
+
+    pthread_t thread;
+    atomic_bool is_closing;
+};
+
+/**
+ * @brief A mapped trace being read.
+ * - data, size: The mapped file.
+ * - position: The offset of the next record.
+ * - time: The time of the last stroke read, relative to the first.
+ */
+struct TraceReaderStruct {
+    const unsigned char* data;
+    size_t size;
+    size_t position;
+    time_t time;
+};
+
+static atomic_bool is_stop_requested = false;
+
+static void write_stroke(TraceWriter* writer, const TraceStroke* stroke) {
+    // Strokes are recorded from one thread in the order they happened, so times never decrease.
+    uint64_t delta = writer->has_stroke ? (uint64_t) (stroke->time - writer->last_time) : 0;
+    writer->last_time = stroke->time;
+    writer->has_stroke = true;
+
+    unsigned char record[TRACE_MAX_RECORD_SIZE];
+    int size = 0;
+
+    do {
+        record[size] = (unsigned char) (delta & 0x7F);
+        delta >>= 7;
+
+        if (delta != 0) {
+            record[size] |= 0x80;
+        }
+
+        size++;
+    } while (delta != 0);
+
+    const uint16_t key_up_bit = stroke->is_key_down ? 0 : TRACE_KEY_UP_BIT;
+    const uint16_t code = (uint16_t) ((stroke->keycode & TRACE_KEYCODE_MASK) | key_up_bit);
+    record[size++] = (unsigned char) (code & 0xFF);
+    record[size++] = (unsigned char) (code >> 8);
+
+    fwrite(record, 1, size, writer->file);
+}
+
+/**
+ * Writes every stroke in the ring to the file and flushes it. Only called by the consumer of the ring.
+ */
+static void drain_strokes(TraceWriter* writer) {
+    TraceStroke stroke;
+    bool has_written = false;
+
+    while (spsc_ring_try_pop(writer->strokes, &stroke)) {
+        write_stroke(writer, &stroke);
+        has_written = true;
+    }
+
+    if (has_written) {
+        fflush(writer->file);
+    }
+}
+
+static void* trace_writer_run(void* argument) {
+    TraceWriter* writer = (TraceWriter*) argument;
+
+    while (atomic_load(&writer->is_closing) == false) {
+        clock_sleep_until_us(clock_get_time_us() + TRACE_DRAIN_PERIOD_US);
+        drain_strokes(writer);
+    }
+
+    return NULL;
+}
+
+/**
+ * Creates the trace file at the given path, replacing any file there, and starts its writer thread. Returns NULL if
+ * the file cannot be created.
+ *
+ * @param path
+ * @return
+ */
+TraceWriter* trace_writer_open(const char* path) {
+    assert(path != NULL, "Attempting to open trace with NULL path.");
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    TraceWriter* writer = (TraceWriter*) malloc(sizeof(TraceWriter));
+    assert(writer != NULL, "Failed to allocate memory for trace writer.");
+
+    writer->buffer = (char*) malloc(TRACE_WRITE_BUFFER_SIZE);
+    assert(writer->buffer != NULL, "Failed to allocate memory for trace buffer.");
+
+    writer->file = file;
+    setvbuf(writer->file, writer->buffer, _IOFBF, TRACE_WRITE_BUFFER_SIZE);
+
+    const unsigned char header[TRACE_HEADER_SIZE] = {
+        TRACE_MAGIC[0], TRACE_MAGIC[1], TRACE_MAGIC[2], TRACE_MAGIC[3],
+        (unsigned char) TRACE_VERSION, (unsigned char) (TRACE_VERSION >> 8),
+        (unsigned char) (TRACE_VERSION >> 16), (unsigned char) (TRACE_VERSION >> 24),
+    };
+    fwrite(header, 1, TRACE_HEADER_SIZE, writer->file);
+    fflush(writer->file);
+
+    writer->strokes = spsc_ring_new(TRACE_RING_CAPACITY, sizeof(TraceStroke));
+    atomic_init(&writer->num_dropped, 0);
+    writer->last_time = 0;
+    writer->has_stroke = false;
+    atomic_init(&writer->is_closing, false);
+
+    const int result = pthread_create(&writer->thread, NULL, trace_writer_run, writer);
+    assert(result == 0, "Failed to create trace writer thread (error %d).", result);
+
+    return writer;
+}
+
+/**
+ * Stops the writer thread, writes every stroke still in the ring and closes the file.
+ *
+ * @param ptr_writer
+ */
+void trace_writer_close(TraceWriter** ptr_writer) {
+    assert(ptr_writer != NULL, "Attempting to close trace writer behind NULL pointer.");
+    assert(*ptr_writer != NULL, "Attempting to close NULL trace writer.");
+
+    TraceWriter* writer = *ptr_writer;
+
+    atomic_store(&writer->is_closing, true);
+    pthread_join(writer->thread, NULL);
+    drain_strokes(writer);
+
+    fclose(writer->file);
+    spsc_ring_delete(&writer->strokes);
+    free(writer->buffer);
+
+    free(writer);
+    *ptr_writer = NULL;
+}
+
+/**
+ * Returns the number of strokes left out of the trace because the writer had fallen behind.
+ */
+long trace_writer_get_num_dropped(TraceWriter* writer) {
+    assert(writer != NULL, "Attempting to get dropped strokes of NULL trace writer.");
+
+    return atomic_load(&writer->num_dropped);
+}
+
+/**
+ * Records a stroke. Only one thread may record to a writer. Never blocks; the stroke is dropped if the writer thread
+ * has fallen behind.
+ *
+ * @param writer
+ * @param stroke The stroke, with the monotonic time it happened at.
+ */
+void trace_writer_record(TraceWriter* writer, const TraceStroke* stroke) {
+    if (spsc_ring_try_push(writer->strokes, stroke) == false) {
+        atomic_fetch_add_explicit(&writer->num_dropped, 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * Maps the file read-only. Returns NULL if it cannot be opened or is empty.
+ */
+static const unsigned char* map_file(const char* path, size_t* size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                              NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) == false || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    // The view keeps the mapping and the file open once it exists.
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return NULL;
+    }
+
+    const unsigned char* data = (const unsigned char*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    *size = (size_t) file_size.QuadPart;
+    return data;
+#else
+    const int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(file);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, (size_t) file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    posix_madvise(data, (size_t) file_stat.st_size, POSIX_MADV_SEQUENTIAL);
+
+    *size = (size_t) file_stat.st_size;
+    return (const unsigned char*) data;
+#endif
+}
+
+static void unmap_file(const unsigned char* data, size_t size) {
+#ifdef _WIN32
+    (void) size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*) data, size);
+#endif
+}
+
+/**
+ * Maps the trace at the given path for reading. Returns NULL if the file cannot be mapped or is not a trace of this
+ * version.
+ *
+ * @param path
+ * @return
+ */
+TraceReader* trace_reader_open(const char* path) {
+    assert(path != NULL, "Attempting to open trace with NULL path.");
+
+    size_t size = 0;
+    const unsigned char* data = map_file(path, &size);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    const uint32_t version = size >= TRACE_HEADER_SIZE
+            ? (uint32_t) data[4] | (uint32_t) data[5] << 8 | (uint32_t) data[6] << 16 | (uint32_t) data[7] << 24
+            : 0;
+
+    if (size < TRACE_HEADER_SIZE || memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || version != TRACE_VERSION) {
+        unmap_file(data, size);
+        return NULL;
+    }
+
+    TraceReader* reader = (TraceReader*) malloc(sizeof(TraceReader));
+    assert(reader != NULL, "Failed to allocate memory for trace reader.");
+
+    reader->data = data;
+    reader->size = size;
+    reader->position = TRACE_HEADER_SIZE;
+    reader->time = 0;
+
+    return reader;
+}
+
+void trace_reader_close(TraceReader** ptr_reader) {
+    assert(ptr_reader != NULL, "Attempting to close trace reader behind NULL pointer.");
+    assert(*ptr_reader != NULL, "Attempting to close NULL trace reader.");
+
+    TraceReader* reader = *ptr_reader;
+    unmap_file(reader->data, reader->size);
+
+    free(reader);
+    *ptr_reader = NULL;
+}
+
+/**
+ * Reads the next stroke of the trace, with its time relative to the first stroke. Returns false at the end of the
+ * trace, including at an incomplete last record.
+ *
+ * @param reader
+ * @param stroke
+ * @return
+ */
+bool trace_reader_next(TraceReader* reader, TraceStroke* stroke) {
+    assert(reader != NULL, "Attempting to read from NULL trace reader.");
+
+    size_t position = reader->position;
+    uint64_t delta = 0;
+    int shift = 0;
+
+    while (true) {
+        if (position >= reader->size || shift > 63) {
+            return false;
+        }
+
+        const unsigned char byte = reader->data[position++];
+        delta |= (uint64_t) (byte & 0x7F) << shift;
+        shift += 7;
+
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+
+    if (reader->size - position < 2) {
+        return false;
+    }
+
+    const uint16_t code = (uint16_t) (reader->data[position] | reader->data[position + 1] << 8);
+    reader->position = position + 2;
+    reader->time += (time_t) delta;
+
+    stroke->time = reader->time;
+    stroke->keycode = (unsigned short) (code & TRACE_KEYCODE_MASK);
+    stroke->is_key_down = (code & TRACE_KEY_UP_BIT) == 0;
+
+    return true;
+}
+
+/**
+ * Records every stroke typed on any keyboard to a new trace at the given path until trace_request_stop is called. Each
+ * stroke still reaches the system as it is typed. Recording needs the Interception driver, so it is Windows only.
+ *
+ * The tuning is applied while recording, with the timer resolution raised to TRACE_CAPTURE_RESOLUTION_US if it is not
+ * set or is coarser.
+ *
+ * @param path
+ * @param tuning_config
+ */
+void trace_record(const char* path, const TuningConfig* tuning_config) {
+    assert(path != NULL, "Attempting to record trace to NULL path.");
+    assert(tuning_config != NULL, "Attempting to record trace with NULL tuning config.");
+
+#ifdef _WIN32
+    TuningConfig tuning = *tuning_config;
+    if (tuning.is_timer_resolution_set == false || tuning.timer_resolution_us > TRACE_CAPTURE_RESOLUTION_US) {
+        tuning.timer_resolution_us = TRACE_CAPTURE_RESOLUTION_US;
+        tuning.is_timer_resolution_set = true;
+    }
+
+    tuning_open(&tuning);
+
+    TraceWriter* writer = trace_writer_open(path);
+    assert(writer != NULL, "Could not create trace %s.", path);
+
+    Keyboard* keyboard = keyboard_new(1);
+    keyboard_capture(keyboard);
+
+    while (atomic_load(&is_stop_requested) == false) {
+        TraceStroke stroke;
+        const bool is_received = keyboard_receive_stroke(keyboard, TRACE_CAPTURE_POLL_MS, &stroke.keycode,
+                                                         &stroke.is_key_down, &stroke.time);
+        if (is_received) {
+            trace_writer_record(writer, &stroke);
+        }
+    }
+
+    keyboard_delete(&keyboard);
+
+    const long num_dropped = trace_writer_get_num_dropped(writer);
+    if (num_dropped > 0) {
+        fprintf(stderr, "Dropped %ld strokes from trace %s.\n", num_dropped, path);
+    }
+
+    trace_writer_close(&writer);
+    tuning_close();
+#else
+    assert(false, "Recording trace %s needs the Interception driver, which only exists on Windows.", path);
+#endif
+}
+
+/**
+ * Asks trace_record to stop. Only sets a flag, so it may be called from a signal handler.
+ */
+void trace_request_stop() {
+    atomic_store(&is_stop_requested, true);
+}
+
+/**
+ * Sends every stroke of the trace at the given path through the emitter, keeping the time between strokes. The
+ * emitter must not be open; replay opens it with a single channel and closes it once the last stroke is sent.
+ *
+ * @param path
+ */
+void trace_replay(const char* path) {
+    TraceReader* reader = trace_reader_open(path);
+    assert(reader != NULL, "Could not read trace %s; it is missing or is not a trace.", path);
+
+    emitter_open(1, TRACE_REPLAY_CAPACITY);
+    const time_t start_time = clock_get_time_us() + TRACE_REPLAY_LEAD_US;
+
+    TraceStroke stroke;
+    while (trace_reader_next(reader, &stroke)) {
+        const EmitterEvent event = {
+            .due_time = start_time + stroke.time,
+            .keycode = stroke.keycode,
+            .is_key_down = stroke.is_key_down,
+            .handle = -1,
+        };
+
+        // Stay only a little ahead of the emitter, so the ring never fills and replay does not spin.
+        clock_sleep_until_us(event.due_time - TRACE_REPLAY_AHEAD_US);
+        emitter_push(0, &event);
+    }
+
+    emitter_close_channel(0);
+    emitter_close();
+
+    trace_reader_close(&reader);
+}
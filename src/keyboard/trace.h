@@ -0,0 +1,60 @@
+#ifndef BEANSCRIPT_TRACE_H
+#define BEANSCRIPT_TRACE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "src/keyboard/emitter.h"
+#include "src/keyboard/keyboard.h"
+#include "src/utility/clock.h"
+#include "src/utility/spsc_ring.h"
+#include "src/utility/tuning.h"
+#include "src/main.h"
+
+/**
+ * @brief One stroke of a trace.
+ * - time: When the stroke happened (us). Recorded as a monotonic time; read back relative to the first stroke.
+ */
+typedef struct {
+    time_t time;
+    unsigned short keycode;
+    bool is_key_down;
+} TraceStroke;
+
+typedef struct TraceWriterStruct TraceWriter;
+typedef struct TraceReaderStruct TraceReader;
+
+// Constructor and Destructor
+TraceWriter*    trace_writer_open(const char* path);
+void            trace_writer_close(TraceWriter** ptr_writer);
+TraceReader*    trace_reader_open(const char* path);
+void            trace_reader_close(TraceReader** ptr_reader);
+
+// Accessor Functions
+long            trace_writer_get_num_dropped(TraceWriter* writer);
+bool            trace_reader_next(TraceReader* reader, TraceStroke* stroke);
+
+// Producer Functions
+void            trace_writer_record(TraceWriter* writer, const TraceStroke* stroke);
+
+// Executors
+void            trace_record(const char* path, const TuningConfig* tuning_config);
+void            trace_request_stop();
+void            trace_replay(const char* path);
+
+#endif //BEANSCRIPT_TRACE_H
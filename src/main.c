@@ -1,14 +1,20 @@
+#include <signal.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "main.h"
 #include "runtime.h"
+#include "runtime_pool.h"
+#include "script_loader.h"
 #include "keyboard/keycodes.h"
+#include "keyboard/timing.h"
+#include "keyboard/trace.h"
 #include "parser/instruction.h"
-#include "utility/str_timestamp_queue.h"
+#include "utility/timestamp_queue.h"
+#include "utility/tuning.h"
 
 #ifdef __linux__
     #include <unistd.h>
@@ -16,57 +22,257 @@
     #include <io.h>
 #endif
 
-void assert(bool condition, const char* message, ...) {
-#if DISABLE_ASSERTS
-    return;
-# else
-    if(condition == true) {
-        return;
+#ifdef SIGUSR1
+static void request_timing_dump(int signal_number) {
+    (void) signal_number;
+    timing_request_dump();
+}
+#endif
+
+static void request_trace_stop(int signal_number) {
+    (void) signal_number;
+    trace_request_stop();
+}
+
+/**
+ * @brief The options every pool is run with.
+ */
+typedef struct {
+    int num_workers;
+    const char* timing_path;
+    const char* metrics_path;
+    const char* str_seed;
+    const char* str_panic_button;
+    const char* str_watch_ms;
+    const char* str_simulation_seconds;
+    TuningConfig tuning;
+} PoolOptions;
+
+static RuntimePool* new_pool(const PoolOptions* options) {
+    RuntimePool* pool = runtime_pool_new(options->num_workers);
+    runtime_pool_set_timing_path(pool, options->timing_path);
+    runtime_pool_set_metrics_path(pool, options->metrics_path);
+    runtime_pool_set_tuning(pool, &options->tuning);
+
+    if (options->str_panic_button != NULL) {
+        const Key* panic_key = key_map_get(options->str_panic_button);
+        assert(panic_key != NULL, "Expected a button after -k, got %s.", options->str_panic_button);
+
+        runtime_pool_set_panic_button(pool, panic_key->code);
     }
 
-    va_list args;
-    va_start(args, message);
-    vfprintf(stderr, message, args);
-    fprintf(stderr, "\n");
-    va_end(args);
+    if (options->str_watch_ms != NULL) {
+        const int watch_ms = atoi(options->str_watch_ms);
+        assert(watch_ms > 0, "Expected a positive number of milliseconds after -w, got %s.", options->str_watch_ms);
 
-    exit(EXIT_FAILURE);
-#endif
+        runtime_pool_set_watch_period(pool, (time_t) watch_ms * CLOCK_US_PER_MS);
+    }
+
+    if (options->str_seed != NULL) {
+        char* str_seed_end = NULL;
+        runtime_pool_set_seed(pool, strtoull(options->str_seed, &str_seed_end, 0));
+        assert(*options->str_seed != '\0' && *str_seed_end == '\0', "Expected a number after -s, got %s.",
+               options->str_seed);
+    } else {
+        fprintf(stderr, "Running with seed %llu.\n", (unsigned long long) runtime_pool_get_seed(pool));
+    }
+
+    return pool;
 }
 
-int main() {
+static void run_pool(RuntimePool* pool, const PoolOptions* options) {
+    if (options->str_simulation_seconds != NULL) {
+        const double simulation_seconds = atof(options->str_simulation_seconds);
+        assert(simulation_seconds > 0, "Expected a positive number of seconds after -v, got %s.",
+               options->str_simulation_seconds);
+
+        runtime_pool_simulate(pool, (time_t) (simulation_seconds * 1000000.0), stdout);
+    } else {
+        runtime_pool_run(pool);
+    }
+}
+
+int main(int argc, char** argv) {
 #if IS_MODULE_TESTING
     srand(time(NULL));
 
     char alphabet[27] = "abcdefghijklmnopqrstuvwxyz";
     int num_inserts = 10;
 
-    TimestampQueue* queue = str_timestamp_queue_new(num_inserts, false);
+    TimestampQueue* queue = timestamp_queue_new(num_inserts);
+    int letters[10];
     for(int i = 0; i < num_inserts; i++) {
-        int random_idx = rand() % 27;
-        char* random_char = (char*) malloc(sizeof(char) * 2);
-        random_char[0] = alphabet[random_idx];
-        random_char[1] = '\0';
-
-        str_timestamp_queue_push(queue, random_idx, random_char);
+        letters[i] = rand() % 26;
+        timestamp_queue_push(queue, letters[i], i);
     }
 
     for(int i = 0; i < num_inserts; i++) {
-        char* item = str_timestamp_queue_pop(queue, 9999);
-        printf("%s\n", item);
+        int handle = timestamp_queue_pop(queue, 9999);
+        printf("%c\n", alphabet[letters[handle]]);
     }
 
-    str_timestamp_queue_delete(&queue);
+    timestamp_queue_delete(&queue);
 #else
-        const char *filename = "sample.bs";
+        // Usage: beanscript [option value ...] [script.bs ...]
+        //
+        // Every option takes one value, and the options come before the scripts. Every script runs at once. Without
+        // any scripts, every script in the working directory is listed and the ones picked are run, until q is entered
+        // (see script_loader.c).
+        //
+        //   -j workers          Spreads the scripts over that many threads.
+        //   -t timing.jsonl     Times every sent stroke and appends the timing histograms to the file when the scripts
+        //                       finish, or whenever the process receives SIGUSR1 (see timing.c).
+        //   -m metrics.jsonl    Publishes live counters of every scheduler to the file, rewriting it a few times a
+        //                       second (see metrics.c).
+        //   -s seed             Seeds every random choice, so a run is repeated exactly by passing the seed it
+        //                       reported.
+        //   -k button           Names a panic button that stops every script at once (see hotkeys.c).
+        //   -w ms               Checks the script files for edits every that many ms and reloads an edited script in
+        //                       place, keeping its cooldowns and where it was (see runtime.c).
+        //   -R us               Asks for a system timer resolution of that many us and reports the one granted.
+        //   -P normal|high|mmcss
+        //                       Sets how the emitter thread is scheduled.
+        //   -A core,core,...    Pins the emitter to the first core and deals the workers the rest.
+        //   -v seconds          Simulates the scripts for that many seconds of virtual time without typing anything,
+        //                       and writes what each instruction would have typed to stdout as JSON lines.
+        //   -a analysis.jsonl   Analyzes the scripts instead of running them, and writes how long each group takes,
+        //                       how fast each routine, waitlist and random cycles and what blocks it, and any mistakes
+        //                       found, such as instructions that never run, to the file as JSON lines (see analyzer.c).
+        //   -r trace.bst        Records every keystroke typed, with its time, to the trace until interrupted, instead
+        //                       of running scripts (see trace.c).
+        //   -p trace.bst        Replays a recorded trace with its original timing instead of running scripts.
+        //
+        // -R, -P and -A override the same settings in the `script` headers (see tuning.c), and also apply while
+        // recording. -r comes first, then -p, then -a; with none of them the scripts are run, or simulated with -v.
+        int num_workers = 1;
+        const char* timing_path = NULL;
+        const char* metrics_path = NULL;
+        const char* str_seed = NULL;
+        const char* record_path = NULL;
+        const char* replay_path = NULL;
+        const char* analysis_path = NULL;
+        const char* str_simulation_seconds = NULL;
+        const char* str_panic_button = NULL;
+        const char* str_watch_ms = NULL;
+        int first_script_idx = 1;
+
+        TuningConfig tuning;
+        tuning_config_init(&tuning);
+
+        while (first_script_idx + 1 < argc) {
+            if (strcmp(argv[first_script_idx], "-j") == 0) {
+                num_workers = atoi(argv[first_script_idx + 1]);
+                assert(num_workers > 0, "Expected a positive number of workers after -j, got %s.", argv[first_script_idx + 1]);
+            } else if (strcmp(argv[first_script_idx], "-t") == 0) {
+                timing_path = argv[first_script_idx + 1];
+            } else if (strcmp(argv[first_script_idx], "-m") == 0) {
+                metrics_path = argv[first_script_idx + 1];
+            } else if (strcmp(argv[first_script_idx], "-s") == 0) {
+                str_seed = argv[first_script_idx + 1];
+            } else if (strcmp(argv[first_script_idx], "-r") == 0) {
+                record_path = argv[first_script_idx + 1];
+            } else if (strcmp(argv[first_script_idx], "-p") == 0) {
+                replay_path = argv[first_script_idx + 1];
+            } else if (strcmp(argv[first_script_idx], "-a") == 0) {
+                analysis_path = argv[first_script_idx + 1];
+            } else if (strcmp(argv[first_script_idx], "-v") == 0) {
+                str_simulation_seconds = argv[first_script_idx + 1];
+            } else if (strcmp(argv[first_script_idx], "-k") == 0) {
+                str_panic_button = argv[first_script_idx + 1];
+            } else if (strcmp(argv[first_script_idx], "-w") == 0) {
+                str_watch_ms = argv[first_script_idx + 1];
+            } else if (strcmp(argv[first_script_idx], "-R") == 0) {
+                tuning_config_set_parameter(&tuning, "resolution", &argv[first_script_idx + 1], 1);
+            } else if (strcmp(argv[first_script_idx], "-P") == 0) {
+                tuning_config_set_parameter(&tuning, "priority", &argv[first_script_idx + 1], 1);
+            } else if (strcmp(argv[first_script_idx], "-A") == 0) {
+                char* cores[TUNING_MAX_CORES];
+                int num_cores = 0;
+                for (char* core = strtok(argv[first_script_idx + 1], ","); core != NULL; core = strtok(NULL, ",")) {
+                    assert(num_cores < TUNING_MAX_CORES, "Expected at most %d cores after -A.", TUNING_MAX_CORES);
+                    cores[num_cores++] = core;
+                }
+
+                tuning_config_set_parameter(&tuning, "cores", cores, num_cores);
+            } else {
+                break;
+            }
+
+            first_script_idx += 2;
+        }
+
+        if (record_path != NULL) {
+            signal(SIGINT, request_trace_stop);
+            trace_record(record_path, &tuning);
+            return 0;
+        }
+
+        if (replay_path != NULL) {
+            trace_replay(replay_path);
+            return 0;
+        }
+
+        if (analysis_path != NULL) {
+            FILE* file = fopen(analysis_path, "w");
+            assert(file != NULL, "Failed to open analysis file %s.", analysis_path);
+
+            for (int idx = first_script_idx; idx < argc; idx++) {
+                Runtime* runtime = runtime_load(argv[idx]);
+                runtime_print_analysis(runtime, file);
+                runtime_delete(&runtime);
+            }
+
+            fclose(file);
+            return 0;
+        }
+
+#ifdef SIGUSR1
+        if (timing_path != NULL) {
+            signal(SIGUSR1, request_timing_dump);
+        }
+#endif
+
+        const PoolOptions options = {
+            .num_workers = num_workers,
+            .timing_path = timing_path,
+            .metrics_path = metrics_path,
+            .str_seed = str_seed,
+            .str_panic_button = str_panic_button,
+            .str_watch_ms = str_watch_ms,
+            .str_simulation_seconds = str_simulation_seconds,
+            .tuning = tuning,
+        };
+
+        if (first_script_idx < argc) {
+            RuntimePool* pool = new_pool(&options);
+            for (int idx = first_script_idx; idx < argc; idx++) {
+                runtime_pool_add_script(pool, argv[idx]);
+            }
+
+            run_pool(pool, &options);
+            runtime_pool_delete(&pool);
+            return 0;
+        }
+
+        ScriptLoader* loader = script_loader_new(".", script_loader_get_default_num_threads());
+        assert(script_loader_get_size(loader) > 0, "There are no scripts (.bs) in the working directory.");
+
+        while (true) {
+            script_loader_print(loader, stderr);
+
+            RuntimePool* pool = new_pool(&options);
+            const bool is_picked = script_loader_prompt(loader, pool, stdin, stderr);
+            if (is_picked) {
+                run_pool(pool, &options);
+            }
 
-        runtime_prepare(filename);
-        instruction_map_print();
-        runtime_start();
+            runtime_pool_delete(&pool);
+            if (is_picked == false) {
+                break;
+            }
+        }
 
-        instruction_map_clear();
-        key_map_clear();
-        runtime_delete();
+        script_loader_delete(&loader);
 #endif
 
     return 0;
@@ -4,8 +4,23 @@
 #define DISABLE_ASSERTS false
 #define IS_MODULE_TESTING false
 
+#include <setjmp.h>
 #include <stdbool.h>
 
+// The longest assertion message a trap keeps.
+#define ASSERT_MAX_MESSAGE_LENGTH 512
+
+/**
+ * @brief Catches the next failed assertion on the thread that set it (see assert_set_trap), in place of exiting.
+ * - jump: Where the failed assertion returns to, with setjmp returning 1.
+ * - message: The message of the failed assertion.
+ */
+typedef struct {
+    jmp_buf jump;
+    char message[ASSERT_MAX_MESSAGE_LENGTH];
+} AssertTrap;
+
 void assert(bool condition, const char* message, ...);
+void assert_set_trap(AssertTrap* trap);
 
 #endif //BEANSCRIPT_MAIN_H
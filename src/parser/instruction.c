@@ -1,61 +1,325 @@
 #include "instruction.h"
+#include "op_stream.h"
+#include "src/utility/str_intern.h"
+#include "src/keyboard/output.h"
+#include "src/scheduler/scheduler.h"
+
+#define INSTRUCTION_SCRIPT_BLOCK_SIZE (64 * 1024)
+#define INSTRUCTION_DRAFT_BLOCK_SIZE (64 * 1024)
+#define INSTRUCTION_SCRATCH_BLOCK_SIZE (4 * 1024)
+#define INSTRUCTION_NUM_PARAMETER_VALUES \
+    (2 * sizeof(InstructionParameterLookupArray) / sizeof(InstructionParameterLookupArray[0]))
 
 /**
- * @brief A struct representing a single instruction. An instruction can be a single key, a group of keys, a routine, a
- * waitlist, script declaration, window declaration, etc.
- * - id: The id or target of this instruction. This must be unique if it is an id.
+ * @brief The cold part of an instruction: what it needs to be parsed, found by id and reported, but never to execute.
+ * - id: The id or target of this instruction. This must be unique if it is an id. Interned by the instruction map.
+ * - id_atom: The atom of the id in the instruction map's interning table, which is the key the map finds it by.
  * - indent_count: Leading spaces in the instruction string; used for parsing hierarchy.
- * - keycode: Keycode for single-key press instructions.
- * - parameters:An array of integers where adjacent pairs define the lower and upper bounds of each parameter,
- *   respectively. For example, [lower_bound1, upper_bound1, lower_bound2, upper_bound2, ...].
+ * - line_number: The line of the script the instruction was parsed from, or -1 if it has none.
+ * - sub_instruction_atoms: The atoms of the ids of the sub-instructions; relevant for instruction groups. Only needed
+ *   until the map is linked, which resolves them to handles and drops them.
+ * - num_sub_instruction_atoms, sub_instruction_atoms_capacity: The number of sub-instruction atoms and the room for
+ *   them.
+ * - num_listed_sub_instructions: How many of the sub-instructions the line of the instruction lists itself. The rest
+ *   are the lines nested under it, in script order.
+ * - reference_atoms, num_reference_atoms, reference_atoms_capacity: The atoms of the ids of the instructions the
+ *   instruction copies values from (see instruction_copy_values), so a patch can tell which lines depend on the lines
+ *   it replaces.
+ * - is_retired: True while a patch replaces the instruction (see instruction_map_retire).
+ */
+typedef struct {
+    const char* id;
+    int id_atom;
+    int indent_count;
+    int line_number;
+    int* sub_instruction_atoms;
+    int num_sub_instruction_atoms;
+    int sub_instruction_atoms_capacity;
+    int num_listed_sub_instructions;
+    int* reference_atoms;
+    int num_reference_atoms;
+    int reference_atoms_capacity;
+    bool is_retired;
+} InstructionInfo;
+
+/**
+ * @brief A struct representing a single instruction. An instruction can be a single key, a group of keys, a routine, a
+ * waitlist, script declaration, window declaration, etc. Only what executing the instruction reads is kept here; the
+ * rest lives in its info. Once the map is linked, every instruction is a record in one contiguous table and every info
+ * an entry of a parallel side table.
  * - type: The type of this instruction. See InstructionType for more details.
- * - sub_instructions: List of sub-instructions; relevant for instruction groups.
+ * - keycode: Keycode for single-key press instructions.
+ * - handle: Dense index of this instruction in the instruction table. Assigned by instruction_map_link, -1 before.
+ * - first_sub_handle, num_sub_handles: The range of the handles of the sub-instructions, in the same order, in the
+ *   map's shared handle array. Resolved by instruction_map_link so execution never looks a sub-instruction up by its
+ *   id. first_sub_handle is -1 until they are resolved.
+ * - parameters: Adjacent pairs define the lower and upper bounds of each parameter, respectively. For example,
+ *   [lower_bound1, upper_bound1, lower_bound2, upper_bound2, ...].
+ * - available_time: The monotonic time (us) at which the instruction is off cooldown and may execute again.
+ * - resume_time: While an execution of the instruction is in flight, the time (us) the coroutine or op cursor running
+ *   it resumes next (see instruction_acquire), or NULL.
+ * - op_stream: The flattened form of a pass (see op_stream.c), or NULL if a pass is executed by walking the tree.
+ * - info: The cold part of the instruction. Allocated with the instruction until it is linked.
+ *
+ * An instruction is allocated from the draft arena of the bound map until the map is linked, and is a record of the
+ * instruction table, in the map's script arena, after. Neither is ever freed on its own. A patch writes a draft over
+ * the record it replaces, so a record never moves.
  */
 struct InstructionStruct {
-    char* id;
-    int indent_count;
+    uint8_t type;
     unsigned short keycode;
-    int* parameters;
-    InstructionType type;
-    StrList* sub_instructions;
-    int line_number;
-    UT_hash_handle hh;
+    int handle;
+    int first_sub_handle;
+    int num_sub_handles;
+    int32_t parameters[INSTRUCTION_NUM_PARAMETER_VALUES];
+    time_t available_time;
+    const time_t* resume_time;
+    OpStream* op_stream;
+    InstructionInfo* info;
 };
 
 /**
- * @brief A map of all instructions. The key is the id of the instruction and the value is the instruction itself.
+ * @brief The instructions of one script.
+ * - arena: The script arena. Owns everything that lives as long as the compiled script: the instruction table and its
+ *   side tables here, and the op streams, routines, waitlists and randoms built from them (see
+ *   instruction_map_get_arena). Deleting the map frees all of it at once.
+ * - draft_arena: Owns the instructions while they are parsed or loaded. Deleted when the map is linked, since every
+ *   instruction has then been moved into the table. Created again for the drafts of a patch, until it is committed.
+ * - scratch_arena: Owns what the parser needs only while it parses one line, such as the buckets of the line and
+ *   generated aliases before they are interned. Rewound after every line, and deleted with the draft arena.
+ * - newest_draft, draft_mark: The newest instruction that has not been inserted, and the end of the draft arena before
+ *   it was created, so deleting it gives its memory back (see instruction_delete).
+ * - drafts, num_drafts, drafts_capacity: The inserted instructions in insertion order. Moved into the table when the
+ *   map is linked, or written over records when a patch is committed.
+ * - atom_handles, atom_handles_size: The index of the instruction with each id atom, or -1 for an atom that is not the
+ *   id of an instruction. The index is the position among the drafts, which is also the handle the instruction is
+ *   linked with.
+ * - atom_drafts, atom_drafts_size: While a patch is made, the position among the drafts of the draft with each id
+ *   atom, or -1.
+ * - retired_handles, num_retired_handles, retired_handles_capacity: The handles retired by the patch being made.
+ * - ids: The interning table owning every instruction id and reference of the script. Every id is stored here once
+ *   and compared by atom.
+ * - table, infos, num_installed: The linked instruction table and its side table. The ith record is the instruction
+ *   with handle i and the ith info is its cold part. Built by instruction_map_link, or from the instructions handed
+ *   over by instruction_map_load_table.
+ * - added_records, added_records_capacity: The records a patch added past the end of the table, each with its info in
+ *   one allocation. The record with handle num_installed + i is the ith.
+ * - table_size: The number of records, installed or added.
+ * - is_linked: True once the table is installed.
+ * - sub_handles, sub_handles_size, sub_handles_capacity: The sub-instruction handles of every linked instruction, one
+ *   range per instruction. A patch writes a range in place if it fits and appends it otherwise.
+ * - free_handles, num_free_handles, free_handles_capacity: The handles of the records earlier patches removed, which
+ *   the next patch reuses before adding records.
+ * - alias_counter: The number of aliases generated so far, which keeps aliases unique within the map.
  */
-static Instruction* instructions = NULL;
+struct InstructionMapStruct {
+    Arena* arena;
+    Arena* draft_arena;
+    Arena* scratch_arena;
+    Instruction* newest_draft;
+    ArenaMark draft_mark;
+    Instruction** drafts;
+    int num_drafts;
+    int drafts_capacity;
+    int* atom_handles;
+    int atom_handles_size;
+    int* atom_drafts;
+    int atom_drafts_size;
+    int* retired_handles;
+    int num_retired_handles;
+    int retired_handles_capacity;
+    StrInternTable* ids;
+    Instruction* table;
+    InstructionInfo* infos;
+    int num_installed;
+    Instruction** added_records;
+    int added_records_capacity;
+    int table_size;
+    bool is_linked;
+    int* sub_handles;
+    int sub_handles_size;
+    int sub_handles_capacity;
+    int* free_handles;
+    int num_free_handles;
+    int free_handles_capacity;
+    int alias_counter;
+};
+
+// The map the calling thread is working on. See instruction_map_bind.
+static _Thread_local InstructionMap* instruction_map = NULL;
+
 static const char* instruction_alias_prefix = "Alias_";
-static int instruction_alias_counter = 0;
 
 /**
- * @brief Inserts instruction into map; exits if an instruction with the same ID already exists.
+ * @brief Records the given index for the given id atom in an index by atom allocated from the given arena, growing the
+ * index as needed. Atoms without an index have -1.
+ */
+static void set_atom_index(Arena* arena, int** ptr_indices, int* ptr_size, int atom, int index) {
+    if (atom >= *ptr_size) {
+        int new_size = *ptr_size > 0 ? *ptr_size : 64;
+        while (new_size <= atom) {
+            new_size *= 2;
+        }
+
+        *ptr_indices = (int*) arena_grow(arena, *ptr_indices, sizeof(int) * *ptr_size, sizeof(int) * new_size);
+
+        for (int idx = *ptr_size; idx < new_size; idx++) {
+            (*ptr_indices)[idx] = -1;
+        }
+        *ptr_size = new_size;
+    }
+
+    (*ptr_indices)[atom] = index;
+}
+
+static int get_atom_index(const int* indices, int size, int atom) {
+    return atom >= 0 && atom < size ? indices[atom] : -1;
+}
+
+/**
+ * @brief Records that the instruction with the given id atom has the given index.
+ */
+static void set_atom_handle(InstructionMap* map, int atom, int handle) {
+    set_atom_index(map->arena, &map->atom_handles, &map->atom_handles_size, atom, handle);
+}
+
+static int get_atom_handle(InstructionMap* map, int atom) {
+    return get_atom_index(map->atom_handles, map->atom_handles_size, atom);
+}
+
+static bool is_patching(InstructionMap* map) {
+    return map->is_linked && map->draft_arena != NULL;
+}
+
+/**
+ * @brief Inserts instruction into map; exits if an instruction with the same ID already exists. While a patch is made,
+ * the instruction is a draft of the patch, and only instructions that are not retired count.
  */
 void instruction_map_insert(Instruction* instruction) {
     assert(instruction != NULL, "Attempting to insert NULL instruction.");
-    assert(strchr(instruction->id, '\0') != NULL, "Instruction id does not contain a null character.");
+    assert(instruction_map != NULL, "Attempting to insert instruction without a bound instruction map.");
+    assert(instruction_map->is_linked == false || is_patching(instruction_map),
+           "Attempting to insert instruction into linked instruction map.");
+    assert(instruction->info->id != NULL, "Attempting to insert instruction without an id.");
+
+    const int atom = instruction->info->id_atom;
+    assert(instruction_map_get_by_atom(atom) == NULL, "Instruction with id %s already exists.",
+           instruction->info->id);
+
+    if (instruction_map->num_drafts == instruction_map->drafts_capacity) {
+        const int capacity = instruction_map->drafts_capacity;
+        instruction_map->drafts_capacity = capacity > 0 ? 2 * capacity : 64;
+
+        instruction_map->drafts = (Instruction**) arena_grow(instruction_map->draft_arena, instruction_map->drafts,
+                                                             sizeof(Instruction*) * capacity,
+                                                             sizeof(Instruction*) * instruction_map->drafts_capacity);
+    }
 
-    Instruction* current_instruction = NULL;
-    HASH_FIND_STR(instructions, instruction->id, current_instruction);
-    assert(current_instruction == NULL, "Instruction with id %s already exists.", instruction->id);
+    // Once inserted, the instruction lives as long as the map.
+    instruction_map->newest_draft = NULL;
 
-    HASH_ADD_STR(instructions, id, instruction);
+    if (is_patching(instruction_map)) {
+        set_atom_index(instruction_map->draft_arena, &instruction_map->atom_drafts, &instruction_map->atom_drafts_size,
+                       atom, instruction_map->num_drafts);
+    } else {
+        set_atom_handle(instruction_map, atom, instruction_map->num_drafts);
+    }
+
+    instruction_map->drafts[instruction_map->num_drafts++] = instruction;
 }
 
 /**
- * @brief Clears all instructions from the map.
+ * @brief Creates an empty instruction map.
  */
-void instruction_map_clear() {
-    Instruction *current_instruction = NULL;
-    Instruction *tmp = NULL;
+InstructionMap* instruction_map_new() {
+    InstructionMap* map = (InstructionMap*) malloc(sizeof(InstructionMap));
+    assert(map != NULL, "Failed to allocate memory for instruction map.");
+
+    map->arena = arena_new(INSTRUCTION_SCRIPT_BLOCK_SIZE);
+    map->draft_arena = arena_new(INSTRUCTION_DRAFT_BLOCK_SIZE);
+    map->scratch_arena = arena_new(INSTRUCTION_SCRATCH_BLOCK_SIZE);
+    map->newest_draft = NULL;
+    map->draft_mark = arena_get_mark(map->draft_arena);
+    map->drafts = NULL;
+    map->num_drafts = 0;
+    map->drafts_capacity = 0;
+    map->atom_handles = NULL;
+    map->atom_handles_size = 0;
+    map->atom_drafts = NULL;
+    map->atom_drafts_size = 0;
+    map->retired_handles = NULL;
+    map->num_retired_handles = 0;
+    map->retired_handles_capacity = 0;
+    map->ids = str_intern_table_new();
+    map->table = NULL;
+    map->infos = NULL;
+    map->num_installed = 0;
+    map->added_records = NULL;
+    map->added_records_capacity = 0;
+    map->table_size = 0;
+    map->is_linked = false;
+    map->sub_handles = NULL;
+    map->sub_handles_size = 0;
+    map->sub_handles_capacity = 0;
+    map->free_handles = NULL;
+    map->num_free_handles = 0;
+    map->free_handles_capacity = 0;
+    map->alias_counter = 0;
+
+    return map;
+}
 
-    HASH_ITER(hh, instructions, current_instruction, tmp) {
-        HASH_DEL(instructions, current_instruction);
-        instruction_delete(&current_instruction);
+/**
+ * @brief Deletes the instruction map and every instruction in it, along with everything else allocated from its
+ * arenas.
+ */
+void instruction_map_delete(InstructionMap** ptr_map) {
+    assert(ptr_map != NULL, "Attempting to delete instruction map behind NULL pointer.");
+    assert(*ptr_map != NULL, "Attempting to delete NULL instruction map.");
+
+    InstructionMap* map = *ptr_map;
+    if (instruction_map == map) {
+        instruction_map = NULL;
+    }
+
+    if (map->draft_arena != NULL) {
+        arena_delete(&map->draft_arena);
+        arena_delete(&map->scratch_arena);
     }
 
-    instructions = NULL;
+    str_intern_table_delete(&map->ids);
+    arena_delete(&map->arena);
+    free(map);
+    *ptr_map = NULL;
+}
+
+/**
+ * @brief Makes the given map the one every other instruction map and table function on the calling thread works on.
+ * May be NULL.
+ */
+void instruction_map_bind(InstructionMap* map) {
+    instruction_map = map;
+}
+
+/**
+ * @brief Returns the script arena of the bound map. Whatever is built for the compiled script and lives as long as it
+ * is allocated here and freed with the map, never on its own.
+ */
+Arena* instruction_map_get_arena() {
+    assert(instruction_map != NULL, "Attempting to get arena without a bound instruction map.");
+
+    return instruction_map->arena;
+}
+
+/**
+ * @brief Returns the scratch arena of the bound map, for allocations that only live while one line is parsed. Whoever
+ * allocates from it rewinds it to where it was once done (see arena_get_mark).
+ */
+Arena* instruction_map_get_scratch_arena() {
+    assert(instruction_map != NULL, "Attempting to get scratch arena without a bound instruction map.");
+    assert(instruction_map->scratch_arena != NULL, "Attempting to get scratch arena of linked instruction map.");
+
+    return instruction_map->scratch_arena;
 }
 
 /**
@@ -63,41 +327,603 @@ void instruction_map_clear() {
  */
 Instruction* instruction_map_get(const char* id) {
     assert(id != NULL, "Attempting to get instruction with NULL id.");
-    assert(strchr(id, '\0') != NULL, "Instruction id does not contain a null character.");
 
-    Instruction* instruction = NULL;
-    HASH_FIND_STR(instructions, id, instruction);
+    const int atom = str_intern_table_find(instruction_map->ids, id);
+    return atom != -1 ? instruction_map_get_by_atom(atom) : NULL;
+}
 
-    return instruction;
+/**
+ * @brief Retrieves instruction by the atom of its ID from map or NULL if no instruction has the ID. Once the map is
+ * linked, the instruction is its record in the instruction table. While a patch is made, a draft of the patch is found
+ * before a record, and a retired record is not found at all.
+ */
+Instruction* instruction_map_get_by_atom(int atom) {
+    InstructionMap* map = instruction_map;
+    if (map->is_linked == false) {
+        const int handle = get_atom_handle(map, atom);
+        return handle != -1 ? map->drafts[handle] : NULL;
+    }
+
+    if (map->draft_arena != NULL) {
+        const int draft_idx = get_atom_index(map->atom_drafts, map->atom_drafts_size, atom);
+        if (draft_idx != -1) {
+            return map->drafts[draft_idx];
+        }
+    }
+
+    const int handle = get_atom_handle(map, atom);
+    if (handle == -1) {
+        return NULL;
+    }
+
+    Instruction* instruction = instruction_table_get(handle);
+    return instruction->info->is_retired ? NULL : instruction;
+}
+
+/**
+ * @brief Returns the atom of the given ID in the bound map's interning table, interning a copy of the ID if the map
+ * has not seen it.
+ */
+int instruction_map_intern(const char* id) {
+    assert(instruction_map != NULL, "Attempting to intern id without a bound instruction map.");
+
+    return str_intern_table_intern(instruction_map->ids, id);
+}
+
+/**
+ * @brief Returns the ID with the given atom.
+ */
+const char* instruction_map_get_id(int atom) {
+    assert(instruction_map != NULL, "Attempting to get id without a bound instruction map.");
+
+    return str_intern_table_get_str(instruction_map->ids, atom);
+}
+
+/**
+ * @brief Copies the given atoms into the given arena, or returns NULL if there are none.
+ */
+static int* copy_atoms(Arena* arena, const int* atoms, int num_atoms) {
+    if (num_atoms == 0) {
+        return NULL;
+    }
+
+    int* copy = (int*) arena_alloc(arena, sizeof(int) * num_atoms);
+    memcpy(copy, atoms, sizeof(int) * num_atoms);
+
+    return copy;
+}
+
+/**
+ * @brief Moves the given instructions, whose sub-instruction ranges are already set, into the contiguous instruction
+ * table and side table of the bound map. The ith instruction becomes the record with handle i. The map takes ownership
+ * of the given number of sub-instruction handles, which must be in its script arena. The drafts are left to the caller.
+ */
+static void install_table(Instruction** instructions, int num_instructions, int* sub_handles, int num_sub_handles) {
+    Instruction* table = (Instruction*) arena_alloc(instruction_map->arena, sizeof(Instruction) * num_instructions);
+    InstructionInfo* infos = (InstructionInfo*) arena_alloc(instruction_map->arena,
+                                                            sizeof(InstructionInfo) * num_instructions);
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instructions[handle];
+
+        infos[handle] = *instruction->info;
+        infos[handle].sub_instruction_atoms = NULL;
+        infos[handle].num_sub_instruction_atoms = 0;
+        infos[handle].sub_instruction_atoms_capacity = 0;
+        infos[handle].reference_atoms = copy_atoms(instruction_map->arena, instruction->info->reference_atoms,
+                                                   instruction->info->num_reference_atoms);
+        infos[handle].reference_atoms_capacity = instruction->info->num_reference_atoms;
+
+        table[handle] = *instruction;
+        table[handle].handle = handle;
+        table[handle].info = &infos[handle];
+
+        if (infos[handle].id_atom != -1) {
+            set_atom_handle(instruction_map, infos[handle].id_atom, handle);
+        }
+    }
+
+    instruction_map->drafts = NULL;
+    instruction_map->num_drafts = 0;
+    instruction_map->drafts_capacity = 0;
+    instruction_map->table = table;
+    instruction_map->infos = infos;
+    instruction_map->num_installed = num_instructions;
+    instruction_map->table_size = num_instructions;
+    instruction_map->is_linked = true;
+    instruction_map->sub_handles = sub_handles;
+    instruction_map->sub_handles_size = num_sub_handles;
+    instruction_map->sub_handles_capacity = num_sub_handles;
+}
+
+/**
+ * @brief Frees the drafts and scratch of the bound map once its instructions are in the table.
+ */
+static void delete_draft_arenas() {
+    arena_delete(&instruction_map->draft_arena);
+    arena_delete(&instruction_map->scratch_arena);
+    instruction_map->newest_draft = NULL;
+    instruction_map->drafts = NULL;
+    instruction_map->num_drafts = 0;
+    instruction_map->drafts_capacity = 0;
+    instruction_map->atom_drafts = NULL;
+    instruction_map->atom_drafts_size = 0;
+    instruction_map->retired_handles = NULL;
+    instruction_map->num_retired_handles = 0;
+    instruction_map->retired_handles_capacity = 0;
+}
+
+/**
+ * @brief Assigns every instruction in the map a dense handle, resolves every sub-instruction id to a handle, and moves
+ * the instructions into the instruction table. Must be called once, after every instruction has been inserted; any
+ * pointer to an instruction taken before is invalid after. Exits if a sub-instruction references an instruction that
+ * does not exist.
+ */
+void instruction_map_link() {
+    assert(instruction_map != NULL, "Attempting to link without a bound instruction map.");
+    assert(instruction_map->is_linked == false, "Attempting to link instruction map that has already been linked.");
+
+    const int num_instructions = instruction_map->num_drafts;
+
+    int num_sub_handles = 0;
+    for (int handle = 0; handle < num_instructions; handle++) {
+        num_sub_handles += instruction_map->drafts[handle]->info->num_sub_instruction_atoms;
+    }
+
+    int* sub_handles = (int*) arena_alloc(instruction_map->arena, sizeof(int) * num_sub_handles);
+
+    int sub_handle_idx = 0;
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_map->drafts[handle];
+        const InstructionInfo* info = instruction->info;
+
+        instruction->first_sub_handle = sub_handle_idx;
+        instruction->num_sub_handles = info->num_sub_instruction_atoms;
+
+        for (int idx = 0; idx < info->num_sub_instruction_atoms; idx++) {
+            const int sub_instruction_atom = info->sub_instruction_atoms[idx];
+
+            const int sub_instruction_handle = get_atom_handle(instruction_map, sub_instruction_atom);
+            assert(sub_instruction_handle != -1, "Instruction %s (line %d) references undefined instruction %s.",
+                   info->id, info->line_number, instruction_map_get_id(sub_instruction_atom));
+
+            sub_handles[sub_handle_idx++] = sub_instruction_handle;
+        }
+    }
+
+    install_table(instruction_map->drafts, num_instructions, sub_handles, num_sub_handles);
+    delete_draft_arenas();
+}
+
+/**
+ * @brief Makes the given instructions the linked instruction table of the map, in place of instruction_map_link. The
+ * ith instruction is given handle i and its range of the given sub-instruction handles must already be set (see
+ * instruction_set_sub_instruction_span). The map takes ownership of the table, which is freed once its instructions
+ * are moved into the instruction table like linked ones; the sub-instruction handles are copied.
+ */
+void instruction_map_load_table(Instruction** table, int table_size, const int* sub_handles, int num_sub_handles) {
+    assert(instruction_map != NULL, "Attempting to load table without a bound instruction map.");
+    assert(instruction_map->num_drafts == 0 && instruction_map->is_linked == false,
+           "Attempting to load table into instruction map that is not empty.");
+    assert(table != NULL && table_size > 0, "Attempting to load empty instruction table.");
+    assert(sub_handles != NULL || num_sub_handles == 0, "Attempting to load table with NULL sub-instruction handles.");
+
+    int* sub_handles_copy = (int*) arena_alloc(instruction_map->arena, sizeof(int) * num_sub_handles);
+
+    if (num_sub_handles > 0) {
+        memcpy(sub_handles_copy, sub_handles, sizeof(int) * num_sub_handles);
+    }
+
+    for (int handle = 0; handle < table_size; handle++) {
+        const Instruction* instruction = table[handle];
+        assert(instruction->first_sub_handle >= 0
+               && instruction->first_sub_handle + instruction->num_sub_handles <= num_sub_handles,
+               "Loaded instruction %d has invalid sub-instruction handles.", handle);
+    }
+
+    install_table(table, table_size, sub_handles_copy, num_sub_handles);
+    free(table);
+    delete_draft_arenas();
+
+    // Fewer aliases than instructions were generated when the table was compiled, so an alias generated by a patch
+    // counts on from there and cannot be taken.
+    instruction_map->alias_counter = table_size;
+}
+
+/**
+ * @brief Returns the number of instructions in the instruction table, including any a patch removed. Zero until
+ * instruction_map_link is called.
+ */
+int instruction_table_get_size() {
+    return instruction_map->table_size;
+}
+
+/**
+ * @brief Retrieves the instruction with the given handle from the instruction table.
+ */
+Instruction* instruction_table_get(int handle) {
+    assert(handle >= 0 && handle < instruction_map->table_size, "Attempting to get instruction with invalid handle %d.", handle);
+
+    if (handle < instruction_map->num_installed) {
+        return &instruction_map->table[handle];
+    }
+
+    return instruction_map->added_records[handle - instruction_map->num_installed];
+}
+
+/**
+ * @brief Starts a patch of the linked map (see runtime.c). Until it is committed, instructions are created and
+ * inserted again, as drafts of the patch, while the linked records stay as they are and keep executing nothing. A draft
+ * is found by id before a record, and a record retired by the patch is not found at all.
+ */
+void instruction_map_begin_patch() {
+    assert(instruction_map != NULL, "Attempting to patch without a bound instruction map.");
+
+    // A script without instructions has nothing to link, so it is linked now.
+    if (instruction_map->is_linked == false) {
+        instruction_map_link();
+    }
+
+    assert(instruction_map->draft_arena == NULL, "Attempting to patch instruction map that is already being patched.");
+
+    instruction_map->draft_arena = arena_new(INSTRUCTION_DRAFT_BLOCK_SIZE);
+    instruction_map->scratch_arena = arena_new(INSTRUCTION_SCRATCH_BLOCK_SIZE);
+    instruction_map->draft_mark = arena_get_mark(instruction_map->draft_arena);
+}
+
+/**
+ * @brief Retires the record with the given handle for the patch being made, as if its line were gone: it is no longer
+ * found by id, and a draft with its id takes its place when the patch is committed. The record is left as it is until
+ * then.
+ */
+void instruction_map_retire(int handle) {
+    InstructionMap* map = instruction_map;
+    assert(map != NULL && is_patching(map), "Attempting to retire instruction without a patch.");
+
+    Instruction* record = instruction_table_get(handle);
+    assert(record->info->is_retired == false, "Attempting to retire instruction %s twice.", record->info->id);
+
+    if (map->num_retired_handles == map->retired_handles_capacity) {
+        const int capacity = map->retired_handles_capacity;
+        map->retired_handles_capacity = capacity > 0 ? 2 * capacity : 16;
+
+        map->retired_handles = (int*) arena_grow(map->draft_arena, map->retired_handles, sizeof(int) * capacity,
+                                                 sizeof(int) * map->retired_handles_capacity);
+    }
+
+    record->info->is_retired = true;
+    map->retired_handles[map->num_retired_handles++] = handle;
+}
+
+/**
+ * @brief Returns true if the record copied values from a record the patch being made retired, so its line has to be
+ * parsed again.
+ */
+bool instruction_references_retired(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to check references of NULL instruction.");
+
+    const InstructionInfo* info = instruction->info;
+    for (int idx = 0; idx < info->num_reference_atoms; idx++) {
+        const int handle = get_atom_handle(instruction_map, info->reference_atoms[idx]);
+
+        if (handle != -1 && instruction_table_get(handle)->info->is_retired) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Empties a retired record no draft took the place of. It keeps its id, for reporting, but is no longer found by
+ * it, and executes nothing.
+ */
+static void remove_record(InstructionMap* map, Instruction* record) {
+    InstructionInfo* info = record->info;
+
+    if (get_atom_handle(map, info->id_atom) == record->handle) {
+        set_atom_handle(map, info->id_atom, -1);
+    }
+
+    record->type = NONE;
+    record->keycode = 0;
+    record->num_sub_handles = 0;
+    memcpy(record->parameters, InstructionParameterDefaultValues, sizeof(record->parameters));
+    record->available_time = 0;
+    record->resume_time = NULL;
+    record->op_stream = NULL;
+
+    info->indent_count = 0;
+    info->line_number = -1;
+    info->num_listed_sub_instructions = 0;
+    info->num_reference_atoms = 0;
+    info->is_retired = false;
+}
+
+/**
+ * @brief Returns a handle for a draft that takes the place of no record: that of a record an earlier patch removed, or
+ * a new record past the end of the table. A new record is allocated on its own, so no record ever moves.
+ */
+static int claim_handle(InstructionMap* map) {
+    if (map->num_free_handles > 0) {
+        return map->free_handles[--map->num_free_handles];
+    }
+
+    const int num_added = map->table_size - map->num_installed;
+    if (num_added == map->added_records_capacity) {
+        const int capacity = map->added_records_capacity;
+        map->added_records_capacity = capacity > 0 ? 2 * capacity : 16;
+
+        map->added_records = (Instruction**) arena_grow(map->arena, map->added_records,
+                                                        sizeof(Instruction*) * capacity,
+                                                        sizeof(Instruction*) * map->added_records_capacity);
+    }
+
+    Instruction* record = (Instruction*) arena_alloc(map->arena, sizeof(Instruction) + sizeof(InstructionInfo));
+    InstructionInfo* info = (InstructionInfo*) (record + 1);
+    memset(info, 0, sizeof(InstructionInfo));
+    info->id_atom = -1;
+    info->line_number = -1;
+
+    record->type = NONE;
+    record->keycode = 0;
+    record->handle = map->table_size;
+    record->first_sub_handle = map->sub_handles_size;
+    record->num_sub_handles = 0;
+    memcpy(record->parameters, InstructionParameterDefaultValues, sizeof(record->parameters));
+    record->available_time = 0;
+    record->resume_time = NULL;
+    record->op_stream = NULL;
+    record->info = info;
+
+    map->added_records[num_added] = record;
+    return map->table_size++;
+}
+
+/**
+ * @brief Returns the index of a new range of the given number of sub-instruction handles, at the end of the shared
+ * handle array.
+ */
+static int append_sub_handles(InstructionMap* map, int num_sub_handles) {
+    if (map->sub_handles_size + num_sub_handles > map->sub_handles_capacity) {
+        int capacity = map->sub_handles_capacity > 0 ? 2 * map->sub_handles_capacity : 64;
+        while (capacity < map->sub_handles_size + num_sub_handles) {
+            capacity *= 2;
+        }
+
+        map->sub_handles = (int*) arena_grow(map->arena, map->sub_handles, sizeof(int) * map->sub_handles_capacity,
+                                             sizeof(int) * capacity);
+        map->sub_handles_capacity = capacity;
+    }
+
+    const int first_sub_handle = map->sub_handles_size;
+    map->sub_handles_size += num_sub_handles;
+
+    return first_sub_handle;
+}
+
+/**
+ * @brief Writes the draft over the record whose place it takes. The record keeps its handle and, if it executed
+ * anything, its cooldown. Returns true if the record executes something else now: its type, keycode, parameters or
+ * sub-instructions changed, or it executed nothing before.
+ */
+static bool patch_record(InstructionMap* map, Instruction* draft, Instruction* record) {
+    const InstructionInfo* draft_info = draft->info;
+    InstructionInfo* info = record->info;
+    const int num_sub_handles = draft_info->num_sub_instruction_atoms;
+
+    bool is_changed = record->type == NONE || record->type != draft->type || record->keycode != draft->keycode ||
+                      record->num_sub_handles != num_sub_handles ||
+                      memcmp(record->parameters, draft->parameters, sizeof(record->parameters)) != 0;
+
+    // The range is written in place if it fits, so most patches leave the shared handle array as it is.
+    if (num_sub_handles > record->num_sub_handles) {
+        record->first_sub_handle = append_sub_handles(map, num_sub_handles);
+    }
+
+    for (int idx = 0; idx < num_sub_handles; idx++) {
+        const int sub_instruction_atom = draft_info->sub_instruction_atoms[idx];
+
+        const int sub_instruction_handle = get_atom_handle(map, sub_instruction_atom);
+        assert(sub_instruction_handle != -1, "Instruction %s (line %d) references undefined instruction %s.",
+               draft_info->id, draft_info->line_number, instruction_map_get_id(sub_instruction_atom));
+
+        int* sub_handle = &map->sub_handles[record->first_sub_handle + idx];
+        is_changed |= *sub_handle != sub_instruction_handle;
+        *sub_handle = sub_instruction_handle;
+    }
+
+    if (record->type == NONE) {
+        record->available_time = 0;
+        record->resume_time = NULL;
+        record->op_stream = NULL;
+    }
+
+    record->type = draft->type;
+    record->keycode = draft->keycode;
+    record->num_sub_handles = num_sub_handles;
+    memcpy(record->parameters, draft->parameters, sizeof(record->parameters));
+
+    info->id = draft_info->id;
+    info->id_atom = draft_info->id_atom;
+    info->indent_count = draft_info->indent_count;
+    info->line_number = draft_info->line_number;
+    info->num_listed_sub_instructions = draft_info->num_listed_sub_instructions;
+    info->reference_atoms = copy_atoms(map->arena, draft_info->reference_atoms, draft_info->num_reference_atoms);
+    info->num_reference_atoms = draft_info->num_reference_atoms;
+    info->reference_atoms_capacity = draft_info->num_reference_atoms;
+    info->is_retired = false;
+
+    return is_changed;
+}
+
+/**
+ * @brief Commits the patch being made: every draft is written over a record, and every retired record no draft took
+ * the place of is removed. A draft takes the place of the record given for it, if any; else that of the retired record
+ * with its id, if any; else a handle of its own (see claim_handle). A removed record stays in the table, executing
+ * nothing, and its handle is only reused by a later patch. Exits if a sub-instruction references an instruction that
+ * does not exist.
+ *
+ * @param handles In: for each draft, in insertion order, the handle of the retired record it is meant to take the
+ * place of, or -1. Out: the handle of the record it was written over.
+ * @param is_changed Out: for each draft, whether its record executes something else now (see patch_record).
+ * @param removed_handles Out: the handles of the removed records. Must have room for every retired one.
+ * @return The number of removed records.
+ */
+int instruction_map_commit_patch(int* handles, bool* is_changed, int* removed_handles) {
+    InstructionMap* map = instruction_map;
+    assert(map != NULL && is_patching(map), "Attempting to commit patch without a patch.");
+    assert(map->newest_draft == NULL, "Attempting to commit patch with an instruction that was not inserted.");
+
+    const int num_drafts = map->num_drafts;
+
+    for (int draft_idx = 0; draft_idx < num_drafts; draft_idx++) {
+        if (handles[draft_idx] != -1) {
+            InstructionInfo* info = instruction_table_get(handles[draft_idx])->info;
+            assert(info->is_retired, "Attempting to patch instruction %s over one that is not retired.",
+                   map->drafts[draft_idx]->info->id);
+            info->is_retired = false;
+        }
+    }
+
+    for (int draft_idx = 0; draft_idx < num_drafts; draft_idx++) {
+        if (handles[draft_idx] == -1) {
+            const int handle = get_atom_handle(map, map->drafts[draft_idx]->info->id_atom);
+
+            if (handle != -1 && instruction_table_get(handle)->info->is_retired) {
+                instruction_table_get(handle)->info->is_retired = false;
+                handles[draft_idx] = handle;
+            }
+        }
+    }
+
+    int num_removed = 0;
+    for (int idx = 0; idx < map->num_retired_handles; idx++) {
+        Instruction* record = instruction_table_get(map->retired_handles[idx]);
+
+        if (record->info->is_retired) {
+            remove_record(map, record);
+            removed_handles[num_removed++] = record->handle;
+        }
+    }
+
+    for (int draft_idx = 0; draft_idx < num_drafts; draft_idx++) {
+        if (handles[draft_idx] == -1) {
+            handles[draft_idx] = claim_handle(map);
+        }
+
+        set_atom_handle(map, map->drafts[draft_idx]->info->id_atom, handles[draft_idx]);
+    }
+
+    for (int draft_idx = 0; draft_idx < num_drafts; draft_idx++) {
+        is_changed[draft_idx] = patch_record(map, map->drafts[draft_idx], instruction_table_get(handles[draft_idx]));
+    }
+
+    if (map->num_free_handles + num_removed > map->free_handles_capacity) {
+        int capacity = map->free_handles_capacity > 0 ? 2 * map->free_handles_capacity : 16;
+        while (capacity < map->num_free_handles + num_removed) {
+            capacity *= 2;
+        }
+
+        map->free_handles = (int*) arena_grow(map->arena, map->free_handles, sizeof(int) * map->free_handles_capacity,
+                                              sizeof(int) * capacity);
+        map->free_handles_capacity = capacity;
+    }
+
+    for (int idx = 0; idx < num_removed; idx++) {
+        map->free_handles[map->num_free_handles++] = removed_handles[idx];
+    }
+
+    delete_draft_arenas();
+    return num_removed;
 }
 
 /**
- * @brief Generates a unique alias for instruction referencing.
+ * @brief Returns the number of drafts of the patch being made.
  */
-char* instruction_map_generate_alias(const char* original_id) {
+int instruction_map_get_num_drafts() {
+    assert(instruction_map != NULL && is_patching(instruction_map), "Attempting to get drafts without a patch.");
+
+    return instruction_map->num_drafts;
+}
+
+/**
+ * @brief Generates a unique alias for instruction referencing. The alias is interned like any other id.
+ */
+const char* instruction_map_generate_alias(const char* original_id) {
 //    char* alias = (char*) malloc(sizeof(char) * (strlen(instruction_alias_prefix) + 10));
 //    assert(alias != NULL, "Failed to allocate memory for instruction alias.");
 //
 //    sprintf(alias, "%s%02d", instruction_alias_prefix, instruction_alias_counter++);
 //    return alias;
 
-    // Generate a string in the format "Alias(original_id)" using strlen to determine the length of the string.
-    const size_t alias_len = strlen(instruction_alias_prefix) + strlen(original_id) + 10;
-    char* alias = (char*) malloc(sizeof(char) * alias_len);
-    assert(alias != NULL, "Failed to allocate memory for instruction alias.");
+    // Generate a string in the format "Alias(original_id)" using strlen to determine the length of the string. The
+    // string is scratch: it is interned and its memory given back right away.
+    Arena* scratch = instruction_map_get_scratch_arena();
+    const ArenaMark mark = arena_get_mark(scratch);
+    const size_t alias_len = strlen(instruction_alias_prefix) + strlen(original_id) + 16;
+    char* alias = (char*) arena_alloc(scratch, sizeof(char) * alias_len);
 
-    sprintf(alias, "%s%02d(%s)", instruction_alias_prefix, instruction_alias_counter, original_id);
-    instruction_alias_counter++;
-    return alias;
+    sprintf(alias, "%s%02d(%s)", instruction_alias_prefix, instruction_map->alias_counter, original_id);
+    instruction_map->alias_counter++;
+
+    const char* interned_alias = instruction_map_get_id(instruction_map_intern(alias));
+    arena_rewind(scratch, mark);
+
+    return interned_alias;
 }
 
 void instruction_map_print() {
-    Instruction* current_instruction = NULL;
-    Instruction* tmp = NULL;
+    for (int handle = 0; handle < instruction_map->table_size; handle++) {
+        instruction_print(instruction_table_get(handle), true);
+    }
+
+    for (int idx = 0; idx < instruction_map->num_drafts; idx++) {
+        instruction_print(instruction_map->drafts[idx], true);
+    }
+}
+
+/**
+ * @brief Returns the instruction type with the given name, or -1 if there is none. The first character, and the length
+ * where that is not enough, selects the only type the name can be, so a lookup is one comparison.
+ */
+int instruction_type_find(const char* str_type) {
+    assert(str_type != NULL, "Attempting to find instruction type of NULL string.");
+
+    int candidate = -1;
+    switch (str_type[0]) {
+        case 'k': candidate = KEY; break;
+        case 'p': candidate = PRESS; break;
+        case 'h': candidate = HOLD; break;
+        case 'r': candidate = str_type[1] == 'a' ? RANDOM : str_type[1] == 'o' ? ROUTINE : RELEASE; break;
+        case 's': candidate = str_type[1] == 'c' ? SCRIPT : (str_type[1] == 't' && str_type[2] == 'a') ? START : STOP; break;
+        case 'w': candidate = str_type[1] == 'i' ? WINDOW : WAITLIST; break;
+        case 'g': candidate = GROUP; break;
+        case 'n': candidate = NONE; break;
+        default: return -1;
+    }
+
+    return strcmp(InstructionTypeLookupArray[candidate], str_type) == 0 ? candidate : -1;
+}
 
-    HASH_ITER(hh, instructions, current_instruction, tmp) {
-        instruction_print(current_instruction, true);
+/**
+ * @brief Returns the instruction parameter with the given name, or -1 if there is none. Every parameter starts with a
+ * different character, so a lookup is one comparison.
+ */
+int instruction_parameter_find(const char* str_parameter) {
+    assert(str_parameter != NULL, "Attempting to find instruction parameter of NULL string.");
+
+    int candidate = -1;
+    switch (str_parameter[0]) {
+        case 'd': candidate = DURATION; break;
+        case 'b': candidate = BEFORE; break;
+        case 'a': candidate = AFTER; break;
+        case 'r': candidate = REPEAT; break;
+        case 'c': candidate = COOLDOWN; break;
+        default: return -1;
     }
+
+    return strcmp(InstructionParameterLookupArray[candidate], str_parameter) == 0 ? candidate : -1;
 }
 
 /**
@@ -111,6 +937,7 @@ bool instruction_type_is_definition(InstructionType type) {
         case WINDOW:
         case WAITLIST:
         case ROUTINE:
+        case RANDOM:
         case GROUP:
             return true;
         default:
@@ -156,36 +983,61 @@ bool instruction_type_is_scheduler(InstructionType type) {
 }
 
 /**
- * @brief Creates a new instruction with default values.
+ * @brief Creates a new instruction with default values in the draft arena of the bound map. The instruction and its
+ * info are one allocation until the instruction is linked.
  * - id: NULL
  * - indent_count: 0
  * - keycode: 0
  * - parameters: See InstructionParameterDefaultValues for more details.
  * - type: NONE
- * - sub_instructions: NULL
+ * - sub_instruction_atoms: NULL
  */
 Instruction* instruction_new() {
-    Instruction* instruction = (Instruction*) malloc(sizeof(Instruction));
-    assert(instruction != NULL, "Failed to allocate memory for instruction.");
+    _Static_assert(sizeof(Instruction) % _Alignof(InstructionInfo) == 0, "An info must fit after its instruction.");
+
+    assert(instruction_map != NULL, "Attempting to create instruction without a bound instruction map.");
+    assert(instruction_map->draft_arena != NULL, "Attempting to create instruction in linked instruction map.");
+
+    Arena* draft_arena = instruction_map->draft_arena;
+    instruction_map->draft_mark = arena_get_mark(draft_arena);
+
+    Instruction* instruction = (Instruction*) arena_alloc(draft_arena, sizeof(Instruction) + sizeof(InstructionInfo));
+    instruction_map->newest_draft = instruction;
+
+    InstructionInfo* info = (InstructionInfo*) (instruction + 1);
+    info->id = NULL;
+    info->id_atom = -1;
+    info->indent_count = 0;
+    info->line_number = -1;
+    info->sub_instruction_atoms = NULL;
+    info->num_sub_instruction_atoms = 0;
+    info->sub_instruction_atoms_capacity = 0;
+    info->num_listed_sub_instructions = 0;
+    info->reference_atoms = NULL;
+    info->num_reference_atoms = 0;
+    info->reference_atoms_capacity = 0;
+    info->is_retired = false;
 
-    instruction->id = NULL;
     instruction->type = NONE;
     instruction->keycode = 0;
-    instruction->sub_instructions = NULL;
-    instruction->indent_count = 0;
-
-    instruction->parameters = (int*) malloc(2 * NUM_INSTRUCTION_PARAMETERS * sizeof(int));
-    assert(instruction->parameters != NULL, "Failed to allocate memory for instruction parameters.");
+    instruction->handle = -1;
+    instruction->first_sub_handle = -1;
+    instruction->num_sub_handles = 0;
 
-    memcpy(instruction->parameters, InstructionParameterDefaultValues, 2 * NUM_INSTRUCTION_PARAMETERS * sizeof(int));
+    memcpy(instruction->parameters, InstructionParameterDefaultValues, sizeof(instruction->parameters));
 
-    instruction->line_number = -1;
+    instruction->available_time = 0;
+    instruction->resume_time = NULL;
+    instruction->op_stream = NULL;
+    instruction->info = info;
 
     return instruction;
 }
 
 /**
- * @brief Deletes instruction and its sub-instructions if applicable.
+ * @brief Deletes an instruction that has not been inserted or linked. The memory of the newest instruction is given
+ * back to the draft arena; any other is only freed with the map. A linked instruction is a record of the instruction
+ * table and is deleted with its map.
  * @param ptr_instruction A pointer to the instruction to delete.
  */
 void instruction_delete(Instruction** ptr_instruction) {
@@ -193,30 +1045,36 @@ void instruction_delete(Instruction** ptr_instruction) {
     assert(*ptr_instruction != NULL, "Attempting to delete NULL instruction.");
 
     Instruction* instruction = *ptr_instruction;
-
-    if(instruction->id != NULL) {
-        free(instruction->id);
-        instruction->id = NULL;
-    }
-
-    free(instruction->parameters);
-
-    if(instruction->sub_instructions != NULL) {
-        str_list_delete(&instruction->sub_instructions);
-        instruction->sub_instructions = NULL;
+    assert(instruction->handle == -1, "Attempting to delete instruction %s that belongs to an instruction table.",
+           instruction->info->id);
+
+    // The id is owned by the instruction map's interning table, and everything allocated for the newest instruction
+    // since it was created belongs to it.
+    if (instruction_map != NULL && instruction_map->newest_draft == instruction) {
+        arena_rewind(instruction_map->draft_arena, instruction_map->draft_mark);
+        instruction_map->newest_draft = NULL;
     }
 
-    free(instruction);
     *ptr_instruction = NULL;
 }
 
 /**
  * @brief Returns the id.
  */
-char* instruction_get_id(Instruction* instruction) {
+const char* instruction_get_id(Instruction* instruction) {
     assert(instruction != NULL, "Attempting to get id of NULL instruction.");
 
-    return instruction->id;
+    return instruction->info->id;
+}
+
+/**
+ * @brief Returns the atom of the id, or -1 if the instruction has no id. Two instructions of one map have the same id
+ * exactly when their atoms are equal.
+ */
+int instruction_get_id_atom(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to get id atom of NULL instruction.");
+
+    return instruction->info->id_atom;
 }
 
 /**
@@ -225,7 +1083,7 @@ char* instruction_get_id(Instruction* instruction) {
 InstructionType instruction_get_type(Instruction* instruction) {
     assert(instruction != NULL, "Attempting to get type of NULL instruction.");
 
-    return instruction->type;
+    return (InstructionType) instruction->type;
 }
 
 /**
@@ -244,7 +1102,7 @@ unsigned short instruction_get_keycode(Instruction* instruction) {
 int instruction_get_indent_count(Instruction* instruction) {
     assert(instruction != NULL, "Attempting to get number of prefix spaces of NULL instruction.");
 
-    return instruction->indent_count;
+    return instruction->info->indent_count;
 }
 
 /**
@@ -265,48 +1123,76 @@ int instruction_get_parameter_upper_value(Instruction* instruction, InstructionP
     return instruction->parameters[2 * parameter + 1];
 }
 
+/**
+ * @brief Returns the handle assigned by instruction_map_link, or -1 if the instruction has not been linked.
+ */
+int instruction_get_handle(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to get handle of NULL instruction.");
+
+    return instruction->handle;
+}
+
 /**
  * @brief Returns the name of the sub-instruction at the given index.
  */
-char* instruction_get_sub_instruction_by_index(Instruction* instruction, int index) {
+const char* instruction_get_sub_instruction_by_index(Instruction* instruction, int index) {
     assert(instruction != NULL, "Attempting to get sub-instruction of NULL instruction.");
-    assert(instruction->type == GROUP, "Attempting to get sub-instruction of instruction that is not a group.");
-    assert(index >= 0 && index < str_list_get_size(instruction->sub_instructions),
+    assert(index >= 0 && index < instruction_get_num_sub_instructions(instruction),
            "Attempting to get sub-instruction of instruction with invalid index.");
 
-    return str_list_get_str(instruction->sub_instructions, index);
+    if (instruction->first_sub_handle != -1) {
+        return instruction_get_linked_sub_instruction(instruction, index)->info->id;
+    }
+
+    return instruction_map_get_id(instruction->info->sub_instruction_atoms[index]);
+}
+
+/**
+ * @brief Returns the handle of the sub-instruction at the given index. Errors if the instruction is not linked.
+ */
+int instruction_get_sub_instruction_handle(Instruction* instruction, int index) {
+    assert(instruction != NULL, "Attempting to get sub-instruction handle of NULL instruction.");
+    assert(instruction->handle != -1, "Attempting to get sub-instruction handle of unlinked instruction.");
+    assert(index >= 0 && index < instruction->num_sub_handles,
+           "Attempting to get sub-instruction handle of instruction with invalid index.");
+
+    return instruction_map->sub_handles[instruction->first_sub_handle + index];
 }
 
 /**
- * @brief Retrieves the count of sub-instructions. Errors if the instruction is not a group.
+ * @brief Returns the sub-instruction at the given index from the instruction table. Errors if the instruction is not
+ * linked.
+ */
+Instruction* instruction_get_linked_sub_instruction(Instruction* instruction, int index) {
+    return instruction_table_get(instruction_get_sub_instruction_handle(instruction, index));
+}
+
+/**
+ * @brief Retrieves the count of sub-instructions, or 0 if the instruction has none.
  */
 int instruction_get_num_sub_instructions(Instruction* instruction) {
     assert(instruction != NULL, "Attempting to get number of sub-instructions of NULL instruction.");
-    assert(instruction->type == GROUP,
-           "Attempting to get number of sub-instructions of instruction that is not a group.");
 
-    return str_list_get_size(instruction->sub_instructions);
+    if (instruction->first_sub_handle != -1) {
+        return instruction->num_sub_handles;
+    }
+
+    return instruction->info->num_sub_instruction_atoms;
 }
 
 /**
- * @brief Assigns the ID of an instruction. Errors if the ID already exists. A copy of the given ID is made.
+ * @brief Assigns the ID of an instruction. Errors if the ID already exists. The ID is interned in the bound instruction
+ * map, so the given string need not outlive the call.
  */
 void instruction_set_id(Instruction* instruction, const char* id) {
     assert(instruction != NULL, "Attempting to set id of NULL instruction.");
     assert(id != NULL, "Attempting to set id of instruction to NULL.");
-    assert(instruction->id == NULL, "Attempting to set id of instruction that already has an id. (current: %s, new: %s)",
-           instruction->id, id);
+    assert(instruction->info->id == NULL,
+           "Attempting to set id of instruction that already has an id. (current: %s, new: %s)",
+           instruction->info->id, id);
 
-    size_t id_len = strlen(id);
-    if (id[id_len - 1] != '\0') {
-        id_len++;
-    }
-
-    instruction->id = (char*) malloc(sizeof(char) * id_len);
-    assert(instruction->id != NULL, "Failed to allocate memory for instruction id.");
-
-    strcpy(instruction->id, id);
-    instruction->id[id_len - 1] = '\0';
+    instruction->info->id_atom = instruction_map_intern(id);
+    instruction->info->id = instruction_map_get_id(instruction->info->id_atom);
 }
 
 /**
@@ -317,7 +1203,7 @@ void instruction_set_type(Instruction* instruction, InstructionType type) {
     assert(instruction->type == NONE, "Attempting to set type of instruction that already has a type.");
     assert(type != NONE, "Attempting to set type of instruction to NONE.");
 
-    instruction->type = type;
+    instruction->type = (uint8_t) type;
 }
 
 /**
@@ -328,7 +1214,7 @@ void instruction_set_indent_count(Instruction* instruction, int indent_count) {
     assert(instruction != NULL, "Attempting to set number of prefix spaces of NULL instruction.");
     assert(indent_count >= 0, "Attempting to set indent count of instruction to negative value.");
 
-    instruction->indent_count = indent_count;
+    instruction->info->indent_count = indent_count;
 }
 
 
@@ -360,24 +1246,49 @@ void instruction_set_parameter_upper_value(Instruction* instruction, Instruction
 }
 
 /**
- * @brief Adds the given sub-instruction. A copy of the given sub-instruction is added.
+ * @brief Adds the given sub-instruction. The id is interned like the instruction's own id (see instruction_set_id).
  */
 void instruction_add_sub_instruction(Instruction* instruction, const char* sub_instruction_id) {
     assert(instruction != NULL, "Attempting to add sub-instruction to NULL instruction.");
     assert(sub_instruction_id != NULL, "Attempting to add NULL sub-instruction to instruction.");
+    assert(instruction->first_sub_handle == -1, "Attempting to add sub-instruction to linked instruction.");
+
+    InstructionInfo* info = instruction->info;
+    if (info->num_sub_instruction_atoms == info->sub_instruction_atoms_capacity) {
+        const int capacity = info->sub_instruction_atoms_capacity;
+        info->sub_instruction_atoms_capacity = capacity > 0 ? 2 * capacity : 4;
 
-    if (instruction->sub_instructions == NULL) {
-        const int resize_value = 1;
-        const bool is_using_shared_memory = false;
-        instruction->sub_instructions = str_list_new(resize_value, is_using_shared_memory);
+        info->sub_instruction_atoms = (int*) arena_grow(instruction_map->draft_arena, info->sub_instruction_atoms,
+                                                        sizeof(int) * capacity,
+                                                        sizeof(int) * info->sub_instruction_atoms_capacity);
     }
 
-    str_list_insert_str(instruction->sub_instructions, sub_instruction_id);
+    const int atom = instruction_map_intern(sub_instruction_id);
+    info->sub_instruction_atoms[info->num_sub_instruction_atoms++] = atom;
+}
+
+/**
+ * @brief Records that the instruction copies values from the instruction with the given id atom.
+ */
+static void add_reference_atom(Instruction* instruction, int atom) {
+    InstructionInfo* info = instruction->info;
+    if (info->num_reference_atoms == info->reference_atoms_capacity) {
+        const int capacity = info->reference_atoms_capacity;
+        info->reference_atoms_capacity = capacity > 0 ? 2 * capacity : 2;
+
+        info->reference_atoms = (int*) arena_grow(instruction_map->draft_arena, info->reference_atoms,
+                                                  sizeof(int) * capacity,
+                                                  sizeof(int) * info->reference_atoms_capacity);
+    }
+
+    info->reference_atoms[info->num_reference_atoms++] = atom;
 }
 
 /**
  * @brief Overwrites @param instruction's keycode and parameters from @param ref_instruction. sub_instructions are
- * overwritten too if @param instruction and @param ref_instruction are both of type group.
+ * overwritten too if @param instruction and @param ref_instruction are both of type group. A linked group, referenced
+ * while a patch is made, gives the sub-instructions it had when the line of @param instruction was reached: those its
+ * own line lists and those nested under it on earlier lines.
  * @param instruction The instruction whose values will be overwritten.
  * @param ref_instruction The instruction whose values will be copied from.
  */
@@ -388,21 +1299,105 @@ void instruction_copy_values(Instruction* instruction, Instruction* ref_instruct
     // unsigned short keycode;
     instruction->keycode = ref_instruction->keycode;
 
-    // int* parameters;
-    for (int i = 0; i < 2 * NUM_INSTRUCTION_PARAMETERS; i++) {
-        instruction->parameters[i] = ref_instruction->parameters[i];
-    }
+    // int32_t parameters[];
+    memcpy(instruction->parameters, ref_instruction->parameters, sizeof(instruction->parameters));
 
     // InstructionType type;
     if (instruction->type == GROUP && ref_instruction->type == GROUP) {
-        if (instruction->sub_instructions != NULL) {
-            str_list_delete(&instruction->sub_instructions);
-            instruction->sub_instructions = NULL;
+        InstructionInfo* info = instruction->info;
+        const InstructionInfo* ref_info = ref_instruction->info;
+        const int num_atoms = ref_info->num_sub_instruction_atoms;
+
+        info->sub_instruction_atoms = NULL;
+        info->num_sub_instruction_atoms = num_atoms;
+        info->sub_instruction_atoms_capacity = num_atoms;
+
+        if (ref_instruction->first_sub_handle != -1) {
+            const int num_sub_handles = ref_instruction->num_sub_handles;
+            info->sub_instruction_atoms = num_sub_handles > 0
+                ? (int*) arena_alloc(instruction_map->draft_arena, sizeof(int) * num_sub_handles) : NULL;
+            info->num_sub_instruction_atoms = 0;
+            info->sub_instruction_atoms_capacity = num_sub_handles;
+
+            for (int idx = 0; idx < num_sub_handles; idx++) {
+                Instruction* sub_instruction = instruction_get_linked_sub_instruction(ref_instruction, idx);
+                if (idx < ref_info->num_listed_sub_instructions ||
+                    sub_instruction->info->line_number < info->line_number) {
+                    info->sub_instruction_atoms[info->num_sub_instruction_atoms++] = sub_instruction->info->id_atom;
+                }
+            }
+        } else if (num_atoms > 0) {
+            info->sub_instruction_atoms = (int*) arena_alloc(instruction_map->draft_arena, sizeof(int) * num_atoms);
+            memcpy(info->sub_instruction_atoms, ref_info->sub_instruction_atoms, sizeof(int) * num_atoms);
         }
-
-        instruction->sub_instructions = str_list_copy(ref_instruction->sub_instructions);
-        assert(instruction->sub_instructions != NULL, "Failed to allocate memory for instruction sub_instructions.");
     }
+
+    add_reference_atom(instruction, ref_instruction->info->id_atom);
+}
+
+/**
+ * @brief Records that the instruction copied values from the instruction with the given id, for an instruction loaded
+ * in linked form (see instruction_copy_values).
+ */
+void instruction_add_reference(Instruction* instruction, const char* ref_id) {
+    assert(instruction != NULL, "Attempting to add reference to NULL instruction.");
+    assert(ref_id != NULL, "Attempting to add NULL reference to instruction.");
+
+    add_reference_atom(instruction, instruction_map_intern(ref_id));
+}
+
+/**
+ * @brief Returns the number of instructions the instruction copied values from.
+ */
+int instruction_get_num_references(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to get number of references of NULL instruction.");
+
+    return instruction->info->num_reference_atoms;
+}
+
+/**
+ * @brief Returns the instruction at the given index the instruction copied values from.
+ */
+Instruction* instruction_get_reference(Instruction* instruction, int index) {
+    assert(instruction != NULL, "Attempting to get reference of NULL instruction.");
+    assert(index >= 0 && index < instruction->info->num_reference_atoms,
+           "Attempting to get reference %d of instruction %s, which has %d.", index, instruction->info->id,
+           instruction->info->num_reference_atoms);
+
+    Instruction* ref_instruction = instruction_map_get_by_atom(instruction->info->reference_atoms[index]);
+    assert(ref_instruction != NULL, "Instruction %s references undefined instruction %s.", instruction->info->id,
+           instruction_map_get_id(instruction->info->reference_atoms[index]));
+
+    return ref_instruction;
+}
+
+/**
+ * @brief Returns how many of the sub-instructions the line of the instruction lists itself; the rest are nested under
+ * it.
+ */
+int instruction_get_num_listed_sub_instructions(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to get number of listed sub-instructions of NULL instruction.");
+
+    return instruction->info->num_listed_sub_instructions;
+}
+
+/**
+ * @brief Sets how many of the sub-instructions the line of the instruction lists itself.
+ */
+void instruction_set_num_listed_sub_instructions(Instruction* instruction, int num_listed) {
+    assert(instruction != NULL, "Attempting to set number of listed sub-instructions of NULL instruction.");
+    assert(num_listed >= 0, "Attempting to set number of listed sub-instructions to negative value.");
+
+    instruction->info->num_listed_sub_instructions = num_listed;
+}
+
+/**
+ * @brief Returns true while a patch replaces the instruction (see instruction_map_retire).
+ */
+bool instruction_is_retired(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to check if NULL instruction is retired.");
+
+    return instruction->info->is_retired;
 }
 
 /**
@@ -412,16 +1407,308 @@ void instruction_set_line_number(Instruction* instruction, int line_number) {
     assert(instruction != NULL, "Attempting to set line number of NULL instruction.");
     assert(line_number > 0, "Attempting to set line number of instruction to non-positive value.");
 
-    instruction->line_number = line_number;
+    instruction->info->line_number = line_number;
 }
 
-bool instruction_execute(Instruction* instruction) {
+/**
+ * @brief Returns the line of the script the instruction was parsed from, or -1 if it has none.
+ */
+int instruction_get_line_number(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to get line number of NULL instruction.");
+
+    return instruction->info->line_number;
+}
+
+/**
+ * @brief Returns the flattened form of a pass of the instruction, or NULL if it has none.
+ */
+OpStream* instruction_get_op_stream(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to get op stream of NULL instruction.");
+
+    return instruction->op_stream;
+}
+
+/**
+ * @brief Sets the range of an instruction's sub-instruction handles directly, for an instruction loaded in linked form
+ * rather than linked by instruction_map_link. The range indexes the handles given to instruction_map_load_table.
+ */
+void instruction_set_sub_instruction_span(Instruction* instruction, int first_sub_handle, int num_sub_handles) {
+    assert(instruction != NULL, "Attempting to set sub-instruction handles of NULL instruction.");
+    assert(instruction->first_sub_handle == -1 && instruction->info->sub_instruction_atoms == NULL,
+           "Attempting to set sub-instruction handles of instruction that already has sub-instructions.");
+    assert(first_sub_handle >= 0 && num_sub_handles >= 0, "Attempting to set invalid sub-instruction handles.");
+
+    instruction->first_sub_handle = first_sub_handle;
+    instruction->num_sub_handles = num_sub_handles;
+}
+
+/**
+ * @brief Gives the instruction the flattened form of its pass, replacing any it had. The stream lives in the script
+ * arena (see op_stream_new). NULL makes passes walk the tree again.
+ */
+void instruction_set_op_stream(Instruction* instruction, OpStream* op_stream) {
+    assert(instruction != NULL, "Attempting to set op stream of NULL instruction.");
+
+    instruction->op_stream = op_stream;
+}
+
+/**
+ * @brief Returns the time at which the instruction is off cooldown. While an execution of the instruction is in flight,
+ * its cooldown is not known yet, and the time the execution resumes next is returned instead: it completes no earlier,
+ * so that is the earliest the instruction is worth trying again.
+ */
+time_t instruction_get_available_time(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to get available time of NULL instruction.");
+
+    if (instruction->resume_time != NULL) {
+        return *instruction->resume_time;
+    }
+
+    return instruction->available_time;
+}
+
+/**
+ * @brief Returns true while an execution of the instruction is in flight (see instruction_acquire).
+ */
+bool instruction_is_in_flight(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to check if NULL instruction is in flight.");
+
+    return instruction->resume_time != NULL;
+}
+
+/**
+ * @brief Returns true if the instruction may begin an execution at the given time: no execution of it is in flight and
+ * it is off cooldown.
+ */
+bool instruction_is_available(Instruction* instruction, time_t time) {
+    assert(instruction != NULL, "Attempting to check availability of NULL instruction.");
+
+    return instruction->resume_time == NULL && time >= instruction->available_time;
+}
+
+/**
+ * @brief Samples a value uniformly between the lower and upper value of the parameter, inclusive, with the bound random
+ * number generator.
+ */
+int instruction_sample_parameter(Instruction* instruction, InstructionParameter parameter) {
+    assert(instruction != NULL, "Attempting to sample parameter of NULL instruction.");
+
+    const int lower_value = instruction->parameters[2 * parameter];
+    const int upper_value = instruction->parameters[2 * parameter + 1];
+
+    return (int) rng_sample_range(lower_value, upper_value);
+}
+
+/**
+ * @brief Samples a time parameter (given in ms by the script) uniformly in microseconds between its lower and upper
+ * value, inclusive. Sampling in microseconds keeps narrow ranges such as "duration 1 2" from collapsing onto two
+ * values.
+ */
+time_t instruction_sample_time_us(Instruction* instruction, InstructionParameter parameter) {
+    assert(instruction != NULL, "Attempting to sample time parameter of NULL instruction.");
+
+    const time_t lower_value = (time_t) instruction->parameters[2 * parameter] * CLOCK_US_PER_MS;
+    const time_t upper_value = (time_t) instruction->parameters[2 * parameter + 1] * CLOCK_US_PER_MS;
+
+    return (time_t) rng_sample_range(lower_value, upper_value);
+}
+
+/**
+ * @brief Samples the number of passes an execution of the instruction makes. An instruction runs once plus the
+ * sampled repeat count; a repeat of -1 repeats forever, in which case -1 is returned.
+ */
+int instruction_sample_num_passes(Instruction* instruction) {
+    const int num_repeats = instruction_sample_parameter(instruction, REPEAT);
+    if (num_repeats < 0) {
+        return -1;
+    }
+
+    return num_repeats + 1;
+}
+
+/**
+ * @brief Marks an execution of the instruction as in flight, so it is not available to anything else until it completes
+ * (see instruction_complete). An execution that runs over time, one wait at a time, must acquire its instruction when
+ * it begins: its cooldown only starts once it completes, so until then nothing else would see it as busy.
+ *
+ * @param instruction
+ * @param resume_time The time the execution resumes next, kept up to date by whatever runs it (see coroutine.c). Must
+ * stay valid until the instruction completes.
+ */
+void instruction_acquire(Instruction* instruction, const time_t* resume_time) {
+    assert(instruction != NULL, "Attempting to acquire NULL instruction.");
+    assert(resume_time != NULL, "Attempting to acquire instruction %s with NULL resume time.", instruction->info->id);
+    assert(instruction->resume_time == NULL, "Attempting to acquire instruction %s, which is already in flight.",
+           instruction->info->id);
+
+    instruction->resume_time = resume_time;
+}
+
+/**
+ * @brief Starts the cooldown of an instruction that completed at the given time, ending the execution in flight if it
+ * was acquired.
+ */
+void instruction_complete(Instruction* instruction, time_t end_time) {
+    assert(instruction != NULL, "Attempting to complete NULL instruction.");
+
+    instruction->resume_time = NULL;
+    instruction->available_time = end_time + instruction_sample_time_us(instruction, COOLDOWN);
+}
+
+/**
+ * @brief Executes a sub-instruction in place, waiting for it to come off cooldown first. Returns its completion time.
+ * The pass is executed in one go, so it cannot wait for an execution of the sub-instruction that is in flight
+ * elsewhere; such a sub-instruction is skipped.
+ */
+static time_t execute_sub_instruction(Instruction* sub_instruction, time_t start_time) {
+    if (instruction_is_in_flight(sub_instruction)) {
+        return start_time;
+    }
+
+    const time_t available_time = instruction_get_available_time(sub_instruction);
+    if (available_time > start_time) {
+        start_time = available_time;
+    }
+
+    time_t end_time = start_time;
+    instruction_execute(sub_instruction, start_time, &end_time);
+
+    return end_time;
+}
+
+/**
+ * @brief Executes a single pass of the instruction starting at the given time (us), ignoring repeat and cooldown. A pass
+ * waits `before`, performs the instruction, and waits `after`. Returns the time at which the pass completes.
+ *
+ * Keystrokes are pushed to the output stage with the time they are due rather than sent inline (see output.c).
+ *
+ * Start and stop targets are handed to the scheduler with the time they take effect, so a pass never blocks on the
+ * targets it starts.
+ *
+ * If the pass has been flattened, its op stream is executed instead, which sends the same strokes at the same times.
+ */
+time_t instruction_execute_pass(Instruction* instruction, time_t start_time) {
     assert(instruction != NULL, "Attempting to execute NULL instruction.");
 
-    InstructionType instruction_type = instruction_get_type(instruction);
+    if (instruction->op_stream != NULL) {
+        return op_stream_execute(instruction->op_stream, start_time);
+    }
+
+    const InstructionType instruction_type = instruction_get_type(instruction);
     assert(instruction_type != NONE, "Attempting to execute instruction with type NONE.");
 
-    return false;
+    time_t current_time = start_time + instruction_sample_time_us(instruction, BEFORE);
+    const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+
+    switch (instruction_type) {
+        case KEY:
+        case PRESS:
+            if (instruction->keycode != 0) {
+                output_push_stroke(current_time, instruction->keycode, true, instruction->handle);
+                current_time += instruction_sample_time_us(instruction, DURATION);
+                output_push_stroke(current_time, instruction->keycode, false, instruction->handle);
+            }
+
+            for (int idx = 0; idx < num_sub_instructions; idx++) {
+                current_time = execute_sub_instruction(instruction_get_linked_sub_instruction(instruction, idx), current_time);
+            }
+            break;
+        case HOLD:
+            // Holding presses the key (or each referenced key) down without releasing it.
+            if (instruction->keycode != 0) {
+                output_push_stroke(current_time, instruction->keycode, true, instruction->handle);
+            }
+
+            for (int idx = 0; idx < num_sub_instructions; idx++) {
+                const unsigned short keycode = instruction_get_linked_sub_instruction(instruction, idx)->keycode;
+                if (keycode != 0) {
+                    output_push_stroke(current_time, keycode, true, instruction->handle);
+                }
+            }
+
+            current_time += instruction_sample_time_us(instruction, DURATION);
+            break;
+        case RELEASE:
+            if (instruction->keycode != 0) {
+                output_push_stroke(current_time, instruction->keycode, false, instruction->handle);
+            }
+
+            for (int idx = 0; idx < num_sub_instructions; idx++) {
+                const unsigned short keycode = instruction_get_linked_sub_instruction(instruction, idx)->keycode;
+                if (keycode != 0) {
+                    output_push_stroke(current_time, keycode, false, instruction->handle);
+                }
+            }
+            break;
+        case GROUP:
+            for (int idx = 0; idx < num_sub_instructions; idx++) {
+                current_time = execute_sub_instruction(instruction_get_linked_sub_instruction(instruction, idx), current_time);
+            }
+            break;
+        case START:
+            for (int idx = 0; idx < num_sub_instructions; idx++) {
+                scheduler_start(instruction_get_linked_sub_instruction(instruction, idx), current_time);
+            }
+            break;
+        case STOP:
+            for (int idx = 0; idx < num_sub_instructions; idx++) {
+                scheduler_stop(instruction_get_linked_sub_instruction(instruction, idx), current_time);
+            }
+            break;
+        case WAITLIST:
+        case ROUTINE:
+        case RANDOM:
+            // Executing a scheduler in place starts it.
+            scheduler_start(instruction, current_time);
+            break;
+        default:
+            break;
+    }
+
+    return current_time + instruction_sample_time_us(instruction, AFTER);
+}
+
+/**
+ * @brief Executes the instruction in place starting at the given time, including each repeat, and starts its cooldown.
+ * Returns false without executing if the instruction is on cooldown or in flight at the given time. Otherwise the
+ * completion time is written to end_time.
+ *
+ * An instruction that repeats forever never completes in place; it must be started so the scheduler can run it one
+ * pass at a time.
+ */
+bool instruction_execute(Instruction* instruction, time_t start_time, time_t* end_time) {
+    assert(instruction != NULL, "Attempting to execute NULL instruction.");
+    assert(end_time != NULL, "Attempting to execute instruction with NULL end_time.");
+
+    if (instruction_is_available(instruction, start_time) == false) {
+        return false;
+    }
+
+    const int num_passes = instruction_sample_num_passes(instruction);
+    assert(num_passes >= 0, "Instruction %s (line %d) repeats forever and must be started instead of executed in place.",
+           instruction->info->id, instruction->info->line_number);
+
+    time_t current_time = start_time;
+    for (int pass = 0; pass < num_passes; pass++) {
+        current_time = instruction_execute_pass(instruction, current_time);
+    }
+
+    instruction_complete(instruction, current_time);
+    *end_time = current_time;
+
+    return true;
+}
+
+/**
+ * @brief Prints the ids of the sub-instructions, taking them from the instruction table if the instruction was loaded
+ * in linked form.
+ */
+static void print_sub_instructions(Instruction* instruction) {
+    printf("[");
+    for (int idx = 0; idx < instruction_get_num_sub_instructions(instruction); idx++) {
+        printf(idx > 0 ? ", %s" : "%s", instruction_get_sub_instruction_by_index(instruction, idx));
+    }
+    printf("]");
 }
 
 /**
@@ -430,14 +1717,14 @@ bool instruction_execute(Instruction* instruction) {
 void instruction_print(Instruction* instruction, bool should_format) {
     assert(instruction != NULL, "Attempting to print NULL instruction.");
 
-    printf("Instruction (line %d) {", instruction->line_number);
-    char* key_code_id = key_map_get_id(instruction->keycode);
+    printf("Instruction (line %d) {", instruction->info->line_number);
+    const char* key_code_id = key_map_get_id(instruction->keycode);
 
     if (should_format) {
         printf("\n");
         printf("\ttype: %s\n", InstructionTypeLookupArray[instruction->type]);
-        printf("\tid: %s\n", instruction->id);
-        printf("\tindent_count: %d\n", instruction->indent_count);
+        printf("\tid: %s\n", instruction->info->id);
+        printf("\tindent_count: %d\n", instruction->info->indent_count);
         printf("\tbutton: %s\n", key_code_id);
         for (int i = 0; i < NUM_INSTRUCTION_PARAMETERS; i++) {
             printf("\t%s: Random(min=%d, max=%d)\n", InstructionParameterLookupArray[i],
@@ -446,17 +1733,13 @@ void instruction_print(Instruction* instruction, bool should_format) {
 
         printf("\tsub_instructions: ");
 
-        if (instruction->sub_instructions != NULL) {
-            str_list_print(instruction->sub_instructions, false);
-        } else {
-            printf("[]");
-        }
+        print_sub_instructions(instruction);
 
         printf("\n}\n");
     } else {
         printf("type: %s, ", InstructionTypeLookupArray[instruction->type]);
-        printf("id: %s, ", instruction->id);
-        printf("indent_count: %d, ", instruction->indent_count);
+        printf("id: %s, ", instruction->info->id);
+        printf("indent_count: %d, ", instruction->info->indent_count);
         printf("button: %s, ", key_code_id);
         for (int i = 0; i < NUM_INSTRUCTION_PARAMETERS; i++) {
             printf("%s: Random(min=%d, max=%d), ", InstructionParameterLookupArray[i],
@@ -465,11 +1748,7 @@ void instruction_print(Instruction* instruction, bool should_format) {
 
         printf("sub_instructions: ");
 
-        if (instruction->sub_instructions != NULL) {
-            str_list_print(instruction->sub_instructions, false);
-        } else {
-            printf("[]");
-        }
+        print_sub_instructions(instruction);
 
         printf("}");
     }
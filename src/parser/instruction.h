@@ -8,10 +8,11 @@
 #include <string.h>
 
 #include "src/utility/utility.h"
+#include "src/utility/rng.h"
 #include "src/keyboard/keycodes.h"
 #include "src/utility/str_list.h"
+#include "src/utility/arena.h"
 #include "src/main.h"
-#include "src/utility/uthash.h"
 
 #define DEFAULT_DURATION_LOWER_BOUND 50
 #define DEFAULT_DURATION_UPPER_BOUND 70
@@ -93,15 +94,39 @@ static const int NUM_INSTRUCTION_TYPES = sizeof (InstructionTypeLookupArray) / s
 static const int NUM_INSTRUCTION_PARAMETERS = sizeof (InstructionParameterLookupArray) / sizeof (InstructionParameterLookupArray[0]);
 
 typedef struct InstructionStruct Instruction;
+typedef struct InstructionMapStruct InstructionMap;
+typedef struct OpStreamStruct OpStream;
 
 // Collection Functions
+InstructionMap* instruction_map_new();
+void            instruction_map_delete(InstructionMap** ptr_map);
+void            instruction_map_bind(InstructionMap* map);
+Arena*          instruction_map_get_arena();
+Arena*          instruction_map_get_scratch_arena();
 void            instruction_map_insert(Instruction* instruction);
-void            instruction_map_clear();
 Instruction*    instruction_map_get(const char* id);
-char*           instruction_map_generate_alias(const char* original_id);
+Instruction*    instruction_map_get_by_atom(int atom);
+int             instruction_map_intern(const char* id);
+const char*     instruction_map_get_id(int atom);
+const char*     instruction_map_generate_alias(const char* original_id);
+void            instruction_map_link();
+void            instruction_map_load_table(Instruction** table, int table_size, const int* sub_handles, int num_sub_handles);
 void            instruction_map_print();
 
+// Patch Functions
+void            instruction_map_begin_patch();
+void            instruction_map_retire(int handle);
+bool            instruction_references_retired(Instruction* instruction);
+int             instruction_map_get_num_drafts();
+int             instruction_map_commit_patch(int* handles, bool* is_changed, int* removed_handles);
+
+// Linked Table Functions
+int             instruction_table_get_size();
+Instruction*    instruction_table_get(int handle);
+
 // Instruction Helpers
+int             instruction_type_find(const char* str_type);
+int             instruction_parameter_find(const char* str_parameter);
 bool            instruction_type_is_definition(InstructionType type);
 bool            instruction_can_define_inplace(InstructionType type);
 bool            instruction_type_is_transaction(InstructionType type);
@@ -112,14 +137,24 @@ Instruction*    instruction_new();
 void            instruction_delete(Instruction** ptr_instruction);
 
 // Accessor Functions
-char*           instruction_get_id(Instruction* instruction);
+const char*     instruction_get_id(Instruction* instruction);
+int             instruction_get_id_atom(Instruction* instruction);
 InstructionType instruction_get_type(Instruction* instruction);
 unsigned short  instruction_get_keycode(Instruction* instruction);
 int             instruction_get_indent_count(Instruction* instruction);
 int             instruction_get_parameter_lower_value(Instruction* instruction, InstructionParameter parameter);
 int             instruction_get_parameter_upper_value(Instruction* instruction, InstructionParameter parameter);
-char*           instruction_get_sub_instruction_by_index(Instruction* instruction, int index);
+int             instruction_get_handle(Instruction* instruction);
+const char*     instruction_get_sub_instruction_by_index(Instruction* instruction, int index);
+int             instruction_get_sub_instruction_handle(Instruction* instruction, int index);
+Instruction*    instruction_get_linked_sub_instruction(Instruction* instruction, int index);
 int             instruction_get_num_sub_instructions(Instruction* instruction);
+int             instruction_get_line_number(Instruction* instruction);
+int             instruction_get_num_listed_sub_instructions(Instruction* instruction);
+int             instruction_get_num_references(Instruction* instruction);
+Instruction*    instruction_get_reference(Instruction* instruction, int index);
+bool            instruction_is_retired(Instruction* instruction);
+OpStream*       instruction_get_op_stream(Instruction* instruction);
 
 // Mutator Functions
 void            instruction_set_id(Instruction* instruction, const char* id);
@@ -131,9 +166,22 @@ void            instruction_set_parameter_upper_value(Instruction* instruction,
 void            instruction_add_sub_instruction(Instruction* instruction, const char* sub_instruction_id);
 void            instruction_copy_values(Instruction* instruction, Instruction* ref_instruction);
 void            instruction_set_line_number(Instruction* instruction, int line_number);
+void            instruction_set_sub_instruction_span(Instruction* instruction, int first_sub_handle, int num_sub_handles);
+void            instruction_set_op_stream(Instruction* instruction, OpStream* op_stream);
+void            instruction_set_num_listed_sub_instructions(Instruction* instruction, int num_listed);
+void            instruction_add_reference(Instruction* instruction, const char* ref_id);
 
 // Executors
-bool instruction_execute(Instruction* instruction);
+time_t          instruction_get_available_time(Instruction* instruction);
+bool            instruction_is_in_flight(Instruction* instruction);
+bool            instruction_is_available(Instruction* instruction, time_t time);
+int             instruction_sample_parameter(Instruction* instruction, InstructionParameter parameter);
+time_t          instruction_sample_time_us(Instruction* instruction, InstructionParameter parameter);
+int             instruction_sample_num_passes(Instruction* instruction);
+void            instruction_acquire(Instruction* instruction, const time_t* resume_time);
+void            instruction_complete(Instruction* instruction, time_t end_time);
+time_t          instruction_execute_pass(Instruction* instruction, time_t start_time);
+bool            instruction_execute(Instruction* instruction, time_t start_time, time_t* end_time);
 
 // Utility Functions
 void            instruction_print(Instruction* instruction, bool should_format);
@@ -28,7 +28,7 @@
 const int BUCKET_TYPE_ID = 0;
 
 /**
- * Inserts the token into the bucket.
+ * Inserts the token of the given length into the bucket.
  *
  * True is returned if :
  * - The token was an instruction type or id.
@@ -38,9 +38,10 @@ const int BUCKET_TYPE_ID = 0;
  * See @class Lexer.c file summary for a more detailed explanation.
  * @param bucket
  * @param token
+ * @param length
  * @return
  */
-static bool insert_token(StrBucket* bucket, char* token) {
+static bool insert_token(StrBucket* bucket, char* token, size_t length) {
     // If the bucket is empty, then insert the token as the instruction type.
     // The bucket is only ever empty when the instruction type has not been set.
     // The bucket containing the instruction type should contain nothing else. See @class Lexer.c file summary.
@@ -52,14 +53,19 @@ static bool insert_token(StrBucket* bucket, char* token) {
     }
 
     // If the current token is "with", then the id bucket is now over. Insert a new bucket for the first parameter.
-    const bool is_end_of_header = strcmp(token, "with") == 0;
+    const bool is_end_of_header = length == 4 && memcmp(token, "with", 4) == 0;
     if (is_end_of_header) {
         return true;
     }
 
     // If the current token ends with a comma, then the current parameter group is over. Insert a new bucket for the
-    // next parameter.
-    const bool is_end_of_parameter = str_remove_trailing_delimiters(token, ",") > 0;
+    // next parameter. The length is known, so the commas are removed from the end without searching for it.
+    const size_t unstripped_length = length;
+    while (length > 0 && token[length - 1] == ',') {
+        token[--length] = '\0';
+    }
+
+    const bool is_end_of_parameter = length < unstripped_length;
     const int bucket_id = str_bucket_get_size(bucket) - 1;
     str_bucket_insert_str(bucket, bucket_id, token);
 
@@ -67,32 +73,27 @@ static bool insert_token(StrBucket* bucket, char* token) {
 }
 
 /**
- * Tokenizes and groups a string into buckets based on the ignored_chars parameter.
+ * Tokenizes the first length characters of a string and groups the tokens into buckets. A token is a run of
+ * characters not in the ignored set; the scanner finds where each run starts and ends a block of characters at a time
+ * (see char_scan.c), and the character ending each token is replaced with a null terminator.
  *
  * See @class Lexer.c file summary for a more detailed explanation.
  *
+ * @param bucket
  * @param str_instruction
+ * @param length
  * @param ignored_chars
- * @return
  */
-static void tokenize_and_insert(StrBucket* bucket, char* str_instruction, const char* ignored_chars) {
-    char* current_token = str_instruction;
+static void tokenize_and_insert(StrBucket* bucket, char* str_instruction, size_t length, const CharSet* ignored_chars) {
+    CharScanner scanner;
+    char_scanner_begin(&scanner, ignored_chars, str_instruction, length);
+
     bool is_bucket_full = false;
+    size_t token_start = char_scanner_find(&scanner, 0, false);
 
-    while(*current_token) {
-        // Remove leading ignored chars. If the token becomes empty, then do nothing. This happens when the entire
-        // string is composed of ignored chars.
-        current_token += str_remove_leading_ignored_chars(current_token, ignored_chars);
-        if (current_token == NULL || *current_token == '\0') {
-            break;
-        }
-
-        // Finds the first ignored character. The string composed of characters before the ignored character is the
-        // current token. The ignored character is replaced with a null terminator to end the current token.
-        char* next_ignored_char = strpbrk(current_token, ignored_chars);
-        if (next_ignored_char != NULL) {
-            *next_ignored_char = '\0';
-        }
+    while (token_start < length) {
+        const size_t token_end = char_scanner_find(&scanner, token_start, true);
+        str_instruction[token_end] = '\0';
 
         // If the current bucket is full (i.e., completed), then insert a new bucket to be used.
         if (is_bucket_full) {
@@ -102,37 +103,44 @@ static void tokenize_and_insert(StrBucket* bucket, char* str_instruction, const
         // Insert the current token into the bucket. Based on the token, the bucket may become full. A bucket is full
         // when the token is an instruction type, id, is "with", or the token ends with a comma signifying the end of
         // the parameter group.
-        is_bucket_full = insert_token(bucket, current_token);
+        is_bucket_full = insert_token(bucket, str_instruction + token_start, token_end - token_start);
 
-        // Set the beginning of the next token to the character after the newly inserted null terminator.
-        if (next_ignored_char) {
-            current_token = next_ignored_char + 1;
-        } else {
-            break;
-        }
+        // The next token starts at the first character after this one that is not ignored.
+        token_start = char_scanner_find(&scanner, token_end + 1, false);
     }
 }
 
 /**
- * Tokenizes and groups a string into buckets based on the ignored_chars parameter.
+ * Tokenizes and groups a string into buckets based on the ignored_chars parameter. The buckets are allocated from the
+ * given scratch arena, or from the heap if it is NULL.
  *
  * See @class Lexer.c file summary for a more detailed explanation.
  *
  * @param str_instruction
  * @param ignored_chars
+ * @param scratch
  * @return
  */
-StrBucket* tokenize_to_buckets(char* str_instruction, const char* ignored_chars) {
+StrBucket* tokenize_to_buckets(char* str_instruction, const char* ignored_chars, Arena* scratch) {
     assert(str_instruction != NULL, "Attempting to bucket NULL string.");
     assert(ignored_chars != NULL, "Attempting to bucket string with NULL ignored_chars.");
 
-    str_remove_trailing_delimiters(str_instruction, ",\n");
-    if(strlen(str_instruction) == 0) {
+    size_t length = strlen(str_instruction);
+    while (length > 0 && (str_instruction[length - 1] == ',' || str_instruction[length - 1] == '\n')) {
+        str_instruction[--length] = '\0';
+    }
+
+    if (length == 0) {
         return NULL;
     }
 
-    StrBucket* bucket = str_bucket_new(1, 1, true);
-    tokenize_and_insert(bucket, str_instruction, ignored_chars);
+    CharSet ignored_set;
+    char_set_init(&ignored_set, ignored_chars);
+
+    // Tokens are not copied; they point into the instruction string. A typical line fits in the storage inside the
+    // bucket, so bucketing it allocates only the bucket, which is scratch memory when there is a scratch arena.
+    StrBucket* bucket = scratch != NULL ? str_bucket_new_in_arena(scratch, 8, 16) : str_bucket_new(8, 16, true);
+    tokenize_and_insert(bucket, str_instruction, length, &ignored_set);
 
     if (str_bucket_get_size(bucket) == 0) {
         str_bucket_delete(&bucket);
@@ -140,4 +148,4 @@ StrBucket* tokenize_to_buckets(char* str_instruction, const char* ignored_chars)
     }
 
     return bucket;
-}
\ No newline at end of file
+}
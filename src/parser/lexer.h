@@ -5,6 +5,7 @@
 #include <stdlib.h>
 
 
+#include "../utility/char_scan.h"
 #include "../utility/str_bucket.h"
 #include "../main.h"
 
@@ -18,6 +19,6 @@ typedef enum {
     PARSING_PARAMETER,
 } ParsingState;
 
-StrBucket* tokenize_to_buckets(char* str_instruction, const char* ignored_chars);
+StrBucket* tokenize_to_buckets(char* str_instruction, const char* ignored_chars, Arena* scratch);
 
 #endif //BEANSCRIPT_LEXER_H
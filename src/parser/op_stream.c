@@ -0,0 +1,677 @@
+/**
+ * @file op_stream.c
+ *
+ * Op streams are the flattened form of an instruction's pass. Executing a pass by walking the instruction tree samples
+ * every parameter of every instruction it reaches, switches on each type and follows each reference through the
+ * instruction table. After linking, every pass is compiled once into a flat array of primitive ops instead: key down,
+ * key up and wait. The keys and keycodes of groups, presses and referenced keys are inlined in execution order, waits
+ * whose range is a single value are folded to a constant, and adjacent waits are merged wherever that leaves the
+ * sampled distribution unchanged.
+ *
+ * A stream makes the same random draws in the same order as walking the tree. A sub-instruction that may make more
+ * than one pass runs its pass in a loop whose count is sampled when the loop begins, exactly when the tree samples it.
+ * Only a sub-instruction that can never be flattened (one that repeats forever, nests too deeply, or would grow the
+ * stream past OP_STREAM_MAX_OPS) stays a single execute op that walks the tree. An inlined sub-instruction still waits
+ * for and starts its own cooldown, and is in flight in between (see instruction_acquire), unless it has no cooldown and
+ * is referenced from nowhere else, because then nothing can ever observe it. Such an instruction (typically an alias
+ * generated for a reference) is dropped: no stream is compiled for it, since it only ever runs inlined in its parent.
+ *
+ * A stream is executed through a cursor, which holds everything needed to resume it: the next op, the current time and
+ * the passes left of each loop. op_stream_resume runs ops until time has to pass, so a caller can execute a pass one
+ * wait at a time without a thread or a stack of its own (see coroutine.c).
+ */
+
+#include "op_stream.h"
+#include "src/keyboard/output.h"
+#include "src/scheduler/scheduler.h"
+
+#define OP_STREAM_MAX_OPS 1024
+#define OP_STREAM_MAX_DEPTH 32
+
+typedef enum {
+    OP_KEY_DOWN,
+    OP_KEY_UP,
+    OP_WAIT,
+    OP_WAIT_RANGE,
+    OP_ACQUIRE,
+    OP_COMPLETE,
+    OP_EXECUTE,
+    OP_START,
+    OP_STOP,
+    OP_LOOP_BEGIN,
+    OP_LOOP_END,
+} OpType;
+
+static const char* OpTypeLookupArray[] = {
+        "key_down",
+        "key_up",
+        "wait",
+        "wait_range",
+        "acquire",
+        "complete",
+        "execute",
+        "start",
+        "stop",
+        "loop_begin",
+        "loop_end",
+};
+
+/**
+ * @brief A primitive op.
+ * - keycode, handle: The key a key op sends, and the handle of the instruction the stroke is recorded against.
+ * - lower, upper: The time (us) a wait op waits, sampled uniformly between the two for a ranged wait.
+ * - target: The instruction an acquire, complete, execute, start or stop op acts on, or whose passes a loop counts.
+ * - loop: The index (nesting depth) of the loop a loop op begins or ends.
+ * - jump: The index of the first op in the loop an end op closes, or of the op after the complete op that closes an
+ *   acquire op.
+ */
+typedef struct {
+    OpType type;
+    unsigned short keycode;
+    int handle;
+    time_t lower;
+    time_t upper;
+    Instruction* target;
+    int loop;
+    int jump;
+} Op;
+
+/**
+ * @brief A compiled pass. The stream and its ops live in the script arena (see instruction_map_get_arena). Nothing else
+ * is allocated from the arena while a stream is compiled, so its ops are always the newest allocation and grow in
+ * place one op at a time.
+ */
+struct OpStreamStruct {
+    Op* ops;
+    int size;
+};
+
+static void emit(OpStream* stream, Op op) {
+    stream->ops = (Op*) arena_grow(instruction_map_get_arena(), stream->ops, sizeof(Op) * stream->size,
+                                   sizeof(Op) * (stream->size + 1));
+    stream->ops[stream->size++] = op;
+}
+
+/**
+ * Emits a wait of the given time parameter of the instruction. A range of one value becomes a constant wait, which is
+ * added onto a wait just before it; a ranged wait can take a constant wait before it onto its bounds. Two ranged waits
+ * are kept apart, since the sum of two uniform waits is not uniform.
+ */
+static void emit_wait(OpStream* stream, Instruction* instruction, InstructionParameter parameter) {
+    time_t lower_value = (time_t) instruction_get_parameter_lower_value(instruction, parameter) * CLOCK_US_PER_MS;
+    time_t upper_value = (time_t) instruction_get_parameter_upper_value(instruction, parameter) * CLOCK_US_PER_MS;
+
+    // Sampling a range whose upper value is not above its lower value always gives the lower value.
+    const bool is_constant = upper_value <= lower_value;
+    if (is_constant) {
+        if (lower_value == 0) {
+            return;
+        }
+        upper_value = lower_value;
+    }
+
+    if (stream->size > 0) {
+        Op* previous = &stream->ops[stream->size - 1];
+
+        if (previous->type == OP_WAIT || (previous->type == OP_WAIT_RANGE && is_constant)) {
+            previous->type = is_constant ? previous->type : OP_WAIT_RANGE;
+            previous->lower += lower_value;
+            previous->upper += upper_value;
+            return;
+        }
+    }
+
+    emit(stream, (Op) { .type = is_constant ? OP_WAIT : OP_WAIT_RANGE, .lower = lower_value, .upper = upper_value });
+}
+
+static void emit_key(OpStream* stream, OpType type, unsigned short keycode, Instruction* instruction) {
+    if (keycode != 0) {
+        emit(stream, (Op) { .type = type, .keycode = keycode, .handle = instruction_get_handle(instruction) });
+    }
+}
+
+/**
+ * Returns true if an execution of the instruction can never repeat forever.
+ */
+static bool is_finite(Instruction* instruction) {
+    return instruction_get_parameter_lower_value(instruction, REPEAT) >= 0;
+}
+
+/**
+ * Returns true if every execution of the instruction makes exactly one pass.
+ */
+static bool is_single_pass(Instruction* instruction) {
+    const int lower_value = instruction_get_parameter_lower_value(instruction, REPEAT);
+    const int upper_value = instruction_get_parameter_upper_value(instruction, REPEAT);
+
+    return lower_value == 0 && upper_value <= lower_value;
+}
+
+/**
+ * Returns true if nothing but its only reference can observe when the instruction is available: it has no cooldown and
+ * is referenced exactly once, and not from the execution list.
+ */
+static bool is_unobservable(Instruction* instruction, const int* reference_counts) {
+    const int lower_value = instruction_get_parameter_lower_value(instruction, COOLDOWN);
+    const int upper_value = instruction_get_parameter_upper_value(instruction, COOLDOWN);
+
+    return upper_value <= lower_value && lower_value <= 0 && reference_counts[instruction_get_handle(instruction)] == 1;
+}
+
+static bool emit_pass(OpStream* stream, Instruction* instruction, const int* reference_counts, int depth,
+                      int num_loops);
+
+/**
+ * Emits the execution of a sub-instruction in place, the way instruction_execute performs it: wait for its cooldown,
+ * make its passes and start its cooldown. A sub-instruction that may make more than one pass runs its pass in a loop.
+ * If it cannot be inlined, a single execute op is emitted instead.
+ *
+ * @param depth The number of sub-instructions the stream is already inlined into.
+ * @param num_loops The number of loops the sub-instruction is emitted inside of.
+ */
+static void emit_sub_instruction(OpStream* stream, Instruction* sub_instruction, const int* reference_counts,
+                                 int depth, int num_loops) {
+    const bool is_looped = is_single_pass(sub_instruction) == false;
+
+    // Where to roll back to if the sub-instruction turns out too large to inline. Its first wait may be merged into
+    // the op before it, so that op is kept as well.
+    const int mark = stream->size;
+    const Op last_op = mark > 0 ? stream->ops[mark - 1] : (Op) { 0 };
+
+    const bool can_loop = is_looped == false || num_loops < OP_STREAM_MAX_LOOPS;
+
+    if (is_finite(sub_instruction) && depth < OP_STREAM_MAX_DEPTH && can_loop) {
+        const bool is_synchronized = is_unobservable(sub_instruction, reference_counts) == false;
+        const int acquire_idx = stream->size;
+        if (is_synchronized) {
+            emit(stream, (Op) { .type = OP_ACQUIRE, .target = sub_instruction });
+        }
+
+        const int loop_begin_idx = stream->size;
+        if (is_looped) {
+            emit(stream, (Op) { .type = OP_LOOP_BEGIN, .target = sub_instruction, .loop = num_loops });
+        }
+
+        const bool is_inlined = emit_pass(stream, sub_instruction, reference_counts, depth + 1,
+                                          is_looped ? num_loops + 1 : num_loops) && stream->size <= OP_STREAM_MAX_OPS;
+
+        if (is_inlined) {
+            if (is_looped) {
+                emit(stream, (Op) { .type = OP_LOOP_END, .loop = num_loops, .jump = loop_begin_idx + 1 });
+            }
+
+            if (is_synchronized) {
+                emit(stream, (Op) { .type = OP_COMPLETE, .target = sub_instruction });
+                stream->ops[acquire_idx].jump = stream->size;
+            }
+            return;
+        }
+
+        stream->size = mark;
+        if (mark > 0) {
+            stream->ops[mark - 1] = last_op;
+        }
+    }
+
+    emit(stream, (Op) { .type = OP_EXECUTE, .target = sub_instruction });
+}
+
+/**
+ * Emits one pass of the instruction, in the order instruction_execute_pass performs it. Returns false if the
+ * instruction has no type and therefore cannot be flattened.
+ */
+static bool emit_pass(OpStream* stream, Instruction* instruction, const int* reference_counts, int depth,
+                      int num_loops) {
+    const InstructionType instruction_type = instruction_get_type(instruction);
+    if (instruction_type == NONE) {
+        return false;
+    }
+
+    const unsigned short keycode = instruction_get_keycode(instruction);
+    const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+
+    emit_wait(stream, instruction, BEFORE);
+
+    switch (instruction_type) {
+        case KEY:
+        case PRESS:
+            if (keycode != 0) {
+                emit_key(stream, OP_KEY_DOWN, keycode, instruction);
+                emit_wait(stream, instruction, DURATION);
+                emit_key(stream, OP_KEY_UP, keycode, instruction);
+            }
+
+            for (int idx = 0; idx < num_sub_instructions && stream->size <= OP_STREAM_MAX_OPS; idx++) {
+                emit_sub_instruction(stream, instruction_get_linked_sub_instruction(instruction, idx), reference_counts,
+                                     depth, num_loops);
+            }
+            break;
+        case HOLD:
+        case RELEASE: {
+            const OpType key_type = instruction_type == HOLD ? OP_KEY_DOWN : OP_KEY_UP;
+            emit_key(stream, key_type, keycode, instruction);
+
+            for (int idx = 0; idx < num_sub_instructions; idx++) {
+                Instruction* sub_instruction = instruction_get_linked_sub_instruction(instruction, idx);
+                emit_key(stream, key_type, instruction_get_keycode(sub_instruction), instruction);
+            }
+
+            if (instruction_type == HOLD) {
+                emit_wait(stream, instruction, DURATION);
+            }
+            break;
+        }
+        case GROUP:
+            for (int idx = 0; idx < num_sub_instructions && stream->size <= OP_STREAM_MAX_OPS; idx++) {
+                emit_sub_instruction(stream, instruction_get_linked_sub_instruction(instruction, idx), reference_counts,
+                                     depth, num_loops);
+            }
+            break;
+        case START:
+        case STOP:
+            for (int idx = 0; idx < num_sub_instructions; idx++) {
+                emit(stream, (Op) { .type = instruction_type == START ? OP_START : OP_STOP,
+                                    .target = instruction_get_linked_sub_instruction(instruction, idx) });
+            }
+            break;
+        case WAITLIST:
+        case ROUTINE:
+        case RANDOM:
+            emit(stream, (Op) { .type = OP_START, .target = instruction });
+            break;
+        default:
+            break;
+    }
+
+    emit_wait(stream, instruction, AFTER);
+    return true;
+}
+
+/**
+ * @brief Compiles one pass of the instruction into an op stream. Returns NULL if the instruction cannot be flattened,
+ * in which case it is executed by walking the tree. The stream is allocated from the script arena of the bound map and
+ * is freed with the map.
+ *
+ * @param instruction
+ * @param reference_counts The number of times each instruction is referenced, by handle (see
+ * op_stream_count_references).
+ */
+OpStream* op_stream_new(Instruction* instruction, const int* reference_counts) {
+    assert(instruction != NULL, "Attempting to compile op stream of NULL instruction.");
+    assert(reference_counts != NULL, "Attempting to compile op stream without reference counts.");
+
+    Arena* arena = instruction_map_get_arena();
+    const ArenaMark mark = arena_get_mark(arena);
+
+    OpStream* stream = (OpStream*) arena_alloc(arena, sizeof(OpStream));
+    stream->ops = NULL;
+    stream->size = 0;
+
+    // The pass itself must fit; only its sub-instructions fall back to execute ops. A stream that does not fit gives
+    // its memory back.
+    if (emit_pass(stream, instruction, reference_counts, 0, 0) == false || stream->size > OP_STREAM_MAX_OPS) {
+        arena_rewind(arena, mark);
+        return NULL;
+    }
+
+    return stream;
+}
+
+int op_stream_get_size(OpStream* stream) {
+    assert(stream != NULL, "Attempting to get size of NULL op stream.");
+
+    return stream->size;
+}
+
+/**
+ * @brief Counts the references to every instruction in the bound instruction table into the given array, which has an
+ * entry per instruction: each listing as a sub-instruction, and each listing in the execution list.
+ *
+ * @param execution_handles The top-level instructions, which count as references.
+ * @param num_execution_handles
+ * @param reference_counts Out: the number of references, by handle.
+ */
+void op_stream_count_references(const int* execution_handles, int num_execution_handles, int* reference_counts) {
+    const int num_instructions = instruction_table_get_size();
+    memset(reference_counts, 0, sizeof(int) * num_instructions);
+
+    for (int idx = 0; idx < num_execution_handles; idx++) {
+        reference_counts[execution_handles[idx]]++;
+    }
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+
+        for (int idx = 0; idx < num_sub_instructions; idx++) {
+            reference_counts[instruction_get_sub_instruction_handle(instruction, idx)]++;
+        }
+    }
+}
+
+/**
+ * Returns true if the instruction inlines its sub-instructions into its own stream.
+ */
+static bool is_inlining(InstructionType type) {
+    return type == KEY || type == PRESS || type == GROUP;
+}
+
+/**
+ * Returns true if the instruction is only ever executed inlined in its parent, so it needs no stream of its own: its
+ * only reference inlines it, and nothing can observe it.
+ */
+static bool is_inlined_only(Instruction* instruction, Instruction* parent, const int* reference_counts) {
+    return parent != NULL && is_inlining(instruction_get_type(parent)) &&
+           is_unobservable(instruction, reference_counts) && is_finite(instruction);
+}
+
+/**
+ * @brief Compiles the op stream of every instruction in the bound instruction table, except the instructions that are
+ * only ever executed inlined in their parent. Must be called after the table is linked or loaded.
+ *
+ * @param reference_counts The number of references to each instruction, by handle (see op_stream_count_references).
+ */
+void op_stream_compile_table(const int* reference_counts) {
+    const int num_instructions = instruction_table_get_size();
+    if (num_instructions == 0) {
+        return;
+    }
+
+    // Set if the only reference to the instruction inlines it.
+    bool* is_inlined = (bool*) calloc(num_instructions, sizeof(bool));
+    assert(is_inlined != NULL, "Failed to allocate memory for inlined instructions.");
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+
+        for (int idx = 0; idx < num_sub_instructions; idx++) {
+            Instruction* sub_instruction = instruction_get_linked_sub_instruction(instruction, idx);
+            if (is_inlined_only(sub_instruction, instruction, reference_counts)) {
+                is_inlined[instruction_get_handle(sub_instruction)] = true;
+            }
+        }
+    }
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        if (is_inlined[handle] == false) {
+            Instruction* instruction = instruction_table_get(handle);
+            instruction_set_op_stream(instruction, op_stream_new(instruction, reference_counts));
+        }
+    }
+
+    free(is_inlined);
+}
+
+/**
+ * @brief Compiles the op streams again after a patch of the bound instruction table (see runtime.c), for only the
+ * instructions whose stream may differ: the given ones, every instruction whose stream may inline one of them, and
+ * the sub-instructions of the given ones, which may have gained or lost their stream. Every other stream is kept.
+ *
+ * @param changed_handles The instructions whose type, keycode, parameters, sub-instructions or number of references
+ * changed.
+ * @param num_changed_handles
+ * @param reference_counts The number of references to each instruction, by handle (see op_stream_count_references).
+ */
+void op_stream_recompile(const int* changed_handles, int num_changed_handles, const int* reference_counts) {
+    const int num_instructions = instruction_table_get_size();
+    if (num_instructions == 0 || num_changed_handles == 0) {
+        return;
+    }
+
+    // The instructions that may inline each instruction or read its keycode, as a compressed adjacency list: the
+    // parents of handle h are parents[first_parent[h]] up to parents[first_parent[h + 1]].
+    int* first_parent = (int*) calloc(num_instructions + 1, sizeof(int));
+    int* is_queued = (int*) calloc(num_instructions, sizeof(int));
+    int* queue = (int*) malloc(sizeof(int) * num_instructions);
+    assert(first_parent != NULL && is_queued != NULL && queue != NULL,
+           "Failed to allocate memory for recompiling op streams.");
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        const InstructionType type = instruction_get_type(instruction);
+        if (is_inlining(type) == false && type != HOLD && type != RELEASE) {
+            continue;
+        }
+
+        const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+        for (int idx = 0; idx < num_sub_instructions; idx++) {
+            first_parent[instruction_get_sub_instruction_handle(instruction, idx) + 1]++;
+        }
+    }
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        first_parent[handle + 1] += first_parent[handle];
+    }
+
+    const int num_edges = first_parent[num_instructions];
+    int* parents = (int*) malloc(sizeof(int) * (num_edges > 0 ? num_edges : 1));
+    int* num_parents = (int*) calloc(num_instructions, sizeof(int));
+    assert(parents != NULL && num_parents != NULL, "Failed to allocate memory for recompiling op streams.");
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        const InstructionType type = instruction_get_type(instruction);
+        if (is_inlining(type) == false && type != HOLD && type != RELEASE) {
+            continue;
+        }
+
+        const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+        for (int idx = 0; idx < num_sub_instructions; idx++) {
+            const int sub_handle = instruction_get_sub_instruction_handle(instruction, idx);
+            parents[first_parent[sub_handle] + num_parents[sub_handle]++] = handle;
+        }
+    }
+
+    int queue_size = 0;
+    for (int idx = 0; idx < num_changed_handles; idx++) {
+        const int handle = changed_handles[idx];
+        if (is_queued[handle] == false) {
+            is_queued[handle] = true;
+            queue[queue_size++] = handle;
+        }
+    }
+
+    for (int queue_idx = 0; queue_idx < queue_size; queue_idx++) {
+        const int handle = queue[queue_idx];
+
+        for (int idx = first_parent[handle]; idx < first_parent[handle + 1]; idx++) {
+            if (is_queued[parents[idx]] == false) {
+                is_queued[parents[idx]] = true;
+                queue[queue_size++] = parents[idx];
+            }
+        }
+    }
+
+    for (int idx = 0; idx < num_changed_handles; idx++) {
+        Instruction* instruction = instruction_table_get(changed_handles[idx]);
+        const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+
+        for (int sub_idx = 0; sub_idx < num_sub_instructions; sub_idx++) {
+            const int sub_handle = instruction_get_sub_instruction_handle(instruction, sub_idx);
+            if (is_queued[sub_handle] == false) {
+                is_queued[sub_handle] = true;
+                queue[queue_size++] = sub_handle;
+            }
+        }
+    }
+
+    for (int queue_idx = 0; queue_idx < queue_size; queue_idx++) {
+        const int handle = queue[queue_idx];
+        Instruction* instruction = instruction_table_get(handle);
+
+        // An instruction inlined only has exactly one reference, so only an instruction with one parent can be.
+        Instruction* parent = first_parent[handle + 1] - first_parent[handle] == 1
+                              ? instruction_table_get(parents[first_parent[handle]]) : NULL;
+
+        const bool is_inlined = is_inlined_only(instruction, parent, reference_counts);
+        instruction_set_op_stream(instruction, is_inlined ? NULL : op_stream_new(instruction, reference_counts));
+    }
+
+    free(num_parents);
+    free(parents);
+    free(queue);
+    free(is_queued);
+    free(first_parent);
+}
+
+/**
+ * @brief Points the cursor at the first op of a stream, to be executed from the given time (us).
+ */
+void op_stream_begin(OpCursor* cursor, time_t start_time) {
+    assert(cursor != NULL, "Attempting to begin NULL op cursor.");
+
+    cursor->pc = 0;
+    cursor->current_time = start_time;
+    cursor->can_yield = true;
+}
+
+/**
+ * Waits for the target of an acquire or execute op to come off cooldown, as walking the tree does for a sub-instruction.
+ * If it is not available yet, the cursor is moved to the time it is expected to be and left at the op, which is tried
+ * again when the stream is resumed. Returns true if the stream has to yield for it.
+ *
+ * While an execution of the target is in flight elsewhere, the cursor waits for the time that execution resumes next,
+ * which may be the current time: the stream then yields without time passing, and tries again once the execution in
+ * flight has been resumed (see scheduler.c). A stream executed in one go cannot yield. It only waits for the cooldown of
+ * the target, and skips a target that is in flight.
+ */
+static bool should_wait_for(Instruction* target, OpCursor* cursor) {
+    if (instruction_is_available(target, cursor->current_time)) {
+        return false;
+    }
+
+    if (cursor->can_yield == false && instruction_is_in_flight(target)) {
+        return false;
+    }
+
+    const time_t available_time = instruction_get_available_time(target);
+    if (available_time > cursor->current_time) {
+        cursor->current_time = available_time;
+    }
+
+    if (cursor->can_yield == false) {
+        return false;
+    }
+
+    cursor->pc--;
+    return true;
+}
+
+/**
+ * @brief Executes the ops of the stream from the cursor until time has to pass, then leaves the cursor at the next op
+ * and its time. Returns true once every op has been executed, in which case the cursor holds the time at which the
+ * pass the stream was compiled from completes.
+ */
+bool op_stream_resume(OpStream* stream, OpCursor* cursor) {
+    assert(stream != NULL, "Attempting to resume NULL op stream.");
+    assert(cursor != NULL, "Attempting to resume op stream with NULL cursor.");
+
+    while (cursor->pc < stream->size) {
+        const Op* op = &stream->ops[cursor->pc++];
+        const time_t op_time = cursor->current_time;
+
+        switch (op->type) {
+            case OP_KEY_DOWN:
+                output_push_stroke(cursor->current_time, op->keycode, true, op->handle);
+                break;
+            case OP_KEY_UP:
+                output_push_stroke(cursor->current_time, op->keycode, false, op->handle);
+                break;
+            case OP_WAIT:
+                cursor->current_time += op->lower;
+                break;
+            case OP_WAIT_RANGE:
+                cursor->current_time += (time_t) rng_sample_range(op->lower, op->upper);
+                break;
+            case OP_ACQUIRE:
+                if (should_wait_for(op->target, cursor)) {
+                    return false;
+                }
+
+                if (instruction_is_in_flight(op->target)) {
+                    cursor->pc = op->jump;
+                    break;
+                }
+
+                instruction_acquire(op->target, &cursor->current_time);
+                break;
+            case OP_COMPLETE:
+                instruction_complete(op->target, cursor->current_time);
+                break;
+            case OP_EXECUTE:
+                if (should_wait_for(op->target, cursor)) {
+                    return false;
+                }
+
+                instruction_execute(op->target, cursor->current_time, &cursor->current_time);
+                break;
+            case OP_START:
+                scheduler_start(op->target, cursor->current_time);
+                break;
+            case OP_STOP:
+                scheduler_stop(op->target, cursor->current_time);
+                break;
+            case OP_LOOP_BEGIN:
+                cursor->loop_passes[op->loop] = instruction_sample_num_passes(op->target);
+                break;
+            case OP_LOOP_END:
+                cursor->loop_passes[op->loop]--;
+                if (cursor->loop_passes[op->loop] > 0) {
+                    cursor->pc = op->jump;
+                }
+                break;
+        }
+
+        if (cursor->current_time > op_time && cursor->pc < stream->size) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Executes every op of the stream at once, starting at the given time (us). Returns the time at which the pass
+ * the stream was compiled from completes.
+ */
+time_t op_stream_execute(OpStream* stream, time_t start_time) {
+    OpCursor cursor;
+    op_stream_begin(&cursor, start_time);
+    cursor.can_yield = false;
+
+    while (op_stream_resume(stream, &cursor) == false) {
+    }
+
+    return cursor.current_time;
+}
+
+void op_stream_print(OpStream* stream) {
+    assert(stream != NULL, "Attempting to print NULL op stream.");
+
+    for (int idx = 0; idx < stream->size; idx++) {
+        const Op* op = &stream->ops[idx];
+        printf("%s%s", idx > 0 ? ", " : "", OpTypeLookupArray[op->type]);
+
+        switch (op->type) {
+            case OP_KEY_DOWN:
+            case OP_KEY_UP:
+                printf("(0x%X)", op->keycode);
+                break;
+            case OP_WAIT:
+                printf("(%lld)", (long long) op->lower);
+                break;
+            case OP_WAIT_RANGE:
+                printf("(%lld, %lld)", (long long) op->lower, (long long) op->upper);
+                break;
+            case OP_LOOP_END:
+                printf("(%d)", op->jump);
+                break;
+            default:
+                printf("(%s)", instruction_get_id(op->target));
+                break;
+        }
+    }
+
+    printf("\n");
+}
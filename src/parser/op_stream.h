@@ -0,0 +1,44 @@
+#ifndef BEANSCRIPT_OP_STREAM_H
+#define BEANSCRIPT_OP_STREAM_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "instruction.h"
+#include "../main.h"
+
+// The deepest loops can be nested in one stream.
+#define OP_STREAM_MAX_LOOPS 16
+
+/**
+ * @brief Where the execution of an op stream is: the index of the next op, the time (us) it runs at and the passes
+ * left of each loop it is inside of. A cursor is all the state a suspended stream needs. can_yield is false for a
+ * stream executed in one go (see op_stream_execute), which cannot wait for anything in flight.
+ */
+typedef struct {
+    int pc;
+    time_t current_time;
+    int loop_passes[OP_STREAM_MAX_LOOPS];
+    bool can_yield;
+} OpCursor;
+
+// Constructor
+OpStream*   op_stream_new(Instruction* instruction, const int* reference_counts);
+
+// Accessor Functions
+int         op_stream_get_size(OpStream* stream);
+
+// Executors
+void        op_stream_count_references(const int* execution_handles, int num_execution_handles, int* reference_counts);
+void        op_stream_compile_table(const int* reference_counts);
+void        op_stream_recompile(const int* changed_handles, int num_changed_handles, const int* reference_counts);
+void        op_stream_begin(OpCursor* cursor, time_t start_time);
+bool        op_stream_resume(OpStream* stream, OpCursor* cursor);
+time_t      op_stream_execute(OpStream* stream, time_t start_time);
+
+// Utility Functions
+void        op_stream_print(OpStream* stream);
+
+#endif //BEANSCRIPT_OP_STREAM_H
@@ -8,12 +8,12 @@
 #include "parser.h"
 
 const char* DELIMITERS = " \r\n";
-const char* STR_PARAM_MERGE_SPLITTER = " ";
+const char STR_PARAM_MERGE_SEPARATOR = ' ';
 
-static int count_leading_whitespace(char* str_instruction) {
+static int count_leading_whitespace(const char* str_instruction) {
     assert(str_instruction != NULL, "Attempting to count leading whitespace from NULL string.");
 
-    for (char* current = str_instruction; *current; current++) {
+    for (const char* current = str_instruction; *current; current++) {
         if (*current != ' ' && *current != '\t') {
             return (int)(current - str_instruction);
         }
@@ -23,13 +23,11 @@ static int count_leading_whitespace(char* str_instruction) {
 }
 
 static InstructionType parse_and_set_type(Instruction* instruction, StrBucket* buckets) {
-    StrList* type_bucket = str_bucket_get_bucket(buckets, 0);
-
-    int num_tokens = str_list_get_size(type_bucket);
+    int num_tokens = str_bucket_get_bucket_size(buckets, 0);
     assert(num_tokens == 1, "Instruction type must be a single token.");
 
-    const char* str_type = str_list_get_str(type_bucket, 0);
-    int type_idx = str_array_find(InstructionTypeLookupArray, NUM_INSTRUCTION_TYPES, str_type);
+    const char* str_type = str_bucket_get_str(buckets, 0, 0);
+    int type_idx = instruction_type_find(str_type);
     assert(type_idx != -1, "Instruction type does not exist.");
 
     instruction_set_type(instruction, type_idx);
@@ -38,12 +36,8 @@ static InstructionType parse_and_set_type(Instruction* instruction, StrBucket* b
 }
 
 static void parse_and_set_id(Instruction* instruction, StrBucket* buckets) {
-    StrList* type_bucket = str_bucket_get_bucket(buckets, 1);
-
-    char* id = str_list_concatenate(type_bucket, STR_PARAM_MERGE_SPLITTER);
+    char* id = str_bucket_join_in_place(buckets, 1, STR_PARAM_MERGE_SEPARATOR);
     instruction_set_id(instruction, id);
-
-    free(id);
 }
 
 /**
@@ -55,26 +49,23 @@ static void parse_and_set_id(Instruction* instruction, StrBucket* buckets) {
  * @param buckets
  */
 static void set_alias_id(Instruction* instruction, StrBucket* buckets) {
-    StrList* type_bucket = str_bucket_get_bucket(buckets, 1);
-    char* original_id = str_list_concatenate(type_bucket, STR_PARAM_MERGE_SPLITTER);
+    const char* original_id = str_bucket_join_in_place(buckets, 1, STR_PARAM_MERGE_SEPARATOR);
 
-    char* alias_id = instruction_map_generate_alias(original_id);
+    const char* alias_id = instruction_map_generate_alias(original_id);
     instruction_set_id(instruction, alias_id);
-
-    free(alias_id);
-    free(original_id);
 }
 
 /**
  * Attempts to parse the instruction parameter as a button. A button parameter is a parameter that contains a single
  * configuration for a keystroke.
  * @param instruction
- * @param parameter_bucket
+ * @param buckets
+ * @param bucket_idx
  * @return
  */
-static bool try_set_parameter_as_button(Instruction* instruction, StrBucket* parameter_bucket) {
-    const int num_tokens = str_list_get_size(parameter_bucket);
-    const char* str_param = str_list_get_str(parameter_bucket, 0);
+static bool try_set_parameter_as_button(Instruction* instruction, StrBucket* buckets, int bucket_idx) {
+    const int num_tokens = str_bucket_get_bucket_size(buckets, bucket_idx);
+    const char* str_param = str_bucket_get_str(buckets, bucket_idx, 0);
 
     if(strcmp(str_param, "button") != 0) {
         return false;
@@ -82,9 +73,9 @@ static bool try_set_parameter_as_button(Instruction* instruction, StrBucket* par
 
     assert(num_tokens == 2, "Button parameter must contain exactly one token.");
 
-    char* button_str = str_list_get_str(parameter_bucket, 1);
+    char* button_str = str_bucket_get_str(buckets, bucket_idx, 1);
 
-    Key* key = key_map_get(button_str);
+    const Key* key = key_map_get(button_str);
     assert(key != NULL, "Button parameter must be a valid key (found : %s).", button_str);
 
     const unsigned short keycode = key->code;
@@ -93,21 +84,36 @@ static bool try_set_parameter_as_button(Instruction* instruction, StrBucket* par
     return true;
 }
 
+/**
+ * Attempts to skip the instruction parameter as a setting of the process, which only a `script` can hold. Settings are
+ * read from the header of the script before it is compiled (see script_header.c), so the instruction ignores them.
+ *
+ * @param instruction
+ * @param buckets
+ * @param bucket_idx
+ * @return
+ */
+static bool try_skip_tuning_parameter(Instruction* instruction, StrBucket* buckets, int bucket_idx) {
+    return instruction_get_type(instruction) == SCRIPT &&
+           tuning_is_parameter(str_bucket_get_str(buckets, bucket_idx, 0));
+}
+
 /**
  * Attempts to parse the instruction parameter as a known parameter. A known parameter is a pre-defined parameter such
  * as "delay" and follows the format <parameter name> <lower value> <upper value> or <parameter name> <value>. For
  * example, "delay 1 2" or "delay 1".
  *
  * @param instruction
- * @param parameter_bucket
+ * @param buckets
+ * @param bucket_idx
  * @return
  */
-static bool try_set_known_parameters(Instruction* instruction, StrBucket* parameter_bucket) {
-    const int num_tokens = str_list_get_size(parameter_bucket);
+static bool try_set_known_parameters(Instruction* instruction, StrBucket* buckets, int bucket_idx) {
+    const int num_tokens = str_bucket_get_bucket_size(buckets, bucket_idx);
     assert(num_tokens >= 1, "Instruction parameter must contain at least a one token.");
 
-    char* str_param = str_list_get_str(parameter_bucket, 0);
-    const int param_idx = str_array_find(InstructionParameterLookupArray, NUM_INSTRUCTION_PARAMETERS, str_param);
+    char* str_param = str_bucket_get_str(buckets, bucket_idx, 0);
+    const int param_idx = instruction_parameter_find(str_param);
     const bool is_defined_param = param_idx != -1;
 
     if(is_defined_param == false) {
@@ -115,7 +121,7 @@ static bool try_set_known_parameters(Instruction* instruction, StrBucket* parame
     }
 
     if(num_tokens == 2) {
-        const char *str_lower_value = str_list_get_str(parameter_bucket, 1);
+        const char *str_lower_value = str_bucket_get_str(buckets, bucket_idx, 1);
         const int lower_value = atoi(str_lower_value);
         instruction_set_parameter_lower_value(instruction, param_idx, lower_value);
         instruction_set_parameter_upper_value(instruction, param_idx, lower_value);
@@ -123,8 +129,8 @@ static bool try_set_known_parameters(Instruction* instruction, StrBucket* parame
     }
 
     if(num_tokens == 3) {
-        const char *str_lower_value = str_list_get_str(parameter_bucket, 1);
-        const char *str_upper_value = str_list_get_str(parameter_bucket, 2);
+        const char *str_lower_value = str_bucket_get_str(buckets, bucket_idx, 1);
+        const char *str_upper_value = str_bucket_get_str(buckets, bucket_idx, 2);
         const int lower_value = atoi(str_lower_value);
         const int upper_value = atoi(str_upper_value);
         instruction_set_parameter_lower_value(instruction, param_idx, lower_value);
@@ -140,10 +146,11 @@ static bool try_set_known_parameters(Instruction* instruction, StrBucket* parame
  * series or time-based collection (e.g., routine, scheduler, random queue).
  *
  * @param instruction
- * @param parameter_bucket
+ * @param buckets
+ * @param bucket_idx
  * @return
  */
-static bool try_parse_transaction_scheduler_parameter(Instruction* instruction, StrBucket* parameter_bucket) {
+static bool try_parse_transaction_scheduler_parameter(Instruction* instruction, StrBucket* buckets, int bucket_idx) {
     const InstructionType type = instruction_get_type(instruction);
     const bool is_scheduler = instruction_type_is_scheduler(type);
     const bool is_transaction = instruction_type_is_transaction(type);
@@ -152,9 +159,8 @@ static bool try_parse_transaction_scheduler_parameter(Instruction* instruction,
         return false;
     }
 
-    char* str_merged_params = str_list_concatenate(parameter_bucket, STR_PARAM_MERGE_SPLITTER);
+    char* str_merged_params = str_bucket_join_in_place(buckets, bucket_idx, STR_PARAM_MERGE_SEPARATOR);
     instruction_add_sub_instruction(instruction, str_merged_params);
-    free(str_merged_params);
 
     return true;
 }
@@ -166,19 +172,19 @@ static bool try_parse_transaction_scheduler_parameter(Instruction* instruction,
  * the transaction instruction object.
  *
  * @param instruction
- * @param parameter_bucket
+ * @param buckets
+ * @param bucket_idx
  * @return
  */
-static bool try_parse_transaction_parameter(Instruction* instruction, StrBucket* parameter_bucket) {
+static bool try_parse_transaction_parameter(Instruction* instruction, StrBucket* buckets, int bucket_idx) {
     const InstructionType type = instruction_get_type(instruction);
     const bool is_transaction = instruction_type_is_transaction(type);
     if(is_transaction == false) {
         return false;
     }
 
-    char* str_merged_params = str_list_concatenate(parameter_bucket, STR_PARAM_MERGE_SPLITTER);
+    char* str_merged_params = str_bucket_join_in_place(buckets, bucket_idx, STR_PARAM_MERGE_SEPARATOR);
     instruction_add_sub_instruction(instruction, str_merged_params);
-    free(str_merged_params);
 
     return true;
 }
@@ -190,19 +196,22 @@ static bool try_parse_transaction_parameter(Instruction* instruction, StrBucket*
  * in both instructions are replaced.
  *
  * @param instruction
- * @param parameter_bucket
+ * @param buckets
+ * @param bucket_idx
  * @return
  */
-static bool try_parse_ref_instruction(Instruction* instruction, StrBucket* parameter_bucket) {
-    const char* str_merged_params = str_list_concatenate(parameter_bucket, STR_PARAM_MERGE_SPLITTER);
+static bool try_parse_ref_instruction(Instruction* instruction, StrBucket* buckets, int bucket_idx) {
+    const char* str_merged_params = str_bucket_join_in_place(buckets, bucket_idx, STR_PARAM_MERGE_SEPARATOR);
     Instruction* ref_instruction = instruction_map_get(str_merged_params);
 
-    if (ref_instruction == NULL) {
+    // Only an instruction on an earlier line can be referenced. While a script is compiled, no later line has been
+    // parsed yet; while it is patched (see runtime.c), the lines after this one already have instructions.
+    if (ref_instruction == NULL ||
+        instruction_get_line_number(ref_instruction) >= instruction_get_line_number(instruction)) {
         return false;
     }
 
     instruction_copy_values(instruction, ref_instruction);
-    free(str_merged_params);
     return true;
 }
 
@@ -218,25 +227,27 @@ static bool try_parse_ref_instruction(Instruction* instruction, StrBucket* param
  * @param bucket_idx
  */
 static void parse_and_set_parameter(Instruction* instruction, StrBucket* buckets, int bucket_idx) {
-    StrBucket* parameter_bucket = str_bucket_get_bucket(buckets, bucket_idx);
+    if(try_set_parameter_as_button(instruction, buckets, bucket_idx) == true) {
+        return;
+    }
 
-    if(try_set_parameter_as_button(instruction, parameter_bucket) == true) {
+    if (try_skip_tuning_parameter(instruction, buckets, bucket_idx) == true) {
         return;
     }
 
-    if (try_set_known_parameters(instruction, parameter_bucket) == true) {
+    if (try_set_known_parameters(instruction, buckets, bucket_idx) == true) {
         return;
     }
 
-    if (try_parse_transaction_scheduler_parameter(instruction, parameter_bucket) == true) {
+    if (try_parse_transaction_scheduler_parameter(instruction, buckets, bucket_idx) == true) {
         return;
     }
 
-    if (try_parse_transaction_parameter(instruction, parameter_bucket) == true) {
+    if (try_parse_transaction_parameter(instruction, buckets, bucket_idx) == true) {
         return;
     }
 
-    if (try_parse_ref_instruction(instruction, parameter_bucket) == true) {
+    if (try_parse_ref_instruction(instruction, buckets, bucket_idx) == true) {
         return;
     }
 
@@ -250,6 +261,10 @@ static void parse_and_set_parameter(Instruction* instruction, StrBucket* buckets
  * bucket represents a single parameter of the instruction. See @class Lexer.c for more information on how the buckets
  * are created.
  *
+ * The line is tokenized in place. The id and references of the instruction are interned in the bound instruction map,
+ * so the instruction keeps no pointer into the line. The buckets are scratch: they are allocated from the bound map's
+ * scratch arena, which is rewound once the line is parsed.
+ *
  * @param instruction
  * @param str_instruction
  */
@@ -264,8 +279,12 @@ void parse_line_into_instruction(Instruction* instruction, char* str_instruction
 
     // Tokenize the instruction into buckets. If the buckets are null, then the instruction is invalid and the
     // instruction is not parsed into (i.e., remains unchanged).
-    StrBucket* buckets = tokenize_to_buckets(str_instruction, DELIMITERS);
+    Arena* scratch = instruction_map_get_scratch_arena();
+    const ArenaMark mark = arena_get_mark(scratch);
+
+    StrBucket* buckets = tokenize_to_buckets(str_instruction, DELIMITERS, scratch);
     if (buckets == NULL) {
+        arena_rewind(scratch, mark);
         return;
     }
 
@@ -287,5 +306,34 @@ void parse_line_into_instruction(Instruction* instruction, char* str_instruction
         parse_and_set_parameter(instruction, buckets, bucket_param_idx);
     }
 
+    // Any sub-instruction added from here on is a line nested under this one.
+    instruction_set_num_listed_sub_instructions(instruction, instruction_get_num_sub_instructions(instruction));
+
     str_bucket_delete(&buckets);
-}
\ No newline at end of file
+    arena_rewind(scratch, mark);
+}
+
+/**
+ * Returns the indent of the instruction on a line, as parse_line_into_instruction would set it, without tokenizing or
+ * otherwise modifying the line. Returns -1 if the line holds no instruction, i.e. if it would be left unparsed.
+ *
+ * @param str_instruction
+ * @return
+ */
+int parse_line_indent(const char* str_instruction) {
+    assert(str_instruction != NULL, "Attempting to get indent of NULL instruction string.");
+
+    // The same characters are stripped and ignored as when the line is tokenized (see tokenize_to_buckets).
+    size_t length = strlen(str_instruction);
+    while (length > 0 && (str_instruction[length - 1] == ',' || str_instruction[length - 1] == '\n')) {
+        length--;
+    }
+
+    for (size_t idx = 0; idx < length; idx++) {
+        if (strchr(DELIMITERS, str_instruction[idx]) == NULL) {
+            return count_leading_whitespace(str_instruction);
+        }
+    }
+
+    return -1;
+}
@@ -3,10 +3,13 @@
 
 #include "instruction.h"
 #include "lexer.h"
+#include "../utility/tuning.h"
 #include "../main.h"
 
 extern const char* DELIMITERS;
+extern const char STR_PARAM_MERGE_SEPARATOR;
 
 void parse_line_into_instruction(Instruction* instruction, char* str_instruction);
+int parse_line_indent(const char* str_instruction);
 
 #endif //BEANSCRIPT_PARSER_H
@@ -0,0 +1,162 @@
+/**
+ * @file script_header.c
+ *
+ * The header of a script: the `script` and `window` lines at the top of the file. A header is read without compiling
+ * the script, from as few lines as it takes, so the scripts of a directory can be listed (see script_loader.c) and the
+ * process can be tuned for them (see tuning.c) before any of them is compiled.
+ *
+ * Besides its button and timing, the `script` line can hold the settings the scripts are run with (see
+ * tuning_config_set_parameter), e.g. `script farm with button f1, resolution 500, priority mmcss, cores 2 3`. Only the
+ * header reads them; the parser skips them.
+ */
+
+#include "script_header.h"
+
+// The longest header line that is read whole. Any longer line is cut short.
+#define SCRIPT_HEADER_MAX_LINE_LENGTH 1024
+
+/**
+ * @brief What the header of a script holds.
+ * - script_id, window_id: The ids of the `script` and `window` lines, or NULL if there is no such line.
+ * - tuning: The settings of the `script` line. Settings it does not hold are not set.
+ */
+struct ScriptHeaderStruct {
+    char* script_id;
+    char* window_id;
+    TuningConfig tuning;
+};
+
+/**
+ * Sets the tuning of the header from the parameters of its `script` line.
+ */
+static void read_tuning(ScriptHeader* header, StrBucket* buckets) {
+    char* values[TUNING_MAX_CORES];
+
+    for (int bucket_idx = 2; bucket_idx < str_bucket_get_size(buckets); bucket_idx++) {
+        const int num_values = str_bucket_get_bucket_size(buckets, bucket_idx) - 1;
+        const char* str_name = str_bucket_get_str(buckets, bucket_idx, 0);
+        if (tuning_is_parameter(str_name) == false) {
+            continue;
+        }
+
+        assert(num_values <= TUNING_MAX_CORES, "Expected at most %d values for %s.", TUNING_MAX_CORES, str_name);
+        for (int idx = 0; idx < num_values; idx++) {
+            values[idx] = str_bucket_get_str(buckets, bucket_idx, idx + 1);
+        }
+
+        tuning_config_set_parameter(&header->tuning, str_name, values, num_values);
+    }
+}
+
+/**
+ * Reads the header of the script: every `script` and `window` line at the top of the file, up to the first line that
+ * is neither. Blank lines are skipped. Ids are read the way the parser reads them, so they match the ids of the
+ * compiled instructions. Returns NULL if the file cannot be read.
+ *
+ * @param filename
+ * @return
+ */
+ScriptHeader* script_header_read(const char* filename) {
+    assert(filename != NULL, "Attempting to read header of NULL script.");
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    ScriptHeader* header = (ScriptHeader*) malloc(sizeof(ScriptHeader));
+    assert(header != NULL, "Failed to allocate memory for script header.");
+
+    header->script_id = NULL;
+    header->window_id = NULL;
+    tuning_config_init(&header->tuning);
+
+    char line[SCRIPT_HEADER_MAX_LINE_LENGTH];
+    while ((header->script_id == NULL || header->window_id == NULL) && fgets(line, sizeof(line), file) != NULL) {
+        // Drop the rest of a line that is too long rather than reading it as a line of its own.
+        const size_t length = strlen(line);
+        if (length > 0 && line[length - 1] != '\n') {
+            int character = 0;
+            while ((character = fgetc(file)) != EOF && character != '\n') {}
+        }
+
+        char* start = line;
+        while (*start == ' ' || *start == '\t') {
+            start++;
+        }
+
+        StrBucket* buckets = tokenize_to_buckets(start, DELIMITERS, NULL);
+        if (buckets == NULL) {
+            continue;
+        }
+
+        const int type = instruction_type_find(str_bucket_get_str(buckets, 0, 0));
+        const bool is_header = (type == SCRIPT || type == WINDOW) && str_bucket_get_size(buckets) >= 2;
+        char** ptr_id = type == SCRIPT ? &header->script_id : &header->window_id;
+
+        if (is_header && *ptr_id == NULL) {
+            if (type == SCRIPT) {
+                read_tuning(header, buckets);
+            }
+
+            *ptr_id = strdup(str_bucket_join_in_place(buckets, 1, STR_PARAM_MERGE_SEPARATOR));
+            assert(*ptr_id != NULL, "Failed to allocate memory for script header.");
+        }
+
+        str_bucket_delete(&buckets);
+        if (is_header == false) {
+            break;
+        }
+    }
+
+    fclose(file);
+    return header;
+}
+
+void script_header_delete(ScriptHeader** ptr_header) {
+    assert(ptr_header != NULL, "Attempting to delete script header behind NULL pointer.");
+    assert(*ptr_header != NULL, "Attempting to delete NULL script header.");
+
+    ScriptHeader* header = *ptr_header;
+    free(header->script_id);
+    free(header->window_id);
+
+    free(header);
+    *ptr_header = NULL;
+}
+
+/**
+ * Returns the id of the `script` line, or NULL if there is none.
+ *
+ * @param header
+ * @return
+ */
+const char* script_header_get_script_id(ScriptHeader* header) {
+    assert(header != NULL, "Attempting to get script id of NULL script header.");
+
+    return header->script_id;
+}
+
+/**
+ * Returns the id of the `window` line, or NULL if there is none.
+ *
+ * @param header
+ * @return
+ */
+const char* script_header_get_window_id(ScriptHeader* header) {
+    assert(header != NULL, "Attempting to get window id of NULL script header.");
+
+    return header->window_id;
+}
+
+/**
+ * Returns the settings of the `script` line (see tuning.h).
+ *
+ * @param header
+ * @return
+ */
+const TuningConfig* script_header_get_tuning(ScriptHeader* header) {
+    assert(header != NULL, "Attempting to get tuning of NULL script header.");
+
+    return &header->tuning;
+}
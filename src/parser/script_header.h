@@ -0,0 +1,26 @@
+#ifndef BEANSCRIPT_SCRIPT_HEADER_H
+#define BEANSCRIPT_SCRIPT_HEADER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "instruction.h"
+#include "lexer.h"
+#include "parser.h"
+#include "../utility/tuning.h"
+#include "../main.h"
+
+typedef struct ScriptHeaderStruct ScriptHeader;
+
+// Constructor and Destructor
+ScriptHeader*       script_header_read(const char* filename);
+void                script_header_delete(ScriptHeader** ptr_header);
+
+// Accessor Functions
+const char*         script_header_get_script_id(ScriptHeader* header);
+const char*         script_header_get_window_id(ScriptHeader* header);
+const TuningConfig* script_header_get_tuning(ScriptHeader* header);
+
+#endif //BEANSCRIPT_SCRIPT_HEADER_H
@@ -0,0 +1,422 @@
+/**
+ * @file script_image.c
+ *
+ * A compiled script (.bsc): a flat image of a script's linked instruction table, written after the script is compiled
+ * and loaded in place of compiling on the next run. The image stores, per instruction, its type, keycode, parameter
+ * ranges, the range of its sub-instruction handles and the range of the handles of the instructions it copied values
+ * from, followed by one array of every sub-instruction handle, the script's execution handles, the reference handles,
+ * and the instruction ids. Every reference is an index or an offset into the image, so
+ * the image can be read anywhere in memory and used without fixing anything up: loaded ids are interned straight from
+ * the image and the lexer, the parser and alias generation are all skipped.
+ *
+ * The header records the hash of the source the image was compiled from. An image whose version, layout or hash does
+ * not match, or that is malformed in any way, is ignored and the script is compiled again. Images are a cache for the
+ * machine that wrote them and are not portable between builds.
+ */
+
+#include "script_image.h"
+
+#define SCRIPT_IMAGE_VERSION 3
+#define SCRIPT_IMAGE_NUM_PARAMETER_VALUES \
+    (2 * sizeof(InstructionParameterLookupArray) / sizeof(InstructionParameterLookupArray[0]))
+
+static const char SCRIPT_IMAGE_MAGIC[4] = { 'B', 'S', 'C', '\0' };
+
+_Static_assert(sizeof(int) == sizeof(int32_t), "Compiled scripts store handles as 32-bit ints.");
+
+/**
+ * @brief The start of every image.
+ * - record_size: The size of one ScriptImageRecord, so an image written by a build with a different layout is rejected.
+ * - num_sub_handles: The length of the sub-instruction handle array shared by every record.
+ * - num_reference_handles: The length of the reference handle array shared by every record.
+ * - strings_size: The size of the id section, including the terminator of every id.
+ */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    uint32_t record_size;
+    int32_t num_instructions;
+    int32_t num_sub_handles;
+    int32_t num_execution_handles;
+    uint32_t strings_size;
+    int32_t num_reference_handles;
+} ScriptImageHeader;
+
+/**
+ * @brief One linked instruction. The ith record is the instruction with handle i.
+ * - parameters: The lower and upper value of each parameter, laid out as in the instruction.
+ * - id_offset: The offset of the instruction id in the id section.
+ * - first_sub_handle, num_sub_handles: The range of the instruction's sub-instruction handles in the handle array.
+ * - num_listed_sub_handles: How many of them the instruction's own line lists.
+ * - first_reference, num_references: The range of the handles of the instructions it copied values from in the
+ *   reference handle array.
+ */
+typedef struct {
+    int32_t type;
+    int32_t line_number;
+    int32_t indent_count;
+    int32_t keycode;
+    int32_t parameters[SCRIPT_IMAGE_NUM_PARAMETER_VALUES];
+    uint32_t id_offset;
+    int32_t first_sub_handle;
+    int32_t num_sub_handles;
+    int32_t num_listed_sub_handles;
+    int32_t first_reference;
+    int32_t num_references;
+} ScriptImageRecord;
+
+/**
+ * @brief An image read into memory, with each section located.
+ */
+struct ScriptImageStruct {
+    unsigned char* data;
+    size_t size;
+
+    const ScriptImageHeader* header;
+    const ScriptImageRecord* records;
+    const int32_t* sub_handles;
+    const int32_t* execution_handles;
+    const int32_t* reference_handles;
+    char* strings;
+};
+
+static size_t get_image_size(int num_instructions, int num_sub_handles, int num_execution_handles,
+                             int num_reference_handles, size_t strings_size) {
+    return sizeof(ScriptImageHeader)
+           + sizeof(ScriptImageRecord) * (size_t) num_instructions
+           + sizeof(int32_t) * ((size_t) num_sub_handles + (size_t) num_execution_handles
+                                + (size_t) num_reference_handles)
+           + strings_size;
+}
+
+static bool is_valid_handle(int32_t handle, int32_t num_instructions) {
+    return handle >= 0 && handle < num_instructions;
+}
+
+/**
+ * Returns true if the header describes an image of exactly the given size compiled from the given source, and every
+ * record, handle and id in the image lies within it.
+ */
+static bool is_valid_image(ScriptImage* image, uint64_t source_hash) {
+    if (image->size < sizeof(ScriptImageHeader)) {
+        return false;
+    }
+
+    const ScriptImageHeader* header = (const ScriptImageHeader*) image->data;
+    if (memcmp(header->magic, SCRIPT_IMAGE_MAGIC, sizeof(SCRIPT_IMAGE_MAGIC)) != 0 ||
+        header->version != SCRIPT_IMAGE_VERSION ||
+        header->record_size != sizeof(ScriptImageRecord) ||
+        header->source_hash != source_hash) {
+        return false;
+    }
+
+    if (header->num_instructions < 0 || header->num_sub_handles < 0 || header->num_execution_handles < 0 ||
+        header->num_reference_handles < 0 || header->strings_size == 0) {
+        return false;
+    }
+
+    const size_t expected_size = get_image_size(header->num_instructions, header->num_sub_handles,
+                                                header->num_execution_handles, header->num_reference_handles,
+                                                header->strings_size);
+    if (expected_size != image->size) {
+        return false;
+    }
+
+    image->header = header;
+    image->records = (const ScriptImageRecord*) (image->data + sizeof(ScriptImageHeader));
+    image->sub_handles = (const int32_t*) (image->records + header->num_instructions);
+    image->execution_handles = image->sub_handles + header->num_sub_handles;
+    image->reference_handles = image->execution_handles + header->num_execution_handles;
+    image->strings = (char*) (image->reference_handles + header->num_reference_handles);
+
+    if (image->strings[header->strings_size - 1] != '\0') {
+        return false;
+    }
+
+    for (int handle = 0; handle < header->num_instructions; handle++) {
+        const ScriptImageRecord* record = &image->records[handle];
+
+        if (record->type < 0 || record->type >= NONE || record->line_number <= 0 ||
+            record->keycode < 0 || record->keycode > USHRT_MAX || record->id_offset >= header->strings_size) {
+            return false;
+        }
+
+        if (record->first_sub_handle < 0 || record->num_sub_handles < 0 ||
+            record->num_sub_handles > header->num_sub_handles - record->first_sub_handle ||
+            record->num_listed_sub_handles < 0 || record->num_listed_sub_handles > record->num_sub_handles) {
+            return false;
+        }
+
+        if (record->first_reference < 0 || record->num_references < 0 ||
+            record->num_references > header->num_reference_handles - record->first_reference) {
+            return false;
+        }
+    }
+
+    for (int idx = 0; idx < header->num_sub_handles; idx++) {
+        if (is_valid_handle(image->sub_handles[idx], header->num_instructions) == false) {
+            return false;
+        }
+    }
+
+    for (int idx = 0; idx < header->num_execution_handles; idx++) {
+        if (is_valid_handle(image->execution_handles[idx], header->num_instructions) == false) {
+            return false;
+        }
+    }
+
+    for (int idx = 0; idx < header->num_reference_handles; idx++) {
+        if (is_valid_handle(image->reference_handles[idx], header->num_instructions) == false) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Reads the image with the given name. Returns NULL if there is no such image or if it was not compiled from the
+ * source with the given hash by this build, in which case the script must be compiled.
+ *
+ * @param image_name
+ * @param source_hash
+ * @return
+ */
+ScriptImage* script_image_open(const char* image_name, uint64_t source_hash) {
+    assert(image_name != NULL, "Attempting to open script image with NULL name.");
+
+    FILE* file = fopen(image_name, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long file_length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (file_length <= 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    ScriptImage* image = (ScriptImage*) malloc(sizeof(ScriptImage));
+    assert(image != NULL, "Failed to allocate memory for script image.");
+
+    image->data = (unsigned char*) malloc(file_length);
+    assert(image->data != NULL, "Failed to allocate memory for script image %s.", image_name);
+
+    image->size = fread(image->data, 1, file_length, file);
+    fclose(file);
+
+    if (image->size != (size_t) file_length || is_valid_image(image, source_hash) == false) {
+        script_image_delete(&image);
+        return NULL;
+    }
+
+    return image;
+}
+
+/**
+ * Frees the image. Loaded instructions intern their ids, so the image may be freed as soon as it is loaded.
+ *
+ * @param ptr_image
+ */
+void script_image_delete(ScriptImage** ptr_image) {
+    assert(ptr_image != NULL, "Attempting to delete script image behind NULL pointer.");
+    assert(*ptr_image != NULL, "Attempting to delete NULL script image.");
+
+    ScriptImage* image = *ptr_image;
+    free(image->data);
+
+    free(image);
+    *ptr_image = NULL;
+}
+
+int script_image_get_num_execution_handles(ScriptImage* image) {
+    assert(image != NULL, "Attempting to get execution handles of NULL script image.");
+
+    return image->header->num_execution_handles;
+}
+
+/**
+ * Returns the handles of the script's top-level instructions, in script order. They live in the image.
+ */
+const int* script_image_get_execution_handles(ScriptImage* image) {
+    assert(image != NULL, "Attempting to get execution handles of NULL script image.");
+
+    return (const int*) image->execution_handles;
+}
+
+/**
+ * Creates every instruction in the image and installs them as the linked instruction table of the bound instruction
+ * map (see instruction_map_load_table), in place of parsing and linking the script.
+ *
+ * @param image
+ */
+void script_image_load(ScriptImage* image) {
+    assert(image != NULL, "Attempting to load NULL script image.");
+
+    const int num_instructions = image->header->num_instructions;
+    if (num_instructions == 0) {
+        return;
+    }
+
+    Instruction** table = (Instruction**) malloc(sizeof(Instruction*) * num_instructions);
+    assert(table != NULL, "Failed to allocate memory for instruction table.");
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        const ScriptImageRecord* record = &image->records[handle];
+        Instruction* instruction = instruction_new();
+
+        instruction_set_id(instruction, image->strings + record->id_offset);
+        instruction_set_type(instruction, (InstructionType) record->type);
+        instruction_set_line_number(instruction, record->line_number);
+        instruction_set_indent_count(instruction, record->indent_count);
+        instruction_set_keycode(instruction, (unsigned short) record->keycode);
+
+        for (int parameter = 0; parameter < NUM_INSTRUCTION_PARAMETERS; parameter++) {
+            instruction_set_parameter_lower_value(instruction, parameter, record->parameters[2 * parameter]);
+            instruction_set_parameter_upper_value(instruction, parameter, record->parameters[2 * parameter + 1]);
+        }
+
+        instruction_set_sub_instruction_span(instruction, record->first_sub_handle, record->num_sub_handles);
+        instruction_set_num_listed_sub_instructions(instruction, record->num_listed_sub_handles);
+
+        for (int idx = 0; idx < record->num_references; idx++) {
+            const int ref_handle = image->reference_handles[record->first_reference + idx];
+            const ScriptImageRecord* ref_record = &image->records[ref_handle];
+            instruction_add_reference(instruction, image->strings + ref_record->id_offset);
+        }
+
+        table[handle] = instruction;
+    }
+
+    const int* sub_handles = (const int*) image->sub_handles;
+    instruction_map_load_table(table, num_instructions, sub_handles, image->header->num_sub_handles);
+}
+
+/**
+ * Writes the linked instruction table of the bound instruction map and the given execution handles as an image of the
+ * source with the given hash. The image is written beside its final name and renamed into place, so a reader never
+ * sees a partial image. Returns false if the image could not be written; the script still runs, it is just compiled
+ * again next time.
+ *
+ * @param image_name
+ * @param source_hash
+ * @param execution_handles
+ * @param num_execution_handles
+ * @return
+ */
+bool script_image_save(const char* image_name, uint64_t source_hash, const int* execution_handles,
+                       int num_execution_handles) {
+    assert(image_name != NULL, "Attempting to save script image with NULL name.");
+
+    const int num_instructions = instruction_table_get_size();
+
+    int num_sub_handles = 0;
+    int num_reference_handles = 0;
+    size_t strings_size = 1;
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        num_sub_handles += instruction_get_num_sub_instructions(instruction);
+        num_reference_handles += instruction_get_num_references(instruction);
+        strings_size += strlen(instruction_get_id(instruction)) + 1;
+    }
+
+    const size_t image_size = get_image_size(num_instructions, num_sub_handles, num_execution_handles,
+                                             num_reference_handles, strings_size);
+    unsigned char* data = (unsigned char*) calloc(image_size, 1);
+    assert(data != NULL, "Failed to allocate memory for script image %s.", image_name);
+
+    ScriptImageHeader* header = (ScriptImageHeader*) data;
+    memcpy(header->magic, SCRIPT_IMAGE_MAGIC, sizeof(SCRIPT_IMAGE_MAGIC));
+    header->version = SCRIPT_IMAGE_VERSION;
+    header->source_hash = source_hash;
+    header->record_size = sizeof(ScriptImageRecord);
+    header->num_instructions = num_instructions;
+    header->num_sub_handles = num_sub_handles;
+    header->num_execution_handles = num_execution_handles;
+    header->num_reference_handles = num_reference_handles;
+    header->strings_size = (uint32_t) strings_size;
+
+    ScriptImageRecord* records = (ScriptImageRecord*) (data + sizeof(ScriptImageHeader));
+    int32_t* sub_handles = (int32_t*) (records + num_instructions);
+    int32_t* image_execution_handles = sub_handles + num_sub_handles;
+    int32_t* reference_handles = image_execution_handles + num_execution_handles;
+    char* strings = (char*) (reference_handles + num_reference_handles);
+
+    // The id section starts with an empty string, so it is never empty, even for a script with no instructions.
+    int sub_handle_idx = 0;
+    int reference_idx = 0;
+    size_t string_offset = 1;
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        ScriptImageRecord* record = &records[handle];
+
+        record->type = instruction_get_type(instruction);
+        record->line_number = instruction_get_line_number(instruction);
+        record->indent_count = instruction_get_indent_count(instruction);
+        record->keycode = instruction_get_keycode(instruction);
+
+        for (int parameter = 0; parameter < NUM_INSTRUCTION_PARAMETERS; parameter++) {
+            record->parameters[2 * parameter] = instruction_get_parameter_lower_value(instruction, parameter);
+            record->parameters[2 * parameter + 1] = instruction_get_parameter_upper_value(instruction, parameter);
+        }
+
+        const char* id = instruction_get_id(instruction);
+        const size_t id_size = strlen(id) + 1;
+        memcpy(strings + string_offset, id, id_size);
+        record->id_offset = (uint32_t) string_offset;
+        string_offset += id_size;
+
+        const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+        record->first_sub_handle = sub_handle_idx;
+        record->num_sub_handles = num_sub_instructions;
+
+        record->num_listed_sub_handles = instruction_get_num_listed_sub_instructions(instruction);
+
+        for (int idx = 0; idx < num_sub_instructions; idx++) {
+            sub_handles[sub_handle_idx++] = instruction_get_sub_instruction_handle(instruction, idx);
+        }
+
+        const int num_references = instruction_get_num_references(instruction);
+        record->first_reference = reference_idx;
+        record->num_references = num_references;
+
+        for (int idx = 0; idx < num_references; idx++) {
+            reference_handles[reference_idx++] = instruction_get_handle(instruction_get_reference(instruction, idx));
+        }
+    }
+
+    for (int idx = 0; idx < num_execution_handles; idx++) {
+        image_execution_handles[idx] = execution_handles[idx];
+    }
+
+    const size_t name_length = strlen(image_name);
+    char* temp_name = (char*) malloc(name_length + sizeof(".tmp"));
+    assert(temp_name != NULL, "Failed to allocate memory for script image name.");
+    sprintf(temp_name, "%s.tmp", image_name);
+
+    bool is_saved = false;
+    FILE* file = fopen(temp_name, "wb");
+    if (file != NULL) {
+        const bool is_written = fwrite(data, 1, image_size, file) == image_size;
+        if (fclose(file) == 0 && is_written) {
+#ifdef _WIN32
+            remove(image_name);
+#endif
+            is_saved = rename(temp_name, image_name) == 0;
+        }
+
+        if (is_saved == false) {
+            remove(temp_name);
+        }
+    }
+
+    free(temp_name);
+    free(data);
+
+    return is_saved;
+}
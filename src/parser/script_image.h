@@ -0,0 +1,30 @@
+
+#ifndef BEANSCRIPT_SCRIPT_IMAGE_H
+#define BEANSCRIPT_SCRIPT_IMAGE_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "instruction.h"
+#include "../main.h"
+
+typedef struct ScriptImageStruct ScriptImage;
+
+// Constructor and Destructor
+ScriptImage*    script_image_open(const char* image_name, uint64_t source_hash);
+void            script_image_delete(ScriptImage** ptr_image);
+
+// Accessor Functions
+int             script_image_get_num_execution_handles(ScriptImage* image);
+const int*      script_image_get_execution_handles(ScriptImage* image);
+
+// Executors
+void            script_image_load(ScriptImage* image);
+bool            script_image_save(const char* image_name, uint64_t source_hash, const int* execution_handles,
+                                  int num_execution_handles);
+
+#endif //BEANSCRIPT_SCRIPT_IMAGE_H
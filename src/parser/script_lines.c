@@ -0,0 +1,196 @@
+/**
+ * @file script_lines.c
+ *
+ * The lines of the script a runtime is running, as they were when it was last compiled or patched, together with the
+ * handle of the instruction compiled from each line. A watched runtime keeps them so an edit of the file can be patched
+ * into the running script (see runtime.c): the lines of the edited file are compared with these, and only the lines
+ * that differ are parsed again.
+ *
+ * The lines are split exactly as script_source_next_line splits them, from a copy of the text taken before the source
+ * hands out its first line, so the source can still be tokenized in place. Every line is null-terminated in the copy
+ * and is never modified; a line to be parsed is copied out first (see script_lines_copy).
+ */
+
+#include "script_lines.h"
+
+/**
+ * @brief The lines of one version of a script.
+ * - text: The text, with the newline ending each line replaced with a null terminator.
+ * - offsets: The offset of each line in text, followed by the offset one past the terminator of the last line, so the
+ *   length of line i is offsets[i + 1] - offsets[i] - 1.
+ * - handles: The handle of the instruction compiled from each line, or -1 for a line without one.
+ * - num_lines: The number of lines.
+ * - hash: The hash of the text (see script_source_get_hash).
+ */
+struct ScriptLinesStruct {
+    char* text;
+    size_t* offsets;
+    int* handles;
+    int num_lines;
+    uint64_t hash;
+};
+
+/**
+ * Splits a copy of the text of the source into lines. Must be called before the source hands out its first line. Every
+ * line starts without an instruction.
+ *
+ * @param source
+ * @return
+ */
+ScriptLines* script_lines_new(ScriptSource* source) {
+    assert(source != NULL, "Attempting to split NULL script source into lines.");
+
+    size_t length = 0;
+    const char* source_text = script_source_get_text(source, &length);
+
+    ScriptLines* lines = (ScriptLines*) malloc(sizeof(ScriptLines));
+    assert(lines != NULL, "Failed to allocate memory for script lines.");
+
+    lines->text = (char*) malloc(length + 1);
+    assert(lines->text != NULL, "Failed to allocate memory for script lines.");
+    memcpy(lines->text, source_text, length);
+    lines->text[length] = '\0';
+
+    int num_lines = 0;
+    for (const char* line = source_text; line < source_text + length; num_lines++) {
+        const char* newline = (const char*) memchr(line, '\n', length - (size_t) (line - source_text));
+        line = newline != NULL ? newline + 1 : source_text + length;
+    }
+
+    lines->offsets = (size_t*) malloc(sizeof(size_t) * (num_lines + 1));
+    lines->handles = (int*) malloc(sizeof(int) * (num_lines > 0 ? num_lines : 1));
+    assert(lines->offsets != NULL && lines->handles != NULL, "Failed to allocate memory for script lines.");
+
+    size_t cursor = 0;
+    for (int line_idx = 0; line_idx < num_lines; line_idx++) {
+        lines->offsets[line_idx] = cursor;
+        lines->handles[line_idx] = -1;
+
+        char* newline = (char*) memchr(lines->text + cursor, '\n', length - cursor);
+        if (newline != NULL) {
+            *newline = '\0';
+            cursor = (size_t) (newline - lines->text) + 1;
+        } else {
+            cursor = length + 1;
+        }
+    }
+
+    lines->offsets[num_lines] = cursor;
+    lines->num_lines = num_lines;
+    lines->hash = script_source_get_hash(source);
+
+    return lines;
+}
+
+void script_lines_delete(ScriptLines** ptr_lines) {
+    assert(ptr_lines != NULL, "Attempting to delete script lines behind NULL pointer.");
+    assert(*ptr_lines != NULL, "Attempting to delete NULL script lines.");
+
+    ScriptLines* lines = *ptr_lines;
+    free(lines->text);
+    free(lines->offsets);
+    free(lines->handles);
+
+    free(lines);
+    *ptr_lines = NULL;
+}
+
+int script_lines_get_size(ScriptLines* lines) {
+    assert(lines != NULL, "Attempting to get size of NULL script lines.");
+
+    return lines->num_lines;
+}
+
+/**
+ * Returns the hash of the text the lines were split from.
+ */
+uint64_t script_lines_get_hash(ScriptLines* lines) {
+    assert(lines != NULL, "Attempting to get hash of NULL script lines.");
+
+    return lines->hash;
+}
+
+/**
+ * Returns the line with the given index, starting from 0, without its newline. The line must not be modified.
+ */
+const char* script_lines_get(ScriptLines* lines, int line_idx) {
+    assert(lines != NULL, "Attempting to get line of NULL script lines.");
+    assert(line_idx >= 0 && line_idx < lines->num_lines, "Attempting to get line %d of %d.", line_idx,
+           lines->num_lines);
+
+    return lines->text + lines->offsets[line_idx];
+}
+
+/**
+ * Copies the line with the given index into the given arena, so it can be tokenized in place.
+ */
+char* script_lines_copy(ScriptLines* lines, int line_idx, Arena* arena) {
+    const char* line = script_lines_get(lines, line_idx);
+    const size_t size = lines->offsets[line_idx + 1] - lines->offsets[line_idx];
+
+    char* copy = (char*) arena_alloc(arena, size);
+    memcpy(copy, line, size);
+
+    return copy;
+}
+
+/**
+ * Returns the handle of the instruction compiled from the line with the given index, or -1 if it has none.
+ */
+int script_lines_get_handle(ScriptLines* lines, int line_idx) {
+    assert(lines != NULL, "Attempting to get handle of NULL script lines.");
+    assert(line_idx >= 0 && line_idx < lines->num_lines, "Attempting to get handle of line %d of %d.", line_idx,
+           lines->num_lines);
+
+    return lines->handles[line_idx];
+}
+
+void script_lines_set_handle(ScriptLines* lines, int line_idx, int handle) {
+    assert(lines != NULL, "Attempting to set handle of NULL script lines.");
+    assert(line_idx >= 0 && line_idx < lines->num_lines, "Attempting to set handle of line %d of %d.", line_idx,
+           lines->num_lines);
+
+    lines->handles[line_idx] = handle;
+}
+
+static bool is_same_line(ScriptLines* lines, int line_idx, ScriptLines* other_lines, int other_line_idx) {
+    const size_t size = lines->offsets[line_idx + 1] - lines->offsets[line_idx];
+
+    return size == other_lines->offsets[other_line_idx + 1] - other_lines->offsets[other_line_idx] &&
+           memcmp(lines->text + lines->offsets[line_idx], other_lines->text + other_lines->offsets[other_line_idx],
+                  size) == 0;
+}
+
+/**
+ * Returns the lines the edited lines replace: everything between the longest run of lines both start with and the
+ * longest run of lines both end with.
+ *
+ * @param lines
+ * @param edited_lines
+ * @return
+ */
+ScriptEdit script_lines_diff(ScriptLines* lines, ScriptLines* edited_lines) {
+    assert(lines != NULL && edited_lines != NULL, "Attempting to compare NULL script lines.");
+
+    const int num_lines = lines->num_lines;
+    const int num_edited_lines = edited_lines->num_lines;
+
+    int first_line = 0;
+    while (first_line < num_lines && first_line < num_edited_lines &&
+           is_same_line(lines, first_line, edited_lines, first_line)) {
+        first_line++;
+    }
+
+    int num_same_last_lines = 0;
+    while (num_same_last_lines < num_lines - first_line && num_same_last_lines < num_edited_lines - first_line &&
+           is_same_line(lines, num_lines - 1 - num_same_last_lines, edited_lines,
+                        num_edited_lines - 1 - num_same_last_lines)) {
+        num_same_last_lines++;
+    }
+
+    return (ScriptEdit) {
+        .first_line = first_line,
+        .num_old_lines = num_lines - first_line - num_same_last_lines,
+        .num_new_lines = num_edited_lines - first_line - num_same_last_lines,
+    };
+}
@@ -0,0 +1,42 @@
+#ifndef BEANSCRIPT_SCRIPT_LINES_H
+#define BEANSCRIPT_SCRIPT_LINES_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "script_source.h"
+#include "src/utility/arena.h"
+#include "../main.h"
+
+/**
+ * @brief The lines an edit replaced: the first line that differs, and how many lines from there the old text had and
+ * the new text has in their place. Every other line is the same in both texts.
+ */
+typedef struct {
+    int first_line;
+    int num_old_lines;
+    int num_new_lines;
+} ScriptEdit;
+
+typedef struct ScriptLinesStruct ScriptLines;
+
+// Constructor and Destructor
+ScriptLines*    script_lines_new(ScriptSource* source);
+void            script_lines_delete(ScriptLines** ptr_lines);
+
+// Accessor Functions
+int             script_lines_get_size(ScriptLines* lines);
+uint64_t        script_lines_get_hash(ScriptLines* lines);
+const char*     script_lines_get(ScriptLines* lines, int line_idx);
+char*           script_lines_copy(ScriptLines* lines, int line_idx, Arena* arena);
+int             script_lines_get_handle(ScriptLines* lines, int line_idx);
+
+// Mutator Functions
+void            script_lines_set_handle(ScriptLines* lines, int line_idx, int handle);
+
+// Executors
+ScriptEdit      script_lines_diff(ScriptLines* lines, ScriptLines* edited_lines);
+
+#endif //BEANSCRIPT_SCRIPT_LINES_H
@@ -0,0 +1,145 @@
+/**
+ * @file script_source.c
+ *
+ * The text of one script, read from its file in a single call into one buffer. Lines are handed out in place: the
+ * newline ending each line is replaced with a null terminator, so a line has no length limit and is never copied. The
+ * lexer then splits each line into tokens in place as well, and the parser interns the tokens it keeps as instruction
+ * ids and references, so the source can be freed as soon as the script is compiled (see runtime.c).
+ */
+
+#include "script_source.h"
+
+/**
+ * @brief The loaded text of a script.
+ * - text: The file contents followed by a null terminator. Lines already handed out are split by null terminators.
+ * - length: The number of bytes read from the file, not counting the terminator.
+ * - cursor: The offset of the next line in text.
+ * - line_number: The number of lines handed out so far.
+ * - hash: The FNV-1a hash of the file contents, taken before any line is handed out. Identifies the script's compiled
+ *   image (see script_image.c).
+ */
+struct ScriptSourceStruct {
+    char* text;
+    size_t length;
+    size_t cursor;
+    int line_number;
+    uint64_t hash;
+};
+
+static uint64_t hash_text(const char* text, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t idx = 0; idx < length; idx++) {
+        hash ^= (unsigned char) text[idx];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * Reads the whole file into a new source. Exits if the file cannot be opened.
+ *
+ * @param filename
+ * @return
+ */
+ScriptSource* script_source_new(const char* filename) {
+    assert(filename != NULL, "Attempting to load script source from NULL filename.");
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Error opening file: %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long file_length = ftell(file);
+    assert(file_length >= 0, "Failed to get the length of script %s.", filename);
+    fseek(file, 0, SEEK_SET);
+
+    ScriptSource* source = (ScriptSource*) malloc(sizeof(ScriptSource));
+    assert(source != NULL, "Failed to allocate memory for script source.");
+
+    source->text = (char*) malloc(sizeof(char) * (file_length + 1));
+    assert(source->text != NULL, "Failed to allocate memory for script %s.", filename);
+
+    source->length = fread(source->text, sizeof(char), file_length, file);
+    assert(ferror(file) == 0, "Failed to read script %s.", filename);
+    source->text[source->length] = '\0';
+
+    source->cursor = 0;
+    source->line_number = 0;
+    source->hash = hash_text(source->text, source->length);
+
+    fclose(file);
+    return source;
+}
+
+void script_source_delete(ScriptSource** ptr_source) {
+    assert(ptr_source != NULL, "Attempting to delete script source behind NULL pointer.");
+    assert(*ptr_source != NULL, "Attempting to delete NULL script source.");
+
+    ScriptSource* source = *ptr_source;
+    free(source->text);
+
+    free(source);
+    *ptr_source = NULL;
+}
+
+/**
+ * Returns the next line of the source, without its newline, or NULL once every line has been handed out. The line
+ * lives in the source buffer and may be modified in place.
+ *
+ * @param source
+ * @return
+ */
+char* script_source_next_line(ScriptSource* source) {
+    assert(source != NULL, "Attempting to read line from NULL script source.");
+
+    if (source->cursor >= source->length) {
+        return NULL;
+    }
+
+    char* line = source->text + source->cursor;
+    char* newline = (char*) memchr(line, '\n', source->length - source->cursor);
+
+    if (newline != NULL) {
+        *newline = '\0';
+        source->cursor = (size_t) (newline - source->text) + 1;
+    } else {
+        source->cursor = source->length;
+    }
+
+    source->line_number++;
+    return line;
+}
+
+/**
+ * Returns the line number of the line last returned by script_source_next_line, starting from 1.
+ */
+int script_source_get_line_number(ScriptSource* source) {
+    assert(source != NULL, "Attempting to get line number of NULL script source.");
+
+    return source->line_number;
+}
+
+/**
+ * Returns the hash of the file contents as they were read.
+ */
+uint64_t script_source_get_hash(ScriptSource* source) {
+    assert(source != NULL, "Attempting to get hash of NULL script source.");
+
+    return source->hash;
+}
+
+/**
+ * Returns the file contents as they were read and sets length to their size. Only whole until the first line is handed
+ * out, since handing out a line splits it off in place.
+ */
+const char* script_source_get_text(ScriptSource* source, size_t* length) {
+    assert(source != NULL, "Attempting to get text of NULL script source.");
+    assert(source->line_number == 0, "Attempting to get text of script source after handing out a line.");
+
+    *length = source->length;
+    return source->text;
+}
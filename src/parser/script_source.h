@@ -0,0 +1,24 @@
+
+#ifndef BEANSCRIPT_SCRIPT_SOURCE_H
+#define BEANSCRIPT_SCRIPT_SOURCE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../main.h"
+
+typedef struct ScriptSourceStruct ScriptSource;
+
+// Constructor and Destructor
+ScriptSource*   script_source_new(const char* filename);
+void            script_source_delete(ScriptSource** ptr_source);
+
+// Accessor Functions
+char*           script_source_next_line(ScriptSource* source);
+int             script_source_get_line_number(ScriptSource* source);
+uint64_t        script_source_get_hash(ScriptSource* source);
+const char*     script_source_get_text(ScriptSource* source, size_t* length);
+
+#endif //BEANSCRIPT_SCRIPT_SOURCE_H
@@ -2,83 +2,220 @@
  * @file runtime.c
  *
  * This file contains the runtime for the script. The runtime is responsible for executing the script.
+ *
+ * A runtime owns everything one script needs: its instruction, routine, waitlist and random maps, its scheduler, its
+ * output stage and its random number generator. Those modules work on whichever of their objects is bound to the calling thread, so a runtime binds
+ * itself (runtime_bind) before it parses, steps or frees anything. Several runtimes can therefore run on different
+ * threads, or take turns on one thread, without sharing any state except the emitter.
+ *
+ * A `script`, `start` or `stop` with a button binds the button instead of running in the body (see hotkeys.c). While
+ * buttons are listened for, a script with a button of its own waits for it before its body starts, and a runtime with
+ * any binding stays armed when it runs out of work, until its buttons start something again.
+ *
+ * A watched runtime (see runtime_watch) patches an edit of its file into the running script, at a cost that follows
+ * the size of the edit rather than of the script. The runtime keeps the lines it was compiled from, with the handle of
+ * the instruction of each line. When the file changes, the scheduler is suspended: nothing new begins, and every pass
+ * in flight is finished so no key is left held down. Once nothing is in flight, the edited lines are compared with the
+ * kept ones, and only the lines that differ are parsed again, together with the lines whose nesting the edit changes
+ * and the lines that copied values from any of them (see runtime_patch). Each of those instructions is written over its
+ * record in place, so every other instruction keeps its handle, its op stream, its cooldown, its routine, waitlist or
+ * random, and its place in the scheduler untouched. A parsed instruction with the id of an old one takes its place and
+ * keeps its state; the transactions of the edit, which have no id, take the place of the old ones in order. Removed
+ * instructions are forgotten. An edit that no longer compiles stops the program, as it would at startup. The image is
+ * written again the next time the script is compiled.
  */
 
 #include "runtime.h"
 
-static StrList* execution_list = NULL;
+/**
+ * @brief The instructions the next line may be nested under: the most recent instruction at each indent, from the
+ * shallowest to the deepest. Indents strictly increase from the bottom of the stack to the top, so the parent of a line
+ * is the deepest entry left after popping every entry at least as deep as the line.
+ */
+typedef struct {
+    Instruction** instructions;
+    int size;
+    int capacity;
+} ParentStack;
+
+/**
+ * @brief The state of one script.
+ * - execution_atoms: The atoms of the ids of the top-level instructions, in script order (see
+ *   instruction_map_intern), and their number and room.
+ * - execution_handles: The execution list resolved to instruction handles by runtime_link. The runtime only reads these
+ *   after preparing.
+ * - channel: The emitter channel the script's strokes are sent on, or -1 until the runtime is attached.
+ * - source: The text of the script while it is compiled. Every id is interned, so nothing points into the source once
+ *   it is compiled and it is freed then.
+ * - parents: The candidate parents of the next line while the script is compiled (see try_handle_sub_instruction).
+ * - image_name: The file of the compiled image while the script is prepared.
+ * - lines: The lines of the script as it was last compiled or patched, with the handle of the instruction of each.
+ * - edited_lines: The lines of the edited file while the scheduler is suspended to patch them in, or NULL.
+ * - reference_counts: The number of references to each instruction, by handle (see op_stream_count_references).
+ * - image: The compiled script while the instructions are loaded from it, or NULL if the script is compiled from
+ *   source. Freed once the instructions are loaded, for the same reason.
+ * - sink: Where the strokes of the script go instead of the emitter, or NULL (see runtime_set_sink). Not owned.
+ * - is_armed: True if buttons are bound in the script and are listened for.
+ * - is_toggled: True if the script has a button of its own, so its body only starts when the button is pressed.
+ * - is_channel_closed: True while the script's emitter channel is closed because the script ran out of work.
+ * - script_name: The file the script is compiled from.
+ * - source_mtime, source_size: The modification time and size of the file when it was last read, so a watched runtime
+ *   can tell when it changes without reading it.
+ * - horizon: The latest horizon the script was stepped to. Strokes up to it may have been handed off, so a patched
+ *   script resumes no earlier.
+ */
+struct RuntimeStruct {
+    InstructionMap* instruction_map;
+    RoutineMap* routine_map;
+    WaitlistMap* waitlist_map;
+    RandomMap* random_map;
+    Scheduler* scheduler;
+    Output* output;
+    Rng* rng;
+
+    int* execution_atoms;
+    int num_execution_atoms;
+    int execution_atoms_capacity;
+    int* execution_handles;
+    int num_execution_handles;
+    int channel;
+    ScriptSource* source;
+    ParentStack parents;
+    char* image_name;
+    ScriptImage* image;
+    ScriptLines* lines;
+    ScriptLines* edited_lines;
+    int* reference_counts;
+    NullSink* sink;
+    bool is_armed;
+    bool is_toggled;
+    bool is_channel_closed;
 
-static FILE* open_file(const char* filename) {
-    FILE* file = fopen(filename, "r");
+    char* script_name;
+    time_t source_mtime;
+    long long source_size;
+    time_t horizon;
+};
 
-    if (file == NULL) {
-        printf("Error opening file: %s\n", filename);
-        exit(EXIT_FAILURE);
+static void parent_stack_push(ParentStack* parents, Instruction* instruction) {
+    if (parents->size == parents->capacity) {
+        parents->capacity = parents->capacity > 0 ? 2 * parents->capacity : 8;
+        parents->instructions = (Instruction**) realloc(parents->instructions, sizeof(Instruction*) * parents->capacity);
+        assert(parents->instructions != NULL, "Failed to allocate memory for parent instructions.");
     }
 
-    return file;
+    parents->instructions[parents->size++] = instruction;
 }
 
 /**
  * Attempts to execute a sub-instruction. A sub-instruction is an instruction that is indented and is therefore ran
- * as a result of another instruction.
+ * as a result of another instruction. Its parent is the most recent instruction with a smaller indent. Every
+ * instruction is then pushed as a possible parent of the lines after it, so each line takes amortized constant time.
  *
  * @param instruction
- * @param all_instructions
+ * @param parents
  * @return
  */
-static bool try_handle_sub_instruction(Instruction* instruction, StrList* all_instructions) {
-    const bool is_sub_instruction = instruction_get_indent_count(instruction) > 0;
-    if (is_sub_instruction == false) {
-        return false;
-    }
+static bool try_handle_sub_instruction(Instruction* instruction, ParentStack* parents) {
+    const int current_indent_count = instruction_get_indent_count(instruction);
 
-    const int num_total_instructions = str_list_get_size(all_instructions);
-    assert(num_total_instructions > 0, "Attempting to add sub instruction to empty execution list.");
+    while (parents->size > 0 &&
+           instruction_get_indent_count(parents->instructions[parents->size - 1]) >= current_indent_count) {
+        parents->size--;
+    }
 
-    const int current_indent_count = instruction_get_indent_count(instruction);
+    const bool is_sub_instruction = current_indent_count > 0 && parents->size > 0;
+    if (is_sub_instruction) {
+        Instruction* ref_instruction = parents->instructions[parents->size - 1];
+        instruction_add_sub_instruction(ref_instruction, instruction_get_id(instruction));
+    }
 
-    for(int idx = num_total_instructions - 1; idx >= 0; idx--) {
-        const char* str_ref_instruction_id = str_list_get_str(all_instructions, idx);
-        Instruction* ref_instruction = instruction_map_get(str_ref_instruction_id);
-        assert(ref_instruction != NULL, "Attempting to reference instruction for sub-instruction.");
+    parent_stack_push(parents, instruction);
+    return is_sub_instruction;
+}
 
-        const int ref_indent_count = instruction_get_indent_count(ref_instruction);
+/**
+ * Builds each routine, waitlist and random from its linked sub-instructions and creates the scheduler for the linked
+ * execution handles. Runs the same way whether the script was compiled or loaded from its image.
+ */
+static void runtime_build_schedulers(Runtime* runtime) {
+    const int num_instructions = instruction_table_get_size();
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+        const int resize_value = num_sub_instructions > 0 ? num_sub_instructions : 1;
 
-        if (ref_indent_count < current_indent_count) {
-            const char* current_instruction_id = instruction_get_id(instruction);
-            instruction_add_sub_instruction(ref_instruction, current_instruction_id);
-            return true;
+        switch (instruction_get_type(instruction)) {
+            case ROUTINE:
+                routine_map_insert(routine_new(instruction, resize_value));
+                break;
+            case WAITLIST:
+                waitlist_map_insert(waitlist_new(instruction, resize_value));
+                break;
+            case RANDOM:
+                random_map_insert(random_new(instruction, resize_value));
+                break;
+            default:
+                break;
         }
     }
 
-    return false;
+    runtime->scheduler = scheduler_new(runtime->execution_handles, runtime->num_execution_handles);
+    scheduler_bind(runtime->scheduler);
 }
 
 /**
- * Compiles the script into a list of instructions that are ready to be executed.
- *
- * @param str_script_name
+ * Links the parsed script. Every instruction id is resolved to a dense handle (see instruction_map_link) and the
+ * execution list is resolved to handles. After linking, executing the script never hashes or compares an instruction
+ * id.
  */
-void runtime_prepare(const char* str_script_name) {
-    execution_list = str_list_new(1, true);
+static void runtime_link(Runtime* runtime) {
+    instruction_map_link();
+
+    const int num_execution_handles = runtime->num_execution_atoms;
+    int* execution_handles = (int*) malloc(sizeof(int) * (num_execution_handles > 0 ? num_execution_handles : 1));
+    assert(execution_handles != NULL, "Failed to allocate memory for execution handles.");
+
+    for (int idx = 0; idx < num_execution_handles; idx++) {
+        Instruction* instruction = instruction_map_get_by_atom(runtime->execution_atoms[idx]);
+        assert(instruction != NULL, "Attempting to get instruction from instruction map.");
+
+        execution_handles[idx] = instruction_get_handle(instruction);
+    }
+
+    runtime->execution_handles = execution_handles;
+    runtime->num_execution_handles = num_execution_handles;
+}
 
-    const char *filename = str_script_name;
-    FILE* file = open_file(filename);
+static void runtime_push_execution_atom(Runtime* runtime, int atom) {
+    if (runtime->num_execution_atoms == runtime->execution_atoms_capacity) {
+        const int capacity = runtime->execution_atoms_capacity;
+        runtime->execution_atoms_capacity = capacity > 0 ? 2 * capacity : 8;
 
-    const int max_line_length = 256;
-    char* line = (char*) malloc(max_line_length);
+        runtime->execution_atoms = (int*) realloc(runtime->execution_atoms,
+                                                  sizeof(int) * runtime->execution_atoms_capacity);
+        assert(runtime->execution_atoms != NULL, "Failed to allocate memory for execution list.");
+    }
 
-    int current_line = 0;
+    runtime->execution_atoms[runtime->num_execution_atoms++] = atom;
+}
 
-    // Keep a record of all parsed instructions. This assists with sub-instruction nesting. Once the instructions are
-    // parsed, this list is no longer needed.
-    StrList* all_instructions = str_list_new(1, true);
+/**
+ * Compiles the script source into a linked list of instructions that are ready to be executed.
+ *
+ * @param runtime
+ */
+static void runtime_compile(Runtime* runtime) {
+    ScriptSource* source = runtime->source;
 
+    // The candidate parents of the next line. This assists with sub-instruction nesting. Once the instructions are
+    // parsed, the stack is no longer needed.
+    ParentStack* parents = &runtime->parents;
 
-    while (fgets(line, max_line_length, file) != NULL) {
+    char* line = NULL;
+    while ((line = script_source_next_line(source)) != NULL) {
         Instruction* instruction = instruction_new();
-        instruction_set_line_number(instruction, ++current_line);
+        instruction_set_line_number(instruction, script_source_get_line_number(source));
 
         // Call the parser, which calls the lexer, to parse the line into an instruction.
         parse_line_into_instruction(instruction, line);
@@ -95,47 +232,1358 @@ void runtime_prepare(const char* str_script_name) {
         // order and thus each instruction must have a unique name. Naming is in the parsing stage.
         instruction_map_insert(instruction);
 
-        // Keep a record of all parsed instructions. This assists with sub-instruction nesting.
-        const char* current_instruction_id = instruction_get_id(instruction);
-        str_list_insert_str(all_instructions, current_instruction_id);
-
         // If the instruction is a sub-instruction, then add it to the parent instruction and continue to the next
         // instruction. Sub-instructions are not added to the execution list because they are ran as a result of the
         // parent instruction.
-        const bool is_sub_instruction = try_handle_sub_instruction(instruction, all_instructions);
+        const bool is_sub_instruction = try_handle_sub_instruction(instruction, parents);
         if (is_sub_instruction == true) {
             continue;
         }
 
-        // If the instruction is a transaction, then add it to the execution list.
+        // If the instruction is a transaction, then add it to the execution list. A start or stop with a button is a
+        // hotkey binding instead, and only runs when its button is pressed.
+        const bool is_binding = (type == START || type == STOP) && instruction_get_keycode(instruction) != 0;
         const bool is_transaction = instruction_type_is_transaction(type);
-        if (is_transaction == true) {
-            const char* str_instruction_id = instruction_get_id(instruction);
-            str_list_insert_str(execution_list, str_instruction_id);
+        if (is_transaction == true && is_binding == false) {
+            runtime_push_execution_atom(runtime, instruction_get_id_atom(instruction));
         }
     }
 
-    str_list_delete(&all_instructions);
+    free(parents->instructions);
+    *parents = (ParentStack) { .instructions = NULL, .size = 0, .capacity = 0 };
 
-    free(line);
-    fclose(file);
+    runtime_link(runtime);
 }
 
-void runtime_start() {
-    str_list_print(execution_list, true);
-    for (int i = 0; i < str_list_get_size(execution_list); i++) {
-        const char* str_instruction_id = str_list_get_str(execution_list, i);
-        Instruction* instruction = instruction_map_get(str_instruction_id);
-        assert(instruction != NULL, "Attempting to get instruction from instruction map.");
+/**
+ * Installs the instructions of a compiled script whose image matches the source, in place of compiling it.
+ *
+ * @param runtime
+ */
+static void runtime_load_image(Runtime* runtime) {
+    script_image_load(runtime->image);
+
+    const int num_execution_handles = script_image_get_num_execution_handles(runtime->image);
+    int* execution_handles = (int*) malloc(sizeof(int) * (num_execution_handles > 0 ? num_execution_handles : 1));
+    assert(execution_handles != NULL, "Failed to allocate memory for execution handles.");
+
+    memcpy(execution_handles, script_image_get_execution_handles(runtime->image), sizeof(int) * num_execution_handles);
+
+    runtime->execution_handles = execution_handles;
+    runtime->num_execution_handles = num_execution_handles;
+}
+
+/**
+ * Returns the name of the compiled image of a script: the script name with ".bsc" in place of ".bs", or with ".bsc"
+ * appended if it has another extension. The caller frees the name.
+ */
+static char* get_image_name(const char* str_script_name) {
+    const size_t name_length = strlen(str_script_name);
+    const bool is_bs_file = name_length >= 3 && strcmp(str_script_name + name_length - 3, ".bs") == 0;
+
+    char* image_name = (char*) malloc(name_length + sizeof(".bsc"));
+    assert(image_name != NULL, "Failed to allocate memory for script image name.");
+
+    sprintf(image_name, is_bs_file ? "%sc" : "%s.bsc", str_script_name);
+    return image_name;
+}
+
+/**
+ * Prepares the script for execution. The script is loaded from its compiled image if the image was compiled from the
+ * current source; otherwise the script is compiled and a new image is written for the next run.
+ *
+ * @param runtime
+ * @param str_script_name
+ */
+static void runtime_prepare(Runtime* runtime, const char* str_script_name) {
+    runtime->source = script_source_new(str_script_name);
+    runtime->lines = script_lines_new(runtime->source);
+    const uint64_t source_hash = script_lines_get_hash(runtime->lines);
+
+    runtime->image_name = get_image_name(str_script_name);
+    runtime->image = script_image_open(runtime->image_name, source_hash);
+
+    // Every id is interned as it is parsed or loaded, so neither the source nor the image is needed afterwards.
+    if (runtime->image != NULL) {
+        script_source_delete(&runtime->source);
+        runtime_load_image(runtime);
+        script_image_delete(&runtime->image);
+    } else {
+        runtime_compile(runtime);
+        script_source_delete(&runtime->source);
+        script_image_save(runtime->image_name, source_hash, runtime->execution_handles,
+                          runtime->num_execution_handles);
+    }
+
+    free(runtime->image_name);
+    runtime->image_name = NULL;
+
+    const int num_instructions = instruction_table_get_size();
+    for (int handle = 0; handle < num_instructions; handle++) {
+        const int line_number = instruction_get_line_number(instruction_table_get(handle));
+        script_lines_set_handle(runtime->lines, line_number - 1, handle);
+    }
+
+    runtime->reference_counts = (int*) malloc(sizeof(int) * (num_instructions > 0 ? num_instructions : 1));
+    assert(runtime->reference_counts != NULL, "Failed to allocate memory for reference counts.");
+
+    // Passes are flattened after every load, so the image only ever holds the instructions themselves.
+    op_stream_count_references(runtime->execution_handles, runtime->num_execution_handles, runtime->reference_counts);
+    op_stream_compile_table(runtime->reference_counts);
+    runtime_build_schedulers(runtime);
+}
+
+/**
+ * Names the script and every instruction for the timing dump, which outlives the runtime.
+ *
+ * @param runtime
+ * @param str_script_name
+ */
+static void runtime_name_for_timing(Runtime* runtime, const char* str_script_name) {
+    timing_name_channel(runtime->channel, str_script_name);
+
+    const int num_instructions = instruction_table_get_size();
+    for (int handle = 0; handle < num_instructions; handle++) {
+        timing_name_instruction(runtime->channel, handle, instruction_get_id(instruction_table_get(handle)));
+    }
+}
+
+/**
+ * Attaches the runtime's channel to the metrics with an entry for every instruction and the script body, and has the
+ * bound scheduler count its steps on it (see metrics.c).
+ *
+ * @param runtime
+ */
+static void runtime_attach_metrics(Runtime* runtime) {
+    const int num_instructions = instruction_table_get_size();
+    metrics_attach_channel(runtime->channel, runtime->script_name, num_instructions + 1);
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        metrics_name_entry(runtime->channel, handle, instruction_get_id(instruction),
+                           InstructionTypeLookupArray[instruction_get_type(instruction)]);
+    }
+
+    metrics_name_entry(runtime->channel, num_instructions, runtime->script_name, "body");
+    scheduler_set_metrics_channel(runtime->channel);
+}
+
+/**
+ * Binds the buttons of every `script`, `start` and `stop` with a button to the runtime's channel (see hotkeys.c).
+ *
+ * @param runtime
+ */
+static void runtime_bind_hotkeys(Runtime* runtime) {
+    const int num_instructions = instruction_table_get_size();
+    for (int handle = 0; handle < num_instructions; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        const unsigned short keycode = instruction_get_keycode(instruction);
+        if (keycode == 0) {
+            continue;
+        }
+
+        switch (instruction_get_type(instruction)) {
+            case SCRIPT:
+                hotkeys_bind(runtime->channel, keycode, HOTKEY_TOGGLE, handle);
+                runtime->is_toggled = true;
+                break;
+            case START:
+                hotkeys_bind(runtime->channel, keycode, HOTKEY_START, handle);
+                break;
+            case STOP:
+                hotkeys_bind(runtime->channel, keycode, HOTKEY_STOP, handle);
+                break;
+            default:
+                continue;
+        }
+
+        runtime->is_armed = true;
+    }
+}
+
+/**
+ * Reads the modification time and size of the script file. Returns false if the file cannot be read right now, e.g.
+ * while an editor replaces it.
+ */
+static bool get_source_signature(const char* str_script_name, time_t* mtime, long long* size) {
+    struct stat file_stat;
+    if (stat(str_script_name, &file_stat) != 0) {
+        return false;
+    }
+
+    *mtime = (time_t) file_stat.st_mtime;
+    *size = (long long) file_stat.st_size;
+    return true;
+}
+
+/**
+ * Creates a runtime for the script without compiling it yet, and binds it to the calling thread. Every field is set, so
+ * the runtime can be deleted however far its compile gets.
+ */
+static Runtime* runtime_alloc(const char* str_script_name, int channel) {
+    Runtime* runtime = (Runtime*) malloc(sizeof(Runtime));
+    assert(runtime != NULL, "Failed to allocate memory for runtime.");
+
+    runtime->instruction_map = instruction_map_new();
+    runtime->routine_map = routine_map_new();
+    runtime->waitlist_map = waitlist_map_new();
+    runtime->random_map = random_map_new();
+    runtime->scheduler = NULL;
+    runtime->output = NULL;
+    runtime->rng = NULL;
+
+    runtime->execution_atoms = NULL;
+    runtime->num_execution_atoms = 0;
+    runtime->execution_atoms_capacity = 0;
+    runtime->execution_handles = NULL;
+    runtime->num_execution_handles = 0;
+    runtime->channel = channel;
+    runtime->source = NULL;
+    runtime->parents = (ParentStack) { .instructions = NULL, .size = 0, .capacity = 0 };
+    runtime->image_name = NULL;
+    runtime->image = NULL;
+    runtime->lines = NULL;
+    runtime->edited_lines = NULL;
+    runtime->reference_counts = NULL;
+    runtime->sink = NULL;
+    runtime->is_armed = false;
+    runtime->is_toggled = false;
+    runtime->is_channel_closed = false;
+
+    runtime->script_name = strdup(str_script_name);
+    assert(runtime->script_name != NULL, "Failed to allocate memory for script name.");
+    runtime->source_mtime = 0;
+    runtime->source_size = -1;
+    runtime->horizon = 0;
+
+    // The signature is read before the source, so an edit made while the script compiles is seen by the next watch.
+    get_source_signature(str_script_name, &runtime->source_mtime, &runtime->source_size);
+
+    runtime_bind(runtime);
+
+    return runtime;
+}
+
+/**
+ * Creates a runtime for the script and compiles it, without an output stage or a random number generator. The runtime
+ * is left bound to the calling thread.
+ */
+static Runtime* runtime_create(const char* str_script_name, int channel) {
+    Runtime* runtime = runtime_alloc(str_script_name, channel);
+    runtime_prepare(runtime, str_script_name);
+
+    return runtime;
+}
+
+/**
+ * Creates a runtime for the script and compiles it. The strokes of the script are sent on the given emitter channel.
+ * Every random choice the script makes is drawn from a generator seeded with the given seed, so the same seed repeats
+ * the same choices. The runtime is left bound to the calling thread.
+ *
+ * @param str_script_name
+ * @param channel
+ * @param seed
+ * @return
+ */
+Runtime* runtime_new(const char* str_script_name, int channel, uint64_t seed) {
+    Runtime* runtime = runtime_create(str_script_name, channel);
+    runtime_attach(runtime, channel, seed);
+
+    return runtime;
+}
+
+/**
+ * Creates a runtime for the script and compiles it, without a channel to send on yet. The runtime can be compiled on
+ * one thread ahead of time and attached on another once it is run (see script_loader.c). Until it is attached, it can
+ * only be deleted.
+ *
+ * @param str_script_name
+ * @return
+ */
+Runtime* runtime_load(const char* str_script_name) {
+    return runtime_create(str_script_name, -1);
+}
 
-        instruction_print(instruction, true);
+/**
+ * Compiles the script as runtime_load does, except that a script that does not compile does not stop the program:
+ * NULL is returned instead, with the error written to the given buffer. Whatever the failed compile allocated is
+ * owned by the runtime, which is freed.
+ *
+ * @param str_script_name
+ * @param str_error Out: the error, if the script does not compile.
+ * @param error_size The size of the error buffer.
+ * @return
+ */
+Runtime* runtime_try_load(const char* str_script_name, char* str_error, size_t error_size) {
+    assert(str_error != NULL && error_size > 0, "Attempting to load script %s without an error buffer.",
+           str_script_name);
+
+    Runtime* runtime = runtime_alloc(str_script_name, -1);
+
+    AssertTrap trap;
+    if (setjmp(trap.jump) == 0) {
+        assert_set_trap(&trap);
+        runtime_prepare(runtime, str_script_name);
+        assert_set_trap(NULL);
+
+        return runtime;
     }
+
+    snprintf(str_error, error_size, "%s", trap.message);
+    runtime_delete(&runtime);
+
+    return NULL;
 }
 
-void runtime_delete() {
-    str_list_delete(&execution_list);
+/**
+ * Attaches a compiled runtime to the given emitter channel and seeds its random choices with the given seed, as
+ * runtime_new does. The runtime is left bound to the calling thread.
+ *
+ * @param runtime
+ * @param channel
+ * @param seed
+ */
+void runtime_attach(Runtime* runtime, int channel, uint64_t seed) {
+    assert(runtime != NULL, "Attempting to attach NULL runtime.");
+    assert(runtime->output == NULL, "Attempting to attach runtime of %s twice.", runtime->script_name);
+
+    runtime->channel = channel;
+    runtime->output = output_new(channel);
+    runtime->rng = rng_new(seed);
+    runtime_bind(runtime);
+
+    if (timing_is_open()) {
+        runtime_name_for_timing(runtime, runtime->script_name);
+    }
+
+    if (metrics_is_open()) {
+        runtime_attach_metrics(runtime);
+    }
+
+    if (hotkeys_is_listening()) {
+        runtime_bind_hotkeys(runtime);
+    }
 }
 
-void runtime_print() {
-    str_list_print(execution_list, false);
-}
\ No newline at end of file
+/**
+ * Frees the runtime and everything the script owns. Strokes already handed to the emitter are still sent.
+ *
+ * @param ptr_runtime
+ */
+void runtime_delete(Runtime** ptr_runtime) {
+    assert(ptr_runtime != NULL, "Attempting to delete runtime behind NULL pointer.");
+    assert(*ptr_runtime != NULL, "Attempting to delete NULL runtime.");
+
+    Runtime* runtime = *ptr_runtime;
+
+    // Routines, waitlists and randoms refer to instructions and their interned ids and live in the script arena, so the
+    // instruction map goes last.
+    if (runtime->scheduler != NULL) {
+        scheduler_delete(&runtime->scheduler);
+    }
+
+    if (runtime->output != NULL) {
+        output_delete(&runtime->output);
+    }
+
+    if (runtime->rng != NULL) {
+        rng_delete(&runtime->rng);
+    }
+
+    routine_map_delete(&runtime->routine_map);
+    waitlist_map_delete(&runtime->waitlist_map);
+    random_map_delete(&runtime->random_map);
+    instruction_map_delete(&runtime->instruction_map);
+
+    free(runtime->execution_atoms);
+    free(runtime->execution_handles);
+    free(runtime->reference_counts);
+    free(runtime->parents.instructions);
+    free(runtime->image_name);
+
+    if (runtime->lines != NULL) {
+        script_lines_delete(&runtime->lines);
+    }
+
+    if (runtime->edited_lines != NULL) {
+        script_lines_delete(&runtime->edited_lines);
+    }
+
+    if (runtime->source != NULL) {
+        script_source_delete(&runtime->source);
+    }
+
+    if (runtime->image != NULL) {
+        script_image_delete(&runtime->image);
+    }
+
+    free(runtime->script_name);
+    free(runtime);
+    *ptr_runtime = NULL;
+}
+
+/**
+ * Binds the maps, scheduler, output stage and random number generator of the runtime to the calling thread. Every module function called on
+ * this thread afterwards works on this runtime's script.
+ *
+ * @param runtime
+ */
+void runtime_bind(Runtime* runtime) {
+    assert(runtime != NULL, "Attempting to bind NULL runtime.");
+
+    instruction_map_bind(runtime->instruction_map);
+    routine_map_bind(runtime->routine_map);
+    waitlist_map_bind(runtime->waitlist_map);
+    random_map_bind(runtime->random_map);
+    scheduler_bind(runtime->scheduler);
+    output_bind(runtime->output);
+    rng_bind(runtime->rng);
+}
+
+/**
+ * Sends the strokes of the script to the given null sink instead of the emitter, so the script can be stepped without
+ * an open emitter (see runtime_pool_simulate). The sink is not owned and must outlive the runtime.
+ *
+ * @param runtime
+ * @param sink
+ */
+void runtime_set_sink(Runtime* runtime, NullSink* sink) {
+    assert(runtime != NULL, "Attempting to set sink of NULL runtime.");
+
+    runtime->sink = sink;
+    output_set_sink(runtime->output, sink);
+}
+
+/**
+ * Returns true if buttons bound in the script are listened for, so the script may start again after it runs out of
+ * work.
+ *
+ * @param runtime
+ * @return
+ */
+bool runtime_is_armed(Runtime* runtime) {
+    assert(runtime != NULL, "Attempting to check if NULL runtime is armed.");
+
+    return runtime->is_armed;
+}
+
+/**
+ * Returns true if the script file has not changed since the runtime compiled it, going by its modification time and
+ * size. A file that cannot be read right now counts as unchanged.
+ *
+ * @param runtime
+ * @return
+ */
+bool runtime_is_current(Runtime* runtime) {
+    assert(runtime != NULL, "Attempting to check if NULL runtime is current.");
+
+    time_t mtime = 0;
+    long long size = 0;
+    return get_source_signature(runtime->script_name, &mtime, &size) == false ||
+           (mtime == runtime->source_mtime && size == runtime->source_size);
+}
+
+/**
+ * Returns the file the script was compiled from.
+ *
+ * @param runtime
+ * @return
+ */
+const char* runtime_get_script_name(Runtime* runtime) {
+    assert(runtime != NULL, "Attempting to get script name of NULL runtime.");
+
+    return runtime->script_name;
+}
+
+/**
+ * Schedules the script body to run from the given time. Returns the first deadline of the script, or -1 if the script
+ * waits for its button first.
+ *
+ * @param runtime
+ * @param start_time
+ * @return
+ */
+time_t runtime_start(Runtime* runtime, time_t start_time) {
+    runtime_bind(runtime);
+
+    if (runtime->is_toggled == false) {
+        scheduler_start_body(start_time);
+    } else if (runtime->sink == NULL) {
+        // Nothing is pushed until the button is pressed, so the other channels must not wait on this one.
+        emitter_close_channel(runtime->channel);
+        runtime->is_channel_closed = true;
+    }
+
+    return scheduler_get_next_deadline();
+}
+
+/**
+ * Handles every button press bound in the script since the last call, as of the given time. A press of the script's
+ * own button stops everything that runs, or starts the body again if nothing does. Returns the next deadline of the
+ * script, as runtime_step does.
+ *
+ * @param runtime
+ * @param current_time
+ * @return
+ */
+time_t runtime_handle_hotkeys(Runtime* runtime, time_t current_time) {
+    runtime_bind(runtime);
+
+    HotkeyCommand command;
+    while (hotkeys_poll(runtime->channel, &command)) {
+        Instruction* instruction = instruction_table_get(command.handle);
+        const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+
+        switch (command.action) {
+            case HOTKEY_TOGGLE:
+                if (scheduler_get_next_deadline() >= 0) {
+                    scheduler_stop_all(current_time);
+                } else {
+                    scheduler_start_body(current_time);
+                }
+                break;
+            case HOTKEY_START:
+                for (int idx = 0; idx < num_sub_instructions; idx++) {
+                    scheduler_start(instruction_get_linked_sub_instruction(instruction, idx), current_time);
+                }
+                break;
+            case HOTKEY_STOP:
+                for (int idx = 0; idx < num_sub_instructions; idx++) {
+                    scheduler_stop(instruction_get_linked_sub_instruction(instruction, idx), current_time);
+                }
+                break;
+        }
+    }
+
+    const time_t next_deadline = time_get_earliest_deadline(scheduler_get_next_deadline(), output_get_next_deadline());
+    if (runtime->is_channel_closed && next_deadline >= 0) {
+        emitter_reopen_channel(runtime->channel, current_time);
+        runtime->is_channel_closed = false;
+    }
+
+    return next_deadline;
+}
+
+/**
+ * @brief A growable list of instruction handles.
+ */
+typedef struct {
+    int* handles;
+    int size;
+    int capacity;
+} HandleList;
+
+static void handle_list_push(HandleList* list, int handle) {
+    if (list->size == list->capacity) {
+        list->capacity = list->capacity > 0 ? 2 * list->capacity : 16;
+        list->handles = (int*) realloc(list->handles, sizeof(int) * list->capacity);
+        assert(list->handles != NULL, "Failed to allocate memory for instruction handles.");
+    }
+
+    list->handles[list->size++] = handle;
+}
+
+/**
+ * @brief The lines of the script a patch looks at again (see runtime_patch): every line of the edit, from the last
+ * top-level instruction before it up to the first top-level instruction after it. A top-level instruction ends every
+ * nesting before it, so the edit cannot change which line any line outside of the region is nested under.
+ * - edit: The lines the edit replaced (see script_lines_diff).
+ * - first_line: The first line of the region, which is the same line before and after the edit.
+ * - num_old_lines, num_new_lines: The number of lines of the region before and after the edit.
+ * - old_parents, new_parents: The line each line of the region is nested under, before and after the edit (see
+ *   find_parent_lines).
+ * - is_marked: For each line of the region after the edit, true if its instruction gains or loses a nested line.
+ */
+typedef struct {
+    ScriptEdit edit;
+    int first_line;
+    int num_old_lines;
+    int num_new_lines;
+    int* old_parents;
+    int* new_parents;
+    bool* is_marked;
+} PatchRegion;
+
+/**
+ * Returns the line before the edit that the given line after it is, or -1 for a line of the edit.
+ */
+static int get_old_line(const ScriptEdit* edit, int line_idx) {
+    if (line_idx < edit->first_line) {
+        return line_idx;
+    }
+
+    if (line_idx >= edit->first_line + edit->num_new_lines) {
+        return line_idx - edit->num_new_lines + edit->num_old_lines;
+    }
+
+    return -1;
+}
+
+/**
+ * Returns the line after the edit that the given line before it is, or -1 for a line the edit replaced.
+ */
+static int get_new_line(const ScriptEdit* edit, int line_idx) {
+    if (line_idx < edit->first_line) {
+        return line_idx;
+    }
+
+    if (line_idx >= edit->first_line + edit->num_old_lines) {
+        return line_idx - edit->num_old_lines + edit->num_new_lines;
+    }
+
+    return -1;
+}
+
+/**
+ * Returns true if the line holds an instruction that is nested under no other.
+ */
+static bool is_top_level_line(ScriptLines* lines, int line_idx) {
+    const int handle = script_lines_get_handle(lines, line_idx);
+
+    return handle >= 0 && instruction_get_indent_count(instruction_table_get(handle)) == 0;
+}
+
+/**
+ * Finds the line each of the given run of lines is nested under, the same way try_handle_sub_instruction does as the
+ * script is compiled: the line is -1 for a top-level line and -2 for a line without an instruction. The run must start
+ * with a top-level line or at the first line of the script.
+ *
+ * @param indents The indent of each line, or -1 for a line without an instruction.
+ * @param num_lines
+ * @param first_line The line the run starts at.
+ * @param parents Out: the line each line is nested under.
+ * @param stack Room for an index per line.
+ */
+static void find_parent_lines(const int* indents, int num_lines, int first_line, int* parents, int* stack) {
+    int stack_size = 0;
+
+    for (int idx = 0; idx < num_lines; idx++) {
+        if (indents[idx] < 0) {
+            parents[idx] = -2;
+            continue;
+        }
+
+        while (stack_size > 0 && indents[stack[stack_size - 1]] >= indents[idx]) {
+            stack_size--;
+        }
+
+        parents[idx] = indents[idx] > 0 && stack_size > 0 ? first_line + stack[stack_size - 1] : -1;
+        stack[stack_size++] = idx;
+    }
+}
+
+/**
+ * Returns true if the instruction binds a button instead of running in the body.
+ */
+static bool is_binding(Instruction* instruction) {
+    const InstructionType type = instruction_get_type(instruction);
+
+    return (type == SCRIPT || type == START || type == STOP) && instruction_get_keycode(instruction) != 0;
+}
+
+/**
+ * Retires the record with the given handle for the patch being made (see instruction_map_retire), and keeps what the
+ * patch needs to know of it once it is written over: its sub-instructions, which may be inlined in it no longer, and
+ * whether it bound a button.
+ *
+ * @param handle
+ * @param old_sub_handles Out: the sub-instructions of the record are added to the list.
+ * @param is_binding_changed Out: set if the record bound a button.
+ */
+static void retire_record(int handle, HandleList* old_sub_handles, bool* is_binding_changed) {
+    Instruction* record = instruction_table_get(handle);
+
+    for (int idx = 0; idx < instruction_get_num_sub_instructions(record); idx++) {
+        handle_list_push(old_sub_handles, instruction_get_sub_instruction_handle(record, idx));
+    }
+
+    *is_binding_changed |= is_binding(record);
+    instruction_map_retire(handle);
+}
+
+/**
+ * Finds the region of the edit of the runtime's lines and the line each of its lines is nested under, and marks every
+ * instruction of an unchanged line that gains or loses a nested line. A line nested under another line than before
+ * moves from one to the other; a line of the edit is new to the line it is nested under, or gone from it.
+ *
+ * @param runtime
+ * @param edited_lines
+ * @param region Out: the region of the edit. Its arrays are freed by the caller.
+ */
+static void find_patch_region(Runtime* runtime, ScriptLines* edited_lines, PatchRegion* region) {
+    ScriptLines* lines = runtime->lines;
+    const ScriptEdit edit = script_lines_diff(lines, edited_lines);
+    const int num_lines = script_lines_get_size(lines);
+
+    int first_line = edit.first_line - 1;
+    while (first_line > 0 && is_top_level_line(lines, first_line) == false) {
+        first_line--;
+    }
+
+    first_line = first_line > 0 ? first_line : 0;
+
+    int end_line = edit.first_line + edit.num_old_lines;
+    while (end_line < num_lines && is_top_level_line(lines, end_line) == false) {
+        end_line++;
+    }
+
+    region->edit = edit;
+    region->first_line = first_line;
+    region->num_old_lines = end_line - first_line;
+    region->num_new_lines = region->num_old_lines + edit.num_new_lines - edit.num_old_lines;
+
+    const int max_lines = region->num_old_lines > region->num_new_lines ? region->num_old_lines : region->num_new_lines;
+    int* indents = (int*) malloc(sizeof(int) * (max_lines > 0 ? max_lines : 1));
+    int* stack = (int*) malloc(sizeof(int) * (max_lines > 0 ? max_lines : 1));
+    region->old_parents = (int*) malloc(sizeof(int) * (max_lines > 0 ? max_lines : 1));
+    region->new_parents = (int*) malloc(sizeof(int) * (max_lines > 0 ? max_lines : 1));
+    region->is_marked = (bool*) calloc(max_lines > 0 ? max_lines : 1, sizeof(bool));
+    assert(indents != NULL && stack != NULL && region->old_parents != NULL && region->new_parents != NULL &&
+           region->is_marked != NULL, "Failed to allocate memory for patching script %s.", runtime->script_name);
+
+    for (int idx = 0; idx < region->num_old_lines; idx++) {
+        const int handle = script_lines_get_handle(lines, first_line + idx);
+        indents[idx] = handle >= 0 ? instruction_get_indent_count(instruction_table_get(handle)) : -1;
+    }
+
+    find_parent_lines(indents, region->num_old_lines, first_line, region->old_parents, stack);
+
+    // An unchanged line only needs its indent, which its instruction already has.
+    for (int idx = 0; idx < region->num_new_lines; idx++) {
+        const int old_line_idx = get_old_line(&edit, first_line + idx);
+        if (old_line_idx < 0) {
+            indents[idx] = parse_line_indent(script_lines_get(edited_lines, first_line + idx));
+            continue;
+        }
+
+        const int handle = script_lines_get_handle(lines, old_line_idx);
+        indents[idx] = handle >= 0 ? instruction_get_indent_count(instruction_table_get(handle)) : -1;
+    }
+
+    find_parent_lines(indents, region->num_new_lines, first_line, region->new_parents, stack);
+
+    for (int idx = 0; idx < region->num_new_lines; idx++) {
+        const int new_parent = region->new_parents[idx];
+        const int old_line_idx = get_old_line(&edit, first_line + idx);
+
+        if (old_line_idx < 0) {
+            if (new_parent >= 0 && get_old_line(&edit, new_parent) >= 0) {
+                region->is_marked[new_parent - first_line] = true;
+            }
+            continue;
+        }
+
+        // A line that was nested under a line of the edit moved, whatever it is nested under now.
+        const int old_parent = region->old_parents[old_line_idx - first_line];
+        const int moved_parent = old_parent >= 0 && get_new_line(&edit, old_parent) < 0
+                                 ? -3 : (old_parent >= 0 ? get_new_line(&edit, old_parent) : old_parent);
+
+        if (new_parent != moved_parent) {
+            if (new_parent >= 0 && get_old_line(&edit, new_parent) >= 0) {
+                region->is_marked[new_parent - first_line] = true;
+            }
+
+            if (moved_parent >= 0) {
+                region->is_marked[moved_parent - first_line] = true;
+            }
+        }
+    }
+
+    for (int line_idx = edit.first_line; line_idx < edit.first_line + edit.num_old_lines; line_idx++) {
+        const int old_parent = region->old_parents[line_idx - first_line];
+        if (script_lines_get_handle(lines, line_idx) >= 0 && old_parent >= 0 && get_new_line(&edit, old_parent) >= 0) {
+            region->is_marked[get_new_line(&edit, old_parent) - first_line] = true;
+        }
+    }
+
+    free(indents);
+    free(stack);
+}
+
+/**
+ * Parses the given line of the edited script into a draft of the patch being made and inserts it, as the script
+ * compiler does. Returns the draft, or NULL if the line holds no instruction.
+ */
+static Instruction* parse_patch_line(ScriptLines* edited_lines, int line_idx) {
+    Arena* scratch = instruction_map_get_scratch_arena();
+    const ArenaMark mark = arena_get_mark(scratch);
+    char* line = script_lines_copy(edited_lines, line_idx, scratch);
+
+    Instruction* instruction = instruction_new();
+    instruction_set_line_number(instruction, line_idx + 1);
+    parse_line_into_instruction(instruction, line);
+    arena_rewind(scratch, mark);
+
+    if (instruction_get_type(instruction) == NONE) {
+        instruction_delete(&instruction);
+        return NULL;
+    }
+
+    instruction_map_insert(instruction);
+    return instruction;
+}
+
+/**
+ * Returns the index of the first top-level instruction of the runtime on or after the given line.
+ */
+static int find_execution_index(Runtime* runtime, int line_idx) {
+    int low = 0;
+    int high = runtime->num_execution_handles;
+
+    while (low < high) {
+        const int mid = low + (high - low) / 2;
+        if (instruction_get_line_number(instruction_table_get(runtime->execution_handles[mid])) - 1 < line_idx) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * Builds the routine, waitlist or random of every given instruction again, in place of the one it had. The position of
+ * a routine and the availability of the instructions of a waitlist or random carry over if it is still one.
+ *
+ * @param handles
+ * @param num_handles
+ */
+static void runtime_rebuild_schedulers(const int* handles, int num_handles) {
+    for (int idx = 0; idx < num_handles; idx++) {
+        Instruction* instruction = instruction_table_get(handles[idx]);
+        const int atom = instruction_get_id_atom(instruction);
+        const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+        const int resize_value = num_sub_instructions > 0 ? num_sub_instructions : 1;
+
+        Routine* old_routine = routine_map_remove(atom);
+        Waitlist* old_waitlist = waitlist_map_remove(atom);
+        Random* old_random = random_map_remove(atom);
+
+        switch (instruction_get_type(instruction)) {
+            case ROUTINE: {
+                Routine* routine = routine_new(instruction, resize_value);
+                if (old_routine != NULL) {
+                    routine_migrate(routine, old_routine);
+                }
+                routine_map_insert(routine);
+                break;
+            }
+            case WAITLIST: {
+                Waitlist* waitlist = waitlist_new(instruction, resize_value);
+                if (old_waitlist != NULL) {
+                    waitlist_migrate(waitlist, old_waitlist);
+                }
+                waitlist_map_insert(waitlist);
+                break;
+            }
+            case RANDOM: {
+                Random* random = random_new(instruction, resize_value);
+                if (old_random != NULL) {
+                    random_migrate(random, old_random);
+                }
+                random_map_insert(random);
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (old_routine != NULL) {
+            routine_delete(&old_routine);
+        }
+
+        if (old_waitlist != NULL) {
+            waitlist_delete(&old_waitlist);
+        }
+
+        if (old_random != NULL) {
+            random_delete(&old_random);
+        }
+    }
+}
+
+/**
+ * Patches the edited lines of the runtime into its suspended script in place (see the top of this file). Nothing of
+ * the script may be in flight. No entry resumes before the given time.
+ *
+ * Only the lines of the edit are parsed, together with the unchanged lines around it whose instruction gains or loses
+ * a nested line, and every later line that copied values from one of those. Each becomes a draft of a patch of the
+ * instruction map (see instruction_map_begin_patch), which is then written over the records in place. Only the op
+ * streams and schedulers of the records that changed, and of the records that inline them, are built again.
+ *
+ * @param runtime
+ * @param resume_time
+ */
+static void runtime_patch(Runtime* runtime, time_t resume_time) {
+    ScriptLines* lines = runtime->lines;
+    ScriptLines* edited_lines = runtime->edited_lines;
+    runtime->edited_lines = NULL;
+
+    const int num_edited_lines = script_lines_get_size(edited_lines);
+    const int old_num_instructions = instruction_table_get_size();
+
+    PatchRegion region;
+    find_patch_region(runtime, edited_lines, &region);
+
+    const ScriptEdit* edit = &region.edit;
+    const int first_line = region.first_line;
+    const int end_line = first_line + region.num_new_lines;
+    const int num_shifted_lines = edit->num_new_lines - edit->num_old_lines;
+
+    // The top-level instructions of the region, which the patch replaces, before any line moves.
+    const int first_execution_idx = find_execution_index(runtime, first_line);
+    const int end_execution_idx = find_execution_index(runtime, first_line + region.num_old_lines);
+
+    for (int line_idx = edit->first_line + edit->num_old_lines; line_idx < script_lines_get_size(lines); line_idx++) {
+        const int handle = script_lines_get_handle(lines, line_idx);
+        if (handle >= 0) {
+            instruction_set_line_number(instruction_table_get(handle), line_idx + num_shifted_lines + 1);
+        }
+    }
+
+    instruction_map_begin_patch();
+
+    // The transactions of the edit have no id to be matched by, so they are matched by place instead.
+    HandleList old_transactions = { .handles = NULL, .size = 0, .capacity = 0 };
+    HandleList old_sub_handles = { .handles = NULL, .size = 0, .capacity = 0 };
+    int num_retired = 0;
+    bool is_binding_changed = false;
+
+    for (int line_idx = edit->first_line; line_idx < edit->first_line + edit->num_old_lines; line_idx++) {
+        const int handle = script_lines_get_handle(lines, line_idx);
+        if (handle < 0) {
+            continue;
+        }
+
+        if (instruction_type_is_transaction(instruction_get_type(instruction_table_get(handle)))) {
+            handle_list_push(&old_transactions, handle);
+        }
+
+        retire_record(handle, &old_sub_handles, &is_binding_changed);
+        num_retired++;
+    }
+
+    for (int idx = 0; idx < region.num_new_lines; idx++) {
+        if (region.is_marked[idx]) {
+            retire_record(script_lines_get_handle(lines, get_old_line(edit, first_line + idx)), &old_sub_handles,
+                          &is_binding_changed);
+            num_retired++;
+        }
+    }
+
+    // The instruction of each line of the region, and the draft it is, or -1 for an unchanged instruction.
+    Instruction** instructions = (Instruction**) calloc(region.num_new_lines > 0 ? region.num_new_lines : 1,
+                                                        sizeof(Instruction*));
+    int* draft_idxs = (int*) malloc(sizeof(int) * (region.num_new_lines > 0 ? region.num_new_lines : 1));
+    assert(instructions != NULL && draft_idxs != NULL, "Failed to allocate memory for patching script %s.",
+           runtime->script_name);
+
+    for (int idx = 0; idx < region.num_new_lines; idx++) {
+        draft_idxs[idx] = -1;
+    }
+
+    // The handle of the record each draft should take the place of, or -1.
+    HandleList handles = { .handles = NULL, .size = 0, .capacity = 0 };
+    int num_edit_transactions = 0;
+
+    for (int line_idx = first_line; line_idx < num_edited_lines; line_idx++) {
+        const bool is_in_region = line_idx < end_line;
+        const int old_line_idx = get_old_line(edit, line_idx);
+        Instruction* instruction = NULL;
+        int handle = -1;
+        bool is_draft = true;
+
+        if (old_line_idx < 0) {
+            instruction = parse_patch_line(edited_lines, line_idx);
+
+            if (instruction != NULL && instruction_type_is_transaction(instruction_get_type(instruction))) {
+                if (num_edit_transactions < old_transactions.size &&
+                    instruction_get_type(instruction_table_get(old_transactions.handles[num_edit_transactions])) ==
+                    instruction_get_type(instruction)) {
+                    handle = old_transactions.handles[num_edit_transactions];
+                }
+                num_edit_transactions++;
+            }
+        } else {
+            handle = script_lines_get_handle(lines, old_line_idx);
+            if (handle < 0) {
+                continue;
+            }
+
+            Instruction* record = instruction_table_get(handle);
+            const bool is_marked = is_in_region && region.is_marked[line_idx - first_line];
+            is_draft = is_marked || instruction_references_retired(record);
+
+            if (is_draft == false) {
+                instruction = record;
+            } else {
+                if (is_marked == false) {
+                    retire_record(handle, &old_sub_handles, &is_binding_changed);
+                    num_retired++;
+                }
+
+                instruction = parse_patch_line(edited_lines, line_idx);
+
+                // Past the region, the lines nested under the line are unchanged and are not parsed again.
+                for (int idx = instruction_get_num_listed_sub_instructions(record);
+                     is_in_region == false && idx < instruction_get_num_sub_instructions(record); idx++) {
+                    Instruction* sub_instruction = instruction_get_linked_sub_instruction(record, idx);
+                    instruction_add_sub_instruction(instruction, instruction_get_id(sub_instruction));
+                }
+            }
+        }
+
+        if (instruction == NULL || (is_draft == false && is_in_region == false)) {
+            continue;
+        }
+
+        if (is_draft) {
+            is_binding_changed |= is_binding(instruction);
+            handle_list_push(&handles, handle);
+        }
+
+        if (is_in_region) {
+            instructions[line_idx - first_line] = instruction;
+            draft_idxs[line_idx - first_line] = is_draft ? handles.size - 1 : -1;
+
+            // An unchanged line is listed again by a parent that is parsed again.
+            const int parent = region.new_parents[line_idx - first_line];
+            assert(parent < 0 || instructions[parent - first_line] != NULL,
+                   "Instruction %s (line %d) is nested under a line without an instruction.",
+                   instruction_get_id(instruction), line_idx + 1);
+
+            if (parent >= 0 && draft_idxs[parent - first_line] >= 0) {
+                instruction_add_sub_instruction(instructions[parent - first_line], instruction_get_id(instruction));
+            }
+        }
+    }
+
+    // Drafts are freed once the patch is committed, so whatever is needed of them is taken first.
+    bool* is_body = (bool*) calloc(region.num_new_lines > 0 ? region.num_new_lines : 1, sizeof(bool));
+    int* region_handles = (int*) malloc(sizeof(int) * (region.num_new_lines > 0 ? region.num_new_lines : 1));
+    assert(is_body != NULL && region_handles != NULL, "Failed to allocate memory for patching script %s.",
+           runtime->script_name);
+
+    int num_body_handles = 0;
+    for (int idx = 0; idx < region.num_new_lines; idx++) {
+        Instruction* instruction = instructions[idx];
+        region_handles[idx] = instruction != NULL && draft_idxs[idx] < 0 ? instruction_get_handle(instruction) : -1;
+
+        is_body[idx] = instruction != NULL && region.new_parents[idx] == -1 &&
+                       instruction_type_is_transaction(instruction_get_type(instruction)) &&
+                       is_binding(instruction) == false;
+        num_body_handles += is_body[idx];
+    }
+
+    const int num_drafts = instruction_map_get_num_drafts();
+    assert(num_drafts == handles.size, "Patch of script %s has %d drafts for %d instructions.", runtime->script_name,
+           num_drafts, handles.size);
+
+    bool* is_changed = (bool*) malloc(sizeof(bool) * (num_drafts > 0 ? num_drafts : 1));
+    int* removed_handles = (int*) malloc(sizeof(int) * (num_retired > 0 ? num_retired : 1));
+    assert(is_changed != NULL && removed_handles != NULL, "Failed to allocate memory for patching script %s.",
+           runtime->script_name);
+
+    const int num_removed = instruction_map_commit_patch(handles.handles, is_changed, removed_handles);
+    const int num_instructions = instruction_table_get_size();
+
+    for (int idx = 0; idx < region.num_new_lines; idx++) {
+        if (instructions[idx] != NULL && draft_idxs[idx] >= 0) {
+            region_handles[idx] = handles.handles[draft_idxs[idx]];
+        }
+    }
+
+    // The body keeps every top-level instruction outside of the region as it is.
+    const int num_kept_handles = runtime->num_execution_handles - (end_execution_idx - first_execution_idx);
+    const int num_execution_handles = num_kept_handles + num_body_handles;
+    int* execution_handles = (int*) malloc(sizeof(int) * (num_execution_handles > 0 ? num_execution_handles : 1));
+    int* reference_counts = (int*) malloc(sizeof(int) * (num_instructions > 0 ? num_instructions : 1));
+    assert(execution_handles != NULL && reference_counts != NULL, "Failed to allocate memory for patching script %s.",
+           runtime->script_name);
+
+    int num_copied = first_execution_idx;
+    memcpy(execution_handles, runtime->execution_handles, sizeof(int) * first_execution_idx);
+
+    for (int idx = 0; idx < region.num_new_lines; idx++) {
+        if (is_body[idx]) {
+            execution_handles[num_copied++] = region_handles[idx];
+        }
+    }
+
+    memcpy(execution_handles + num_copied, runtime->execution_handles + end_execution_idx,
+           sizeof(int) * (runtime->num_execution_handles - end_execution_idx));
+
+    op_stream_count_references(execution_handles, num_execution_handles, reference_counts);
+
+    // A removed instruction that is still referenced was referenced by an unchanged line, so the script no longer
+    // compiles.
+    for (int idx = 0; idx < num_removed; idx++) {
+        const int removed_handle = removed_handles[idx];
+        for (int handle = 0; reference_counts[removed_handle] > 0 && handle < num_instructions; handle++) {
+            Instruction* instruction = instruction_table_get(handle);
+
+            for (int sub_idx = 0; sub_idx < instruction_get_num_sub_instructions(instruction); sub_idx++) {
+                assert(instruction_get_sub_instruction_handle(instruction, sub_idx) != removed_handle,
+                       "Instruction %s (line %d) references undefined instruction %s.", instruction_get_id(instruction),
+                       instruction_get_line_number(instruction),
+                       instruction_get_id(instruction_table_get(removed_handle)));
+            }
+        }
+    }
+
+    // The streams to compile again: those of the changed records, and those of the records that were listed by a record
+    // the patch wrote over or are referenced more or less often than before, which may be inlined now or no longer be.
+    HandleList changed_handles = { .handles = NULL, .size = 0, .capacity = 0 };
+    HandleList stream_handles = { .handles = NULL, .size = 0, .capacity = 0 };
+
+    for (int draft_idx = 0; draft_idx < num_drafts; draft_idx++) {
+        if (is_changed[draft_idx]) {
+            handle_list_push(&changed_handles, handles.handles[draft_idx]);
+            handle_list_push(&stream_handles, handles.handles[draft_idx]);
+        }
+    }
+
+    for (int idx = 0; idx < old_sub_handles.size; idx++) {
+        if (instruction_get_type(instruction_table_get(old_sub_handles.handles[idx])) != NONE) {
+            handle_list_push(&stream_handles, old_sub_handles.handles[idx]);
+        }
+    }
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        const int old_count = handle < old_num_instructions ? runtime->reference_counts[handle] : 0;
+        if (reference_counts[handle] != old_count &&
+            instruction_get_type(instruction_table_get(handle)) != NONE) {
+            handle_list_push(&stream_handles, handle);
+        }
+    }
+
+    for (int idx = 0; idx < num_removed; idx++) {
+        handle_list_push(&changed_handles, removed_handles[idx]);
+    }
+
+    free(runtime->reference_counts);
+    runtime->reference_counts = reference_counts;
+    op_stream_recompile(stream_handles.handles, stream_handles.size, reference_counts);
+
+    runtime_rebuild_schedulers(changed_handles.handles, changed_handles.size);
+    scheduler_relink(changed_handles.handles, changed_handles.size, execution_handles, num_execution_handles);
+    scheduler_resume(resume_time);
+
+    free(runtime->execution_handles);
+    runtime->execution_handles = execution_handles;
+    runtime->num_execution_handles = num_execution_handles;
+
+    for (int line_idx = 0; line_idx < num_edited_lines; line_idx++) {
+        const int old_line_idx = get_old_line(edit, line_idx);
+        const int handle = old_line_idx >= 0 ? script_lines_get_handle(lines, old_line_idx)
+                                             : region_handles[line_idx - first_line];
+        script_lines_set_handle(edited_lines, line_idx, handle);
+    }
+
+    script_lines_delete(&runtime->lines);
+    runtime->lines = edited_lines;
+
+    if (timing_is_open()) {
+        for (int draft_idx = 0; draft_idx < num_drafts; draft_idx++) {
+            const int handle = handles.handles[draft_idx];
+            timing_name_instruction(runtime->channel, handle, instruction_get_id(instruction_table_get(handle)));
+        }
+    }
+
+    if (metrics_is_open()) {
+        if (num_instructions > old_num_instructions) {
+            runtime_attach_metrics(runtime);
+        } else {
+            for (int draft_idx = 0; draft_idx < num_drafts; draft_idx++) {
+                Instruction* instruction = instruction_table_get(handles.handles[draft_idx]);
+                metrics_name_entry(runtime->channel, handles.handles[draft_idx], instruction_get_id(instruction),
+                                   InstructionTypeLookupArray[instruction_get_type(instruction)]);
+            }
+        }
+    }
+
+    if (hotkeys_is_listening() && is_binding_changed) {
+        hotkeys_unbind(runtime->channel);
+        runtime->is_armed = false;
+        runtime->is_toggled = false;
+        runtime_bind_hotkeys(runtime);
+    }
+
+    free(changed_handles.handles);
+    free(stream_handles.handles);
+    free(removed_handles);
+    free(is_changed);
+    free(region_handles);
+    free(is_body);
+    free(handles.handles);
+    free(draft_idxs);
+    free(instructions);
+    free(old_transactions.handles);
+    free(old_sub_handles.handles);
+    free(region.old_parents);
+    free(region.new_parents);
+    free(region.is_marked);
+
+    fprintf(stderr, "Reloaded %s.\n", runtime->script_name);
+}
+
+/**
+ * Steps every scheduler entry due at or before the horizon at its own deadline and hands every resulting stroke due
+ * before the horizon to the emitter. Returns the next deadline of the script, or -1 once nothing is left scheduled and
+ * every stroke has been handed off, at which point the script's emitter channel is closed. A runtime with a sink never
+ * touches the emitter.
+ *
+ * @param runtime
+ * @param horizon
+ * @return
+ */
+time_t runtime_step(Runtime* runtime, time_t horizon) {
+    runtime_bind(runtime);
+
+    scheduler_tick(horizon);
+    runtime->horizon = horizon;
+
+    // The last pass of the suspended script has finished, so the edit can be patched in.
+    if (runtime->edited_lines != NULL && scheduler_get_next_deadline() < 0) {
+        runtime_patch(runtime, horizon);
+    }
+
+    output_flush(horizon);
+
+    // Every remaining entry and stroke is due at or after the next deadline, so nothing earlier can follow.
+    const time_t next_deadline = time_get_earliest_deadline(scheduler_get_next_deadline(), output_get_next_deadline());
+    if (runtime->sink != NULL) {
+        return next_deadline;
+    }
+
+    if (next_deadline < 0) {
+        emitter_close_channel(runtime->channel);
+        runtime->is_channel_closed = true;
+    } else {
+        emitter_promise(runtime->channel, next_deadline);
+    }
+
+    return next_deadline;
+}
+
+/**
+ * Checks whether the script file has changed since it was last read, and patches the edit into the running script if
+ * so, keeping its state (see the top of this file). The edited file is read at once, but is only patched in once every
+ * pass in flight has finished, which is at most one pass later; an edit made in the meantime replaces it. A change that
+ * leaves the source as it was does nothing. Returns the next deadline of the script, as runtime_step does.
+ *
+ * An edit that no longer compiles stops the program, as it would at startup.
+ *
+ * @param runtime
+ * @param current_time
+ * @return
+ */
+time_t runtime_watch(Runtime* runtime, time_t current_time) {
+    runtime_bind(runtime);
+
+    time_t mtime = 0;
+    long long size = 0;
+    const bool is_changed = get_source_signature(runtime->script_name, &mtime, &size) &&
+                            (mtime != runtime->source_mtime || size != runtime->source_size);
+
+    if (is_changed) {
+        runtime->source_mtime = mtime;
+        runtime->source_size = size;
+
+        ScriptSource* source = script_source_new(runtime->script_name);
+        ScriptLines* edited_lines = script_lines_new(source);
+        script_source_delete(&source);
+
+        const bool is_pending = runtime->edited_lines != NULL;
+        if (is_pending) {
+            script_lines_delete(&runtime->edited_lines);
+        }
+
+        if (is_pending == false && script_lines_get_hash(edited_lines) == script_lines_get_hash(runtime->lines)) {
+            script_lines_delete(&edited_lines);
+        } else {
+            runtime->edited_lines = edited_lines;
+        }
+
+        if (is_pending == false && runtime->edited_lines != NULL) {
+            scheduler_suspend(current_time);
+        }
+    }
+
+    if (runtime->edited_lines != NULL && scheduler_get_next_deadline() < 0) {
+        runtime_patch(runtime, runtime->horizon);
+    }
+
+    return time_get_earliest_deadline(scheduler_get_next_deadline(), output_get_next_deadline());
+}
+
+/**
+ * Writes what every instruction of the script sent to the runtime's sink over the given duration (us), one JSON line
+ * per instruction that sent a stroke: how many keys it pressed and released, its actions (key downs) per minute and the
+ * shortest gap between two of its key downs. For a key whose passes never repeat, consecutive key downs belong to
+ * separate executions, so that gap can never be shorter than the lower bound of the key's cooldown; whether it was is
+ * reported as cooldown_respected.
+ *
+ * @param runtime
+ * @param file
+ * @param str_script_name
+ * @param duration_us
+ */
+void runtime_print_sink_report(Runtime* runtime, FILE* file, const char* str_script_name, time_t duration_us) {
+    assert(runtime != NULL, "Attempting to report NULL runtime.");
+    assert(runtime->sink != NULL, "Attempting to report runtime without a sink.");
+
+    runtime_bind(runtime);
+
+    const double duration_minutes = (double) duration_us / (60.0 * 1000000.0);
+    const int num_instructions = instruction_table_get_size();
+
+    for (int handle = 0; handle < num_instructions; handle++) {
+        NullSinkSummary summary;
+        if (null_sink_get_summary(runtime->sink, handle, &summary) == false) {
+            continue;
+        }
+
+        Instruction* instruction = instruction_table_get(handle);
+        const int cooldown_ms = instruction_get_parameter_lower_value(instruction, COOLDOWN);
+        const time_t cooldown_us = (time_t) cooldown_ms * CLOCK_US_PER_MS;
+        const bool is_cooldown_checked = instruction_get_type(instruction) == KEY &&
+                                         instruction_get_parameter_upper_value(instruction, REPEAT) == 0 &&
+                                         summary.min_down_gap >= 0;
+
+        fprintf(file, "{\"script\": \"%s\", \"handle\": %d, \"instruction\": \"%s\", \"key_downs\": %lld, "
+                      "\"key_ups\": %lld, \"apm\": %.2f, \"min_down_gap_us\": %lld, \"cooldown_us\": %lld, "
+                      "\"cooldown_respected\": %s}\n",
+                str_script_name, handle, instruction_get_id(instruction), summary.num_key_downs, summary.num_key_ups,
+                duration_minutes > 0 ? (double) summary.num_key_downs / duration_minutes : 0.0,
+                (long long) summary.min_down_gap, (long long) cooldown_us,
+                is_cooldown_checked ? (summary.min_down_gap >= cooldown_us ? "true" : "false") : "null");
+    }
+}
+
+/**
+ * Analyzes the compiled script without running it and writes the report to the file (see analyzer.c). The runtime
+ * does not need to be attached.
+ *
+ * @param runtime
+ * @param file
+ */
+void runtime_print_analysis(Runtime* runtime, FILE* file) {
+    assert(runtime != NULL, "Attempting to analyze NULL runtime.");
+
+    runtime_bind(runtime);
+    analyzer_print_report(file, runtime->script_name, runtime->execution_handles, runtime->num_execution_handles);
+}
+
+void runtime_print(Runtime* runtime) {
+    runtime_bind(runtime);
+
+    instruction_map_print();
+
+    printf("[");
+    for (int idx = 0; idx < runtime->num_execution_handles; idx++) {
+        printf(idx > 0 ? ", %s" : "%s", instruction_get_id(instruction_table_get(runtime->execution_handles[idx])));
+    }
+    printf("]");
+}
@@ -2,17 +2,60 @@
 #ifndef BEANSCRIPT_RUNTIME_H
 #define BEANSCRIPT_RUNTIME_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
+#include "keyboard/emitter.h"
+#include "keyboard/hotkeys.h"
+#include "keyboard/null_sink.h"
+#include "keyboard/output.h"
+#include "keyboard/timing.h"
 #include "parser/instruction.h"
+#include "parser/op_stream.h"
 #include "parser/parser.h"
+#include "parser/script_image.h"
+#include "parser/script_lines.h"
+#include "parser/script_source.h"
+#include "scheduler/random.h"
+#include "scheduler/routine.h"
+#include "scheduler/analyzer.h"
+#include "scheduler/metrics.h"
+#include "scheduler/scheduler.h"
+#include "scheduler/waitlist.h"
+#include "utility/rng.h"
 #include "utility/str_list.h"
 
-void runtime_prepare(const char* str_script_name);
-void runtime_delete();
-void runtime_start();
-void runtime_print();
+typedef struct RuntimeStruct Runtime;
+
+// Constructor and Destructor
+Runtime*    runtime_new(const char* str_script_name, int channel, uint64_t seed);
+Runtime*    runtime_load(const char* str_script_name);
+Runtime*    runtime_try_load(const char* str_script_name, char* str_error, size_t error_size);
+void        runtime_delete(Runtime** ptr_runtime);
+void        runtime_bind(Runtime* runtime);
+
+// Mutator Functions
+void        runtime_attach(Runtime* runtime, int channel, uint64_t seed);
+void        runtime_set_sink(Runtime* runtime, NullSink* sink);
+
+// Accessor Functions
+bool        runtime_is_armed(Runtime* runtime);
+bool        runtime_is_current(Runtime* runtime);
+const char* runtime_get_script_name(Runtime* runtime);
+
+// Executors
+time_t      runtime_start(Runtime* runtime, time_t start_time);
+time_t      runtime_handle_hotkeys(Runtime* runtime, time_t current_time);
+time_t      runtime_step(Runtime* runtime, time_t horizon);
+time_t      runtime_watch(Runtime* runtime, time_t current_time);
+
+void        runtime_print(Runtime* runtime);
+void        runtime_print_analysis(Runtime* runtime, FILE* file);
+void        runtime_print_sink_report(Runtime* runtime, FILE* file, const char* str_script_name, time_t duration_us);
 
 
 #endif //BEANSCRIPT_RUNTIME_H
@@ -0,0 +1,523 @@
+/**
+ * @file runtime_pool.c
+ *
+ * Runs several scripts at once. Each script gets its own runtime and its own emitter channel; the scripts are dealt
+ * round-robin to a fixed number of worker threads, and every worker multiplexes its runtimes: it sleeps until shortly
+ * before the earliest deadline of any of them and steps each runtime that is due. All workers feed the one emitter
+ * thread, which merges their strokes.
+ *
+ * Workers work ahead of their deadlines by a fixed lookahead. Strokes reach the emitter early and the emitter sends them
+ * at their exact due time, so a worker only has to wake within the lookahead of its deadline and never spins.
+ *
+ * While buttons are listened for (see hotkeys.c), a worker sleeps on a wake event instead, so a button press wakes it
+ * at once. A worker with armed scripts keeps waiting for their buttons after they run out of work, until the panic
+ * button is pressed.
+ *
+ * While a pool runs, the process and its threads are scheduled as the pool and the script headers ask, e.g. with a
+ * finer system timer or with the emitter and the workers pinned to their own cores (see tuning.c).
+ *
+ * While metrics are published (see metrics.c), every worker also times each step of its runtimes and how late it began
+ * the step, i.e. how far past the runtime's deadline it woke.
+ *
+ * A pool can also watch its scripts (runtime_pool_set_watch_period). Every worker then also wakes once per watch period
+ * to check whether any of its script files changed, and reloads the changed scripts in place (see runtime_watch).
+ *
+ * A pool can also simulate its scripts (runtime_pool_simulate). Nothing in a runtime reads the clock, so the simulation
+ * is the same multiplexing loop driven by a virtual clock instead: time starts at zero and jumps straight to the next
+ * deadline rather than sleeping until it, and strokes go to a null sink per script rather than the emitter. A script
+ * that would type for hours runs in as long as its scheduling takes.
+ */
+
+#include "runtime_pool.h"
+
+#ifdef _WIN32
+    static const time_t RUNTIME_POOL_LOOKAHEAD_US = 20000;
+#else
+    static const time_t RUNTIME_POOL_LOOKAHEAD_US = 5000;
+#endif
+
+static const int RUNTIME_POOL_EMITTER_CAPACITY = 1024;
+
+/**
+ * @brief The scripts a pool runs.
+ * - script_names: One runtime is created per script; the ith script is sent on emitter channel i.
+ * - loaded: The runtime of the ith script if it was compiled ahead of time (see runtime_pool_add_runtime), or NULL if
+ *   it is compiled by its worker. A loaded runtime is owned by the pool until its worker takes it.
+ * - num_workers: The most threads the scripts are spread over.
+ * - timing_path: Where the timing of sent strokes is dumped, or NULL if strokes are not timed.
+ * - metrics_path: Where the live metrics of the schedulers are published, or NULL if they are not.
+ * - seed: The ith script is seeded with seed + i.
+ * - panic_keycode: The button that stops every script at once, or 0 for none.
+ * - watch_period: How often (us) the script files are checked for changes, or 0 if they are not watched.
+ * - tuning: How the process and its threads are scheduled while the pool runs. Settings it leaves unset are taken from
+ *   the script headers (see runtime_pool_run).
+ */
+struct RuntimePoolStruct {
+    StrList* script_names;
+    Runtime** loaded;
+    int loaded_capacity;
+    int num_workers;
+    const char* timing_path;
+    const char* metrics_path;
+    uint64_t seed;
+    unsigned short panic_keycode;
+    time_t watch_period;
+    TuningConfig tuning;
+};
+
+/**
+ * @brief One worker thread and the scripts dealt to it.
+ * - worker_idx: The worker runs every script whose index is worker_idx modulo num_workers.
+ */
+typedef struct {
+    RuntimePool* pool;
+    int worker_idx;
+    int num_workers;
+    pthread_t thread;
+} RuntimePoolWorker;
+
+RuntimePool* runtime_pool_new(int num_workers) {
+    assert(num_workers > 0, "Attempting to create runtime pool with %d workers.", num_workers);
+
+    RuntimePool* pool = (RuntimePool*) malloc(sizeof(RuntimePool));
+    assert(pool != NULL, "Failed to allocate memory for runtime pool.");
+
+    pool->script_names = str_list_new(1, true);
+    pool->loaded = NULL;
+    pool->loaded_capacity = 0;
+    pool->num_workers = num_workers;
+    pool->timing_path = NULL;
+    pool->metrics_path = NULL;
+    pool->seed = rng_generate_seed();
+    pool->panic_keycode = 0;
+    pool->watch_period = 0;
+    tuning_config_init(&pool->tuning);
+
+    return pool;
+}
+
+void runtime_pool_delete(RuntimePool** ptr_pool) {
+    assert(ptr_pool != NULL, "Attempting to delete runtime pool behind NULL pointer.");
+    assert(*ptr_pool != NULL, "Attempting to delete NULL runtime pool.");
+
+    RuntimePool* pool = *ptr_pool;
+
+    // Runtimes that were added but never run.
+    const int num_scripts = str_list_get_size(pool->script_names);
+    for (int idx = 0; idx < num_scripts; idx++) {
+        if (pool->loaded[idx] != NULL) {
+            runtime_delete(&pool->loaded[idx]);
+        }
+    }
+
+    str_list_delete(&pool->script_names);
+    free(pool->loaded);
+
+    free(pool);
+    *ptr_pool = NULL;
+}
+
+/**
+ * Makes room for the entry of one more script and returns its index.
+ */
+static int runtime_pool_push_script(RuntimePool* pool, const char* str_script_name, Runtime* runtime) {
+    const int script_idx = str_list_get_size(pool->script_names);
+    if (script_idx == pool->loaded_capacity) {
+        pool->loaded_capacity = pool->loaded_capacity > 0 ? 2 * pool->loaded_capacity : 4;
+        pool->loaded = (Runtime**) realloc(pool->loaded, sizeof(Runtime*) * pool->loaded_capacity);
+        assert(pool->loaded != NULL, "Failed to allocate memory for loaded runtimes.");
+    }
+
+    str_list_insert_str(pool->script_names, (char*) str_script_name);
+    pool->loaded[script_idx] = runtime;
+
+    return script_idx;
+}
+
+void runtime_pool_add_script(RuntimePool* pool, const char* str_script_name) {
+    assert(pool != NULL, "Attempting to add script to NULL runtime pool.");
+    assert(str_script_name != NULL, "Attempting to add NULL script to runtime pool.");
+
+    runtime_pool_push_script(pool, str_script_name, NULL);
+}
+
+/**
+ * Adds a script that was compiled ahead of time (see runtime_load). The pool takes ownership of the runtime and
+ * attaches it to the script's channel when it runs, instead of compiling the script again.
+ *
+ * @param pool
+ * @param runtime
+ */
+void runtime_pool_add_runtime(RuntimePool* pool, Runtime* runtime) {
+    assert(pool != NULL, "Attempting to add runtime to NULL runtime pool.");
+    assert(runtime != NULL, "Attempting to add NULL runtime to runtime pool.");
+
+    runtime_pool_push_script(pool, runtime_get_script_name(runtime), runtime);
+}
+
+/**
+ * Returns the runtime of the given script, attached to the script's channel: the runtime it was added with, or a
+ * newly compiled one.
+ */
+static Runtime* runtime_pool_take_runtime(RuntimePool* pool, int script_idx) {
+    const uint64_t seed = pool->seed + (uint64_t) script_idx;
+
+    Runtime* runtime = pool->loaded[script_idx];
+    if (runtime == NULL) {
+        return runtime_new(str_list_get_str(pool->script_names, script_idx), script_idx, seed);
+    }
+
+    pool->loaded[script_idx] = NULL;
+    runtime_attach(runtime, script_idx, seed);
+
+    return runtime;
+}
+
+/**
+ * Times every stroke the pool sends and dumps the timing histograms to the given file when the pool finishes (see
+ * timing.c). The path is not copied. May be NULL to stop timing.
+ *
+ * @param pool
+ * @param str_dump_path
+ */
+void runtime_pool_set_timing_path(RuntimePool* pool, const char* str_dump_path) {
+    assert(pool != NULL, "Attempting to set timing path of NULL runtime pool.");
+
+    pool->timing_path = str_dump_path;
+}
+
+/**
+ * Publishes the live metrics of the schedulers to the given file while the pool runs (see metrics.c). The path is not
+ * copied. May be NULL to stop publishing.
+ *
+ * @param pool
+ * @param str_metrics_path
+ */
+void runtime_pool_set_metrics_path(RuntimePool* pool, const char* str_metrics_path) {
+    assert(pool != NULL, "Attempting to set metrics path of NULL runtime pool.");
+
+    pool->metrics_path = str_metrics_path;
+}
+
+/**
+ * Seeds the random choices of every script in the pool. Running the same scripts with the same seed repeats every
+ * choice they make. Without a seed, a different one is generated for every pool.
+ *
+ * @param pool
+ * @param seed
+ */
+void runtime_pool_set_seed(RuntimePool* pool, uint64_t seed) {
+    assert(pool != NULL, "Attempting to set seed of NULL runtime pool.");
+
+    pool->seed = seed;
+}
+
+/**
+ * Makes the given button stop every script of the pool at once when pressed: nothing more is typed and every held key
+ * is released (see hotkeys_panic). Only has an effect where buttons are listened for. May be 0 for no panic button.
+ *
+ * @param pool
+ * @param keycode
+ */
+void runtime_pool_set_panic_button(RuntimePool* pool, unsigned short keycode) {
+    assert(pool != NULL, "Attempting to set panic button of NULL runtime pool.");
+
+    pool->panic_keycode = keycode;
+}
+
+/**
+ * Reloads every script of the pool whose file changes while it runs, keeping the state of the script (see runtime.c).
+ * The files are checked for changes every given period (us). May be 0 to stop watching.
+ *
+ * @param pool
+ * @param period_us
+ */
+void runtime_pool_set_watch_period(RuntimePool* pool, time_t period_us) {
+    assert(pool != NULL, "Attempting to set watch period of NULL runtime pool.");
+    assert(period_us >= 0, "Attempting to set negative watch period %lld us.", (long long) period_us);
+
+    pool->watch_period = period_us;
+}
+
+/**
+ * Sets how the process and the threads of the pool are scheduled while it runs (see tuning.h). Settings the given
+ * configuration leaves unset are taken from the headers of the scripts. The configuration is copied.
+ *
+ * @param pool
+ * @param tuning_config
+ */
+void runtime_pool_set_tuning(RuntimePool* pool, const TuningConfig* tuning_config) {
+    assert(pool != NULL, "Attempting to set tuning of NULL runtime pool.");
+    assert(tuning_config != NULL, "Attempting to set NULL tuning of runtime pool.");
+
+    pool->tuning = *tuning_config;
+}
+
+/**
+ * Returns the seed the scripts of the pool are run with.
+ *
+ * @param pool
+ * @return
+ */
+uint64_t runtime_pool_get_seed(RuntimePool* pool) {
+    assert(pool != NULL, "Attempting to get seed of NULL runtime pool.");
+
+    return pool->seed;
+}
+
+/**
+ * Steps the runtime of the script sent on the given channel, counting how long the step took and how late it began if
+ * metrics are published. Returns the next deadline of the runtime, as runtime_step does.
+ */
+static time_t runtime_pool_step(Runtime* runtime, int channel, time_t deadline, time_t horizon) {
+    if (metrics_is_open() == false) {
+        return runtime_step(runtime, horizon);
+    }
+
+    const time_t start_time = clock_get_time_us();
+    const time_t next_deadline = runtime_step(runtime, horizon);
+    metrics_record_tick(channel, clock_get_time_us() - start_time, start_time - deadline);
+
+    return next_deadline;
+}
+
+/**
+ * Compiles and runs every script dealt to the worker until all of them have finished.
+ */
+static void* runtime_pool_work(void* argument) {
+    const RuntimePoolWorker* worker = (const RuntimePoolWorker*) argument;
+    tuning_tune_worker_thread(worker->worker_idx);
+
+    StrList* script_names = worker->pool->script_names;
+    const int num_scripts = str_list_get_size(script_names);
+
+    const int max_runtimes = (num_scripts - worker->worker_idx + worker->num_workers - 1) / worker->num_workers;
+    Runtime** runtimes = (Runtime**) malloc(sizeof(Runtime*) * max_runtimes);
+    time_t* deadlines = (time_t*) malloc(sizeof(time_t) * max_runtimes);
+    assert(runtimes != NULL && deadlines != NULL, "Failed to allocate memory for worker runtimes.");
+
+    WakeEvent* wake_event = hotkeys_is_listening() ? wake_event_new() : NULL;
+    int num_armed = 0;
+
+    int num_runtimes = 0;
+    for (int script_idx = worker->worker_idx; script_idx < num_scripts; script_idx += worker->num_workers) {
+        runtimes[num_runtimes] = runtime_pool_take_runtime(worker->pool, script_idx);
+        num_armed += runtime_is_armed(runtimes[num_runtimes]) ? 1 : 0;
+        num_runtimes++;
+
+        if (wake_event != NULL) {
+            hotkeys_set_wake_event(script_idx, wake_event);
+        }
+    }
+
+    const time_t start_time = clock_get_time_us();
+    const time_t watch_period = worker->pool->watch_period;
+    time_t next_watch_time = watch_period > 0 ? start_time + watch_period : -1;
+    time_t next_deadline = -1;
+    for (int idx = 0; idx < num_runtimes; idx++) {
+        deadlines[idx] = runtime_start(runtimes[idx], start_time);
+        next_deadline = time_get_earliest_deadline(next_deadline, deadlines[idx]);
+    }
+
+    while ((next_deadline >= 0 || num_armed > 0) && hotkeys_is_panicked() == false) {
+        time_t wake_time = next_deadline >= 0 ? next_deadline - RUNTIME_POOL_LOOKAHEAD_US : -1;
+        wake_time = time_get_earliest_deadline(wake_time, next_watch_time);
+
+        bool is_pressed = false;
+        if (wake_event != NULL) {
+            is_pressed = wake_event_wait_until_us(wake_event, wake_time);
+        } else {
+            clock_sleep_until_us(wake_time);
+        }
+
+        if (hotkeys_is_panicked()) {
+            break;
+        }
+
+        const time_t current_time = clock_get_time_us();
+        const time_t horizon = current_time + RUNTIME_POOL_LOOKAHEAD_US;
+        next_deadline = -1;
+
+        const bool is_watching = next_watch_time >= 0 && current_time >= next_watch_time;
+        if (is_watching) {
+            next_watch_time = current_time + watch_period;
+            num_armed = 0;
+        }
+
+        for (int idx = 0; idx < num_runtimes; idx++) {
+            if (is_watching) {
+                deadlines[idx] = runtime_watch(runtimes[idx], current_time);
+                num_armed += runtime_is_armed(runtimes[idx]) ? 1 : 0;
+            }
+
+            if (is_pressed) {
+                deadlines[idx] = runtime_handle_hotkeys(runtimes[idx], current_time);
+            }
+
+            if (deadlines[idx] >= 0 && deadlines[idx] <= horizon) {
+                const int channel = worker->worker_idx + idx * worker->num_workers;
+                deadlines[idx] = runtime_pool_step(runtimes[idx], channel, deadlines[idx], horizon);
+            }
+
+            next_deadline = time_get_earliest_deadline(next_deadline, deadlines[idx]);
+        }
+    }
+
+    if (wake_event != NULL) {
+        for (int script_idx = worker->worker_idx; script_idx < num_scripts; script_idx += worker->num_workers) {
+            hotkeys_set_wake_event(script_idx, NULL);
+        }
+
+        wake_event_delete(&wake_event);
+    }
+
+    for (int idx = 0; idx < num_runtimes; idx++) {
+        runtime_delete(&runtimes[idx]);
+    }
+
+    free(runtimes);
+    free(deadlines);
+
+    tuning_release_thread();
+    return NULL;
+}
+
+/**
+ * Runs every script in the pool on a virtual clock for the given duration (us) of virtual time, on the calling thread
+ * and without sending any stroke, then writes what each instruction would have sent to the given file (see
+ * runtime_print_sink_report). How much faster than real time the simulation ran is written to stderr.
+ *
+ * @param pool
+ * @param duration_us
+ * @param file
+ */
+void runtime_pool_simulate(RuntimePool* pool, time_t duration_us, FILE* file) {
+    assert(pool != NULL, "Attempting to simulate NULL runtime pool.");
+    assert(duration_us > 0, "Attempting to simulate runtime pool for %lld us.", (long long) duration_us);
+
+    const int num_scripts = str_list_get_size(pool->script_names);
+    if (num_scripts == 0) {
+        return;
+    }
+
+    Runtime** runtimes = (Runtime**) malloc(sizeof(Runtime*) * num_scripts);
+    NullSink** sinks = (NullSink**) malloc(sizeof(NullSink*) * num_scripts);
+    time_t* deadlines = (time_t*) malloc(sizeof(time_t) * num_scripts);
+    assert(runtimes != NULL && sinks != NULL && deadlines != NULL, "Failed to allocate memory for simulated runtimes.");
+
+    for (int idx = 0; idx < num_scripts; idx++) {
+        runtimes[idx] = runtime_pool_take_runtime(pool, idx);
+        sinks[idx] = null_sink_new();
+        runtime_set_sink(runtimes[idx], sinks[idx]);
+    }
+
+    const time_t wall_start_time = clock_get_time_us();
+
+    time_t next_deadline = -1;
+    for (int idx = 0; idx < num_scripts; idx++) {
+        deadlines[idx] = runtime_start(runtimes[idx], 0);
+        next_deadline = time_get_earliest_deadline(next_deadline, deadlines[idx]);
+    }
+
+    while (next_deadline >= 0 && next_deadline <= duration_us) {
+        const time_t horizon = next_deadline;
+        next_deadline = -1;
+
+        for (int idx = 0; idx < num_scripts; idx++) {
+            if (deadlines[idx] >= 0 && deadlines[idx] <= horizon) {
+                deadlines[idx] = runtime_step(runtimes[idx], horizon);
+            }
+
+            next_deadline = time_get_earliest_deadline(next_deadline, deadlines[idx]);
+        }
+    }
+
+    const time_t wall_time_us = clock_get_time_us() - wall_start_time;
+    long long num_strokes = 0;
+
+    for (int idx = 0; idx < num_scripts; idx++) {
+        runtime_print_sink_report(runtimes[idx], file, str_list_get_str(pool->script_names, idx), duration_us);
+        num_strokes += null_sink_get_num_strokes(sinks[idx]);
+
+        runtime_delete(&runtimes[idx]);
+        null_sink_delete(&sinks[idx]);
+    }
+
+    fprintf(stderr, "Simulated %.3f s with %lld strokes in %.3f s (%.0fx real time).\n",
+            (double) duration_us / 1000000.0, num_strokes, (double) wall_time_us / 1000000.0,
+            (double) duration_us / (double) (wall_time_us > 0 ? wall_time_us : 1));
+
+    free(runtimes);
+    free(sinks);
+    free(deadlines);
+}
+
+/**
+ * Runs every script in the pool until all of them have finished and every stroke has been sent, or until the panic
+ * button is pressed. The first worker runs on the calling thread.
+ *
+ * @param pool
+ */
+void runtime_pool_run(RuntimePool* pool) {
+    assert(pool != NULL, "Attempting to run NULL runtime pool.");
+
+    const int num_scripts = str_list_get_size(pool->script_names);
+    if (num_scripts == 0) {
+        return;
+    }
+
+    const int num_workers = pool->num_workers < num_scripts ? pool->num_workers : num_scripts;
+    RuntimePoolWorker* workers = (RuntimePoolWorker*) malloc(sizeof(RuntimePoolWorker) * num_workers);
+    assert(workers != NULL, "Failed to allocate memory for runtime pool workers.");
+
+    // The first script header that holds a setting decides it, unless the pool sets it.
+    TuningConfig tuning = pool->tuning;
+    for (int idx = 0; idx < num_scripts; idx++) {
+        ScriptHeader* header = script_header_read(str_list_get_str(pool->script_names, idx));
+        if (header != NULL) {
+            tuning_config_merge(&tuning, script_header_get_tuning(header));
+            script_header_delete(&header);
+        }
+    }
+
+    tuning_open(&tuning);
+
+    if (pool->timing_path != NULL) {
+        timing_open(num_scripts, pool->timing_path);
+    }
+
+    if (pool->metrics_path != NULL) {
+        metrics_open(num_scripts, pool->metrics_path);
+    }
+
+    emitter_open(num_scripts, RUNTIME_POOL_EMITTER_CAPACITY);
+    hotkeys_open(num_scripts, pool->panic_keycode);
+
+    for (int worker_idx = 0; worker_idx < num_workers; worker_idx++) {
+        workers[worker_idx] = (RuntimePoolWorker) {
+            .pool = pool,
+            .worker_idx = worker_idx,
+            .num_workers = num_workers,
+        };
+
+        if (worker_idx == 0) {
+            continue;
+        }
+
+        const int result = pthread_create(&workers[worker_idx].thread, NULL, runtime_pool_work, &workers[worker_idx]);
+        assert(result == 0, "Failed to create runtime pool worker (error %d).", result);
+    }
+
+    runtime_pool_work(&workers[0]);
+
+    for (int worker_idx = 1; worker_idx < num_workers; worker_idx++) {
+        pthread_join(workers[worker_idx].thread, NULL);
+    }
+
+    hotkeys_close();
+    emitter_close();
+    metrics_close();
+    timing_close();
+    tuning_close();
+    free(workers);
+}
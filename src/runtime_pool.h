@@ -0,0 +1,47 @@
+
+#ifndef BEANSCRIPT_RUNTIME_POOL_H
+#define BEANSCRIPT_RUNTIME_POOL_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "keyboard/emitter.h"
+#include "keyboard/hotkeys.h"
+#include "keyboard/null_sink.h"
+#include "keyboard/timing.h"
+#include "runtime.h"
+#include "parser/script_header.h"
+#include "scheduler/metrics.h"
+#include "utility/clock.h"
+#include "utility/str_list.h"
+#include "utility/tuning.h"
+#include "utility/utility.h"
+#include "utility/wake_event.h"
+
+typedef struct RuntimePoolStruct RuntimePool;
+
+// Constructor and Destructor
+RuntimePool*    runtime_pool_new(int num_workers);
+void            runtime_pool_delete(RuntimePool** ptr_pool);
+
+// Mutator Functions
+void            runtime_pool_add_script(RuntimePool* pool, const char* str_script_name);
+void            runtime_pool_add_runtime(RuntimePool* pool, Runtime* runtime);
+void            runtime_pool_set_timing_path(RuntimePool* pool, const char* str_dump_path);
+void            runtime_pool_set_metrics_path(RuntimePool* pool, const char* str_metrics_path);
+void            runtime_pool_set_seed(RuntimePool* pool, uint64_t seed);
+void            runtime_pool_set_panic_button(RuntimePool* pool, unsigned short keycode);
+void            runtime_pool_set_watch_period(RuntimePool* pool, time_t period_us);
+void            runtime_pool_set_tuning(RuntimePool* pool, const TuningConfig* tuning_config);
+
+// Accessor Functions
+uint64_t        runtime_pool_get_seed(RuntimePool* pool);
+
+// Executors
+void            runtime_pool_run(RuntimePool* pool);
+void            runtime_pool_simulate(RuntimePool* pool, time_t duration_us, FILE* file);
+
+
+#endif //BEANSCRIPT_RUNTIME_POOL_H
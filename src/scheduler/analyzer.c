@@ -0,0 +1,750 @@
+/**
+ * @file analyzer.c
+ *
+ * Static analysis of a compiled script. Every time parameter of an instruction is a range (or its default range, see
+ * instruction.h), so how long an instruction takes to execute, and how often a routine, waitlist or random can cycle
+ * through its instructions, follows from the ranges alone without running anything. Each is given in its best case
+ * (every range at its lower value), expected case (every range at its mean) and worst case (every range at its upper
+ * value).
+ *
+ * An execution in place takes its passes, each waiting before, pressing its key or executing its sub-instructions in
+ * place, and waiting after. Starting or stopping something takes no time. Waits on the cooldown of a sub-instruction
+ * executed in place are left out; cooldowns are only accounted for where the schedulers block on them:
+ * - A routine executes its instructions in turn, each blocking the routine until it is off cooldown. A round takes at
+ *   least every execution in it, and at least as long as any instruction takes to execute and cool down as many times
+ *   as it is in the round. The instruction that sets the round time beyond the executions alone is the bottleneck.
+ * - A waitlist executes the instruction that has been available the longest and a random any available one, so either
+ *   runs each of its instructions about once per round while it can keep up. Each instruction runs at most once per
+ *   execution and cooldown; if the instructions together ask for more than the whole time, the round is stretched
+ *   until they fit, and the waitlist or random is fully utilized.
+ * The expected case applies the model to the mean of every range, so it approximates rather than averages it.
+ * Instructions that are shared between schedulers are analyzed as if each scheduler had them to itself.
+ *
+ * The report is written as JSON lines: one line per finding, group and started entry, then a line for the script body
+ * and a summary of the script. Findings are mistakes that cannot be seen without running the script:
+ * - recursive: The instruction executes itself in place, through its sub-instructions, and would never complete.
+ * - repeats_forever_in_place: The instruction may repeat forever but is executed in place by the cause, which stops
+ *   the script with an error once it gets there.
+ * - never_runs: The instruction is in the script body after the cause, which repeats forever.
+ * - never_ready: The routine, waitlist or random has no instructions to execute.
+ * - unreachable: The instruction is defined but nothing in the body, or bound to a button, ever executes or starts it.
+ * - spins: The started entry always cycles without any time passing, so its scheduler would never move on.
+ */
+
+#include "analyzer.h"
+
+// The steps taken to find the round time of a saturated waitlist or random. Each halves the error.
+#define ANALYZER_BISECTION_STEPS 64
+
+// Rates are given per second rather than per us.
+#define ANALYZER_US_PER_S 1000000.0
+
+typedef enum {
+    ANALYZER_BEST,
+    ANALYZER_EXPECTED,
+    ANALYZER_WORST,
+} AnalyzerCase;
+
+#define ANALYZER_NUM_CASES 3
+
+typedef enum {
+    ANALYZER_UNVISITED,
+    ANALYZER_VISITING,
+    ANALYZER_TIMED,
+} AnalyzerState;
+
+/**
+ * @brief The value of a quantity in each case. A value that is unbounded is INFINITY.
+ */
+typedef struct {
+    double values[ANALYZER_NUM_CASES];
+} AnalyzerRange;
+
+/**
+ * @brief What is known about one instruction.
+ * - execution: How long (us) executing the instruction in place takes: each of its passes, or one pass if it repeats
+ *   forever.
+ * - cooldown: How long (us) the instruction cools down once it completes.
+ * - actions: How many keys an execution presses.
+ * - is_forever: True if the instruction may repeat forever.
+ * - is_reached: True if the script body or a button executes or starts the instruction, directly or not.
+ * - is_started: True if the instruction is scheduled on its own (see scheduler.c).
+ * - is_recursive: True if the instruction executes itself in place.
+ * - state: Where timing the instruction is.
+ */
+typedef struct {
+    AnalyzerRange execution;
+    AnalyzerRange cooldown;
+    AnalyzerRange actions;
+    bool is_forever;
+    bool is_reached;
+    bool is_started;
+    bool is_recursive;
+    AnalyzerState state;
+} AnalyzerNode;
+
+/**
+ * @brief The cycle of a started entry.
+ * - cycle: How long (us) the entry takes to cycle once, or to complete if it does not repeat.
+ * - actions: How many keys a cycle presses.
+ * - executions_per_s, actions_per_s: How many executions the entry makes and keys it presses per second, expected.
+ * - utilization: The expected fraction of the time the entry is executing rather than blocked.
+ * - bottleneck: The instruction that blocks a routine the most, or NULL if it never blocks.
+ * - is_looping: True if the entry runs until it is stopped.
+ * - is_spinning: True if a cycle never takes any time.
+ */
+typedef struct {
+    AnalyzerRange cycle;
+    AnalyzerRange actions;
+    double executions_per_s;
+    double actions_per_s;
+    double utilization;
+    Instruction* bottleneck;
+    bool is_looping;
+    bool is_spinning;
+} AnalyzerCycle;
+
+/**
+ * @brief The analysis of one script.
+ * - nodes: What is known about each instruction, by handle.
+ * - num_findings: The findings printed so far.
+ * - actions_per_s: The keys every looping entry presses per second together, expected.
+ */
+typedef struct {
+    FILE* file;
+    const char* script_name;
+    AnalyzerNode* nodes;
+    int num_nodes;
+    int num_findings;
+    double actions_per_s;
+} Analyzer;
+
+static const AnalyzerRange ANALYZER_ZERO = { .values = { 0.0, 0.0, 0.0 } };
+static const AnalyzerRange ANALYZER_ONE = { .values = { 1.0, 1.0, 1.0 } };
+static const AnalyzerRange ANALYZER_FOREVER = { .values = { INFINITY, INFINITY, INFINITY } };
+
+static AnalyzerRange range_add(AnalyzerRange range_a, AnalyzerRange range_b) {
+    for (int case_idx = 0; case_idx < ANALYZER_NUM_CASES; case_idx++) {
+        range_a.values[case_idx] += range_b.values[case_idx];
+    }
+
+    return range_a;
+}
+
+static AnalyzerRange range_multiply(AnalyzerRange range_a, AnalyzerRange range_b) {
+    for (int case_idx = 0; case_idx < ANALYZER_NUM_CASES; case_idx++) {
+        range_a.values[case_idx] *= range_b.values[case_idx];
+    }
+
+    return range_a;
+}
+
+/**
+ * Returns the range of the parameter, scaled by the given factor. Sampling ignores an upper value below the lower
+ * value (see rng_sample_range), and so does the range.
+ */
+static AnalyzerRange get_parameter_range(Instruction* instruction, InstructionParameter parameter, double scale) {
+    const int lower_value = instruction_get_parameter_lower_value(instruction, parameter);
+    int upper_value = instruction_get_parameter_upper_value(instruction, parameter);
+    if (upper_value < lower_value) {
+        upper_value = lower_value;
+    }
+
+    return (AnalyzerRange) { .values = {
+        lower_value * scale,
+        (lower_value + upper_value) / 2.0 * scale,
+        upper_value * scale,
+    } };
+}
+
+static bool is_forever(Instruction* instruction) {
+    return instruction_get_parameter_lower_value(instruction, REPEAT) < 0;
+}
+
+static void print_number(FILE* file, double value) {
+    if (isfinite(value)) {
+        fprintf(file, "%.2f", value);
+    } else {
+        fprintf(file, "null");
+    }
+}
+
+static void print_range(FILE* file, const char* str_name, AnalyzerRange range) {
+    fprintf(file, ", \"%s\": {\"best\": ", str_name);
+    print_number(file, range.values[ANALYZER_BEST]);
+    fprintf(file, ", \"expected\": ");
+    print_number(file, range.values[ANALYZER_EXPECTED]);
+    fprintf(file, ", \"worst\": ");
+    print_number(file, range.values[ANALYZER_WORST]);
+    fprintf(file, "}");
+}
+
+static void print_instruction(Analyzer* analyzer, Instruction* instruction) {
+    fprintf(analyzer->file, "{\"script\": ");
+    str_print_json(analyzer->file, analyzer->script_name);
+    fprintf(analyzer->file, ", \"instruction\": ");
+    str_print_json(analyzer->file, instruction_get_id(instruction));
+    fprintf(analyzer->file, ", \"type\": \"%s\", \"line\": %d",
+            InstructionTypeLookupArray[instruction_get_type(instruction)], instruction_get_line_number(instruction));
+}
+
+/**
+ * Prints a finding about the instruction (see the top of this file).
+ *
+ * @param analyzer
+ * @param str_finding
+ * @param instruction
+ * @param cause The instruction the finding is due to, or NULL.
+ */
+static void print_finding(Analyzer* analyzer, const char* str_finding, Instruction* instruction, Instruction* cause) {
+    print_instruction(analyzer, instruction);
+    fprintf(analyzer->file, ", \"finding\": \"%s\", \"cause\": ", str_finding);
+
+    if (cause != NULL) {
+        str_print_json(analyzer->file, instruction_get_id(cause));
+    } else {
+        fprintf(analyzer->file, "null");
+    }
+
+    fprintf(analyzer->file, "}\n");
+    analyzer->num_findings++;
+}
+
+/**
+ * Marks the instruction as reached, and started if it is, along with everything it executes or starts. A stop does
+ * not reach its targets.
+ */
+static void reach(Analyzer* analyzer, int handle, bool is_started) {
+    AnalyzerNode* node = &analyzer->nodes[handle];
+    Instruction* instruction = instruction_table_get(handle);
+    const InstructionType type = instruction_get_type(instruction);
+
+    // Executing a routine, waitlist or random in place starts it.
+    is_started = is_started || instruction_type_is_scheduler(type);
+    if (node->is_reached && (node->is_started || is_started == false)) {
+        return;
+    }
+
+    const bool was_reached = node->is_reached;
+    node->is_reached = true;
+    node->is_started = node->is_started || is_started;
+
+    if (was_reached || type == STOP) {
+        return;
+    }
+
+    const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+    for (int idx = 0; idx < num_sub_instructions; idx++) {
+        reach(analyzer, instruction_get_sub_instruction_handle(instruction, idx), type == START);
+    }
+}
+
+/**
+ * Reaches every instruction of the script body up to the first that repeats forever, and every `start` and `stop`
+ * bound to a button. The body never gets past an instruction that repeats forever.
+ */
+static void reach_script(Analyzer* analyzer, const int* body_handles, int num_body_handles) {
+    Instruction* forever_instruction = NULL;
+
+    for (int idx = 0; idx < num_body_handles; idx++) {
+        Instruction* instruction = instruction_table_get(body_handles[idx]);
+        if (forever_instruction != NULL) {
+            print_finding(analyzer, "never_runs", instruction, forever_instruction);
+            continue;
+        }
+
+        reach(analyzer, body_handles[idx], false);
+        forever_instruction = is_forever(instruction) ? instruction : NULL;
+    }
+
+    for (int handle = 0; handle < analyzer->num_nodes; handle++) {
+        Instruction* instruction = instruction_table_get(handle);
+        const InstructionType type = instruction_get_type(instruction);
+
+        if ((type == START || type == STOP) && instruction_get_keycode(instruction) != 0) {
+            reach(analyzer, handle, false);
+        }
+    }
+}
+
+static const AnalyzerNode* time_instruction(Analyzer* analyzer, int handle);
+
+/**
+ * Times the sub-instruction the parent executes in place. One that may repeat forever never completes in place.
+ */
+static AnalyzerRange time_in_place(Analyzer* analyzer, Instruction* parent, int sub_handle, AnalyzerRange* actions) {
+    const AnalyzerNode* sub_node = time_instruction(analyzer, sub_handle);
+    *actions = range_add(*actions, sub_node->actions);
+
+    if (sub_node->is_forever) {
+        print_finding(analyzer, "repeats_forever_in_place", instruction_table_get(sub_handle), parent);
+        return ANALYZER_FOREVER;
+    }
+
+    return sub_node->execution;
+}
+
+/**
+ * Times an execution of the instruction in place (see the top of this file), along with everything it executes in
+ * place. An instruction that executes itself is found once and takes forever.
+ *
+ * @param analyzer
+ * @param handle
+ * @return
+ */
+static const AnalyzerNode* time_instruction(Analyzer* analyzer, int handle) {
+    AnalyzerNode* node = &analyzer->nodes[handle];
+    Instruction* instruction = instruction_table_get(handle);
+
+    if (node->state == ANALYZER_TIMED) {
+        return node;
+    }
+
+    if (node->state == ANALYZER_VISITING) {
+        if (node->is_recursive == false) {
+            node->is_recursive = true;
+            print_finding(analyzer, "recursive", instruction, NULL);
+        }
+
+        return node;
+    }
+
+    node->state = ANALYZER_VISITING;
+    node->execution = ANALYZER_FOREVER;
+    node->actions = ANALYZER_ZERO;
+    node->cooldown = get_parameter_range(instruction, COOLDOWN, CLOCK_US_PER_MS);
+    node->is_forever = is_forever(instruction);
+
+    AnalyzerRange pass = range_add(get_parameter_range(instruction, BEFORE, CLOCK_US_PER_MS),
+                                   get_parameter_range(instruction, AFTER, CLOCK_US_PER_MS));
+    AnalyzerRange pass_actions = ANALYZER_ZERO;
+
+    const InstructionType type = instruction_get_type(instruction);
+    const bool has_key = instruction_get_keycode(instruction) != 0;
+    const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+
+    if ((type == KEY || type == PRESS || type == HOLD) && has_key) {
+        pass_actions = range_add(pass_actions, ANALYZER_ONE);
+    }
+
+    if (((type == KEY || type == PRESS) && has_key) || type == HOLD) {
+        pass = range_add(pass, get_parameter_range(instruction, DURATION, CLOCK_US_PER_MS));
+    }
+
+    for (int idx = 0; idx < num_sub_instructions; idx++) {
+        const int sub_handle = instruction_get_sub_instruction_handle(instruction, idx);
+
+        switch (type) {
+            case KEY:
+            case PRESS:
+            case GROUP:
+                pass = range_add(pass, time_in_place(analyzer, instruction, sub_handle, &pass_actions));
+                break;
+            case HOLD:
+                // A hold presses the keys of its sub-instructions without executing them.
+                if (instruction_get_keycode(instruction_table_get(sub_handle)) != 0) {
+                    pass_actions = range_add(pass_actions, ANALYZER_ONE);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    AnalyzerRange num_passes = ANALYZER_ONE;
+    if (node->is_forever == false) {
+        num_passes = range_add(get_parameter_range(instruction, REPEAT, 1.0), ANALYZER_ONE);
+    }
+
+    node->execution = range_multiply(pass, num_passes);
+    node->actions = range_multiply(pass_actions, num_passes);
+    node->state = ANALYZER_TIMED;
+
+    return node;
+}
+
+/**
+ * Returns the instructions of the routine, waitlist or random that it can execute. An instruction that may repeat
+ * forever cannot be executed by it, and is left out.
+ */
+static int get_members(Analyzer* analyzer, Instruction* instruction, int* handles) {
+    int num_members = 0;
+
+    const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+    for (int idx = 0; idx < num_sub_instructions; idx++) {
+        const int sub_handle = instruction_get_sub_instruction_handle(instruction, idx);
+        if (analyzer->nodes[sub_handle].is_forever == false) {
+            handles[num_members++] = sub_handle;
+        }
+    }
+
+    return num_members;
+}
+
+/**
+ * Returns the round time of a routine in the given case, and the instruction that stretches it beyond the executions
+ * alone, if any.
+ */
+static double get_routine_round_time(Analyzer* analyzer, const int* handles, int num_members, int case_idx,
+                                     Instruction** bottleneck) {
+    double round_time = 0.0;
+    for (int idx = 0; idx < num_members; idx++) {
+        round_time += analyzer->nodes[handles[idx]].execution.values[case_idx];
+    }
+
+    *bottleneck = NULL;
+    for (int idx = 0; idx < num_members; idx++) {
+        const AnalyzerNode* node = &analyzer->nodes[handles[idx]];
+
+        int num_occurrences = 0;
+        for (int other_idx = 0; other_idx < num_members; other_idx++) {
+            num_occurrences += handles[other_idx] == handles[idx] ? 1 : 0;
+        }
+
+        const double bound = num_occurrences * (node->execution.values[case_idx] + node->cooldown.values[case_idx]);
+        if (bound > round_time) {
+            round_time = bound;
+            *bottleneck = instruction_table_get(handles[idx]);
+        }
+    }
+
+    return round_time;
+}
+
+/**
+ * Returns how long the instruction of a waitlist or random takes to come round again, in the given case, if a round
+ * of the waitlist or random takes the given time.
+ */
+static double get_member_period(const AnalyzerNode* node, int case_idx, double round_time) {
+    const double period = node->execution.values[case_idx] + node->cooldown.values[case_idx];
+    return period > round_time ? period : round_time;
+}
+
+/**
+ * Returns the fraction of the time the instructions of a waitlist or random would be executing if a round took the
+ * given time. An instruction that takes no time adds nothing.
+ */
+static double get_demand(Analyzer* analyzer, const int* handles, int num_members, int case_idx, double round_time) {
+    double demand = 0.0;
+    for (int idx = 0; idx < num_members; idx++) {
+        const AnalyzerNode* node = &analyzer->nodes[handles[idx]];
+        const double execution = node->execution.values[case_idx];
+
+        if (execution > 0.0) {
+            demand += execution / get_member_period(node, case_idx, round_time);
+        }
+    }
+
+    return demand;
+}
+
+/**
+ * Returns the round time of a waitlist or random in the given case: none while it keeps up with its instructions,
+ * and otherwise the round time at which they just fit (see the top of this file).
+ */
+static double get_waitlist_round_time(Analyzer* analyzer, const int* handles, int num_members, int case_idx) {
+    if (get_demand(analyzer, handles, num_members, case_idx, 0.0) <= 1.0) {
+        return 0.0;
+    }
+
+    // Every instruction fits once per round if the round is as long as they all are.
+    double lower_time = 0.0;
+    double upper_time = 0.0;
+    for (int idx = 0; idx < num_members; idx++) {
+        upper_time += analyzer->nodes[handles[idx]].execution.values[case_idx];
+    }
+
+    if (isfinite(upper_time) == false) {
+        return INFINITY;
+    }
+
+    for (int step = 0; step < ANALYZER_BISECTION_STEPS; step++) {
+        const double round_time = (lower_time + upper_time) / 2.0;
+        if (get_demand(analyzer, handles, num_members, case_idx, round_time) > 1.0) {
+            lower_time = round_time;
+        } else {
+            upper_time = round_time;
+        }
+    }
+
+    return upper_time;
+}
+
+/**
+ * Analyzes the cycle of a routine, waitlist or random that is started.
+ */
+static AnalyzerCycle analyze_scheduler(Analyzer* analyzer, Instruction* instruction) {
+    AnalyzerCycle cycle = { .cycle = ANALYZER_ZERO, .actions = ANALYZER_ZERO, .is_looping = true };
+
+    int* handles = (int*) malloc(sizeof(int) * (instruction_get_num_sub_instructions(instruction) + 1));
+    assert(handles != NULL, "Failed to allocate memory for analysis of %s.", instruction_get_id(instruction));
+
+    const int num_members = get_members(analyzer, instruction, handles);
+    const bool is_routine = instruction_get_type(instruction) == ROUTINE;
+
+    for (int case_idx = 0; case_idx < ANALYZER_NUM_CASES; case_idx++) {
+        double executions = 0.0;
+        double execution_time = 0.0;
+        double actions = 0.0;
+
+        if (is_routine) {
+            Instruction* bottleneck = NULL;
+            const double round_time = get_routine_round_time(analyzer, handles, num_members, case_idx, &bottleneck);
+
+            for (int idx = 0; idx < num_members; idx++) {
+                const AnalyzerNode* node = &analyzer->nodes[handles[idx]];
+                execution_time += node->execution.values[case_idx];
+                actions += node->actions.values[case_idx];
+            }
+
+            cycle.cycle.values[case_idx] = round_time;
+            cycle.actions.values[case_idx] = actions;
+            cycle.is_spinning = cycle.is_spinning || (num_members > 0 && round_time == 0.0);
+            executions = round_time > 0.0 ? num_members / round_time : 0.0;
+            actions = round_time > 0.0 ? actions / round_time : 0.0;
+            execution_time = round_time > 0.0 ? execution_time / round_time : 0.0;
+
+            if (case_idx == ANALYZER_EXPECTED) {
+                cycle.bottleneck = bottleneck;
+            }
+        } else {
+            const double round_time = get_waitlist_round_time(analyzer, handles, num_members, case_idx);
+
+            // Every instruction runs once per period, so the cycle is the longest period.
+            for (int idx = 0; idx < num_members; idx++) {
+                const AnalyzerNode* node = &analyzer->nodes[handles[idx]];
+                const double period = get_member_period(node, case_idx, round_time);
+
+                if (period > cycle.cycle.values[case_idx]) {
+                    cycle.cycle.values[case_idx] = period;
+                }
+
+                cycle.actions.values[case_idx] += node->actions.values[case_idx];
+                cycle.is_spinning = cycle.is_spinning || period == 0.0;
+
+                if (period > 0.0) {
+                    executions += 1.0 / period;
+                    actions += node->actions.values[case_idx] / period;
+                    execution_time += node->execution.values[case_idx] / period;
+                }
+            }
+        }
+
+        if (case_idx == ANALYZER_EXPECTED) {
+            cycle.executions_per_s = executions * ANALYZER_US_PER_S;
+            cycle.actions_per_s = actions * ANALYZER_US_PER_S;
+            cycle.utilization = execution_time;
+        }
+    }
+
+    free(handles);
+    return cycle;
+}
+
+/**
+ * Analyzes the cycle of any other started instruction: each of its passes, or one pass at a time if it repeats
+ * forever.
+ */
+static AnalyzerCycle analyze_sequence(const AnalyzerNode* node) {
+    AnalyzerCycle cycle = {
+        .cycle = node->execution,
+        .actions = node->actions,
+        .utilization = 1.0,
+        .is_looping = node->is_forever,
+    };
+
+    const double cycle_time = node->execution.values[ANALYZER_EXPECTED];
+    if (cycle_time > 0.0 && isfinite(cycle_time)) {
+        cycle.executions_per_s = ANALYZER_US_PER_S / cycle_time;
+        cycle.actions_per_s = node->actions.values[ANALYZER_EXPECTED] * cycle.executions_per_s;
+    }
+
+    cycle.is_spinning = node->is_forever && node->execution.values[ANALYZER_WORST] == 0.0;
+    return cycle;
+}
+
+static void print_cycle(Analyzer* analyzer, const AnalyzerCycle* cycle, bool is_scheduler) {
+    FILE* file = analyzer->file;
+
+    print_range(file, "cycle_us", cycle->cycle);
+    print_range(file, "actions_per_cycle", cycle->actions);
+    fprintf(file, ", \"loops\": %s, \"executions_per_s\": ", cycle->is_looping ? "true" : "false");
+    print_number(file, cycle->executions_per_s);
+    fprintf(file, ", \"actions_per_s\": ");
+    print_number(file, cycle->actions_per_s);
+
+    if (is_scheduler) {
+        fprintf(file, ", \"utilization\": ");
+        print_number(file, cycle->utilization);
+        fprintf(file, ", \"bottleneck\": ");
+
+        if (cycle->bottleneck != NULL) {
+            str_print_json(file, instruction_get_id(cycle->bottleneck));
+        } else {
+            fprintf(file, "null");
+        }
+    }
+}
+
+/**
+ * Prints the analysis of the instruction if it is a group or is started, along with its findings.
+ */
+static void print_entry(Analyzer* analyzer, int handle) {
+    const AnalyzerNode* node = &analyzer->nodes[handle];
+    Instruction* instruction = instruction_table_get(handle);
+    const bool is_scheduler = instruction_type_is_scheduler(instruction_get_type(instruction));
+
+    if (node->is_started == false) {
+        if (instruction_get_type(instruction) == GROUP) {
+            print_instruction(analyzer, instruction);
+            fprintf(analyzer->file, ", \"started\": false");
+            print_range(analyzer->file, "execution_us", node->execution);
+            print_range(analyzer->file, "actions", node->actions);
+            fprintf(analyzer->file, ", \"repeats_forever\": %s}\n", node->is_forever ? "true" : "false");
+        }
+
+        return;
+    }
+
+    const AnalyzerCycle cycle = is_scheduler ? analyze_scheduler(analyzer, instruction) : analyze_sequence(node);
+
+    print_instruction(analyzer, instruction);
+    fprintf(analyzer->file, ", \"started\": true");
+    print_cycle(analyzer, &cycle, is_scheduler);
+    fprintf(analyzer->file, "}\n");
+
+    if (cycle.is_looping) {
+        analyzer->actions_per_s += cycle.actions_per_s;
+    }
+
+    if (cycle.is_spinning) {
+        print_finding(analyzer, "spins", instruction, NULL);
+    }
+}
+
+/**
+ * Prints how long the script body takes, up to the instruction that repeats forever if there is one, and how fast it
+ * presses keys while it does.
+ */
+static void print_body(Analyzer* analyzer, const int* body_handles, int num_body_handles) {
+    AnalyzerRange execution = ANALYZER_ZERO;
+    AnalyzerRange actions = ANALYZER_ZERO;
+    Instruction* forever_instruction = NULL;
+
+    for (int idx = 0; idx < num_body_handles && forever_instruction == NULL; idx++) {
+        const AnalyzerNode* node = &analyzer->nodes[body_handles[idx]];
+        if (node->is_forever) {
+            forever_instruction = instruction_table_get(body_handles[idx]);
+            continue;
+        }
+
+        execution = range_add(execution, node->execution);
+        actions = range_add(actions, node->actions);
+    }
+
+    FILE* file = analyzer->file;
+    fprintf(file, "{\"script\": ");
+    str_print_json(file, analyzer->script_name);
+    fprintf(file, ", \"type\": \"body\"");
+    print_range(file, "execution_us", execution);
+    print_range(file, "actions", actions);
+    fprintf(file, ", \"loops_on\": ");
+
+    if (forever_instruction != NULL) {
+        str_print_json(file, instruction_get_id(forever_instruction));
+
+        const AnalyzerCycle cycle = analyze_sequence(&analyzer->nodes[instruction_get_handle(forever_instruction)]);
+        analyzer->actions_per_s += cycle.actions_per_s;
+        fprintf(file, ", \"actions_per_s\": ");
+        print_number(file, cycle.actions_per_s);
+
+        if (cycle.is_spinning) {
+            fprintf(file, "}\n");
+            print_finding(analyzer, "spins", forever_instruction, NULL);
+            return;
+        }
+    } else {
+        const double execution_time = execution.values[ANALYZER_EXPECTED];
+        fprintf(file, "null, \"actions_per_s\": ");
+        const double actions_per_s = actions.values[ANALYZER_EXPECTED] * ANALYZER_US_PER_S / execution_time;
+        print_number(file, execution_time > 0.0 ? actions_per_s : 0.0);
+    }
+
+    fprintf(file, "}\n");
+}
+
+/**
+ * Analyzes the script bound to the calling thread (see the top of this file) and writes the report to the file. The
+ * script must be linked.
+ *
+ * @param file
+ * @param str_script_name
+ * @param body_handles The top-level instructions of the script, executed in order.
+ * @param num_body_handles
+ */
+void analyzer_print_report(FILE* file, const char* str_script_name, const int* body_handles, int num_body_handles) {
+    assert(file != NULL, "Attempting to print analysis to NULL file.");
+
+    Analyzer analyzer = {
+        .file = file,
+        .script_name = str_script_name,
+        .num_nodes = instruction_table_get_size(),
+        .num_findings = 0,
+        .actions_per_s = 0.0,
+    };
+
+    analyzer.nodes = (AnalyzerNode*) calloc(analyzer.num_nodes > 0 ? analyzer.num_nodes : 1, sizeof(AnalyzerNode));
+    assert(analyzer.nodes != NULL, "Failed to allocate memory for analysis of %s.", str_script_name);
+
+    reach_script(&analyzer, body_handles, num_body_handles);
+
+    for (int handle = 0; handle < analyzer.num_nodes; handle++) {
+        if (analyzer.nodes[handle].is_reached) {
+            time_instruction(&analyzer, handle);
+        }
+    }
+
+    for (int handle = 0; handle < analyzer.num_nodes; handle++) {
+        const AnalyzerNode* node = &analyzer.nodes[handle];
+        Instruction* instruction = instruction_table_get(handle);
+        const InstructionType type = instruction_get_type(instruction);
+
+        if (node->is_reached == false && instruction_type_is_definition(type) && type != SCRIPT && type != WINDOW) {
+            print_finding(&analyzer, "unreachable", instruction, NULL);
+            continue;
+        }
+
+        if (node->is_reached == false || instruction_type_is_scheduler(type) == false) {
+            continue;
+        }
+
+        if (instruction_get_num_sub_instructions(instruction) == 0) {
+            print_finding(&analyzer, "never_ready", instruction, NULL);
+        }
+
+        // A routine, waitlist or random executes its instructions in place.
+        for (int idx = 0; idx < instruction_get_num_sub_instructions(instruction); idx++) {
+            const int sub_handle = instruction_get_sub_instruction_handle(instruction, idx);
+            if (analyzer.nodes[sub_handle].is_forever) {
+                print_finding(&analyzer, "repeats_forever_in_place", instruction_table_get(sub_handle), instruction);
+            }
+        }
+    }
+
+    for (int handle = 0; handle < analyzer.num_nodes; handle++) {
+        if (analyzer.nodes[handle].is_reached) {
+            print_entry(&analyzer, handle);
+        }
+    }
+
+    print_body(&analyzer, body_handles, num_body_handles);
+
+    fprintf(file, "{\"script\": ");
+    str_print_json(file, str_script_name);
+    fprintf(file, ", \"instructions\": %d, \"findings\": %d, \"actions_per_s\": ", analyzer.num_nodes,
+            analyzer.num_findings);
+    print_number(file, analyzer.actions_per_s);
+    fprintf(file, "}\n");
+
+    free(analyzer.nodes);
+}
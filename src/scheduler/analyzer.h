@@ -0,0 +1,17 @@
+#ifndef BEANSCRIPT_ANALYZER_H
+#define BEANSCRIPT_ANALYZER_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/parser/instruction.h"
+#include "src/utility/clock.h"
+#include "src/utility/utility.h"
+#include "src/main.h"
+
+// Executors
+void    analyzer_print_report(FILE* file, const char* str_script_name, const int* body_handles, int num_body_handles);
+
+#endif //BEANSCRIPT_ANALYZER_H
@@ -0,0 +1,182 @@
+/**
+ * @file coroutine.c
+ *
+ * A coroutine executes one instruction in place a little at a time. Executing an instruction in one go would compute
+ * every stroke of every pass up front, so the cooldowns it starts and the targets it starts or stops would take effect
+ * before their time, as seen by every other scheduler entry. A coroutine instead runs the flattened pass (see
+ * op_stream.c) only until time has to pass, and then yields the time it wants to resume at. The scheduler resumes it at
+ * that time, so every op of every entry runs in time order and thousands of presses, holds and waits can be in flight
+ * on one thread without sleeping.
+ *
+ * The coroutines are stackless: everything a suspended execution needs is the op cursor and the passes left, held in
+ * the coroutine itself. An instruction without an op stream makes each of its passes in one go, as before.
+ *
+ * Since the cooldown of an execution only starts once it completes, an instruction executed by a coroutine is acquired
+ * when it starts (see instruction_acquire): until it completes, no other entry begins it, and each one waiting on it
+ * tries again when the coroutine next resumes.
+ */
+
+#include "coroutine.h"
+
+/**
+ * @brief
+ * - instruction, stream: The instruction being executed and the op stream of its pass, or NULL if it has none.
+ * - cursor: Where the current pass is.
+ * - remaining_passes: The passes left after the current one.
+ * - is_in_pass: True while the current pass has ops left.
+ * - should_complete: True if the instruction is in flight, and starts its cooldown once its passes are done.
+ * - is_running: True until the execution is done.
+ * - num_starts: How many executions or passes the coroutine has started (see metrics.c).
+ */
+struct CoroutineStruct {
+    Instruction* instruction;
+    OpStream* stream;
+    OpCursor cursor;
+    int remaining_passes;
+    bool is_in_pass;
+    bool should_complete;
+    bool is_running;
+    long long num_starts;
+};
+
+Coroutine* coroutine_new() {
+    Coroutine* coroutine = (Coroutine*) malloc(sizeof(Coroutine));
+    assert(coroutine != NULL, "Failed to allocate memory for coroutine.");
+
+    coroutine->instruction = NULL;
+    coroutine->stream = NULL;
+    coroutine->remaining_passes = 0;
+    coroutine->is_in_pass = false;
+    coroutine->should_complete = false;
+    coroutine->is_running = false;
+    coroutine->num_starts = 0;
+
+    return coroutine;
+}
+
+void coroutine_delete(Coroutine** ptr_coroutine) {
+    assert(ptr_coroutine != NULL, "Attempting to delete coroutine behind NULL pointer.");
+    assert(*ptr_coroutine != NULL, "Attempting to delete NULL coroutine.");
+
+    free(*ptr_coroutine);
+    *ptr_coroutine = NULL;
+}
+
+bool coroutine_is_running(Coroutine* coroutine) {
+    assert(coroutine != NULL, "Attempting to check if NULL coroutine is running.");
+
+    return coroutine->is_running;
+}
+
+/**
+ * @brief Returns how many executions or passes the coroutine has started, whether or not they are done.
+ */
+long long coroutine_get_num_starts(Coroutine* coroutine) {
+    assert(coroutine != NULL, "Attempting to get starts of NULL coroutine.");
+
+    return coroutine->num_starts;
+}
+
+/**
+ * @brief Returns the instruction the coroutine is executing or executed last.
+ */
+Instruction* coroutine_get_instruction(Coroutine* coroutine) {
+    assert(coroutine != NULL, "Attempting to get instruction of NULL coroutine.");
+
+    return coroutine->instruction;
+}
+
+static void begin(Coroutine* coroutine, Instruction* instruction, time_t start_time) {
+    assert(coroutine->is_running == false, "Attempting to start coroutine that is already running.");
+
+    coroutine->instruction = instruction;
+    coroutine->stream = instruction_get_op_stream(instruction);
+    coroutine->is_in_pass = false;
+    coroutine->is_running = true;
+    coroutine->num_starts++;
+    op_stream_begin(&coroutine->cursor, start_time);
+}
+
+/**
+ * @brief Starts executing the instruction in place at the given time, the way instruction_execute does: each of its
+ * passes, then its cooldown. Returns false without starting if the instruction is on cooldown or in flight at the given
+ * time. Otherwise the instruction is in flight until the execution is done. Nothing runs until the coroutine is resumed.
+ */
+bool coroutine_start(Coroutine* coroutine, Instruction* instruction, time_t start_time) {
+    assert(coroutine != NULL, "Attempting to start NULL coroutine.");
+    assert(instruction != NULL, "Attempting to start coroutine with NULL instruction.");
+
+    if (instruction_is_available(instruction, start_time) == false) {
+        return false;
+    }
+
+    const int num_passes = instruction_sample_num_passes(instruction);
+    assert(num_passes >= 0, "Instruction %s (line %d) repeats forever and must be started instead of executed in place.",
+           instruction_get_id(instruction), instruction_get_line_number(instruction));
+
+    begin(coroutine, instruction, start_time);
+    coroutine->remaining_passes = num_passes;
+    coroutine->should_complete = true;
+    instruction_acquire(instruction, &coroutine->cursor.current_time);
+
+    return true;
+}
+
+/**
+ * @brief Starts a single pass of the instruction at the given time, ignoring its repeat and cooldown, the way
+ * instruction_execute_pass does. Nothing runs until the coroutine is resumed.
+ */
+void coroutine_start_pass(Coroutine* coroutine, Instruction* instruction, time_t start_time) {
+    assert(coroutine != NULL, "Attempting to start NULL coroutine.");
+    assert(instruction != NULL, "Attempting to start coroutine with NULL instruction.");
+
+    begin(coroutine, instruction, start_time);
+    coroutine->remaining_passes = 1;
+    coroutine->should_complete = false;
+}
+
+/**
+ * @brief Runs the coroutine from the time it last yielded (or started) until time has to pass. Returns false if it
+ * yielded, with the time to resume it at written to time. Returns true once the execution is done, with the time it
+ * completed at written to time; that is always the time it was resumed at, since a coroutine yields rather than let
+ * time pass before completing.
+ */
+bool coroutine_resume(Coroutine* coroutine, time_t* time) {
+    assert(coroutine != NULL, "Attempting to resume NULL coroutine.");
+    assert(time != NULL, "Attempting to resume coroutine with NULL time.");
+    assert(coroutine->is_running, "Attempting to resume coroutine that is not running.");
+
+    OpCursor* cursor = &coroutine->cursor;
+    const time_t resume_time = cursor->current_time;
+
+    while (cursor->current_time == resume_time) {
+        if (coroutine->is_in_pass) {
+            if (coroutine->stream == NULL) {
+                cursor->current_time = instruction_execute_pass(coroutine->instruction, cursor->current_time);
+            } else if (op_stream_resume(coroutine->stream, cursor) == false) {
+                break;
+            }
+
+            coroutine->is_in_pass = false;
+            coroutine->remaining_passes--;
+            continue;
+        }
+
+        if (coroutine->remaining_passes > 0) {
+            op_stream_begin(cursor, cursor->current_time);
+            coroutine->is_in_pass = true;
+            continue;
+        }
+
+        if (coroutine->should_complete) {
+            instruction_complete(coroutine->instruction, cursor->current_time);
+        }
+
+        coroutine->is_running = false;
+        *time = cursor->current_time;
+        return true;
+    }
+
+    *time = cursor->current_time;
+    return false;
+}
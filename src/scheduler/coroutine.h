@@ -0,0 +1,27 @@
+#ifndef BEANSCRIPT_COROUTINE_H
+#define BEANSCRIPT_COROUTINE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "src/parser/instruction.h"
+#include "src/parser/op_stream.h"
+#include "src/main.h"
+
+typedef struct CoroutineStruct Coroutine;
+
+// Constructor and Destructor
+Coroutine*      coroutine_new();
+void            coroutine_delete(Coroutine** ptr_coroutine);
+
+// Accessor Functions
+bool            coroutine_is_running(Coroutine* coroutine);
+Instruction*    coroutine_get_instruction(Coroutine* coroutine);
+long long       coroutine_get_num_starts(Coroutine* coroutine);
+
+// Executors
+bool            coroutine_start(Coroutine* coroutine, Instruction* instruction, time_t start_time);
+void            coroutine_start_pass(Coroutine* coroutine, Instruction* instruction, time_t start_time);
+bool            coroutine_resume(Coroutine* coroutine, time_t* time);
+
+#endif //BEANSCRIPT_COROUTINE_H
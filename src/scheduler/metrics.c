@@ -0,0 +1,372 @@
+/**
+ * @file metrics.c
+ *
+ * Live metrics of the schedulers. For every routine, waitlist, random and other started instruction, the scheduler of
+ * its script counts how often it was stepped, how many executions or passes it began, how often it was blocked on a
+ * cooldown and for how long, and how many instructions of a waitlist or random were ready. For every script, the
+ * worker running it counts how long each tick of its scheduler took and how often the worker woke too late for the
+ * script's deadline (an overrun), and by how much.
+ *
+ * Each counter has a single writer: the thread running the script. Recording is a relaxed load and store of the
+ * counter, so it never blocks, allocates or takes a lock. A background thread publishes every counter every
+ * METRICS_PUBLISH_PERIOD_US by writing them to a temporary file as JSON lines and renaming it over the metrics file, so
+ * a dashboard reading the file never sees a partial publish and never pauses the scripts. Each line describes either a
+ * script or one of its entries; entries that were never stepped are left out.
+ *
+ * The runtimes attach their channel and name its entries before they start and again whenever their script is
+ * reloaded. The counters of the entries start over with the reloaded script; those of the script carry on.
+ */
+
+#include "metrics.h"
+
+static const time_t METRICS_PUBLISH_PERIOD_US = 250000;
+static const time_t METRICS_POLL_PERIOD_US = 10000;
+
+/**
+ * @brief The counters of one scheduler entry.
+ * - num_steps: How often the entry was stepped.
+ * - num_executions: How many executions (or passes, for a sequence) the entry began.
+ * - num_blocked, blocked_us: How often a step found the entry blocked on a cooldown, and how long (us) it waited.
+ * - queue_depth, max_queue_depth: How many instructions of a waitlist or random were ready after the last step, and
+ *   the most there ever were.
+ */
+typedef struct {
+    atomic_llong num_steps;
+    atomic_llong num_executions;
+    atomic_llong num_blocked;
+    atomic_llong blocked_us;
+    atomic_int queue_depth;
+    atomic_int max_queue_depth;
+} MetricsCounters;
+
+/**
+ * @brief What is known about one channel.
+ * - script_name, ids, types: The names of the script, and the id and instruction type of every entry. Guarded by
+ *   mutex; types are not copied.
+ * - counters: The counters of every entry. Replaced under mutex when the channel is attached again, and otherwise only
+ *   written by the thread running the script.
+ * - num_ticks, tick_us, max_tick_us: How many ticks the scheduler made and how long (us) they took in total and at
+ *   most.
+ * - num_overruns, overrun_us, max_overrun_us: How many ticks began after the deadline they were due for, and how late
+ *   (us) in total and at most.
+ */
+typedef struct {
+    char* script_name;
+    char** ids;
+    const char** types;
+    MetricsCounters* counters;
+    int num_entries;
+
+    atomic_llong num_ticks;
+    atomic_llong tick_us;
+    atomic_llong max_tick_us;
+    atomic_llong num_overruns;
+    atomic_llong overrun_us;
+    atomic_llong max_overrun_us;
+} MetricsChannel;
+
+static MetricsChannel* channels = NULL;
+static int num_channels = 0;
+static char* metrics_path = NULL;
+static char* temp_path = NULL;
+static int num_publishes = 0;
+
+static pthread_t thread;
+static atomic_bool is_closing = false;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Adds to a counter that only the calling thread writes. Cheaper than an atomic add, as no other thread can write the
+ * counter in between.
+ */
+static void add_relaxed(atomic_llong* counter, long long value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static void max_relaxed(atomic_llong* counter, long long value) {
+    if (value > atomic_load_explicit(counter, memory_order_relaxed)) {
+        atomic_store_explicit(counter, value, memory_order_relaxed);
+    }
+}
+
+static long long load_relaxed(atomic_llong* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void print_channel(FILE* file, int channel) {
+    MetricsChannel* metrics_channel = &channels[channel];
+    const long long num_ticks = load_relaxed(&metrics_channel->num_ticks);
+
+    fprintf(file, "{\"script\": ");
+    str_print_json(file, metrics_channel->script_name);
+    fprintf(file, ", \"channel\": %d, \"ticks\": %lld, \"tick_us\": %lld, \"tick_us_max\": %lld, \"overruns\": %lld, "
+            "\"overrun_us\": %lld, \"overrun_us_max\": %lld}\n", channel, num_ticks,
+            load_relaxed(&metrics_channel->tick_us), load_relaxed(&metrics_channel->max_tick_us),
+            load_relaxed(&metrics_channel->num_overruns), load_relaxed(&metrics_channel->overrun_us),
+            load_relaxed(&metrics_channel->max_overrun_us));
+
+    for (int entry_idx = 0; entry_idx < metrics_channel->num_entries; entry_idx++) {
+        MetricsCounters* counters = &metrics_channel->counters[entry_idx];
+        const long long num_steps = load_relaxed(&counters->num_steps);
+        if (num_steps == 0) {
+            continue;
+        }
+
+        fprintf(file, "{\"script\": ");
+        str_print_json(file, metrics_channel->script_name);
+        fprintf(file, ", \"channel\": %d, \"entry\": %d, \"instruction\": ", channel, entry_idx);
+        str_print_json(file, metrics_channel->ids[entry_idx]);
+        fprintf(file, ", \"type\": ");
+        str_print_json(file, metrics_channel->types[entry_idx]);
+        fprintf(file, ", \"steps\": %lld, \"executions\": %lld, \"blocked\": %lld, \"blocked_us\": %lld", num_steps,
+                load_relaxed(&counters->num_executions), load_relaxed(&counters->num_blocked),
+                load_relaxed(&counters->blocked_us));
+
+        const int queue_depth = atomic_load_explicit(&counters->queue_depth, memory_order_relaxed);
+        if (queue_depth >= 0) {
+            fprintf(file, ", \"queue_depth\": %d, \"queue_depth_max\": %d", queue_depth,
+                    atomic_load_explicit(&counters->max_queue_depth, memory_order_relaxed));
+        }
+
+        fprintf(file, "}\n");
+    }
+}
+
+/**
+ * Writes every counter to the temporary file and renames it over the metrics file: first a line describing the
+ * publish, then one line per attached script followed by one line per entry of it that was stepped.
+ */
+static void publish() {
+    FILE* file = fopen(temp_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open metrics file %s.\n", temp_path);
+        return;
+    }
+
+    fprintf(file, "{\"metrics\": %d, \"time_us\": %lld, \"period_us\": %lld}\n", num_publishes++,
+            (long long) clock_get_time_us(), (long long) METRICS_PUBLISH_PERIOD_US);
+
+    pthread_mutex_lock(&mutex);
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        if (channels[channel].counters != NULL) {
+            print_channel(file, channel);
+        }
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    if (fclose(file) != 0) {
+        remove(temp_path);
+        return;
+    }
+
+#ifdef _WIN32
+    remove(metrics_path);
+#endif
+    if (rename(temp_path, metrics_path) != 0) {
+        remove(temp_path);
+    }
+}
+
+static void* metrics_run(void* argument) {
+    (void) argument;
+
+    time_t next_publish_time = clock_get_time_us() + METRICS_PUBLISH_PERIOD_US;
+    while (atomic_load(&is_closing) == false) {
+        clock_sleep_until_us(clock_get_time_us() + METRICS_POLL_PERIOD_US);
+
+        const time_t current_time = clock_get_time_us();
+        if (current_time >= next_publish_time) {
+            publish();
+            next_publish_time = current_time + METRICS_PUBLISH_PERIOD_US;
+        }
+    }
+
+    return NULL;
+}
+
+static void free_entries(MetricsChannel* metrics_channel) {
+    for (int entry_idx = 0; entry_idx < metrics_channel->num_entries; entry_idx++) {
+        free(metrics_channel->ids[entry_idx]);
+    }
+
+    free(metrics_channel->ids);
+    free(metrics_channel->types);
+    free(metrics_channel->counters);
+}
+
+/**
+ * Starts counting for the given number of channels, and publishing the counters to the file at the given path every
+ * METRICS_PUBLISH_PERIOD_US. Must be called before any runtime is attached.
+ *
+ * @param channel_count
+ * @param str_path
+ */
+void metrics_open(int channel_count, const char* str_path) {
+    assert(channels == NULL, "Attempting to open metrics that are already open.");
+    assert(channel_count > 0, "Attempting to open metrics with no channels.");
+    assert(str_path != NULL, "Attempting to open metrics with NULL path.");
+
+    channels = (MetricsChannel*) calloc(channel_count, sizeof(MetricsChannel));
+    assert(channels != NULL, "Failed to allocate memory for metrics channels.");
+    num_channels = channel_count;
+
+    metrics_path = strdup(str_path);
+    temp_path = (char*) malloc(strlen(str_path) + sizeof(".tmp"));
+    assert(metrics_path != NULL && temp_path != NULL, "Failed to allocate memory for metrics path.");
+    sprintf(temp_path, "%s.tmp", str_path);
+
+    num_publishes = 0;
+    atomic_store(&is_closing, false);
+
+    const int result = pthread_create(&thread, NULL, metrics_run, NULL);
+    assert(result == 0, "Failed to create metrics thread (error %d).", result);
+}
+
+/**
+ * Stops publishing and publishes the counters one last time. Must be called after every runtime is done.
+ */
+void metrics_close() {
+    if (channels == NULL) {
+        return;
+    }
+
+    atomic_store(&is_closing, true);
+    pthread_join(thread, NULL);
+
+    publish();
+
+    for (int channel = 0; channel < num_channels; channel++) {
+        free_entries(&channels[channel]);
+        free(channels[channel].script_name);
+    }
+
+    free(channels);
+    free(metrics_path);
+    free(temp_path);
+
+    channels = NULL;
+    num_channels = 0;
+    metrics_path = NULL;
+    temp_path = NULL;
+}
+
+bool metrics_is_open() {
+    return channels != NULL;
+}
+
+/**
+ * Attaches a script with the given number of scheduler entries to the given channel, with every entry counted from
+ * zero. Only the thread running the script may attach its channel, and attaching it again replaces its entries.
+ *
+ * @param channel
+ * @param str_script_name
+ * @param num_entries
+ */
+void metrics_attach_channel(int channel, const char* str_script_name, int num_entries) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to attach invalid metrics channel %d.", channel);
+    assert(num_entries > 0, "Attempting to attach metrics channel %d with no entries.", channel);
+
+    char* script_name = strdup(str_script_name);
+    char** ids = (char**) calloc(num_entries, sizeof(char*));
+    const char** types = (const char**) calloc(num_entries, sizeof(const char*));
+    MetricsCounters* counters = (MetricsCounters*) calloc(num_entries, sizeof(MetricsCounters));
+    assert(script_name != NULL && ids != NULL && types != NULL && counters != NULL,
+           "Failed to allocate memory for metrics of %s.", str_script_name);
+
+    for (int entry_idx = 0; entry_idx < num_entries; entry_idx++) {
+        atomic_store(&counters[entry_idx].queue_depth, -1);
+    }
+
+    pthread_mutex_lock(&mutex);
+
+    MetricsChannel* metrics_channel = &channels[channel];
+    free_entries(metrics_channel);
+    free(metrics_channel->script_name);
+
+    metrics_channel->script_name = script_name;
+    metrics_channel->ids = ids;
+    metrics_channel->types = types;
+    metrics_channel->counters = counters;
+    metrics_channel->num_entries = num_entries;
+
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * Names the entry with the given index on the given channel. The id is copied; the type must outlive metrics.
+ *
+ * @param channel
+ * @param entry_idx
+ * @param id
+ * @param str_type
+ */
+void metrics_name_entry(int channel, int entry_idx, const char* id, const char* str_type) {
+    assert(channel >= 0 && channel < num_channels, "Attempting to name entry on invalid metrics channel %d.", channel);
+
+    char* id_copy = strdup(id);
+    assert(id_copy != NULL, "Failed to allocate memory for metrics entry id.");
+
+    pthread_mutex_lock(&mutex);
+
+    MetricsChannel* metrics_channel = &channels[channel];
+    assert(entry_idx >= 0 && entry_idx < metrics_channel->num_entries, "Attempting to name invalid metrics entry %d.",
+           entry_idx);
+
+    free(metrics_channel->ids[entry_idx]);
+    metrics_channel->ids[entry_idx] = id_copy;
+    metrics_channel->types[entry_idx] = str_type;
+
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * Counts one step of the given entry. Only the thread running the script of the channel may record on it. Never
+ * blocks.
+ *
+ * @param channel
+ * @param entry_idx
+ * @param step
+ */
+void metrics_record_step(int channel, int entry_idx, const MetricsStep* step) {
+    MetricsCounters* counters = &channels[channel].counters[entry_idx];
+
+    add_relaxed(&counters->num_steps, 1);
+    add_relaxed(&counters->num_executions, step->num_started);
+
+    if (step->is_blocked) {
+        add_relaxed(&counters->num_blocked, 1);
+        add_relaxed(&counters->blocked_us, step->wait_us);
+    }
+
+    if (step->queue_depth >= 0) {
+        atomic_store_explicit(&counters->queue_depth, step->queue_depth, memory_order_relaxed);
+        if (step->queue_depth > atomic_load_explicit(&counters->max_queue_depth, memory_order_relaxed)) {
+            atomic_store_explicit(&counters->max_queue_depth, step->queue_depth, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Counts one tick of the scheduler on the given channel that took the given time (us), and began the given time (us)
+ * after the deadline it was due for, or at most 0 if it began in time. Only the thread running the script of the
+ * channel may record on it. Never blocks.
+ *
+ * @param channel
+ * @param tick_us
+ * @param overrun_us
+ */
+void metrics_record_tick(int channel, time_t tick_us, time_t overrun_us) {
+    MetricsChannel* metrics_channel = &channels[channel];
+
+    add_relaxed(&metrics_channel->num_ticks, 1);
+    add_relaxed(&metrics_channel->tick_us, tick_us);
+    max_relaxed(&metrics_channel->max_tick_us, tick_us);
+
+    if (overrun_us > 0) {
+        add_relaxed(&metrics_channel->num_overruns, 1);
+        add_relaxed(&metrics_channel->overrun_us, overrun_us);
+        max_relaxed(&metrics_channel->max_overrun_us, overrun_us);
+    }
+}
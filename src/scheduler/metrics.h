@@ -0,0 +1,45 @@
+#ifndef BEANSCRIPT_METRICS_H
+#define BEANSCRIPT_METRICS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/utility/clock.h"
+#include "src/utility/utility.h"
+#include "src/main.h"
+
+/**
+ * @brief What one step of a scheduler entry did.
+ * - num_started: How many executions or passes the step began.
+ * - is_blocked: True if the step began nothing and the entry waits for a cooldown before it can (see scheduler.c).
+ * - wait_us: How long (us) a blocked entry waits until it is stepped again.
+ * - queue_depth: How many instructions of a waitlist or random were ready after the step, or -1 for any other entry.
+ */
+typedef struct {
+    int num_started;
+    bool is_blocked;
+    time_t wait_us;
+    int queue_depth;
+} MetricsStep;
+
+// Constructor and Destructor
+void    metrics_open(int channel_count, const char* str_path);
+void    metrics_close();
+
+// Accessor Functions
+bool    metrics_is_open();
+
+// Mutator Functions
+void    metrics_attach_channel(int channel, const char* str_script_name, int num_entries);
+void    metrics_name_entry(int channel, int entry_idx, const char* id, const char* str_type);
+
+// Producer Functions
+void    metrics_record_step(int channel, int entry_idx, const MetricsStep* step);
+void    metrics_record_tick(int channel, time_t tick_us, time_t overrun_us);
+
+#endif //BEANSCRIPT_METRICS_H
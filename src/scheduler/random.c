@@ -0,0 +1,320 @@
+/**
+ * @file random.c
+ *
+ * This file contains the implementation of the random. A random is a collection of instructions executed one at a time
+ * in random order, where each instruction is picked uniformly from the instructions that are available (not cooling
+ * down) at the time of the pick.
+ *
+ * Every instruction is either ready or cooling. Ready instructions are kept in a dense array, so a pick is one random
+ * index and removing the pick is a swap with the last element. Cooling instructions are kept in a timestamp queue keyed
+ * by the time they become available, and every step first moves the instructions that have become available since the
+ * last step into the ready array. Neither a pick nor a step ever scans the whole random.
+ *
+ * An instruction may be listed more than once, so both hold positions in the random rather than instruction handles,
+ * and each listing is ready or cooling on its own.
+ */
+
+#include "random.h"
+
+struct RandomStruct {
+    const char* id;
+    int id_atom;
+    Instruction* instruction;
+    UT_hash_handle hh;
+
+    int* instruction_handles;
+    int num_instructions;
+    int* ready_idxs;
+    int num_ready;
+    int capacity;
+    TimestampQueue* cooling;
+    int picked_idx;
+};
+
+/**
+ * @brief The randoms of one script, keyed by the atom of the random id.
+ */
+struct RandomMapStruct {
+    Random* randoms;
+};
+
+// The map the calling thread is working on. See random_map_bind.
+static _Thread_local RandomMap* random_map = NULL;
+
+/**
+ * Inserts a random into the random map. If a random with the same id already exists, then an assertion is thrown.
+ * @param random
+ */
+void random_map_insert(Random* random) {
+    assert(random != NULL, "Attempting to insert NULL random into random map.");
+
+    Random* current_random = NULL;
+    HASH_FIND_INT(random_map->randoms, &random->id_atom, current_random);
+    assert(current_random == NULL, "Random with id %s already exists.", random->id);
+
+    HASH_ADD_INT(random_map->randoms, id_atom, random);
+}
+
+/**
+ * Creates an empty random map.
+ *
+ * @return
+ */
+RandomMap* random_map_new() {
+    RandomMap* map = (RandomMap*) malloc(sizeof(RandomMap));
+    assert(map != NULL, "Failed to allocate memory for random map.");
+
+    map->randoms = NULL;
+    return map;
+}
+
+/**
+ * Deletes the random map and the queue of every random in it. The randoms themselves live in the script arena and are
+ * freed with the instruction map.
+ *
+ * @param ptr_map
+ */
+void random_map_delete(RandomMap** ptr_map) {
+    assert(ptr_map != NULL, "Attempting to delete random map behind NULL pointer.");
+    assert(*ptr_map != NULL, "Attempting to delete NULL random map.");
+
+    RandomMap* map = *ptr_map;
+    if (random_map == map) {
+        random_map = NULL;
+    }
+
+    Random* current_random = NULL;
+    Random* tmp = NULL;
+
+    HASH_ITER(hh, map->randoms, current_random, tmp) {
+        HASH_DEL(map->randoms, current_random);
+        random_delete(&current_random);
+    }
+
+    free(map);
+    *ptr_map = NULL;
+}
+
+/**
+ * Makes the given map the one every other random map function on the calling thread works on. May be NULL.
+ *
+ * @param map
+ */
+void random_map_bind(RandomMap* map) {
+    random_map = map;
+}
+
+/**
+ * Attempts to get a random from the random map. If a random with the given id does not exist, then NULL is returned.
+ *
+ * @param id_atom
+ * @return
+ */
+Random* random_map_get(int id_atom) {
+    Random* current_random = NULL;
+    HASH_FIND_INT(random_map->randoms, &id_atom, current_random);
+
+    return current_random;
+}
+
+/**
+ * Removes the random with the given id from the random map and returns it, or returns NULL if there is none.
+ *
+ * @param id_atom
+ * @return
+ */
+Random* random_map_remove(int id_atom) {
+    Random* current_random = random_map_get(id_atom);
+    if (current_random != NULL) {
+        HASH_DEL(random_map->randoms, current_random);
+    }
+
+    return current_random;
+}
+
+// Constructor and Destructor
+/**
+ * Creates a new random over the linked sub-instructions of the given instruction. Every sub-instruction starts ready.
+ * The random is allocated from the script arena of the bound instruction map.
+ * @param instruction
+ * @param capacity
+ * @return
+ */
+Random* random_new(Instruction* instruction, int capacity) {
+    assert(instruction != NULL, "Attempting to create random with NULL instruction.");
+    assert(capacity > 0, "Attempting to create random with capacity less than or equal to 0.");
+
+    const int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
+    assert(num_sub_instructions <= capacity, "Attempting to create random %s with capacity %d for %d instructions.",
+           instruction_get_id(instruction), capacity, num_sub_instructions);
+
+    Arena* arena = instruction_map_get_arena();
+    Random* random = (Random*) arena_alloc(arena, sizeof(Random));
+
+    random->id = instruction_get_id(instruction);
+    random->id_atom = instruction_get_id_atom(instruction);
+    random->instruction = instruction;
+    random->capacity = capacity;
+    random->cooling = timestamp_queue_new(capacity);
+
+    random->instruction_handles = (int*) arena_alloc(arena, sizeof(int) * capacity);
+    random->ready_idxs = (int*) arena_alloc(arena, sizeof(int) * capacity);
+    random->picked_idx = -1;
+
+    for (int i = 0; i < num_sub_instructions; i++) {
+        random->instruction_handles[i] = instruction_get_sub_instruction_handle(instruction, i);
+        random->ready_idxs[i] = i;
+    }
+    random->num_instructions = num_sub_instructions;
+    random->num_ready = num_sub_instructions;
+
+    return random;
+}
+
+void random_delete(Random** random) {
+    assert(random != NULL, "Attempting to delete NULL random.");
+    assert(*random != NULL, "Attempting to delete NULL *random.");
+
+    Random* ptr_random = *random;
+
+    // The random, its handles, its instruction and its id are owned by the instruction map; only the queue is the
+    // random's own.
+    timestamp_queue_delete(&ptr_random->cooling);
+    ptr_random->instruction_handles = NULL;
+    ptr_random->ready_idxs = NULL;
+    ptr_random->instruction = NULL;
+    ptr_random->id = NULL;
+
+    *random = NULL;
+}
+
+/**
+ * Returns the position in the old random of the listing a position of the random takes its cooldown from: the listing
+ * of the same instruction that is as many listings in, or -1 if there is none.
+ */
+static int find_old_idx(Random* random, Random* old_random, int idx) {
+    const int handle = random->instruction_handles[idx];
+
+    int num_earlier_listings = 0;
+    for (int earlier_idx = 0; earlier_idx < idx; earlier_idx++) {
+        num_earlier_listings += random->instruction_handles[earlier_idx] == handle;
+    }
+
+    for (int old_idx = 0; old_idx < old_random->num_instructions; old_idx++) {
+        if (old_random->instruction_handles[old_idx] == handle && num_earlier_listings-- == 0) {
+            return old_idx;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Carries the cooldowns over from the random its instruction had before the line was patched (see runtime.c): every
+ * instruction that was cooling there is cooling here until the same time. The rest are ready. An instruction listed
+ * more than once takes the cooldown of each listing in order, as far as the old random listed it as often.
+ *
+ * @param random
+ * @param old_random
+ */
+void random_migrate(Random* random, Random* old_random) {
+    assert(random != NULL && old_random != NULL, "Attempting to migrate NULL random.");
+
+    int ready_idx = 0;
+    while (ready_idx < random->num_ready) {
+        const int idx = random->ready_idxs[ready_idx];
+        const int old_idx = find_old_idx(random, old_random, idx);
+
+        if (old_idx < 0 || timestamp_queue_contains(old_random->cooling, old_idx) == false) {
+            ready_idx++;
+            continue;
+        }
+
+        timestamp_queue_push(random->cooling, timestamp_queue_get_timestamp(old_random->cooling, old_idx), idx);
+        random->num_ready--;
+        random->ready_idxs[ready_idx] = random->ready_idxs[random->num_ready];
+    }
+}
+
+/**
+ * Returns the number of instructions of the random that are available at the given time and could be picked, whether
+ * or not they have been moved to the ready array yet.
+ *
+ * @param random
+ * @param current_time
+ * @return
+ */
+int random_get_num_ready(Random* random, time_t current_time) {
+    assert(random != NULL, "Attempting to count ready instructions of NULL random.");
+
+    return random->num_ready + timestamp_queue_count_ready(random->cooling, current_time);
+}
+
+/**
+ * Resumes the picked instruction, and starts it cooling once it completes. Returns the time the random should next be
+ * stepped.
+ */
+static time_t resume_picked_instruction(Random* random, Coroutine* coroutine) {
+    time_t end_time = 0;
+    if (coroutine_resume(coroutine, &end_time) == false) {
+        return end_time;
+    }
+
+    Instruction* instruction = coroutine_get_instruction(coroutine);
+    timestamp_queue_push(random->cooling, instruction_get_available_time(instruction), random->picked_idx);
+
+    return end_time;
+}
+
+// Executors
+/**
+ * Executes an instruction picked uniformly at random from the instructions available at the given time. The executed
+ * instruction cools down until its completion time plus its cooldown. If no instruction is available, nothing is
+ * executed and the random is blocked until the earliest instruction becomes available.
+ *
+ * The picked instruction is executed by the given coroutine, which yields whenever time has to pass; while it is
+ * running, each step resumes it and returns the time it yields. The instruction starts cooling once it completes.
+ *
+ * An empty random never becomes ready, in which case -1 is returned.
+ *
+ * @param random
+ * @param coroutine The coroutine of the random's scheduler entry.
+ * @param current_time
+ * @return The time at which the random should next be stepped, or -1.
+ */
+time_t random_step(Random* random, Coroutine* coroutine, time_t current_time) {
+    assert(random != NULL, "Attempting to execute NULL random.");
+
+    if (coroutine_is_running(coroutine)) {
+        return resume_picked_instruction(random, coroutine);
+    }
+
+    random->num_ready += timestamp_queue_pop_ready(random->cooling, current_time, random->ready_idxs + random->num_ready,
+                                                   random->capacity - random->num_ready);
+
+    if (random->num_ready == 0) {
+        if (timestamp_queue_get_size(random->cooling) == 0) {
+            return -1;
+        }
+
+        return timestamp_queue_peek_timestamp(random->cooling);
+    }
+
+    const int picked_ready_idx = (int) rng_sample_range(0, random->num_ready - 1);
+    const int idx = random->ready_idxs[picked_ready_idx];
+
+    random->num_ready--;
+    random->ready_idxs[picked_ready_idx] = random->ready_idxs[random->num_ready];
+
+    Instruction* instruction = instruction_table_get(random->instruction_handles[idx]);
+
+    if (coroutine_start(coroutine, instruction, current_time) == false) {
+        // The instruction is shared with another scheduler and is cooling down or in flight there; pick again straight
+        // away.
+        timestamp_queue_push(random->cooling, instruction_get_available_time(instruction), idx);
+        return current_time;
+    }
+
+    random->picked_idx = idx;
+    return resume_picked_instruction(random, coroutine);
+}
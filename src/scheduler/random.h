@@ -0,0 +1,36 @@
+
+#ifndef BEANSCRIPT_RANDOM_H
+#define BEANSCRIPT_RANDOM_H
+
+#include <stdio.h>
+
+#include "src/parser/instruction.h"
+#include "src/scheduler/coroutine.h"
+#include "src/utility/uthash.h"
+#include "src/utility/timestamp_queue.h"
+
+typedef struct RandomStruct Random;
+typedef struct RandomMapStruct RandomMap;
+
+// Collection Functions
+RandomMap* random_map_new();
+void random_map_delete(RandomMap** ptr_map);
+void random_map_bind(RandomMap* map);
+void random_map_insert(Random* random);
+Random* random_map_get(int id_atom);
+Random* random_map_remove(int id_atom);
+
+// Constructor and Destructor
+Random* random_new(Instruction* instruction, int capacity);
+void random_delete(Random** random);
+
+// Mutator Functions
+void random_migrate(Random* random, Random* old_random);
+
+// Accessor Functions
+int random_get_num_ready(Random* random, time_t current_time);
+
+// Executors
+time_t random_step(Random* random, Coroutine* coroutine, time_t current_time);
+
+#endif //BEANSCRIPT_RANDOM_H
@@ -11,16 +11,28 @@
 #include "routine.h"
 
 struct RoutineStruct {
-    char* id;
+    const char* id;
+    int id_atom;
     Instruction* instruction;
     UT_hash_handle hh;
 
-    StrList* instruction_ids;
+    int* instruction_handles;
+    int size;
+    int capacity;
+    int resize_value;
     int current_idx;
     int bound_idx;
 };
 
-static Routine* routines = NULL;
+/**
+ * @brief The routines of one script, keyed by the atom of the routine id.
+ */
+struct RoutineMapStruct {
+    Routine* routines;
+};
+
+// The map the calling thread is working on. See routine_map_bind.
+static _Thread_local RoutineMap* routine_map = NULL;
 
 /**
  * Inserts a routine into the routine map. If a routine with the same id already exists, then an assertion is thrown.
@@ -28,42 +40,80 @@ static Routine* routines = NULL;
  */
 void routine_map_insert(Routine* routine) {
     assert(routine != NULL, "Attempting to insert NULL routine into routine map.");
-    assert(strchr(routine->id, '\0') != NULL, "Routine id does not contain a null character.");
 
     Routine* current_routine = NULL;
-    HASH_FIND_STR(routines, routine->id, current_routine);
+    HASH_FIND_INT(routine_map->routines, &routine->id_atom, current_routine);
     assert(current_routine == NULL, "Routine with id %s already exists.", routine->id);
 
-    HASH_ADD_STR(routines, id, routine);
+    HASH_ADD_INT(routine_map->routines, id_atom, routine);
 }
 
 /**
- * Clears the routine map and frees all memory associated with it.
+ * Creates an empty routine map.
+ *
+ * @return
  */
-void routine_map_clear() {
-    Routine* current_routine = NULL;
-    Routine* tmp = NULL;
+RoutineMap* routine_map_new() {
+    RoutineMap* map = (RoutineMap*) malloc(sizeof(RoutineMap));
+    assert(map != NULL, "Failed to allocate memory for routine map.");
 
-    HASH_ITER(hh, routines, current_routine, tmp) {
-        HASH_DEL(routines, current_routine);
-        free(current_routine);
+    map->routines = NULL;
+    return map;
+}
+
+/**
+ * Deletes the routine map. The routines live in the script arena and are freed with the instruction map.
+ *
+ * @param ptr_map
+ */
+void routine_map_delete(RoutineMap** ptr_map) {
+    assert(ptr_map != NULL, "Attempting to delete routine map behind NULL pointer.");
+    assert(*ptr_map != NULL, "Attempting to delete NULL routine map.");
+
+    RoutineMap* map = *ptr_map;
+    if (routine_map == map) {
+        routine_map = NULL;
     }
 
-    routines = NULL;
+    HASH_CLEAR(hh, map->routines);
+
+    free(map);
+    *ptr_map = NULL;
+}
+
+/**
+ * Makes the given map the one every other routine map function on the calling thread works on. May be NULL.
+ *
+ * @param map
+ */
+void routine_map_bind(RoutineMap* map) {
+    routine_map = map;
 }
 
 /**
  * Attempts to get a routine from the routine map. If a routine with the given id does not exist, then NULL is returned.
  *
- * @param id
+ * @param id_atom
  * @return
  */
-Routine* routine_map_get(const char* id) {
-    assert(id != NULL, "Attempting to get routine from routine map with NULL id.");
-    assert(strchr(id, '\0') != NULL, "Routine id does not contain a null character.");
-
+Routine* routine_map_get(int id_atom) {
     Routine* current_routine = NULL;
-    HASH_FIND_STR(routines, id, current_routine);
+    HASH_FIND_INT(routine_map->routines, &id_atom, current_routine);
+
+    return current_routine;
+}
+
+/**
+ * Removes the routine with the given id from the routine map and returns it, or returns NULL if there is none.
+ *
+ * @param id_atom
+ * @return
+ */
+Routine* routine_map_remove(int id_atom) {
+    Routine* current_routine = routine_map_get(id_atom);
+    if (current_routine != NULL) {
+        HASH_DEL(routine_map->routines, current_routine);
+    }
 
     return current_routine;
 }
@@ -74,18 +124,36 @@ void routine_map_print() {
     Routine* tmp = NULL;
 
     printf("Routines [");
-    HASH_ITER(hh, routines, current_routine, tmp) {
+    HASH_ITER(hh, routine_map->routines, current_routine, tmp) {
         printf("%s\n", current_routine->id);
     }
 
     printf("]\n");
 }
 
+/**
+ * Expands the instruction handle array by resize_value if it is full.
+ *
+ * @param routine
+ */
+static void expand_handles_if_necessary(Routine* routine) {
+    if (routine->size < routine->capacity) {
+        return;
+    }
+
+    const int capacity = routine->capacity;
+    routine->capacity += routine->resize_value;
+    routine->instruction_handles = (int*) arena_grow(instruction_map_get_arena(), routine->instruction_handles,
+                                                     sizeof(int) * capacity, sizeof(int) * routine->capacity);
+}
+
 /**
  * Creates a new routine based on the given instruction. The resize value is used to determine the initial size of the
- * instruction id list. The resize value should be greater than 0.
+ * instruction handle array. The resize value should be greater than 0.
  *
- * The sub-instructions of the given instruction are deep copied to the instruction id list.
+ * The linked sub-instruction handles of the given instruction are copied to the instruction handle array, so the
+ * instruction must have been linked (see instruction_map_link). The routine is allocated from the script arena of the
+ * bound instruction map.
  *
  * @param id
  */
@@ -96,15 +164,19 @@ Routine* routine_new(Instruction* instruction, int resize_value) {
     InstructionType instruction_type = instruction_get_type(instruction);
     assert(instruction_type_is_scheduler(instruction_type), "Attempting to create routine with instruction that is not a routine.");
 
-    Routine* routine = malloc(sizeof(Routine));
-    routine->id = instruction_get_id(instruction); // This is a shallow copy because uthash requires an id field.
+    Routine* routine = (Routine*) arena_alloc(instruction_map_get_arena(), sizeof(Routine));
+    routine->id = instruction_get_id(instruction);
+    routine->id_atom = instruction_get_id_atom(instruction);
     routine->instruction = instruction;
-    routine->instruction_ids = str_list_new(resize_value, false);
+    routine->instruction_handles = NULL;
+    routine->size = 0;
+    routine->capacity = 0;
+    routine->resize_value = resize_value;
 
     int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
     for(int idx = 0; idx < num_sub_instructions; idx++) {
-        char* sub_instruction_id = instruction_get_sub_instruction_by_index(instruction, idx);
-        str_list_insert_str(routine->instruction_ids, sub_instruction_id);
+        expand_handles_if_necessary(routine);
+        routine->instruction_handles[routine->size++] = instruction_get_sub_instruction_handle(instruction, idx);
     }
 
     routine->current_idx = 0;
@@ -114,7 +186,8 @@ Routine* routine_new(Instruction* instruction, int resize_value) {
 }
 
 /**
- * Deletes the given routine and frees all memory associated with it.
+ * Deletes the given routine. The routine and its handles live in the script arena, so nothing is freed until the
+ * instruction map is.
  *
  * @param routine
  */
@@ -122,13 +195,11 @@ void routine_delete(Routine** routine) {
     assert(routine != NULL, "Attempting to delete NULL routine.");
     assert(*routine != NULL, "Attempting to delete NULL routine.");
 
-    free((*routine)->id);
+    // The id is a shallow copy of the instruction id, which is owned by the instruction map.
     (*routine)->id = NULL;
+    (*routine)->instruction = NULL;
+    (*routine)->instruction_handles = NULL;
 
-    str_list_delete(&((*routine)->instruction_ids));
-    (*routine)->instruction_ids = NULL;
-
-    free(*routine);
     *routine = NULL;
 }
 
@@ -142,31 +213,79 @@ void routine_insert_instruction(Routine* routine, Instruction* instruction) {
     assert(routine != NULL, "Attempting to insert instruction into NULL routine.");
     assert(instruction != NULL, "Attempting to insert NULL instruction into routine.");
 
-    char* instruction_id = instruction_get_id(instruction);
-    str_list_insert_str(routine->instruction_ids, instruction_id);
+    const int handle = instruction_get_handle(instruction);
+    assert(handle >= 0, "Attempting to insert unlinked instruction into routine.");
+
+    expand_handles_if_necessary(routine);
+    routine->instruction_handles[routine->size++] = handle;
 
     if (routine->bound_idx == -1) {
-        routine->bound_idx = str_list_get_size(routine->instruction_ids);
+        routine->bound_idx = routine->size;
+    }
+}
+
+/**
+ * Carries the position of a routine over from the routine its instruction had before the line was patched (see
+ * runtime.c). The routine picks up at the instruction the old routine would have executed next, wherever that
+ * instruction now is in the routine. If it was removed, the routine picks up at the same index instead.
+ *
+ * @param routine
+ * @param old_routine
+ */
+void routine_migrate(Routine* routine, Routine* old_routine) {
+    assert(routine != NULL && old_routine != NULL, "Attempting to migrate NULL routine.");
+
+    if (routine->size == 0 || old_routine->size == 0) {
+        return;
+    }
+
+    const int old_handle = old_routine->instruction_handles[old_routine->current_idx];
+    routine->current_idx = old_routine->current_idx < routine->size ? old_routine->current_idx : 0;
+
+    for (int idx = 0; idx < routine->size; idx++) {
+        if (routine->instruction_handles[idx] == old_handle) {
+            routine->current_idx = idx;
+            break;
+        }
     }
 }
 
 /**
- * Attempts to execute the next available routine instruction. If the routine cannot be executed, then nothing happens.
- * If the routine is executed, then the current index is incremented. If the current index is greater than the size of
- * the routine, then the current index is reset to 0. If the routine is bound to a specific index, then the current
- * index is reset to 0 and the bound index is reset to -1.
+ * Attempts to execute the current routine instruction at the given time. If the instruction is not available (i.e., it
+ * is on cooldown, or in flight in another entry), then the routine is blocked and the time the instruction becomes
+ * available is returned. If the instruction is executed, then the current index is incremented and the time the
+ * instruction completes is returned. If the current index is greater than the size of the routine, then the current
+ * index is reset to 0. If the routine is bound to a specific index, then the current index is reset to 0 and the bound
+ * index is reset to -1.
+ *
+ * The instruction is executed by the given coroutine, which yields whenever time has to pass; while it is running, each
+ * step resumes it and returns the time it yields. The current index moves on once the instruction completes.
+ *
+ * A routine without instructions never becomes ready again, in which case -1 is returned.
  *
  * @param routine
+ * @param coroutine The coroutine of the routine's scheduler entry.
+ * @param current_time
+ * @return The time at which the routine should next be stepped, or -1.
  */
-static void routine_execute_(Routine* routine) {
+time_t routine_step(Routine* routine, Coroutine* coroutine, time_t current_time) {
     assert(routine != NULL, "Attempting to iterate NULL routine.");
 
-    char* instruction_id = str_list_get_str(routine->instruction_ids, routine->current_idx);
-    Instruction* instruction = instruction_map_get(instruction_id);
-    assert(instruction != NULL, "Attempting to get instruction with id %s from instruction map.", instruction_id);
+    if (routine->size == 0) {
+        return -1;
+    }
 
-    if(instruction_execute(instruction) == false) {
-        return;
+    if (coroutine_is_running(coroutine) == false) {
+        Instruction* instruction = instruction_table_get(routine->instruction_handles[routine->current_idx]);
+
+        if (coroutine_start(coroutine, instruction, current_time) == false) {
+            return instruction_get_available_time(instruction);
+        }
+    }
+
+    time_t end_time = current_time;
+    if (coroutine_resume(coroutine, &end_time) == false) {
+        return end_time;
     }
 
     routine->current_idx++;
@@ -174,18 +293,9 @@ static void routine_execute_(Routine* routine) {
     if (routine->bound_idx >= 0 && routine->current_idx >= routine->bound_idx) {
         routine->current_idx = 0;
         routine->bound_idx = -1;
-    }else if (routine->current_idx >= str_list_get_size(routine->instruction_ids)) {
+    }else if (routine->current_idx >= routine->size) {
         routine->current_idx = 0;
     }
-}
-
-void routine_execute() {
-    Routine* current_routine = NULL;
-    Routine* tmp = NULL;
 
-    HASH_ITER(hh, routines, current_routine, tmp) {
-        routine_execute_(current_routine);
-    }
+    return end_time;
 }
-
-
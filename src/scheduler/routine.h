@@ -5,9 +5,20 @@
 #include <stdio.h>
 
 #include "src/parser/instruction.h"
+#include "src/scheduler/coroutine.h"
 #include "src/utility/uthash.h"
 
 typedef struct RoutineStruct Routine;
+typedef struct RoutineMapStruct RoutineMap;
+
+// Collection Functions
+RoutineMap* routine_map_new();
+void routine_map_delete(RoutineMap** ptr_map);
+void routine_map_bind(RoutineMap* map);
+void routine_map_insert(Routine* routine);
+Routine* routine_map_get(int id_atom);
+Routine* routine_map_remove(int id_atom);
+void routine_map_print();
 
 // Constructor and Destructor
 Routine* routine_new(Instruction* instruction, int resize_value);
@@ -15,8 +26,9 @@ void routine_delete(Routine** routine);
 
 // Mutator Functions
 void routine_insert_instruction(Routine* routine, Instruction* instruction);
+void routine_migrate(Routine* routine, Routine* old_routine);
 
 // Executors
-void routine_execute();
+time_t routine_step(Routine* routine, Coroutine* coroutine, time_t current_time);
 
 #endif //BEANSCRIPT_ROUTINE_H
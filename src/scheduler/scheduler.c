@@ -0,0 +1,721 @@
+/**
+ * @file scheduler.c
+ *
+ * The scheduler of a script. Every started routine, waitlist, random and instruction, as well as the script body, is an entry in
+ * a single min-heap ordered by the monotonic time (us, see clock.h) the entry next needs to run. The runtime sleeps
+ * until the earliest deadline, steps that entry, and re-inserts it with the deadline the step returns. Nothing is
+ * polled: an entry that is blocked (e.g., a routine waiting on a cooldown) is simply scheduled for the time it unblocks.
+ *
+ * Entries are allocated once per instruction handle when the script is linked, so starting and stopping a target never
+ * looks anything up by id.
+ *
+ * An entry may be blocked by an instruction that another entry is executing (see instruction_acquire). It waits until
+ * that entry next resumes, which may be the time it is stepped at. Such an entry is deferred: it runs after every other
+ * entry due at the same time, so the entry it waits on always runs first, and waiting never spins. Entries due at the
+ * same time that are both deferred, or both not, run in the order they were pushed, so no deferred entry is passed over
+ * by the others indefinitely while it holds what they wait on.
+ *
+ * Every entry executes its instructions through its own coroutine (see coroutine.c), which runs a pass only until time
+ * has to pass and is then re-inserted with the time it yields. A stop takes effect between passes: a pass in flight is
+ * finished first, so it never leaves a key it pressed held down.
+ *
+ * Each script has its own scheduler. The functions below work on the scheduler bound to the calling thread (see
+ * scheduler_bind), so instructions can start and stop targets without carrying their runtime around.
+ *
+ * When an edit is patched into a script (see runtime.c), its scheduler is suspended: every entry is set aside with its
+ * deadline as soon as no pass of it is in flight, until none is left in the heap. The entries of the instructions the
+ * patch changed are then brought up to date (scheduler_relink), and every entry set aside is resumed where it was
+ * (scheduler_resume). Every other entry is left exactly as it was.
+ *
+ * While metrics are published (see metrics.c), every step of an entry is counted on the channel of its script. A step
+ * is blocked if it began nothing and the entry waits until later, i.e. on the cooldown of an instruction; it waits
+ * from the deadline it was stepped at until the deadline it returns.
+ */
+
+#include "scheduler.h"
+
+typedef enum {
+    SCHEDULER_ENTRY_SEQUENCE,
+    SCHEDULER_ENTRY_ROUTINE,
+    SCHEDULER_ENTRY_WAITLIST,
+    SCHEDULER_ENTRY_RANDOM,
+} SchedulerEntryType;
+
+/**
+ * @brief A schedulable entry.
+ * - type: How the entry is stepped. Routines, waitlists and randoms step their own collection; every other started
+ *   instruction (and the script body) is a sequence of instructions executed one pass at a time.
+ * - routine, waitlist, random: The collection stepped by routine, waitlist and random entries.
+ * - handles, num_handles: The instructions of a sequence entry. A started instruction is a sequence of itself.
+ * - sequence_idx: The index of the current instruction in a sequence entry.
+ * - remaining_passes: The passes left of the current instruction of a sequence entry, or -1 if it repeats forever.
+ * - is_running_instruction: True once the current instruction of a sequence entry has begun its first pass.
+ * - coroutine: Executes the current pass or instruction of the entry. Created when the entry is first scheduled.
+ * - deadline: The time the entry next runs.
+ * - stop_time: The time from which the entry no longer runs.
+ * - heap_idx: The position of the entry in the heap, or -1 if the entry is not scheduled.
+ * - is_suspended: True if the entry was set aside with its deadline by scheduler_suspend instead of being scheduled.
+ * - is_deferred: True if the last step of the entry asked to run again at the time it ran at, e.g. to wait on an
+ *   instruction in flight. The entry then runs after every other entry due at its deadline.
+ * - push_order: The number of pushes to the heap before the entry was last pushed. Breaks the tie between entries due
+ *   at the same time, so they run first in, first out.
+ */
+typedef struct {
+    SchedulerEntryType type;
+    Routine* routine;
+    Waitlist* waitlist;
+    Random* random;
+
+    const int* handles;
+    int num_handles;
+    int sequence_idx;
+    int remaining_passes;
+    bool is_running_instruction;
+    int self_handle;
+    Coroutine* coroutine;
+
+    time_t deadline;
+    time_t stop_time;
+    int heap_idx;
+    bool is_suspended;
+    bool is_deferred;
+    uint64_t push_order;
+} SchedulerEntry;
+
+static const time_t SCHEDULER_NEVER = (time_t) INT64_MAX;
+
+/**
+ * @brief The scheduling state of one script.
+ * - entries: One entry per instruction handle, followed by the script body.
+ * - heap: A binary min-heap of entry indices ordered by deadline.
+ * - num_pushes: The number of entries pushed to the heap so far (see SchedulerEntry.push_order).
+ * - suspend_time: The time from which no pass is begun and every entry is set aside instead, or SCHEDULER_NEVER.
+ * - metrics_channel: The channel every step is counted on (see metrics.c), or -1 if steps are not counted.
+ */
+struct SchedulerStruct {
+    SchedulerEntry* entries;
+    int num_entries;
+
+    int* heap;
+    int heap_size;
+    uint64_t num_pushes;
+    time_t suspend_time;
+    int metrics_channel;
+};
+
+// The scheduler the calling thread is working on. See scheduler_bind.
+static _Thread_local Scheduler* scheduler = NULL;
+
+static bool heap_is_less(int heap_idx_a, int heap_idx_b) {
+    const SchedulerEntry* entry_a = &scheduler->entries[scheduler->heap[heap_idx_a]];
+    const SchedulerEntry* entry_b = &scheduler->entries[scheduler->heap[heap_idx_b]];
+
+    if (entry_a->deadline != entry_b->deadline) {
+        return entry_a->deadline < entry_b->deadline;
+    }
+
+    if (entry_a->is_deferred != entry_b->is_deferred) {
+        return entry_b->is_deferred;
+    }
+
+    return entry_a->push_order < entry_b->push_order;
+}
+
+static void heap_swap(int heap_idx_a, int heap_idx_b) {
+    const int tmp = scheduler->heap[heap_idx_a];
+    scheduler->heap[heap_idx_a] = scheduler->heap[heap_idx_b];
+    scheduler->heap[heap_idx_b] = tmp;
+
+    scheduler->entries[scheduler->heap[heap_idx_a]].heap_idx = heap_idx_a;
+    scheduler->entries[scheduler->heap[heap_idx_b]].heap_idx = heap_idx_b;
+}
+
+static void heap_sift_up(int heap_idx) {
+    while (heap_idx > 0) {
+        const int parent_idx = (heap_idx - 1) / 2;
+        if (heap_is_less(heap_idx, parent_idx) == false) {
+            return;
+        }
+
+        heap_swap(heap_idx, parent_idx);
+        heap_idx = parent_idx;
+    }
+}
+
+static void heap_sift_down(int heap_idx) {
+    while (true) {
+        const int left_child_idx = 2 * heap_idx + 1;
+        const int right_child_idx = left_child_idx + 1;
+        int min_idx = heap_idx;
+
+        if (left_child_idx < scheduler->heap_size && heap_is_less(left_child_idx, min_idx)) {
+            min_idx = left_child_idx;
+        }
+
+        if (right_child_idx < scheduler->heap_size && heap_is_less(right_child_idx, min_idx)) {
+            min_idx = right_child_idx;
+        }
+
+        if (min_idx == heap_idx) {
+            return;
+        }
+
+        heap_swap(heap_idx, min_idx);
+        heap_idx = min_idx;
+    }
+}
+
+/**
+ * Inserts the entry into the heap, keeping its place among the entries due at the same time.
+ */
+static void heap_insert(int entry_idx) {
+    assert(scheduler->heap_size < scheduler->num_entries, "Attempting to push to full scheduler heap.");
+
+    scheduler->heap[scheduler->heap_size] = entry_idx;
+    scheduler->entries[entry_idx].heap_idx = scheduler->heap_size;
+    scheduler->heap_size++;
+
+    heap_sift_up(scheduler->heap_size - 1);
+}
+
+/**
+ * Inserts the entry into the heap behind every entry already due at the same time.
+ */
+static void heap_push(int entry_idx) {
+    scheduler->entries[entry_idx].push_order = scheduler->num_pushes++;
+    heap_insert(entry_idx);
+}
+
+static int heap_pop() {
+    assert(scheduler->heap_size > 0, "Attempting to pop from empty scheduler heap.");
+
+    const int entry_idx = scheduler->heap[0];
+    scheduler->heap_size--;
+
+    if (scheduler->heap_size > 0) {
+        scheduler->heap[0] = scheduler->heap[scheduler->heap_size];
+        scheduler->entries[scheduler->heap[0]].heap_idx = 0;
+        heap_sift_down(0);
+    }
+
+    scheduler->entries[entry_idx].heap_idx = -1;
+    return entry_idx;
+}
+
+/**
+ * Steps a sequence entry. The current instruction waits for its cooldown, or for an execution of it in flight
+ * elsewhere, before its first pass, then runs its passes one after another, each resumed until it yields. Once its
+ * passes are exhausted its cooldown starts and the entry moves on to the next instruction. No pass is begun at or after
+ * the stop time.
+ *
+ * @param entry
+ * @param current_time
+ * @return The time at which the entry should next be stepped, or -1 if the sequence is complete.
+ */
+static time_t scheduler_step_sequence(SchedulerEntry* entry, time_t current_time) {
+    while (entry->sequence_idx < entry->num_handles) {
+        Instruction* instruction = instruction_table_get(entry->handles[entry->sequence_idx]);
+
+        if (coroutine_is_running(entry->coroutine) && coroutine_resume(entry->coroutine, &current_time) == false) {
+            return current_time;
+        }
+
+        if (entry->is_running_instruction == false) {
+            if (instruction_is_available(instruction, current_time) == false) {
+                return instruction_get_available_time(instruction);
+            }
+
+            entry->remaining_passes = instruction_sample_num_passes(instruction);
+            entry->is_running_instruction = true;
+        }
+
+        if (entry->remaining_passes != 0) {
+            if (current_time >= entry->stop_time || current_time >= scheduler->suspend_time) {
+                return current_time;
+            }
+
+            if (entry->remaining_passes > 0) {
+                entry->remaining_passes--;
+            }
+
+            coroutine_start_pass(entry->coroutine, instruction, current_time);
+            continue;
+        }
+
+        instruction_complete(instruction, current_time);
+        entry->is_running_instruction = false;
+        entry->sequence_idx++;
+    }
+
+    entry->sequence_idx = 0;
+    return -1;
+}
+
+static time_t scheduler_step(SchedulerEntry* entry, time_t current_time) {
+    switch (entry->type) {
+        case SCHEDULER_ENTRY_ROUTINE:
+            return routine_step(entry->routine, entry->coroutine, current_time);
+        case SCHEDULER_ENTRY_WAITLIST:
+            return waitlist_step(entry->waitlist, entry->coroutine, current_time);
+        case SCHEDULER_ENTRY_RANDOM:
+            return random_step(entry->random, entry->coroutine, current_time);
+        case SCHEDULER_ENTRY_SEQUENCE:
+        default:
+            return scheduler_step_sequence(entry, current_time);
+    }
+}
+
+/**
+ * Counts a step of the entry that returned the given deadline. The entry still holds the deadline it was stepped at.
+ *
+ * @param entry
+ * @param was_running True if the coroutine of the entry was in the middle of an execution before the step.
+ * @param num_starts The number of executions or passes the coroutine had started before the step.
+ * @param next_deadline
+ */
+static void scheduler_record_step(SchedulerEntry* entry, bool was_running, long long num_starts, time_t next_deadline) {
+    const int num_started = (int) (coroutine_get_num_starts(entry->coroutine) - num_starts);
+    const bool is_blocked = was_running == false && num_started == 0 && next_deadline > entry->deadline;
+
+    MetricsStep step = {
+        .num_started = num_started,
+        .is_blocked = is_blocked,
+        .wait_us = is_blocked ? next_deadline - entry->deadline : 0,
+        .queue_depth = -1,
+    };
+
+    switch (entry->type) {
+        case SCHEDULER_ENTRY_WAITLIST:
+            step.queue_depth = waitlist_get_num_ready(entry->waitlist, entry->deadline);
+            break;
+        case SCHEDULER_ENTRY_RANDOM:
+            step.queue_depth = random_get_num_ready(entry->random, entry->deadline);
+            break;
+        default:
+            break;
+    }
+
+    metrics_record_step(scheduler->metrics_channel, (int) (entry - scheduler->entries), &step);
+}
+
+static void scheduler_schedule(int entry_idx, time_t start_time) {
+    SchedulerEntry* entry = &scheduler->entries[entry_idx];
+    entry->stop_time = SCHEDULER_NEVER;
+
+    if (entry->heap_idx >= 0 || entry->is_suspended) {
+        return;
+    }
+
+    if (entry->coroutine == NULL) {
+        entry->coroutine = coroutine_new();
+    }
+
+    entry->sequence_idx = 0;
+    entry->is_running_instruction = false;
+    entry->deadline = start_time;
+    entry->is_deferred = false;
+
+    if (scheduler->suspend_time != SCHEDULER_NEVER) {
+        entry->is_suspended = true;
+        return;
+    }
+
+    heap_push(entry_idx);
+}
+
+/**
+ * Sets up the entry with the given index as a sequence of its own instruction that is not scheduled.
+ */
+static void init_entry(SchedulerEntry* entry, int entry_idx) {
+    entry->type = SCHEDULER_ENTRY_SEQUENCE;
+    entry->routine = NULL;
+    entry->waitlist = NULL;
+    entry->random = NULL;
+    entry->handles = &entry->self_handle;
+    entry->num_handles = 1;
+    entry->sequence_idx = 0;
+    entry->remaining_passes = 0;
+    entry->is_running_instruction = false;
+    entry->self_handle = entry_idx;
+    entry->coroutine = NULL;
+    entry->deadline = SCHEDULER_NEVER;
+    entry->stop_time = SCHEDULER_NEVER;
+    entry->heap_idx = -1;
+    entry->is_suspended = false;
+    entry->is_deferred = false;
+    entry->push_order = 0;
+}
+
+/**
+ * Points the entry of the instruction with the given handle at the routine, waitlist or random of the instruction, or
+ * makes it a sequence of the instruction if it has none.
+ */
+static void link_entry(SchedulerEntry* entry, int handle) {
+    Instruction* instruction = instruction_table_get(handle);
+    const char* id = instruction_get_id(instruction);
+    const int id_atom = instruction_get_id_atom(instruction);
+
+    entry->type = SCHEDULER_ENTRY_SEQUENCE;
+    entry->routine = NULL;
+    entry->waitlist = NULL;
+    entry->random = NULL;
+
+    switch (instruction_get_type(instruction)) {
+        case ROUTINE:
+            entry->type = SCHEDULER_ENTRY_ROUTINE;
+            entry->routine = routine_map_get(id_atom);
+            assert(entry->routine != NULL, "Routine %s was not linked.", id);
+            break;
+        case WAITLIST:
+            entry->type = SCHEDULER_ENTRY_WAITLIST;
+            entry->waitlist = waitlist_map_get(id_atom);
+            assert(entry->waitlist != NULL, "Waitlist %s was not linked.", id);
+            break;
+        case RANDOM:
+            entry->type = SCHEDULER_ENTRY_RANDOM;
+            entry->random = random_map_get(id_atom);
+            assert(entry->random != NULL, "Random %s was not linked.", id);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Creates a scheduler with an entry for every linked instruction and for the script body. Must be called after the
+ * bound instruction map, routines, waitlists and randoms have been linked.
+ *
+ * @param body_handles The top-level instructions of the script, executed in order by scheduler_start_body.
+ * @param num_body_handles
+ * @return
+ */
+Scheduler* scheduler_new(const int* body_handles, int num_body_handles) {
+    Scheduler* new_scheduler = (Scheduler*) malloc(sizeof(Scheduler));
+    assert(new_scheduler != NULL, "Failed to allocate memory for scheduler.");
+
+    const int num_instructions = instruction_table_get_size();
+    new_scheduler->num_entries = num_instructions + 1;
+
+    new_scheduler->entries = (SchedulerEntry*) malloc(sizeof(SchedulerEntry) * new_scheduler->num_entries);
+    assert(new_scheduler->entries != NULL, "Failed to allocate memory for scheduler entries.");
+
+    new_scheduler->heap = (int*) malloc(sizeof(int) * new_scheduler->num_entries);
+    assert(new_scheduler->heap != NULL, "Failed to allocate memory for scheduler heap.");
+    new_scheduler->heap_size = 0;
+    new_scheduler->num_pushes = 0;
+    new_scheduler->suspend_time = SCHEDULER_NEVER;
+    new_scheduler->metrics_channel = -1;
+
+    for (int entry_idx = 0; entry_idx < new_scheduler->num_entries; entry_idx++) {
+        SchedulerEntry* entry = &new_scheduler->entries[entry_idx];
+        init_entry(entry, entry_idx);
+
+        if (entry_idx == num_instructions) {
+            entry->handles = body_handles;
+            entry->num_handles = num_body_handles;
+            continue;
+        }
+
+        link_entry(entry, entry_idx);
+    }
+
+    return new_scheduler;
+}
+
+/**
+ * Frees the scheduler and its entries. Routines, waitlists and randoms are owned by their maps.
+ */
+void scheduler_delete(Scheduler** ptr_scheduler) {
+    assert(ptr_scheduler != NULL, "Attempting to delete scheduler behind NULL pointer.");
+    assert(*ptr_scheduler != NULL, "Attempting to delete NULL scheduler.");
+
+    Scheduler* old_scheduler = *ptr_scheduler;
+    if (scheduler == old_scheduler) {
+        scheduler = NULL;
+    }
+
+    for (int entry_idx = 0; entry_idx < old_scheduler->num_entries; entry_idx++) {
+        if (old_scheduler->entries[entry_idx].coroutine != NULL) {
+            coroutine_delete(&old_scheduler->entries[entry_idx].coroutine);
+        }
+    }
+
+    free(old_scheduler->entries);
+    free(old_scheduler->heap);
+    free(old_scheduler);
+    *ptr_scheduler = NULL;
+}
+
+/**
+ * Makes the given scheduler the one every other scheduler function on the calling thread works on. May be NULL.
+ */
+void scheduler_bind(Scheduler* bound_scheduler) {
+    scheduler = bound_scheduler;
+}
+
+/**
+ * Counts every step of the bound scheduler on the given channel (see metrics.c), which must be attached. May be -1 to
+ * stop counting.
+ */
+void scheduler_set_metrics_channel(int channel) {
+    assert(scheduler != NULL, "Attempting to set metrics channel without a bound scheduler.");
+
+    scheduler->metrics_channel = channel;
+}
+
+/**
+ * Schedules the script body to run from the given time.
+ */
+void scheduler_start_body(time_t start_time) {
+    assert(scheduler != NULL, "Attempting to start body without a bound scheduler.");
+
+    scheduler_schedule(scheduler->num_entries - 1, start_time);
+}
+
+/**
+ * Starts the given instruction at the given time. Routines, waitlists and randoms begin stepping their collection; any other
+ * instruction runs each of its passes. Starting an instruction that is already running cancels any pending stop and
+ * otherwise does nothing.
+ */
+void scheduler_start(Instruction* instruction, time_t start_time) {
+    assert(instruction != NULL, "Attempting to start NULL instruction.");
+    assert(scheduler != NULL, "Attempting to start instruction without a bound scheduler.");
+
+    scheduler_schedule(instruction_get_handle(instruction), start_time);
+}
+
+static void scheduler_stop_entry(SchedulerEntry* entry, time_t stop_time) {
+    if (entry->is_suspended) {
+        entry->stop_time = stop_time;
+        entry->deadline = stop_time < entry->deadline ? stop_time : entry->deadline;
+        return;
+    }
+
+    if (entry->heap_idx < 0) {
+        return;
+    }
+
+    entry->stop_time = stop_time;
+
+    // Bring the entry forward so a long-blocked entry is removed when the stop takes effect. An entry in the middle of
+    // a pass must not run early, and is removed once the pass is done.
+    if (stop_time < entry->deadline && coroutine_is_running(entry->coroutine) == false) {
+        entry->deadline = stop_time;
+        entry->is_deferred = false;
+        heap_sift_up(entry->heap_idx);
+    }
+}
+
+/**
+ * Stops the given instruction from the given time. A step that would run at or after the stop time does not run,
+ * except to finish the pass or instruction in flight. If the instruction is not running, nothing happens.
+ */
+void scheduler_stop(Instruction* instruction, time_t stop_time) {
+    assert(instruction != NULL, "Attempting to stop NULL instruction.");
+    assert(scheduler != NULL, "Attempting to stop instruction without a bound scheduler.");
+
+    scheduler_stop_entry(&scheduler->entries[instruction_get_handle(instruction)], stop_time);
+}
+
+/**
+ * Stops everything that is running, including the script body, from the given time. Passes in flight are finished as
+ * with scheduler_stop.
+ */
+void scheduler_stop_all(time_t stop_time) {
+    assert(scheduler != NULL, "Attempting to stop everything without a bound scheduler.");
+
+    for (int entry_idx = 0; entry_idx < scheduler->num_entries; entry_idx++) {
+        scheduler_stop_entry(&scheduler->entries[entry_idx], stop_time);
+    }
+}
+
+/**
+ * Returns true if the given instruction is scheduled to run.
+ */
+bool scheduler_is_running(Instruction* instruction) {
+    assert(instruction != NULL, "Attempting to check if NULL instruction is running.");
+    assert(scheduler != NULL, "Attempting to check instruction without a bound scheduler.");
+
+    const SchedulerEntry* entry = &scheduler->entries[instruction_get_handle(instruction)];
+    return entry->heap_idx >= 0 || entry->is_suspended;
+}
+
+/**
+ * Returns the earliest deadline of any scheduled entry, or -1 if nothing is scheduled.
+ */
+time_t scheduler_get_next_deadline() {
+    if (scheduler->heap_size == 0) {
+        return -1;
+    }
+
+    return scheduler->entries[scheduler->heap[0]].deadline;
+}
+
+/**
+ * Runs every entry that is due at the given time. Each entry is stepped at its own deadline rather than the current
+ * time so that timing errors do not accumulate across steps.
+ */
+void scheduler_tick(time_t current_time) {
+    while (scheduler->heap_size > 0 && scheduler->entries[scheduler->heap[0]].deadline <= current_time) {
+        const int entry_idx = heap_pop();
+        SchedulerEntry* entry = &scheduler->entries[entry_idx];
+
+        if (entry->deadline >= entry->stop_time && coroutine_is_running(entry->coroutine) == false) {
+            entry->is_running_instruction = false;
+            continue;
+        }
+
+        const bool was_running = coroutine_is_running(entry->coroutine);
+        const long long num_starts = coroutine_get_num_starts(entry->coroutine);
+        const time_t next_deadline = scheduler_step(entry, entry->deadline);
+
+        if (scheduler->metrics_channel >= 0) {
+            scheduler_record_step(entry, was_running, num_starts, next_deadline);
+        }
+
+        if (next_deadline < 0) {
+            continue;
+        }
+
+        entry->is_deferred = next_deadline == entry->deadline;
+        entry->deadline = next_deadline;
+        if (scheduler->suspend_time != SCHEDULER_NEVER && coroutine_is_running(entry->coroutine) == false) {
+            entry->is_suspended = true;
+            continue;
+        }
+
+        heap_push(entry_idx);
+    }
+}
+
+/**
+ * Suspends the scheduler from the given time: every entry is set aside with its deadline once no pass of it is in
+ * flight, and anything started afterwards is set aside instead of scheduled. Entries in the middle of a pass are
+ * stepped until the pass is done, so no key is left held down. Once the next deadline is -1 every entry has been set
+ * aside, and the scheduler can be brought up to date with a patch and resumed (see scheduler_resume).
+ */
+void scheduler_suspend(time_t suspend_time) {
+    assert(scheduler != NULL, "Attempting to suspend without a bound scheduler.");
+
+    scheduler->suspend_time = suspend_time;
+
+    // Rebuild the heap from the entries with a pass in flight. Each push lands at or before the slot just read.
+    const int heap_size = scheduler->heap_size;
+    scheduler->heap_size = 0;
+
+    for (int heap_idx = 0; heap_idx < heap_size; heap_idx++) {
+        const int entry_idx = scheduler->heap[heap_idx];
+        SchedulerEntry* entry = &scheduler->entries[entry_idx];
+
+        if (coroutine_is_running(entry->coroutine)) {
+            heap_insert(entry_idx);
+        } else {
+            entry->heap_idx = -1;
+            entry->is_suspended = true;
+        }
+    }
+}
+
+/**
+ * Brings the suspended, bound scheduler up to date with a patch of its script (see runtime.c), once every entry has
+ * been set aside. The scheduler gets an entry for every record the patch added. The entry of every changed record is
+ * linked again; if it is stepped another way now, it starts over when it is resumed, and the entry of a removed record
+ * is dropped. The body moves on to the given handles and picks up at the same instruction, with the passes it had left,
+ * if that instruction is still in the body.
+ *
+ * @param changed_handles The records whose type or collection may have changed.
+ * @param num_changed_handles
+ * @param body_handles The new top-level instructions of the script.
+ * @param num_body_handles
+ */
+void scheduler_relink(const int* changed_handles, int num_changed_handles, const int* body_handles,
+                      int num_body_handles) {
+    assert(scheduler != NULL, "Attempting to relink without a bound scheduler.");
+    assert(scheduler->heap_size == 0, "Attempting to relink scheduler with entries in the heap.");
+
+    const int num_instructions = instruction_table_get_size();
+    const int old_num_entries = scheduler->num_entries;
+    const SchedulerEntry old_body = scheduler->entries[old_num_entries - 1];
+
+    if (num_instructions + 1 > old_num_entries) {
+        scheduler->num_entries = num_instructions + 1;
+
+        scheduler->entries = (SchedulerEntry*) realloc(scheduler->entries,
+                                                       sizeof(SchedulerEntry) * scheduler->num_entries);
+        scheduler->heap = (int*) realloc(scheduler->heap, sizeof(int) * scheduler->num_entries);
+        assert(scheduler->entries != NULL && scheduler->heap != NULL,
+               "Failed to allocate memory for scheduler entries.");
+
+        // Every entry that is a sequence of itself points into the array, which may have moved.
+        for (int entry_idx = 0; entry_idx < old_num_entries - 1; entry_idx++) {
+            scheduler->entries[entry_idx].handles = &scheduler->entries[entry_idx].self_handle;
+        }
+
+        for (int entry_idx = old_num_entries - 1; entry_idx < num_instructions; entry_idx++) {
+            init_entry(&scheduler->entries[entry_idx], entry_idx);
+        }
+    }
+
+    for (int idx = 0; idx < num_changed_handles; idx++) {
+        SchedulerEntry* entry = &scheduler->entries[changed_handles[idx]];
+        const SchedulerEntryType old_type = entry->type;
+
+        link_entry(entry, changed_handles[idx]);
+
+        const bool is_removed = instruction_get_type(instruction_table_get(changed_handles[idx])) == NONE;
+        if (entry->type != old_type || is_removed) {
+            entry->sequence_idx = 0;
+            entry->remaining_passes = 0;
+            entry->is_running_instruction = false;
+        }
+
+        if (is_removed) {
+            entry->is_suspended = false;
+            entry->stop_time = SCHEDULER_NEVER;
+        }
+    }
+
+    SchedulerEntry* body = &scheduler->entries[num_instructions];
+    *body = old_body;
+    body->handles = body_handles;
+    body->num_handles = num_body_handles;
+
+    const int old_sequence_idx = old_body.sequence_idx;
+    const int old_handle = old_sequence_idx < old_body.num_handles ? old_body.handles[old_sequence_idx] : -1;
+    body->sequence_idx = old_sequence_idx < num_body_handles ? old_sequence_idx : num_body_handles;
+    body->remaining_passes = 0;
+    body->is_running_instruction = false;
+
+    for (int sequence_idx = 0; old_handle >= 0 && sequence_idx < num_body_handles; sequence_idx++) {
+        if (body_handles[sequence_idx] == old_handle) {
+            body->sequence_idx = sequence_idx;
+            body->remaining_passes = old_body.remaining_passes;
+            body->is_running_instruction = old_body.is_running_instruction;
+            break;
+        }
+    }
+}
+
+/**
+ * Schedules every entry of the bound scheduler that was set aside while it was suspended (see scheduler_suspend) at
+ * the deadline it was set aside with, and lifts the suspension. No entry is resumed before the given time.
+ *
+ * @param resume_time
+ */
+void scheduler_resume(time_t resume_time) {
+    assert(scheduler != NULL, "Attempting to resume without a bound scheduler.");
+
+    for (int entry_idx = 0; entry_idx < scheduler->num_entries; entry_idx++) {
+        SchedulerEntry* entry = &scheduler->entries[entry_idx];
+        if (entry->is_suspended == false) {
+            continue;
+        }
+
+        entry->is_suspended = false;
+        entry->deadline = entry->deadline > resume_time ? entry->deadline : resume_time;
+        entry->is_deferred = false;
+        heap_push(entry_idx);
+    }
+
+    scheduler->suspend_time = SCHEDULER_NEVER;
+}
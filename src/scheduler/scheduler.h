@@ -0,0 +1,42 @@
+#ifndef BEANSCRIPT_SCHEDULER_H
+#define BEANSCRIPT_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "src/parser/instruction.h"
+#include "src/scheduler/coroutine.h"
+#include "src/scheduler/metrics.h"
+#include "src/scheduler/random.h"
+#include "src/scheduler/routine.h"
+#include "src/scheduler/waitlist.h"
+#include "src/utility/utility.h"
+#include "src/main.h"
+
+typedef struct SchedulerStruct Scheduler;
+
+// Constructor and Destructor
+Scheduler*  scheduler_new(const int* body_handles, int num_body_handles);
+void        scheduler_delete(Scheduler** ptr_scheduler);
+void        scheduler_bind(Scheduler* bound_scheduler);
+
+// Mutator Functions
+void    scheduler_start_body(time_t start_time);
+void    scheduler_start(Instruction* instruction, time_t start_time);
+void    scheduler_stop(Instruction* instruction, time_t stop_time);
+void    scheduler_stop_all(time_t stop_time);
+void    scheduler_suspend(time_t suspend_time);
+void    scheduler_relink(const int* changed_handles, int num_changed_handles, const int* body_handles,
+                         int num_body_handles);
+void    scheduler_resume(time_t resume_time);
+void    scheduler_set_metrics_channel(int channel);
+
+// Accessor Functions
+bool    scheduler_is_running(Instruction* instruction);
+time_t  scheduler_get_next_deadline();
+
+// Executors
+void    scheduler_tick(time_t current_time);
+
+#endif //BEANSCRIPT_SCHEDULER_H
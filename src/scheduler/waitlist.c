@@ -1,15 +1,36 @@
 
 #include "waitlist.h"
 
+/**
+ * @brief
+ * - instruction_handles, num_instructions, capacity: The handle of the instruction at every position of the waitlist.
+ *   An instruction may be listed more than once, so the queue is keyed by position, and each listing has its own
+ *   availability.
+ * - queue: Every position of the waitlist, keyed by the time its instruction is next available.
+ * - running_idx: The position of the instruction being executed, if the coroutine of the waitlist is running.
+ */
 struct WaitlistStruct {
-    char* id;
+    const char* id;
+    int id_atom;
     Instruction* instruction;
     UT_hash_handle hh;
 
+    int* instruction_handles;
+    int num_instructions;
+    int capacity;
     TimestampQueue* queue;
+    int running_idx;
+};
+
+/**
+ * @brief The waitlists of one script, keyed by the atom of the waitlist id.
+ */
+struct WaitlistMapStruct {
+    Waitlist* waitlists;
 };
 
-static Waitlist* waitlists = NULL;
+// The map the calling thread is working on. See waitlist_map_bind.
+static _Thread_local WaitlistMap* waitlist_map = NULL;
 
 /**
  * Inserts a waitlist into the waitlist map. If a waitlist with the same id already exists, then an assertion is thrown.
@@ -17,42 +38,87 @@ static Waitlist* waitlists = NULL;
  */
 void waitlist_map_insert(Waitlist* waitlist) {
     assert(waitlist != NULL, "Attempting to insert NULL waitlist into waitlist map.");
-    assert(strchr(waitlist->id, '\0') != NULL, "Waitlist id does not contain a null character.");
 
     Waitlist *current_waitlist = NULL;
-    HASH_FIND_STR(waitlists, waitlist->id, current_waitlist);
+    HASH_FIND_INT(waitlist_map->waitlists, &waitlist->id_atom, current_waitlist);
     assert(current_waitlist == NULL, "Waitlist with id %s already exists.", waitlist->id);
 
-    HASH_ADD_STR(waitlists, id, waitlist);
+    HASH_ADD_INT(waitlist_map->waitlists, id_atom, waitlist);
 }
 
 /**
- * Clears the waitlist map and frees all memory associated with it.
+ * Creates an empty waitlist map.
+ *
+ * @return
  */
-void waitlist_map_clear() {
-    Waitlist *current_waitlist = NULL;
-    Waitlist *tmp = NULL;
+WaitlistMap* waitlist_map_new() {
+    WaitlistMap* map = (WaitlistMap*) malloc(sizeof(WaitlistMap));
+    assert(map != NULL, "Failed to allocate memory for waitlist map.");
 
-    HASH_ITER(hh, waitlists, current_waitlist, tmp) {
-        HASH_DEL(waitlists, current_waitlist);
-        free(current_waitlist);
+    map->waitlists = NULL;
+    return map;
+}
+
+/**
+ * Deletes the waitlist map and the queue of every waitlist in it. The waitlists themselves live in the script arena and
+ * are freed with the instruction map.
+ *
+ * @param ptr_map
+ */
+void waitlist_map_delete(WaitlistMap** ptr_map) {
+    assert(ptr_map != NULL, "Attempting to delete waitlist map behind NULL pointer.");
+    assert(*ptr_map != NULL, "Attempting to delete NULL waitlist map.");
+
+    WaitlistMap* map = *ptr_map;
+    if (waitlist_map == map) {
+        waitlist_map = NULL;
     }
 
-    waitlists = NULL;
+    Waitlist* current_waitlist = NULL;
+    Waitlist* tmp = NULL;
+
+    HASH_ITER(hh, map->waitlists, current_waitlist, tmp) {
+        HASH_DEL(map->waitlists, current_waitlist);
+        waitlist_delete(&current_waitlist);
+    }
+
+    free(map);
+    *ptr_map = NULL;
+}
+
+/**
+ * Makes the given map the one every other waitlist map function on the calling thread works on. May be NULL.
+ *
+ * @param map
+ */
+void waitlist_map_bind(WaitlistMap* map) {
+    waitlist_map = map;
 }
 
 /**
  * Attempts to get a waitlist from the waitlist map. If a waitlist with the given id does not exist, then NULL is returned.
  *
- * @param id
+ * @param id_atom
  * @return
  */
-Waitlist* waitlist_map_get(const char* id) {
-    assert(id != NULL, "Attempting to get waitlist from waitlist map with NULL id.");
-    assert(strchr(id, '\0') != NULL, "Waitlist id does not contain a null character.");
-
+Waitlist* waitlist_map_get(int id_atom) {
     Waitlist *current_waitlist = NULL;
-    HASH_FIND_STR(waitlists, id, current_waitlist);
+    HASH_FIND_INT(waitlist_map->waitlists, &id_atom, current_waitlist);
+
+    return current_waitlist;
+}
+
+/**
+ * Removes the waitlist with the given id from the waitlist map and returns it, or returns NULL if there is none.
+ *
+ * @param id_atom
+ * @return
+ */
+Waitlist* waitlist_map_remove(int id_atom) {
+    Waitlist* current_waitlist = waitlist_map_get(id_atom);
+    if (current_waitlist != NULL) {
+        HASH_DEL(waitlist_map->waitlists, current_waitlist);
+    }
 
     return current_waitlist;
 }
@@ -63,7 +129,8 @@ Waitlist* waitlist_map_get(const char* id) {
 
 // Constructor and Destructor
 /**
- * Creates a new waitlist with the given instruction and resize value.
+ * Creates a new waitlist with the given instruction and resize value, allocated from the script arena of the bound
+ * instruction map.
  * @param instruction
  * @param resize_value
  * @return
@@ -72,17 +139,21 @@ Waitlist* waitlist_new(Instruction* instruction, int capacity) {
     assert(instruction != NULL, "Attempting to create waitlist with NULL instruction.");
     assert(capacity > 0, "Attempting to create waitlist with capacity less than or equal to 0.");
 
-    Waitlist* waitlist = (Waitlist*) malloc(sizeof(Waitlist));
-    assert(waitlist != NULL, "Failed to allocate memory for waitlist.");
+    Arena* arena = instruction_map_get_arena();
+    Waitlist* waitlist = (Waitlist*) arena_alloc(arena, sizeof(Waitlist));
 
-    waitlist->id = instruction_get_id(instruction); // This is a shallow copy because uthash requires an id field.
+    waitlist->id = instruction_get_id(instruction);
+    waitlist->id_atom = instruction_get_id_atom(instruction);
     waitlist->instruction = instruction;
-    waitlist->queue = str_timestamp_queue_new(capacity, false);
+    waitlist->instruction_handles = (int*) arena_alloc(arena, sizeof(int) * capacity);
+    waitlist->num_instructions = 0;
+    waitlist->capacity = capacity;
+    waitlist->queue = timestamp_queue_new(capacity);
+    waitlist->running_idx = -1;
 
     int num_sub_instructions = instruction_get_num_sub_instructions(instruction);
     for(int i = 0; i < num_sub_instructions; i++) {
-        char* sub_instruction_id = instruction_get_sub_instruction_by_index(instruction, i);
-        str_timestamp_queue_push(waitlist->queue, (time_t) 0, sub_instruction_id);
+        waitlist_insert_instruction(waitlist, instruction_get_linked_sub_instruction(instruction, i));
     }
 
     return waitlist;
@@ -94,44 +165,134 @@ void waitlist_delete(Waitlist** waitlist) {
 
     Waitlist* ptr_waitlist = *waitlist;
 
-    str_timestamp_queue_delete(&(ptr_waitlist->queue));
-    instruction_delete(&(ptr_waitlist->instruction));
+    // The waitlist, its handles, its instruction and its id are owned by the instruction map; only the queue is the
+    // waitlist's own.
+    timestamp_queue_delete(&(ptr_waitlist->queue));
+    ptr_waitlist->instruction_handles = NULL;
+    ptr_waitlist->instruction = NULL;
+    ptr_waitlist->id = NULL;
 
-    free(ptr_waitlist);
     *waitlist = NULL;
 }
 
 // Mutator Functions
-void waitlist_insert_instruction(Waitlist* waitlist, Waitlist* instruction) {
+/**
+ * Inserts the given instruction at the end of the given waitlist, available at once. The same instruction may be
+ * inserted more than once.
+ *
+ * @param waitlist
+ * @param instruction
+ */
+void waitlist_insert_instruction(Waitlist* waitlist, Instruction* instruction) {
     assert(waitlist != NULL, "Attempting to insert instruction into NULL waitlist.");
     assert(instruction != NULL, "Attempting to insert NULL instruction into waitlist.");
 
-    str_timestamp_queue_push(waitlist->queue, (time_t) 0, instruction->id);
+    const int handle = instruction_get_handle(instruction);
+    assert(handle >= 0, "Attempting to insert unlinked instruction into waitlist.");
+    assert(waitlist->num_instructions < waitlist->capacity, "Attempting to insert instruction into full waitlist %s.",
+           waitlist->id);
+
+    const int idx = waitlist->num_instructions++;
+    waitlist->instruction_handles[idx] = handle;
+    timestamp_queue_push(waitlist->queue, (time_t) 0, idx);
 }
 
-// Executors
+/**
+ * Carries the availability of every instruction over from the waitlist its instruction had before the line was patched
+ * (see runtime.c), so an instruction that was waiting out its cooldown keeps waiting. New instructions are available at
+ * once. An instruction listed more than once takes the availability of each listing in order, as far as the old
+ * waitlist listed it as often.
+ *
+ * @param waitlist
+ * @param old_waitlist
+ */
+void waitlist_migrate(Waitlist* waitlist, Waitlist* old_waitlist) {
+    assert(waitlist != NULL && old_waitlist != NULL, "Attempting to migrate NULL waitlist.");
 
+    for (int idx = 0; idx < waitlist->num_instructions; idx++) {
+        const int handle = waitlist->instruction_handles[idx];
 
-void waitlist_execute() {
-    assert(waitlists != NULL, "Attempting to execute waitlist with NULL waitlists.");
+        int num_earlier_listings = 0;
+        for (int earlier_idx = 0; earlier_idx < idx; earlier_idx++) {
+            num_earlier_listings += waitlist->instruction_handles[earlier_idx] == handle;
+        }
 
-    Waitlist *current_waitlist = NULL;
-    Waitlist *tmp = NULL;
+        for (int old_idx = 0; old_idx < old_waitlist->num_instructions; old_idx++) {
+            if (old_waitlist->instruction_handles[old_idx] != handle || num_earlier_listings-- > 0) {
+                continue;
+            }
 
-    // for each waitlist in the waitlist map
-    HASH_ITER(hh, waitlists, current_waitlist, tmp) {
+            const time_t available_time = timestamp_queue_get_timestamp(old_waitlist->queue, old_idx);
+            timestamp_queue_update(waitlist->queue, idx, available_time);
+            break;
+        }
+    }
+}
 
-        TimestampQueue* queue = current_waitlist->queue;
-        while(str_timestamp_queue_can_pop(queue)) {
-            char* instruction_id = str_timestamp_queue_peek_value(queue);
-            Instruction* instruction = instruction_map_get(instruction_id);
-            assert(instruction != NULL, "Instruction with id %s does not exist.", instruction_id);
-            time_t cooldown = instruction_get_parameter_lower_value(instruction, COOLDOWN);
-            time_t updated_timestamp = (time_t) get_current_time() + cooldown;
+// Accessor Functions
+/**
+ * Returns the number of instructions of the waitlist that are available at the given time, including the one it is
+ * executing.
+ *
+ * @param waitlist
+ * @param current_time
+ * @return
+ */
+int waitlist_get_num_ready(Waitlist* waitlist, time_t current_time) {
+    assert(waitlist != NULL, "Attempting to count ready instructions of NULL waitlist.");
 
-            str_timestamp_queue_pop(queue, updated_timestamp);
+    return timestamp_queue_count_ready(waitlist->queue, current_time);
+}
 
-            instruction_execute(instruction);
+// Executors
+/**
+ * Executes the waitlist instruction with the lowest availability if it is available at the given time. The executed
+ * instruction is re-queued with the time it becomes available again (its completion time plus its cooldown). If the
+ * instruction is not yet available, nothing is executed.
+ *
+ * The instruction is executed by the given coroutine, which yields whenever time has to pass; while it is running, each
+ * step resumes it and returns the time it yields. The instruction is re-queued once it completes.
+ *
+ * An empty waitlist never becomes ready, in which case -1 is returned.
+ *
+ * @param waitlist
+ * @param coroutine The coroutine of the waitlist's scheduler entry.
+ * @param current_time
+ * @return The time at which the waitlist should next be stepped, or -1.
+ */
+time_t waitlist_step(Waitlist* waitlist, Coroutine* coroutine, time_t current_time) {
+    assert(waitlist != NULL, "Attempting to execute NULL waitlist.");
+
+    TimestampQueue* queue = waitlist->queue;
+
+    if (coroutine_is_running(coroutine) == false) {
+        if (timestamp_queue_get_size(queue) == 0) {
+            return -1;
+        }
+
+        if (timestamp_queue_can_pop(queue, current_time) == false) {
+            return timestamp_queue_peek_timestamp(queue);
         }
+
+        const int idx = timestamp_queue_peek_handle(queue);
+        Instruction* instruction = instruction_table_get(waitlist->instruction_handles[idx]);
+
+        if (coroutine_start(coroutine, instruction, current_time) == false) {
+            // The instruction is shared with another scheduler and is cooling down or in flight there.
+            timestamp_queue_pop(queue, instruction_get_available_time(instruction));
+            return current_time;
+        }
+
+        waitlist->running_idx = idx;
     }
-}
\ No newline at end of file
+
+    time_t end_time = current_time;
+    if (coroutine_resume(coroutine, &end_time) == false) {
+        return end_time;
+    }
+
+    Instruction* instruction = coroutine_get_instruction(coroutine);
+    timestamp_queue_update(queue, waitlist->running_idx, instruction_get_available_time(instruction));
+
+    return end_time;
+}
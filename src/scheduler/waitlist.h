@@ -3,22 +3,35 @@
 #define BEANSCRIPT_WAITLIST_H
 
 #include <stdio.h>
-#include <sys/time.h>
 
 #include "src/parser/instruction.h"
+#include "src/scheduler/coroutine.h"
 #include "src/utility/uthash.h"
-#include "src/utility/str_timestamp_queue.h"
+#include "src/utility/timestamp_queue.h"
 
 typedef struct WaitlistStruct Waitlist;
+typedef struct WaitlistMapStruct WaitlistMap;
+
+// Collection Functions
+WaitlistMap* waitlist_map_new();
+void waitlist_map_delete(WaitlistMap** ptr_map);
+void waitlist_map_bind(WaitlistMap* map);
+void waitlist_map_insert(Waitlist* waitlist);
+Waitlist* waitlist_map_get(int id_atom);
+Waitlist* waitlist_map_remove(int id_atom);
 
 // Constructor and Destructor
 Waitlist* waitlist_new(Instruction* instruction, int resize_value);
 void waitlist_delete(Waitlist** waitlist);
 
 // Mutator Functions
-void waitlist_insert_instruction(Waitlist* waitlist, Waitlist* instruction);
+void waitlist_insert_instruction(Waitlist* waitlist, Instruction* instruction);
+void waitlist_migrate(Waitlist* waitlist, Waitlist* old_waitlist);
+
+// Accessor Functions
+int waitlist_get_num_ready(Waitlist* waitlist, time_t current_time);
 
 // Executors
-void waitlist_execute();
+time_t waitlist_step(Waitlist* waitlist, Coroutine* coroutine, time_t current_time);
 
 #endif //BEANSCRIPT_WAITLIST_H
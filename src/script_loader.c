@@ -0,0 +1,532 @@
+/**
+ * @file script_loader.c
+ *
+ * The loader: lists every script (.bs) in a directory, so one can be picked to run, and keeps each of them compiled in
+ * memory so that running the one picked takes no time.
+ *
+ * Listing a script only reads its header, the `script` and `window` lines at the top of the file (see
+ * script_header.c), so the list is ready at once however many scripts there are. The scripts are then compiled in the
+ * background by a few threads, in the order they are listed, each into a runtime that is not attached to a channel yet
+ * (see runtime_try_load). Taking a script hands its compiled runtime over. A script that is taken before its turn is
+ * compiled on the spot, and one that is still being compiled is waited for. A script is only compiled again when it is
+ * taken again, or when it is taken and its file changed since it was compiled; a script that is running keeps up with
+ * its own edits (see runtime_watch).
+ *
+ * A script that does not compile does not stop the program, since it may never be picked: its error is kept and only
+ * reported if it is taken (see script_loader_prompt). It is compiled again once its file changes.
+ */
+
+#include "script_loader.h"
+
+static const char SCRIPT_LOADER_EXTENSION[] = ".bs";
+
+// The longest selection that is read whole.
+#define SCRIPT_LOADER_MAX_LINE_LENGTH 1024
+
+// How many threads compile in the background where the number of processors is not known.
+static const int SCRIPT_LOADER_DEFAULT_NUM_THREADS = 4;
+
+// The longest compile error that is kept.
+#define SCRIPT_LOADER_MAX_ERROR_LENGTH ASSERT_MAX_MESSAGE_LENGTH
+
+typedef enum {
+    SCRIPT_ENTRY_QUEUED,
+    SCRIPT_ENTRY_COMPILING,
+    SCRIPT_ENTRY_COMPILED,
+    SCRIPT_ENTRY_TAKEN,
+} ScriptEntryState;
+
+/**
+ * @brief One script of the directory.
+ * - path: The file of the script.
+ * - header: The header of the script (see script_header.c), or NULL if its file could not be read.
+ * - state: Whether the script is waiting to be compiled, being compiled, compiled, or was taken and is not compiled
+ *   again until it is taken again. Guarded by the loader's mutex.
+ * - runtime: The compiled script while it is compiled without an error, otherwise NULL. Guarded by the loader's mutex.
+ * - error: The error the script failed to compile with while it is compiled, otherwise NULL. Guarded by the loader's
+ *   mutex.
+ * - mtime, size: The signature of the file when the script was last compiled, to tell whether it changed since.
+ */
+typedef struct {
+    char* path;
+    ScriptHeader* header;
+    ScriptEntryState state;
+    Runtime* runtime;
+    char* error;
+    time_t mtime;
+    long long size;
+} ScriptEntry;
+
+/**
+ * @brief The scripts of a directory, sorted by file name, and the threads compiling them.
+ * - num_queued: The number of scripts waiting to be compiled.
+ * - queued_cond: Signalled when a script is queued or the loader closes.
+ * - compiled_cond: Signalled when a script finishes compiling.
+ */
+struct ScriptLoaderStruct {
+    ScriptEntry* entries;
+    int num_entries;
+    pthread_t* threads;
+    int num_threads;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t queued_cond;
+    pthread_cond_t compiled_cond;
+    int num_queued;
+    bool is_closing;
+};
+
+static bool is_script_file(const char* str_file_name) {
+    const size_t length = strlen(str_file_name);
+    const size_t extension_length = sizeof(SCRIPT_LOADER_EXTENSION) - 1;
+
+    return length > extension_length &&
+           strcmp(str_file_name + length - extension_length, SCRIPT_LOADER_EXTENSION) == 0;
+}
+
+static char* join_path(const char* str_directory, const char* str_file_name) {
+    if (strcmp(str_directory, ".") == 0) {
+        char* path = strdup(str_file_name);
+        assert(path != NULL, "Failed to allocate memory for script path.");
+        return path;
+    }
+
+    const size_t directory_length = strlen(str_directory);
+    const bool has_separator = directory_length > 0 && str_directory[directory_length - 1] == '/';
+    char* path = (char*) malloc(directory_length + strlen(str_file_name) + 2);
+    assert(path != NULL, "Failed to allocate memory for script path.");
+
+    sprintf(path, has_separator ? "%s%s" : "%s/%s", str_directory, str_file_name);
+    return path;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    return strcmp(((const ScriptEntry*) a)->path, ((const ScriptEntry*) b)->path);
+}
+
+/**
+ * Lists every script in the directory with its headers, sorted by file name.
+ */
+static void scan_directory(ScriptLoader* loader, const char* str_directory) {
+    DIR* directory = opendir(str_directory);
+    assert(directory != NULL, "Failed to open script directory %s.", str_directory);
+
+    int capacity = 0;
+    struct dirent* directory_entry = NULL;
+    while ((directory_entry = readdir(directory)) != NULL) {
+        if (is_script_file(directory_entry->d_name) == false) {
+            continue;
+        }
+
+        char* path = join_path(str_directory, directory_entry->d_name);
+        struct stat file_stat;
+        if (stat(path, &file_stat) != 0 || S_ISREG(file_stat.st_mode) == false) {
+            free(path);
+            continue;
+        }
+
+        if (loader->num_entries == capacity) {
+            capacity = capacity > 0 ? 2 * capacity : 16;
+            loader->entries = (ScriptEntry*) realloc(loader->entries, sizeof(ScriptEntry) * capacity);
+            assert(loader->entries != NULL, "Failed to allocate memory for script entries.");
+        }
+
+        loader->entries[loader->num_entries++] = (ScriptEntry) {
+            .path = path,
+            .header = NULL,
+            .state = SCRIPT_ENTRY_QUEUED,
+            .runtime = NULL,
+            .error = NULL,
+            .mtime = 0,
+            .size = -1,
+        };
+    }
+
+    closedir(directory);
+
+    if (loader->num_entries > 1) {
+        qsort(loader->entries, loader->num_entries, sizeof(ScriptEntry), compare_entries);
+    }
+
+    for (int idx = 0; idx < loader->num_entries; idx++) {
+        loader->entries[idx].header = script_header_read(loader->entries[idx].path);
+    }
+}
+
+/**
+ * Reads the modification time and size of the file, or leaves them as they are and returns false if it cannot be
+ * read.
+ */
+static bool get_file_signature(const char* path, time_t* mtime, long long* size) {
+    struct stat file_stat;
+    if (stat(path, &file_stat) != 0) {
+        return false;
+    }
+
+    *mtime = (time_t) file_stat.st_mtime;
+    *size = (long long) file_stat.st_size;
+    return true;
+}
+
+/**
+ * Compiles the script of the entry, which the caller has marked as compiling, without holding the loader's mutex.
+ * Returns the runtime, or NULL with the error if the script does not compile. The signature of the file is read first,
+ * so an edit made while the script compiles counts as a change.
+ */
+static Runtime* compile_entry(ScriptEntry* entry, char** str_error) {
+    get_file_signature(entry->path, &entry->mtime, &entry->size);
+
+    char error[SCRIPT_LOADER_MAX_ERROR_LENGTH];
+    Runtime* runtime = runtime_try_load(entry->path, error, sizeof(error));
+
+    *str_error = NULL;
+    if (runtime == NULL) {
+        *str_error = strdup(error);
+        assert(*str_error != NULL, "Failed to allocate memory for compile error of %s.", entry->path);
+    }
+
+    return runtime;
+}
+
+/**
+ * Returns true if the compiled entry no longer matches its file.
+ */
+static bool is_entry_stale(const ScriptEntry* entry) {
+    if (entry->runtime != NULL) {
+        return runtime_is_current(entry->runtime) == false;
+    }
+
+    time_t mtime = 0;
+    long long size = -1;
+    return get_file_signature(entry->path, &mtime, &size) == false || mtime != entry->mtime || size != entry->size;
+}
+
+/**
+ * Compiles queued scripts, first listed first, until the loader closes.
+ */
+static void* script_loader_work(void* argument) {
+    ScriptLoader* loader = (ScriptLoader*) argument;
+
+    pthread_mutex_lock(&loader->mutex);
+    while (true) {
+        while (loader->is_closing == false && loader->num_queued == 0) {
+            pthread_cond_wait(&loader->queued_cond, &loader->mutex);
+        }
+
+        if (loader->is_closing) {
+            break;
+        }
+
+        int idx = 0;
+        while (loader->entries[idx].state != SCRIPT_ENTRY_QUEUED) {
+            idx++;
+        }
+
+        ScriptEntry* entry = &loader->entries[idx];
+        entry->state = SCRIPT_ENTRY_COMPILING;
+        loader->num_queued--;
+        pthread_mutex_unlock(&loader->mutex);
+
+        char* error = NULL;
+        Runtime* runtime = compile_entry(entry, &error);
+
+        pthread_mutex_lock(&loader->mutex);
+        entry->runtime = runtime;
+        entry->error = error;
+        entry->state = SCRIPT_ENTRY_COMPILED;
+        pthread_cond_broadcast(&loader->compiled_cond);
+    }
+
+    pthread_mutex_unlock(&loader->mutex);
+    return NULL;
+}
+
+/**
+ * Lists every script in the directory and starts compiling them in the background on the given number of threads.
+ *
+ * @param str_directory
+ * @param num_threads
+ * @return
+ */
+ScriptLoader* script_loader_new(const char* str_directory, int num_threads) {
+    assert(str_directory != NULL, "Attempting to load scripts from NULL directory.");
+    assert(num_threads > 0, "Attempting to create script loader with %d threads.", num_threads);
+
+    ScriptLoader* loader = (ScriptLoader*) malloc(sizeof(ScriptLoader));
+    assert(loader != NULL, "Failed to allocate memory for script loader.");
+
+    loader->entries = NULL;
+    loader->num_entries = 0;
+    scan_directory(loader, str_directory);
+
+    pthread_mutex_init(&loader->mutex, NULL);
+    pthread_cond_init(&loader->queued_cond, NULL);
+    pthread_cond_init(&loader->compiled_cond, NULL);
+    loader->num_queued = loader->num_entries;
+    loader->is_closing = false;
+
+    loader->num_threads = num_threads < loader->num_entries ? num_threads : loader->num_entries;
+    loader->threads = (pthread_t*) malloc(sizeof(pthread_t) * (loader->num_threads > 0 ? loader->num_threads : 1));
+    assert(loader->threads != NULL, "Failed to allocate memory for script loader threads.");
+
+    for (int idx = 0; idx < loader->num_threads; idx++) {
+        const int result = pthread_create(&loader->threads[idx], NULL, script_loader_work, loader);
+        assert(result == 0, "Failed to create script loader thread (error %d).", result);
+    }
+
+    return loader;
+}
+
+/**
+ * Stops compiling, once the scripts being compiled are done, and frees every script the loader still holds.
+ *
+ * @param ptr_loader
+ */
+void script_loader_delete(ScriptLoader** ptr_loader) {
+    assert(ptr_loader != NULL, "Attempting to delete script loader behind NULL pointer.");
+    assert(*ptr_loader != NULL, "Attempting to delete NULL script loader.");
+
+    ScriptLoader* loader = *ptr_loader;
+
+    pthread_mutex_lock(&loader->mutex);
+    loader->is_closing = true;
+    pthread_cond_broadcast(&loader->queued_cond);
+    pthread_mutex_unlock(&loader->mutex);
+
+    for (int idx = 0; idx < loader->num_threads; idx++) {
+        pthread_join(loader->threads[idx], NULL);
+    }
+
+    for (int idx = 0; idx < loader->num_entries; idx++) {
+        ScriptEntry* entry = &loader->entries[idx];
+        if (entry->runtime != NULL) {
+            runtime_delete(&entry->runtime);
+        }
+
+        free(entry->error);
+
+        if (entry->header != NULL) {
+            script_header_delete(&entry->header);
+        }
+
+        free(entry->path);
+    }
+
+    pthread_cond_destroy(&loader->compiled_cond);
+    pthread_cond_destroy(&loader->queued_cond);
+    pthread_mutex_destroy(&loader->mutex);
+
+    free(loader->entries);
+    free(loader->threads);
+    free(loader);
+    *ptr_loader = NULL;
+}
+
+int script_loader_get_size(ScriptLoader* loader) {
+    assert(loader != NULL, "Attempting to get size of NULL script loader.");
+
+    return loader->num_entries;
+}
+
+const char* script_loader_get_path(ScriptLoader* loader, int idx) {
+    assert(loader != NULL, "Attempting to get script path from NULL script loader.");
+    assert(idx >= 0 && idx < loader->num_entries, "Script index %d out of bounds.", idx);
+
+    return loader->entries[idx].path;
+}
+
+/**
+ * Returns the id of the script's `script` header, or NULL if it has none.
+ *
+ * @param loader
+ * @param idx
+ * @return
+ */
+const char* script_loader_get_script_id(ScriptLoader* loader, int idx) {
+    assert(loader != NULL, "Attempting to get script id from NULL script loader.");
+    assert(idx >= 0 && idx < loader->num_entries, "Script index %d out of bounds.", idx);
+
+    ScriptHeader* header = loader->entries[idx].header;
+    return header != NULL ? script_header_get_script_id(header) : NULL;
+}
+
+/**
+ * Returns the id of the script's `window` header, or NULL if it has none.
+ *
+ * @param loader
+ * @param idx
+ * @return
+ */
+const char* script_loader_get_window_id(ScriptLoader* loader, int idx) {
+    assert(loader != NULL, "Attempting to get window id from NULL script loader.");
+    assert(idx >= 0 && idx < loader->num_entries, "Script index %d out of bounds.", idx);
+
+    ScriptHeader* header = loader->entries[idx].header;
+    return header != NULL ? script_header_get_window_id(header) : NULL;
+}
+
+/**
+ * Returns the compiled runtime of the given script, not attached to a channel yet, or NULL if the script does not
+ * compile (see script_loader_get_error). The caller owns the runtime. Waits for the script if it is being compiled, and
+ * compiles it on the calling thread if it has not been yet, was taken before, or its file changed since. The script is
+ * not compiled again until it is next taken.
+ *
+ * @param loader
+ * @param idx
+ * @return
+ */
+Runtime* script_loader_take(ScriptLoader* loader, int idx) {
+    assert(loader != NULL, "Attempting to take script from NULL script loader.");
+    assert(idx >= 0 && idx < loader->num_entries, "Script index %d out of bounds.", idx);
+
+    ScriptEntry* entry = &loader->entries[idx];
+
+    pthread_mutex_lock(&loader->mutex);
+    while (entry->state == SCRIPT_ENTRY_COMPILING) {
+        pthread_cond_wait(&loader->compiled_cond, &loader->mutex);
+    }
+
+    if (entry->state == SCRIPT_ENTRY_QUEUED) {
+        loader->num_queued--;
+    }
+
+    if (entry->state != SCRIPT_ENTRY_COMPILED || is_entry_stale(entry)) {
+        if (entry->runtime != NULL) {
+            runtime_delete(&entry->runtime);
+        }
+
+        free(entry->error);
+        entry->error = NULL;
+        entry->state = SCRIPT_ENTRY_COMPILING;
+        pthread_mutex_unlock(&loader->mutex);
+
+        char* error = NULL;
+        Runtime* runtime = compile_entry(entry, &error);
+
+        pthread_mutex_lock(&loader->mutex);
+        entry->runtime = runtime;
+        entry->error = error;
+        pthread_cond_broadcast(&loader->compiled_cond);
+    }
+
+    Runtime* runtime = entry->runtime;
+    entry->runtime = NULL;
+    entry->state = entry->error != NULL ? SCRIPT_ENTRY_COMPILED : SCRIPT_ENTRY_TAKEN;
+    pthread_mutex_unlock(&loader->mutex);
+
+    return runtime;
+}
+
+/**
+ * Returns the error the given script last failed to compile with, or NULL if it compiled. Only known once the script
+ * has been taken (see script_loader_take).
+ *
+ * @param loader
+ * @param idx
+ * @return
+ */
+const char* script_loader_get_error(ScriptLoader* loader, int idx) {
+    assert(loader != NULL, "Attempting to get compile error from NULL script loader.");
+    assert(idx >= 0 && idx < loader->num_entries, "Script index %d out of bounds.", idx);
+
+    pthread_mutex_lock(&loader->mutex);
+    const char* error = loader->entries[idx].state == SCRIPT_ENTRY_COMPILED ? loader->entries[idx].error : NULL;
+    pthread_mutex_unlock(&loader->mutex);
+
+    return error;
+}
+
+/**
+ * Asks which scripts to run and adds each one picked to the pool (see runtime_pool_add_runtime). Scripts are picked by
+ * their number in the list (see script_loader_print), any number of them separated by spaces. Returns false once no
+ * more are to be run: at the end of the input, or when q is entered.
+ *
+ * @param loader
+ * @param pool
+ * @param in
+ * @param out
+ * @return
+ */
+bool script_loader_prompt(ScriptLoader* loader, RuntimePool* pool, FILE* in, FILE* out) {
+    assert(loader != NULL && pool != NULL, "Attempting to prompt with NULL script loader or runtime pool.");
+    assert(in != NULL && out != NULL, "Attempting to prompt with NULL input or output.");
+
+    char line[SCRIPT_LOADER_MAX_LINE_LENGTH];
+    while (true) {
+        fprintf(out, "Scripts to run (1-%d, q to quit): ", loader->num_entries);
+        fflush(out);
+
+        if (fgets(line, sizeof(line), in) == NULL || line[strspn(line, " \t")] == 'q') {
+            return false;
+        }
+
+        int num_picked = 0;
+        char* cursor = line;
+        char* end = NULL;
+
+        for (long number = strtol(cursor, &end, 10); end != cursor; number = strtol(cursor, &end, 10)) {
+            cursor = end;
+
+            if (number < 1 || number > loader->num_entries) {
+                fprintf(out, "There is no script %ld.\n", number);
+                continue;
+            }
+
+            Runtime* runtime = script_loader_take(loader, (int) number - 1);
+            if (runtime == NULL) {
+                fprintf(out, "Script %ld (%s) does not compile: %s\n", number, loader->entries[number - 1].path,
+                        script_loader_get_error(loader, (int) number - 1));
+                continue;
+            }
+
+            runtime_pool_add_runtime(pool, runtime);
+            num_picked++;
+        }
+
+        if (num_picked > 0) {
+            return true;
+        }
+    }
+}
+
+/**
+ * Returns how many threads to compile scripts on: one per processor, where the number of processors is known.
+ *
+ * @return
+ */
+int script_loader_get_default_num_threads(void) {
+#if defined(__linux__) && defined(_SC_NPROCESSORS_ONLN)
+    const long num_processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_processors > 0) {
+        return (int) num_processors;
+    }
+#endif
+
+    return SCRIPT_LOADER_DEFAULT_NUM_THREADS;
+}
+
+/**
+ * Writes the numbered list of scripts, with the ids of their `script` and `window` headers.
+ *
+ * @param loader
+ * @param file
+ */
+void script_loader_print(ScriptLoader* loader, FILE* file) {
+    assert(loader != NULL, "Attempting to print NULL script loader.");
+
+    for (int idx = 0; idx < loader->num_entries; idx++) {
+        const char* script_id = script_loader_get_script_id(loader, idx);
+        const char* window_id = script_loader_get_window_id(loader, idx);
+        fprintf(file, "%4d. %s", idx + 1, loader->entries[idx].path);
+
+        if (script_id != NULL) {
+            fprintf(file, ": %s", script_id);
+        }
+
+        if (window_id != NULL) {
+            fprintf(file, " (%s)", window_id);
+        }
+
+        fprintf(file, "\n");
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef BEANSCRIPT_SCRIPT_LOADER_H
+#define BEANSCRIPT_SCRIPT_LOADER_H
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "main.h"
+#include "runtime.h"
+#include "runtime_pool.h"
+#include "parser/script_header.h"
+
+#ifdef __linux__
+    #include <unistd.h>
+#endif
+
+typedef struct ScriptLoaderStruct ScriptLoader;
+
+// Constructor and Destructor
+ScriptLoader*   script_loader_new(const char* str_directory, int num_threads);
+void            script_loader_delete(ScriptLoader** ptr_loader);
+
+// Accessor Functions
+int             script_loader_get_size(ScriptLoader* loader);
+const char*     script_loader_get_path(ScriptLoader* loader, int idx);
+const char*     script_loader_get_script_id(ScriptLoader* loader, int idx);
+const char*     script_loader_get_window_id(ScriptLoader* loader, int idx);
+const char*     script_loader_get_error(ScriptLoader* loader, int idx);
+
+// Executors
+Runtime*        script_loader_take(ScriptLoader* loader, int idx);
+bool            script_loader_prompt(ScriptLoader* loader, RuntimePool* pool, FILE* in, FILE* out);
+
+// Utility Functions
+int             script_loader_get_default_num_threads(void);
+void            script_loader_print(ScriptLoader* loader, FILE* file);
+
+#endif //BEANSCRIPT_SCRIPT_LOADER_H
@@ -0,0 +1,186 @@
+/**
+ * @file arena.c
+ *
+ * A bump allocator. An arena hands out memory from large blocks by moving a pointer forward, and frees it all at once
+ * when it is deleted, so whatever lives as long as the arena is allocated without a malloc per object and freed
+ * without visiting each one. Memory is never freed individually; an allocation that grows is extended in place if it
+ * is the newest one, and copied to the end otherwise.
+ *
+ * Scratch allocations are taken after a mark and freed by rewinding to it (arena_get_mark, arena_rewind). The oldest
+ * block is kept when an arena is rewound to empty, so an arena that is rewound after every use, such as the scratch
+ * arena of a line, stops calling malloc once its first block is allocated.
+ */
+
+#include "arena.h"
+
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+/**
+ * @brief A block of arena memory. Blocks are chained from the newest to the oldest; only the newest is allocated from.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock* previous;
+    size_t size;
+    size_t capacity;
+    _Alignas(max_align_t) unsigned char bytes[];
+} ArenaBlock;
+
+/**
+ * @brief An arena.
+ * - block: The newest block, or NULL before the first allocation.
+ * - block_size: The capacity of a new block, unless a larger allocation needs a block of its own.
+ */
+struct ArenaStruct {
+    ArenaBlock* block;
+    size_t block_size;
+};
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+/**
+ * Returns the start of the given number of free bytes in the newest block, at the given offset alignment, starting a
+ * new block if they do not fit.
+ */
+static unsigned char* reserve(Arena* arena, size_t size, bool is_aligned) {
+    ArenaBlock* block = arena->block;
+    size_t offset = block != NULL ? (is_aligned ? align_up(block->size) : block->size) : 0;
+
+    if (block == NULL || offset > block->capacity || block->capacity - offset < size) {
+        const size_t capacity = size > arena->block_size ? size : arena->block_size;
+
+        block = (ArenaBlock*) malloc(sizeof(ArenaBlock) + capacity);
+        assert(block != NULL, "Failed to allocate memory for arena block.");
+
+        block->previous = arena->block;
+        block->size = 0;
+        block->capacity = capacity;
+        arena->block = block;
+        offset = 0;
+    }
+
+    block->size = offset + size;
+    return block->bytes + offset;
+}
+
+/**
+ * @brief Creates an empty arena that allocates blocks of the given size.
+ */
+Arena* arena_new(size_t block_size) {
+    assert(block_size > 0, "Attempting to create arena with empty blocks.");
+
+    Arena* arena = (Arena*) malloc(sizeof(Arena));
+    assert(arena != NULL, "Failed to allocate memory for arena.");
+
+    arena->block = NULL;
+    arena->block_size = block_size;
+
+    return arena;
+}
+
+/**
+ * @brief Deletes the arena and everything allocated from it.
+ */
+void arena_delete(Arena** ptr_arena) {
+    assert(ptr_arena != NULL, "Attempting to delete arena behind NULL pointer.");
+    assert(*ptr_arena != NULL, "Attempting to delete NULL arena.");
+
+    Arena* arena = *ptr_arena;
+
+    ArenaBlock* block = arena->block;
+    while (block != NULL) {
+        ArenaBlock* previous = block->previous;
+        free(block);
+        block = previous;
+    }
+
+    free(arena);
+    *ptr_arena = NULL;
+}
+
+/**
+ * @brief Returns the current end of the arena's allocations, to rewind to later.
+ */
+ArenaMark arena_get_mark(Arena* arena) {
+    assert(arena != NULL, "Attempting to get mark of NULL arena.");
+
+    return (ArenaMark) { .block = arena->block, .size = arena->block != NULL ? arena->block->size : 0 };
+}
+
+/**
+ * @brief Allocates the given number of bytes, aligned for any type. The memory is not zeroed and lives until the arena
+ * is deleted or rewound past it.
+ */
+void* arena_alloc(Arena* arena, size_t size) {
+    assert(arena != NULL, "Attempting to allocate from NULL arena.");
+
+    return reserve(arena, size > 0 ? size : 1, true);
+}
+
+/**
+ * @brief Grows an allocation of the arena to the given size, keeping its contents. The allocation is extended in place
+ * if it is the newest one and still fits its block; otherwise it is copied to a new allocation and the old one is left
+ * unused. NULL grows like an empty allocation.
+ */
+void* arena_grow(Arena* arena, void* ptr, size_t old_size, size_t new_size) {
+    assert(arena != NULL, "Attempting to grow allocation of NULL arena.");
+    assert(new_size >= old_size, "Attempting to shrink arena allocation.");
+
+    ArenaBlock* block = arena->block;
+    if (ptr != NULL && block != NULL && (unsigned char*) ptr + old_size == block->bytes + block->size
+        && block->capacity - block->size >= new_size - old_size) {
+        block->size += new_size - old_size;
+        return ptr;
+    }
+
+    void* new_ptr = arena_alloc(arena, new_size);
+    if (ptr != NULL && old_size > 0) {
+        memcpy(new_ptr, ptr, old_size);
+    }
+
+    return new_ptr;
+}
+
+/**
+ * @brief Copies the string into the arena. Strings are packed without alignment.
+ */
+char* arena_strdup(Arena* arena, const char* str) {
+    assert(arena != NULL, "Attempting to copy string into NULL arena.");
+    assert(str != NULL, "Attempting to copy NULL string into arena.");
+
+    const size_t size = strlen(str) + 1;
+    char* copy = (char*) reserve(arena, size, false);
+    memcpy(copy, str, size);
+
+    return copy;
+}
+
+/**
+ * @brief Frees everything allocated since the mark was taken. Blocks started since then are returned to the system,
+ * except the oldest block, which an empty arena keeps for reuse.
+ */
+void arena_rewind(Arena* arena, ArenaMark mark) {
+    assert(arena != NULL, "Attempting to rewind NULL arena.");
+
+    while (arena->block != NULL && arena->block != mark.block) {
+        ArenaBlock* previous = arena->block->previous;
+        if (mark.block == NULL && previous == NULL) {
+            break;
+        }
+
+        free(arena->block);
+        arena->block = previous;
+    }
+
+    if (mark.block == NULL) {
+        if (arena->block != NULL) {
+            arena->block->size = 0;
+        }
+        return;
+    }
+
+    assert(arena->block == mark.block, "Attempting to rewind arena to a mark it does not have.");
+    assert(mark.size <= arena->block->size, "Attempting to rewind arena forward.");
+    arena->block->size = mark.size;
+}
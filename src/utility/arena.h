@@ -0,0 +1,36 @@
+#ifndef BEANSCRIPT_ARENA_H
+#define BEANSCRIPT_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/main.h"
+
+typedef struct ArenaStruct Arena;
+
+/**
+ * @brief A point in the allocations of an arena. Rewinding to a mark frees everything allocated after it was taken.
+ */
+typedef struct {
+    void* block;
+    size_t size;
+} ArenaMark;
+
+// Constructor and Destructor
+Arena*      arena_new(size_t block_size);
+void        arena_delete(Arena** ptr_arena);
+
+// Accessor Functions
+ArenaMark   arena_get_mark(Arena* arena);
+
+// Mutator Functions
+void*       arena_alloc(Arena* arena, size_t size);
+void*       arena_grow(Arena* arena, void* ptr, size_t old_size, size_t new_size);
+char*       arena_strdup(Arena* arena, const char* str);
+void        arena_rewind(Arena* arena, ArenaMark mark);
+
+#endif //BEANSCRIPT_ARENA_H
@@ -0,0 +1,168 @@
+/**
+ * @file char_scan.c
+ *
+ * Finds the boundaries between runs of characters in and out of a set, such as the delimiters between the tokens of a
+ * line (see lexer.c). Rather than testing the set once per character, a scan classifies CHAR_SCAN_BLOCK_SIZE characters
+ * at a time into a bitmask, one bit per character that is in the set, and then finds the next boundary with a count of
+ * trailing zeros. Every block is classified once however many tokens it holds.
+ *
+ * With SSE2, a block is classified sixteen characters per compare: every character of the set is compared against the
+ * whole block and the matches are OR-ed into the mask. SSE2 is part of every x86-64 target, so it is chosen when the
+ * interpreter is compiled rather than when it runs. Elsewhere, and for sets too large to compare one by one, each
+ * character is looked up in the bit table of the set instead.
+ *
+ * A block never reads past the end of the string: the last, partial block is copied into a zeroed buffer first.
+ */
+
+#include "char_scan.h"
+
+static int count_trailing_zeros(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#else
+    int count = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        count++;
+    }
+
+    return count;
+#endif
+}
+
+/**
+ * Makes the set the characters of the given string.
+ *
+ * @param set
+ * @param chars
+ */
+void char_set_init(CharSet* set, const char* chars) {
+    assert(set != NULL, "Attempting to initialize NULL character set.");
+    assert(chars != NULL, "Attempting to initialize character set from NULL string.");
+
+    memset(set->bits, 0, sizeof(set->bits));
+    set->num_chars = 0;
+
+    for (const unsigned char* character = (const unsigned char*) chars; *character != '\0'; character++) {
+        if (char_set_contains(set, (char) *character)) {
+            continue;
+        }
+
+        set->bits[*character >> 6] |= (uint64_t) 1 << (*character & 63);
+        if (set->num_chars < CHAR_SET_MAX_VECTOR_CHARS) {
+            set->chars[set->num_chars] = *character;
+        }
+
+        set->num_chars++;
+    }
+}
+
+bool char_set_contains(const CharSet* set, char character) {
+    const unsigned char byte = (unsigned char) character;
+    return (set->bits[byte >> 6] >> (byte & 63)) & 1;
+}
+
+/**
+ * Returns a mask with bit i set if the ith of the CHAR_SCAN_BLOCK_SIZE characters of the block is in the set.
+ */
+static uint64_t classify_block(const CharSet* set, const unsigned char* block) {
+#if defined(__SSE2__)
+    if (set->num_chars <= CHAR_SET_MAX_VECTOR_CHARS) {
+        uint64_t mask = 0;
+
+        for (int lane = 0; lane < CHAR_SCAN_BLOCK_SIZE / 16; lane++) {
+            const __m128i bytes = _mm_loadu_si128((const __m128i*) (block + 16 * lane));
+            __m128i matches = _mm_setzero_si128();
+
+            for (int idx = 0; idx < set->num_chars; idx++) {
+                matches = _mm_or_si128(matches, _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char) set->chars[idx])));
+            }
+
+            mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(matches) << (16 * lane);
+        }
+
+        return mask;
+    }
+#endif
+
+    uint64_t mask = 0;
+    for (int idx = 0; idx < CHAR_SCAN_BLOCK_SIZE; idx++) {
+        mask |= (uint64_t) char_set_contains(set, (char) block[idx]) << idx;
+    }
+
+    return mask;
+}
+
+/**
+ * Classifies the block starting at the given offset. Past the end of the string, the mask is undefined.
+ */
+static void classify_block_at(CharScanner* scanner, size_t block_start) {
+    const unsigned char* block = (const unsigned char*) scanner->str + block_start;
+    const size_t remaining = scanner->length - block_start;
+
+    if (remaining >= CHAR_SCAN_BLOCK_SIZE) {
+        scanner->block_mask = classify_block(scanner->set, block);
+    } else {
+        unsigned char tail[CHAR_SCAN_BLOCK_SIZE] = { 0 };
+        memcpy(tail, block, remaining);
+
+        scanner->block_mask = classify_block(scanner->set, tail);
+    }
+
+    scanner->block_start = block_start;
+}
+
+/**
+ * Starts a scan over the first length characters of the string with the given set. Neither is copied.
+ *
+ * @param scanner
+ * @param set
+ * @param str
+ * @param length
+ */
+void char_scanner_begin(CharScanner* scanner, const CharSet* set, const char* str, size_t length) {
+    assert(scanner != NULL, "Attempting to begin NULL character scanner.");
+    assert(set != NULL && str != NULL, "Attempting to begin character scan with NULL set or string.");
+
+    scanner->set = set;
+    scanner->str = str;
+    scanner->length = length;
+    scanner->block_start = SIZE_MAX;
+    scanner->block_mask = 0;
+}
+
+/**
+ * Returns the offset of the first character at or after the given offset that is in the set if is_member is true, or
+ * is not in the set otherwise. Returns the length of the string if there is none. Searches should move forward through
+ * the string; the string may be modified behind the last offset found, since a classified block is not read again.
+ *
+ * @param scanner
+ * @param from
+ * @param is_member
+ * @return
+ */
+size_t char_scanner_find(CharScanner* scanner, size_t from, bool is_member) {
+    while (from < scanner->length) {
+        const size_t block_start = from - from % CHAR_SCAN_BLOCK_SIZE;
+        if (block_start != scanner->block_start) {
+            classify_block_at(scanner, block_start);
+        }
+
+        const size_t remaining = scanner->length - block_start;
+        uint64_t bits = is_member ? scanner->block_mask : ~scanner->block_mask;
+
+        // Drop the characters before the offset and, for a partial block, the bits past the end of the string.
+        bits &= ~(uint64_t) 0 << (from - block_start);
+        if (remaining < CHAR_SCAN_BLOCK_SIZE) {
+            bits &= ((uint64_t) 1 << remaining) - 1;
+        }
+
+        if (bits != 0) {
+            return block_start + (size_t) count_trailing_zeros(bits);
+        }
+
+        from = block_start + CHAR_SCAN_BLOCK_SIZE;
+    }
+
+    return scanner->length;
+}
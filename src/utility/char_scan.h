@@ -0,0 +1,54 @@
+#ifndef BEANSCRIPT_CHAR_SCAN_H
+#define BEANSCRIPT_CHAR_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+#include "src/main.h"
+
+// The most characters a set can have and still be matched a block at a time.
+#define CHAR_SET_MAX_VECTOR_CHARS 8
+
+// The number of characters classified at once, one bit each.
+#define CHAR_SCAN_BLOCK_SIZE 64
+
+/**
+ * @brief A set of characters: a bit per byte value, and the characters themselves for matching a block at a time.
+ */
+typedef struct {
+    uint64_t bits[4];
+    unsigned char chars[CHAR_SET_MAX_VECTOR_CHARS];
+    int num_chars;
+} CharSet;
+
+/**
+ * @brief A forward scan over a string of known length. The block the last search ended in is kept classified, so
+ * consecutive searches through the string classify every block once.
+ * - block_start: The offset of the classified block, or SIZE_MAX before the first search.
+ * - block_mask: Bit i is set if the character at block_start + i is in the set.
+ */
+typedef struct {
+    const CharSet* set;
+    const char* str;
+    size_t length;
+    size_t block_start;
+    uint64_t block_mask;
+} CharScanner;
+
+// Constructor
+void    char_set_init(CharSet* set, const char* chars);
+
+// Accessor Functions
+bool    char_set_contains(const CharSet* set, char character);
+
+// Executors
+void    char_scanner_begin(CharScanner* scanner, const CharSet* set, const char* str, size_t length);
+size_t  char_scanner_find(CharScanner* scanner, size_t from, bool is_member);
+
+#endif //BEANSCRIPT_CHAR_SCAN_H
@@ -0,0 +1,202 @@
+/**
+ * @file clock.c
+ *
+ * The timing subsystem. Every timestamp in the runtime is a monotonic time in microseconds read from
+ * QueryPerformanceCounter on Windows or CLOCK_MONOTONIC elsewhere, so timestamps never jump with wall-clock
+ * adjustments.
+ *
+ * clock_wait_until_us is a hybrid wait. The bulk of an interval is slept so the thread does not occupy a core, and the
+ * last stretch is spun so the wait ends within a few microseconds of the deadline. The length of the spun stretch
+ * adapts to how far the OS has been observed to oversleep on the calling thread. clock_wait_until_us_or_woken is the
+ * same wait with a sleep supplied by the caller, so another thread can end it early.
+ *
+ * clock_sleep_until_us only sleeps. It is for threads that work ahead of their deadlines and can tolerate waking late.
+ */
+
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "clock.h"
+
+#ifdef _WIN32
+    static const time_t CLOCK_INITIAL_SPIN_US = 2000;
+#else
+    static const time_t CLOCK_INITIAL_SPIN_US = 200;
+#endif
+
+static const time_t CLOCK_MIN_SPIN_US = 50;
+
+/**
+ * @brief Running statistics of observed oversleep, kept per thread so concurrent waiters do not share state.
+ * - num_samples, mean_us, m2_us: Welford's online mean and sum of squared differences.
+ */
+typedef struct {
+    long long num_samples;
+    double mean_us;
+    double m2_us;
+} OversleepEstimate;
+
+static _Thread_local OversleepEstimate oversleep_estimate = { 0, 0.0, 0.0 };
+
+/**
+ * Returns the current monotonic time in microseconds. The epoch is unspecified, so only differences between two
+ * readings are meaningful.
+ *
+ * @return
+ */
+time_t clock_get_time_us() {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    // Split the conversion to avoid overflowing counter * 1000000 on long uptimes.
+    const long long seconds = counter.QuadPart / frequency.QuadPart;
+    const long long remainder = counter.QuadPart % frequency.QuadPart;
+
+    return (time_t) (seconds * 1000000LL + remainder * 1000000LL / frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (time_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * Returns how long before a deadline the wait stops sleeping and starts spinning, in microseconds. This is the mean
+ * observed oversleep plus two standard deviations.
+ *
+ * @return
+ */
+static time_t get_spin_threshold_us() {
+    if (oversleep_estimate.num_samples < 2) {
+        return CLOCK_INITIAL_SPIN_US;
+    }
+
+    const double variance = oversleep_estimate.m2_us / (double) (oversleep_estimate.num_samples - 1);
+    const double deviation = sqrt(variance);
+
+    const time_t threshold = (time_t) (oversleep_estimate.mean_us + 2.0 * deviation);
+    return threshold > CLOCK_MIN_SPIN_US ? threshold : CLOCK_MIN_SPIN_US;
+}
+
+static void record_oversleep(time_t oversleep_us) {
+    oversleep_estimate.num_samples++;
+
+    const double delta = (double) oversleep_us - oversleep_estimate.mean_us;
+    oversleep_estimate.mean_us += delta / (double) oversleep_estimate.num_samples;
+    oversleep_estimate.m2_us += delta * ((double) oversleep_us - oversleep_estimate.mean_us);
+}
+
+/**
+ * Asks the OS to suspend the thread for the given number of microseconds. Returns false if the OS cannot sleep for an
+ * interval that short.
+ *
+ * @param duration_us
+ * @return
+ */
+static bool os_sleep_us(time_t duration_us) {
+#ifdef _WIN32
+    const DWORD duration_ms = (DWORD) (duration_us / 1000);
+    if (duration_ms == 0) {
+        return false;
+    }
+
+    Sleep(duration_ms);
+#else
+    struct timespec duration = { .tv_sec = duration_us / 1000000, .tv_nsec = (duration_us % 1000000) * 1000 };
+    nanosleep(&duration, NULL);
+#endif
+
+    return true;
+}
+
+static inline void cpu_relax() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * Waits until the given monotonic time in microseconds. Returns immediately if the time has already passed.
+ *
+ * The wait sleeps while the remaining time exceeds the spin threshold and spins for the remainder, so it wakes
+ * within microseconds of the deadline without spinning for the whole interval.
+ *
+ * @param deadline_us
+ */
+void clock_wait_until_us(time_t deadline_us) {
+    time_t current_time = clock_get_time_us();
+
+    while (deadline_us - current_time > get_spin_threshold_us()) {
+        const time_t requested_us = deadline_us - current_time - get_spin_threshold_us();
+        if (os_sleep_us(requested_us) == false) {
+            break;
+        }
+
+        const time_t woken_time = clock_get_time_us();
+        record_oversleep(woken_time - current_time - requested_us);
+        current_time = woken_time;
+    }
+
+    while (current_time < deadline_us) {
+        cpu_relax();
+        current_time = clock_get_time_us();
+    }
+}
+
+/**
+ * Waits until the given monotonic time in microseconds like clock_wait_until_us, but sleeps with the given function,
+ * which may wake early and end the wait. Returns false if the sleep ended the wait before the deadline.
+ *
+ * @param deadline_us
+ * @param sleep
+ * @param context Handed to every call of sleep.
+ * @return
+ */
+bool clock_wait_until_us_or_woken(time_t deadline_us, ClockWakeableSleep sleep, void* context) {
+    time_t current_time = clock_get_time_us();
+
+    while (deadline_us - current_time > get_spin_threshold_us()) {
+        const time_t requested_us = deadline_us - current_time - get_spin_threshold_us();
+        if (sleep(current_time + requested_us, context)) {
+            return false;
+        }
+
+        // A sleep that was cut short says nothing about how far the OS oversleeps.
+        const time_t woken_time = clock_get_time_us();
+        if (woken_time - current_time >= requested_us) {
+            record_oversleep(woken_time - current_time - requested_us);
+        }
+
+        current_time = woken_time;
+    }
+
+    while (current_time < deadline_us) {
+        cpu_relax();
+        current_time = clock_get_time_us();
+    }
+
+    return true;
+}
+
+/**
+ * Sleeps until roughly the given monotonic time in microseconds without spinning. The thread may wake late by the
+ * OS's sleep granularity. Returns immediately if the time has already passed.
+ *
+ * @param deadline_us
+ */
+void clock_sleep_until_us(time_t deadline_us) {
+    const time_t remaining_us = deadline_us - clock_get_time_us();
+    if (remaining_us > 0) {
+        os_sleep_us(remaining_us);
+    }
+}
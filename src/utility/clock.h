@@ -0,0 +1,27 @@
+#ifndef BEANSCRIPT_CLOCK_H
+#define BEANSCRIPT_CLOCK_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include "src/main.h"
+
+#define CLOCK_US_PER_MS 1000
+
+/**
+ * @brief A sleep that may be cut short: sleeps until at most the given monotonic time (us), and returns true if the
+ * wait it belongs to should end at once (see clock_wait_until_us_or_woken).
+ */
+typedef bool (*ClockWakeableSleep)(time_t deadline_us, void* context);
+
+time_t clock_get_time_us();
+void clock_wait_until_us(time_t deadline_us);
+bool clock_wait_until_us_or_woken(time_t deadline_us, ClockWakeableSleep sleep, void* context);
+void clock_sleep_until_us(time_t deadline_us);
+
+#endif //BEANSCRIPT_CLOCK_H
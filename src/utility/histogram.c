@@ -0,0 +1,190 @@
+/**
+ * @file histogram.c
+ *
+ * A fixed-size histogram of non-negative integers in the style of HdrHistogram. Values below
+ * HISTOGRAM_SUB_BUCKET_COUNT get a bucket each; above that, every power of two is split into
+ * HISTOGRAM_SUB_BUCKET_COUNT / 2 equal buckets, so a value is always reported within about 6% of what was recorded
+ * while the whole range up to HISTOGRAM_MAX_VALUE fits in a few kilobytes. Recording is a handful of integer
+ * operations and never allocates, so the histogram can be fed on a hot path.
+ *
+ * The exact minimum, maximum and sum are tracked next to the buckets. Negative values are counted as 0 and values
+ * above HISTOGRAM_MAX_VALUE as HISTOGRAM_MAX_VALUE, but both still count towards the exact minimum and maximum.
+ */
+
+#include "histogram.h"
+
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+#define HISTOGRAM_SUB_BUCKET_COUNT (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_HALF_SUB_BUCKET_COUNT (HISTOGRAM_SUB_BUCKET_COUNT / 2)
+#define HISTOGRAM_MAX_VALUE_BITS 40
+#define HISTOGRAM_MAX_VALUE ((INT64_C(1) << HISTOGRAM_MAX_VALUE_BITS) - 1)
+#define HISTOGRAM_NUM_BUCKETS \
+    ((HISTOGRAM_MAX_VALUE_BITS - HISTOGRAM_SUB_BUCKET_BITS + 2) * HISTOGRAM_HALF_SUB_BUCKET_COUNT)
+
+/**
+ * @brief
+ * - counts: The number of values recorded in each bucket. See get_bucket_index.
+ */
+struct HistogramStruct {
+    long long counts[HISTOGRAM_NUM_BUCKETS];
+    long long count;
+    int64_t min;
+    int64_t max;
+    double sum;
+};
+
+/**
+ * Returns the bucket a value is counted in. A value below HISTOGRAM_SUB_BUCKET_COUNT is its own bucket. Otherwise the
+ * value is shifted down until its top HISTOGRAM_SUB_BUCKET_BITS bits remain, and those bits choose one of the buckets
+ * of its power of two.
+ */
+static int get_bucket_index(int64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKET_COUNT) {
+        return (int) value;
+    }
+
+    const int highest_bit = 63 - __builtin_clzll((unsigned long long) value);
+    const int shift = highest_bit - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+
+    return (shift + 1) * HISTOGRAM_HALF_SUB_BUCKET_COUNT + (int) (value >> shift) - HISTOGRAM_HALF_SUB_BUCKET_COUNT;
+}
+
+/**
+ * Returns the largest value counted in the given bucket, the inverse of get_bucket_index.
+ */
+static int64_t get_bucket_upper_value(int index) {
+    if (index < HISTOGRAM_SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    const int shift = index / HISTOGRAM_HALF_SUB_BUCKET_COUNT - 1;
+    const int64_t top_bits = index % HISTOGRAM_HALF_SUB_BUCKET_COUNT + HISTOGRAM_HALF_SUB_BUCKET_COUNT;
+
+    return ((top_bits + 1) << shift) - 1;
+}
+
+Histogram* histogram_new() {
+    Histogram* histogram = (Histogram*) calloc(1, sizeof(Histogram));
+    assert(histogram != NULL, "Failed to allocate memory for histogram.");
+
+    histogram->min = INT64_MAX;
+    histogram->max = INT64_MIN;
+
+    return histogram;
+}
+
+void histogram_delete(Histogram** ptr_histogram) {
+    assert(ptr_histogram != NULL, "Attempting to delete histogram behind NULL pointer.");
+    assert(*ptr_histogram != NULL, "Attempting to delete NULL histogram.");
+
+    free(*ptr_histogram);
+    *ptr_histogram = NULL;
+}
+
+/**
+ * Counts one occurrence of the value.
+ *
+ * @param histogram
+ * @param value
+ */
+void histogram_record(Histogram* histogram, int64_t value) {
+    assert(histogram != NULL, "Attempting to record to NULL histogram.");
+
+    if (value < histogram->min) {
+        histogram->min = value;
+    }
+
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+
+    histogram->count++;
+    histogram->sum += (double) value;
+
+    const int64_t bucket_value = value < 0 ? 0 : (value > HISTOGRAM_MAX_VALUE ? HISTOGRAM_MAX_VALUE : value);
+    histogram->counts[get_bucket_index(bucket_value)]++;
+}
+
+long long histogram_get_count(Histogram* histogram) {
+    assert(histogram != NULL, "Attempting to get count of NULL histogram.");
+
+    return histogram->count;
+}
+
+/**
+ * Returns the smallest value recorded, or 0 if nothing was recorded.
+ */
+int64_t histogram_get_min(Histogram* histogram) {
+    assert(histogram != NULL, "Attempting to get minimum of NULL histogram.");
+
+    return histogram->count > 0 ? histogram->min : 0;
+}
+
+/**
+ * Returns the largest value recorded, or 0 if nothing was recorded.
+ */
+int64_t histogram_get_max(Histogram* histogram) {
+    assert(histogram != NULL, "Attempting to get maximum of NULL histogram.");
+
+    return histogram->count > 0 ? histogram->max : 0;
+}
+
+double histogram_get_mean(Histogram* histogram) {
+    assert(histogram != NULL, "Attempting to get mean of NULL histogram.");
+
+    return histogram->count > 0 ? histogram->sum / (double) histogram->count : 0.0;
+}
+
+/**
+ * Returns a value at or just above the given percentile (0 to 100) of the recorded values: the largest value of the
+ * bucket the percentile falls in, but never more than the largest value recorded. Returns 0 if nothing was recorded.
+ *
+ * @param histogram
+ * @param percentile
+ * @return
+ */
+int64_t histogram_get_percentile(Histogram* histogram, double percentile) {
+    assert(histogram != NULL, "Attempting to get percentile of NULL histogram.");
+    assert(percentile >= 0.0 && percentile <= 100.0, "Attempting to get percentile %f.", percentile);
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    long long rank = (long long) (percentile / 100.0 * (double) histogram->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    long long num_seen = 0;
+    for (int index = 0; index < HISTOGRAM_NUM_BUCKETS; index++) {
+        num_seen += histogram->counts[index];
+        if (num_seen >= rank) {
+            const int64_t upper_value = get_bucket_upper_value(index);
+            return upper_value < histogram->max ? upper_value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+/**
+ * Writes the count, extremes, mean and common percentiles of the histogram as a JSON object.
+ *
+ * @param histogram
+ * @param file
+ */
+void histogram_print_json(Histogram* histogram, FILE* file) {
+    assert(histogram != NULL, "Attempting to print NULL histogram.");
+
+    fprintf(file, "{\"count\": %lld, \"min\": %lld, \"mean\": %.1f, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, "
+                  "\"p99.9\": %lld, \"max\": %lld}",
+            histogram->count,
+            (long long) histogram_get_min(histogram),
+            histogram_get_mean(histogram),
+            (long long) histogram_get_percentile(histogram, 50.0),
+            (long long) histogram_get_percentile(histogram, 90.0),
+            (long long) histogram_get_percentile(histogram, 99.0),
+            (long long) histogram_get_percentile(histogram, 99.9),
+            (long long) histogram_get_max(histogram));
+}
@@ -0,0 +1,30 @@
+#ifndef BEANSCRIPT_HISTOGRAM_H
+#define BEANSCRIPT_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/main.h"
+
+typedef struct HistogramStruct Histogram;
+
+// Constructor and Destructor
+Histogram*  histogram_new();
+void        histogram_delete(Histogram** ptr_histogram);
+
+// Mutator Functions
+void        histogram_record(Histogram* histogram, int64_t value);
+
+// Accessor Functions
+long long   histogram_get_count(Histogram* histogram);
+int64_t     histogram_get_min(Histogram* histogram);
+int64_t     histogram_get_max(Histogram* histogram);
+double      histogram_get_mean(Histogram* histogram);
+int64_t     histogram_get_percentile(Histogram* histogram, double percentile);
+
+// Utility Functions
+void        histogram_print_json(Histogram* histogram, FILE* file);
+
+#endif //BEANSCRIPT_HISTOGRAM_H
@@ -0,0 +1,171 @@
+/**
+ * @file rng.c
+ *
+ * The random number generator of a script. Every runtime owns one generator, so sampling never contends with other
+ * threads and a run is reproduced exactly by reusing its seed: the same seed gives every script the same sequence of
+ * durations, delays, repeats and picks.
+ *
+ * The generator is xoshiro256**, seeded through splitmix64 so that nearby seeds (e.g., a base seed plus the script's
+ * channel) still give unrelated sequences. Numbers are generated RNG_BUFFER_SIZE at a time into a buffer, which keeps
+ * the state in registers for the whole batch, and handed out one at a time. Ranges are sampled with Lemire's multiply
+ * and reject method, which is unbiased and almost never divides.
+ *
+ * The functions below work on the generator bound to the calling thread (see rng_bind).
+ */
+
+#include "rng.h"
+
+#define RNG_BUFFER_SIZE 64
+
+/**
+ * @brief
+ * - state: The xoshiro256** state. Never all zero.
+ * - buffer, buffer_idx: Numbers generated ahead; buffer_idx is the next one to hand out.
+ */
+struct RngStruct {
+    uint64_t state[4];
+    uint64_t buffer[RNG_BUFFER_SIZE];
+    int buffer_idx;
+};
+
+// The generator the calling thread is working on. See rng_bind.
+static _Thread_local Rng* rng = NULL;
+
+static uint64_t rotate_left(uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+static uint64_t splitmix64_next(uint64_t* seed) {
+    uint64_t value = (*seed += UINT64_C(0x9E3779B97F4A7C15));
+    value = (value ^ (value >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    value = (value ^ (value >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return value ^ (value >> 31);
+}
+
+/**
+ * Refills the buffer with the next RNG_BUFFER_SIZE numbers of the sequence.
+ */
+static void refill_buffer(Rng* generator) {
+    uint64_t s0 = generator->state[0];
+    uint64_t s1 = generator->state[1];
+    uint64_t s2 = generator->state[2];
+    uint64_t s3 = generator->state[3];
+
+    for (int idx = 0; idx < RNG_BUFFER_SIZE; idx++) {
+        generator->buffer[idx] = rotate_left(s1 * 5, 7) * 9;
+
+        const uint64_t shifted = s1 << 17;
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= shifted;
+        s3 = rotate_left(s3, 45);
+    }
+
+    generator->state[0] = s0;
+    generator->state[1] = s1;
+    generator->state[2] = s2;
+    generator->state[3] = s3;
+    generator->buffer_idx = 0;
+}
+
+/**
+ * Creates a generator whose sequence is determined by the seed alone.
+ *
+ * @param seed
+ * @return
+ */
+Rng* rng_new(uint64_t seed) {
+    Rng* new_rng = (Rng*) malloc(sizeof(Rng));
+    assert(new_rng != NULL, "Failed to allocate memory for random number generator.");
+
+    for (int idx = 0; idx < 4; idx++) {
+        new_rng->state[idx] = splitmix64_next(&seed);
+    }
+
+    // splitmix64 is a bijection of its counter, so four consecutive outputs are never all zero.
+    refill_buffer(new_rng);
+
+    return new_rng;
+}
+
+void rng_delete(Rng** ptr_rng) {
+    assert(ptr_rng != NULL, "Attempting to delete random number generator behind NULL pointer.");
+    assert(*ptr_rng != NULL, "Attempting to delete NULL random number generator.");
+
+    if (rng == *ptr_rng) {
+        rng = NULL;
+    }
+
+    free(*ptr_rng);
+    *ptr_rng = NULL;
+}
+
+/**
+ * Makes the given generator the one every other generator function on the calling thread works on. May be NULL.
+ *
+ * @param bound_rng
+ */
+void rng_bind(Rng* bound_rng) {
+    rng = bound_rng;
+}
+
+/**
+ * Returns the next 64 uniformly distributed bits of the bound generator.
+ */
+uint64_t rng_next() {
+    assert(rng != NULL, "Attempting to generate random number without a bound generator.");
+
+    if (rng->buffer_idx == RNG_BUFFER_SIZE) {
+        refill_buffer(rng);
+    }
+
+    return rng->buffer[rng->buffer_idx++];
+}
+
+/**
+ * Returns an integer drawn uniformly from [lower_value, upper_value], both inclusive. Returns lower_value if the range
+ * is empty.
+ *
+ * @param lower_value
+ * @param upper_value
+ * @return
+ */
+int64_t rng_sample_range(int64_t lower_value, int64_t upper_value) {
+    if (upper_value <= lower_value) {
+        return lower_value;
+    }
+
+    // The number of values in the range, which wraps to 0 only for the full 64-bit range.
+    const uint64_t range = (uint64_t) upper_value - (uint64_t) lower_value + 1;
+    if (range == 0) {
+        return (int64_t) rng_next();
+    }
+
+    // Scale a random 64-bit value to the range with one multiply. The few products whose low half falls below
+    // 2^64 mod range would make some results more likely than others, so those are drawn again.
+    unsigned __int128 product = (unsigned __int128) rng_next() * range;
+    uint64_t low_bits = (uint64_t) product;
+
+    if (low_bits < range) {
+        const uint64_t threshold = -range % range;
+        while (low_bits < threshold) {
+            product = (unsigned __int128) rng_next() * range;
+            low_bits = (uint64_t) product;
+        }
+    }
+
+    return (int64_t) ((uint64_t) lower_value + (uint64_t) (product >> 64));
+}
+
+/**
+ * Returns a seed that differs between runs, for when no seed is given.
+ */
+uint64_t rng_generate_seed() {
+    uint64_t seed = (uint64_t) time(NULL);
+    seed ^= (uint64_t) clock() << 32;
+    seed ^= (uint64_t) (uintptr_t) &seed;
+
+    return splitmix64_next(&seed);
+}
@@ -0,0 +1,24 @@
+#ifndef BEANSCRIPT_RNG_H
+#define BEANSCRIPT_RNG_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "src/main.h"
+
+typedef struct RngStruct Rng;
+
+// Constructor and Destructor
+Rng*        rng_new(uint64_t seed);
+void        rng_delete(Rng** ptr_rng);
+void        rng_bind(Rng* bound_rng);
+
+// Executors
+uint64_t    rng_next();
+int64_t     rng_sample_range(int64_t lower_value, int64_t upper_value);
+
+// Utility Functions
+uint64_t    rng_generate_seed();
+
+#endif //BEANSCRIPT_RNG_H
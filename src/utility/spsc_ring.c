@@ -0,0 +1,149 @@
+/**
+ * @file spsc_ring.c
+ *
+ * A bounded, lock-free, single-producer/single-consumer ring buffer of fixed-size elements. Exactly one thread may
+ * push and exactly one (other) thread may pop or peek. The producer owns the tail index and the consumer owns the head
+ * index; each publishes its index with release semantics and reads the other's with acquire semantics, so an element
+ * is always fully written before the consumer can see it.
+ *
+ * The capacity is rounded up to a power of two so indices wrap with a mask. Head and tail live on separate cache lines
+ * to avoid false sharing between the two threads.
+ */
+
+#include "spsc_ring.h"
+
+#define SPSC_RING_CACHE_LINE 64
+
+struct SpscRingStruct {
+    alignas(SPSC_RING_CACHE_LINE) atomic_size_t head;
+    alignas(SPSC_RING_CACHE_LINE) atomic_size_t tail;
+
+    alignas(SPSC_RING_CACHE_LINE) size_t mask;
+    size_t element_size;
+    unsigned char* elements;
+};
+
+/**
+ * Creates a ring that holds at least the given number of elements of the given size.
+ *
+ * @param capacity
+ * @param element_size
+ * @return
+ */
+SpscRing* spsc_ring_new(int capacity, size_t element_size) {
+    assert(capacity > 0, "Attempting to create ring with capacity less than 1.");
+    assert(element_size > 0, "Attempting to create ring with element size 0.");
+
+    SpscRing* ring = (SpscRing*) mem_aligned_alloc(SPSC_RING_CACHE_LINE, sizeof(SpscRing));
+    assert(ring != NULL, "Failed to allocate memory for ring.");
+
+    size_t rounded_capacity = 1;
+    while (rounded_capacity < (size_t) capacity) {
+        rounded_capacity <<= 1;
+    }
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->mask = rounded_capacity - 1;
+    ring->element_size = element_size;
+
+    ring->elements = (unsigned char*) malloc(rounded_capacity * element_size);
+    assert(ring->elements != NULL, "Failed to allocate memory for ring elements.");
+
+    return ring;
+}
+
+void spsc_ring_delete(SpscRing** ptr_ring) {
+    assert(ptr_ring != NULL, "Attempting to delete ring behind NULL pointer.");
+    assert(*ptr_ring != NULL, "Attempting to delete NULL ring.");
+
+    SpscRing* ring = *ptr_ring;
+    free(ring->elements);
+    mem_aligned_free(ring);
+    *ptr_ring = NULL;
+}
+
+/**
+ * Returns the number of elements the ring can hold.
+ */
+int spsc_ring_get_capacity(SpscRing* ring) {
+    assert(ring != NULL, "Attempting to get capacity of NULL ring.");
+
+    return (int) (ring->mask + 1);
+}
+
+/**
+ * Returns true if the ring holds no elements. Only exact when called from the consumer.
+ */
+bool spsc_ring_is_empty(SpscRing* ring) {
+    assert(ring != NULL, "Attempting to check if NULL ring is empty.");
+
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    return head == tail;
+}
+
+/**
+ * Copies the element into the ring. Returns false if the ring is full. Producer only.
+ *
+ * @param ring
+ * @param element
+ * @return
+ */
+bool spsc_ring_try_push(SpscRing* ring, const void* element) {
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (tail - head > ring->mask) {
+        return false;
+    }
+
+    memcpy(ring->elements + (tail & ring->mask) * ring->element_size, element, ring->element_size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    return true;
+}
+
+/**
+ * Copies the oldest element out of the ring without removing it. Returns false if the ring is empty. Consumer only.
+ *
+ * @param ring
+ * @param element
+ * @return
+ */
+bool spsc_ring_try_peek(SpscRing* ring, void* element) {
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+
+    memcpy(element, ring->elements + (head & ring->mask) * ring->element_size, ring->element_size);
+    return true;
+}
+
+/**
+ * Removes the oldest element from the ring, copying it out if element is not NULL. Returns false if the ring is empty.
+ * Consumer only.
+ *
+ * @param ring
+ * @param element
+ * @return
+ */
+bool spsc_ring_try_pop(SpscRing* ring, void* element) {
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+
+    if (element != NULL) {
+        memcpy(element, ring->elements + (head & ring->mask) * ring->element_size, ring->element_size);
+    }
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
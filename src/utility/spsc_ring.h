@@ -0,0 +1,31 @@
+#ifndef BEANSCRIPT_SPSC_RING_H
+#define BEANSCRIPT_SPSC_RING_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/utility/utility.h"
+#include "src/main.h"
+
+typedef struct SpscRingStruct SpscRing;
+
+// Constructor and Destructor
+SpscRing*   spsc_ring_new(int capacity, size_t element_size);
+void        spsc_ring_delete(SpscRing** ptr_ring);
+
+// Accessor Functions
+int         spsc_ring_get_capacity(SpscRing* ring);
+bool        spsc_ring_is_empty(SpscRing* ring);
+
+// Producer Functions
+bool        spsc_ring_try_push(SpscRing* ring, const void* element);
+
+// Consumer Functions
+bool        spsc_ring_try_peek(SpscRing* ring, void* element);
+bool        spsc_ring_try_pop(SpscRing* ring, void* element);
+
+#endif //BEANSCRIPT_SPSC_RING_H
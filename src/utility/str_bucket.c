@@ -2,23 +2,40 @@
  * @file str_bucket.c
  *
  * An implementation for a string bucketing data structure. A bucket is a collection of related strings. Naturally, each
- * buckets id is the index of the bucket in the bucket collection. The bucket collection is a dynamic array of buckets
- * that is dynamically resized. The user has the choice of using shared memory for the value strings. If the user
- * chooses to use shared memory, it is the callers responsibility to free the value strings when the queue is deleted.
+ * buckets id is the index of the bucket in the bucket collection. The user has the choice of using shared memory for
+ * the value strings. If the user chooses to use shared memory, it is the callers responsibility to free the value
+ * strings when the queue is deleted.
  *
- * This class uses @class StrList.h to implement each bucket.
+ * Every string of every bucket is held in one contiguous array, bucket after bucket, and each bucket is the range of
+ * the array it starts at and spans. Strings can therefore only be inserted into the last bucket, which is how the
+ * lexer fills buckets anyway. Both arrays start out in storage inside the collection itself, which holds a typical
+ * line, and grow geometrically past it, so bucketing a line usually allocates only the collection. A collection may
+ * also be allocated from an arena (str_bucket_new_in_arena), such as the scratch arena of a line, in which case it
+ * grows in the arena and is freed when the arena is rewound.
  */
 
 #include "str_bucket.h"
 
+#define STR_BUCKET_INLINE_BUCKETS 8
+#define STR_BUCKET_INLINE_STRINGS 16
+
+/**
+ * @brief The strings of one bucket: strings[start] to strings[start + size - 1].
+ */
+typedef struct {
+    int start;
+    int size;
+} StrBucketRange;
+
 /**
  * @brief A struct for representing a list of buckets. A bucket is collection of related strings. Each bucket has an id.
- * - bucket_ids: The list holding the id of each bucket where the ith id is the id of the ith bucket.
- * - buckets: The list of buckets where the ith bucket is the bucket with the id of the ith id in bucket_ids.
+ * - strings: Every string of every bucket, in bucket order.
+ * - num_strings, str_capacity: The number of strings in use and the number that fit.
+ * - ranges: The range of strings of each bucket, where the ith range is the bucket with id i.
  * - size: The number of buckets currently initialized.
  * - capacity: The number of buckets that can be currently held.
- * - resize_value: The amount the bucket capacity is increased or decreased when more or less room is needed.
- * - bucket_resize_value: Similar to resize_value, but for each bucket instead.
+ * - inline_strings, inline_ranges: The storage strings and ranges start out in, until they outgrow it.
+ * - arena: The arena the collection and its arrays are allocated from, or NULL if they are on the heap.
  * - is_using_shared_memory: A boolean representing true if the strings stored in the string buckets are referenced from
  * variables or data structures outside of this string bucket. If true, this bucket will not be in charge of freeing the
  * memory of the strings in each bucket and will only free itself; otherwise this bucket will free the memory of the
@@ -26,43 +43,106 @@
  * of the strings in the buckets.
  */
 struct StrBucketStruct {
-    StrList** buckets;
+    char** strings;
+    int num_strings;
+    int str_capacity;
+    StrBucketRange* ranges;
     int size;
     int capacity;
-    int resize_value;
-    int bucket_resize_value;
     bool is_using_shared_memory;
+    Arena* arena;
+
+    char* inline_strings[STR_BUCKET_INLINE_STRINGS];
+    StrBucketRange inline_ranges[STR_BUCKET_INLINE_BUCKETS];
 };
 
 /**
- * @brief Creates a new bucket collection with default values.
- * - buckets: NULL
- * - size: 0
- * - capacity: 0
- * - resize_value: given by @param resize_value
- * - bucket_resize_value: given by @param bucket_resize_value
- * - is_using_shared_memory: given by @param is_using_shared_memory
+ * Grows an array that may still be in inline storage to hold at least min_capacity elements, at least doubling it. The
+ * array is grown in the arena if the collection has one.
+ */
+static void* grow_array(Arena* arena, void* array, const void* inline_array, int* capacity, int min_capacity,
+                        size_t element_size) {
+    int new_capacity = *capacity > 0 ? 2 * *capacity : 1;
+    if (new_capacity < min_capacity) {
+        new_capacity = min_capacity;
+    }
+
+    void* new_array = NULL;
+    if (arena != NULL) {
+        const void* old_array = array == inline_array ? NULL : array;
+        new_array = arena_grow(arena, (void*) old_array, element_size * *capacity, element_size * new_capacity);
+        if (old_array == NULL) {
+            memcpy(new_array, array, element_size * *capacity);
+        }
+    } else if (array == inline_array) {
+        new_array = malloc(element_size * new_capacity);
+        assert(new_array != NULL, "Failed to allocate memory for buckets.");
+        memcpy(new_array, array, element_size * *capacity);
+    } else {
+        new_array = realloc(array, element_size * new_capacity);
+        assert(new_array != NULL, "Failed to allocate memory for buckets.");
+    }
+
+    *capacity = new_capacity;
+    return new_array;
+}
+
+static void init_buckets(StrBucket* buckets, int bucket_capacity, int str_capacity, bool is_using_shared_memory) {
+    buckets->strings = buckets->inline_strings;
+    buckets->num_strings = 0;
+    buckets->str_capacity = STR_BUCKET_INLINE_STRINGS;
+    buckets->ranges = buckets->inline_ranges;
+    buckets->size = 0;
+    buckets->capacity = STR_BUCKET_INLINE_BUCKETS;
+    buckets->is_using_shared_memory = is_using_shared_memory;
+
+    if (str_capacity > buckets->str_capacity) {
+        buckets->strings = (char**) grow_array(buckets->arena, buckets->strings, buckets->inline_strings,
+                                               &buckets->str_capacity, str_capacity, sizeof(char*));
+    }
+
+    if (bucket_capacity > buckets->capacity) {
+        buckets->ranges = (StrBucketRange*) grow_array(buckets->arena, buckets->ranges, buckets->inline_ranges,
+                                                       &buckets->capacity, bucket_capacity, sizeof(StrBucketRange));
+    }
+}
+
+/**
+ * @brief Creates a new, empty bucket collection.
  *
- * @param resize_value The value for how much the bucket collection is increased by when the capacity is reached or how
- * much the bucket array is decreased by when there are (resize_value + 1) empty spaces in the bucket array.
- * @param bucket_resize_value The value for how much the buckets are increased by when the capacity is reached or how
- * much the bucket array is decreased by when there are (resize_value + 1) empty spaces in the bucket array.
+ * @param bucket_capacity The number of buckets to make room for up front.
+ * @param str_capacity The number of strings, across every bucket, to make room for up front.
  * @param is_using_shared_memory A boolean representing true if the strings stored in the string buckets are referenced
  * from variables or data structures outside of this string bucket. If true, this bucket will not be in charge of
  * freeing the memory of the strings in each bucket and will only free itself; otherwise this bucket will free the
  * memory of the strings in each bucket and itself when deleted.
  * @return A pointer to the newly created bucket collection.
  */
-StrBucket* str_bucket_new(int resize_value, int bucket_resize_value, bool is_using_shared_memory) {
+StrBucket* str_bucket_new(int bucket_capacity, int str_capacity, bool is_using_shared_memory) {
     StrBucket* buckets = (StrBucket*) malloc(sizeof(StrBucket));
     assert(buckets != NULL, "Failed to allocate memory for buckets.");
 
-    buckets->buckets = NULL;
-    buckets->size = 0;
-    buckets->capacity = 0;
-    buckets->resize_value = resize_value;
-    buckets->bucket_resize_value = bucket_resize_value;
-    buckets->is_using_shared_memory = is_using_shared_memory;
+    buckets->arena = NULL;
+    init_buckets(buckets, bucket_capacity, str_capacity, is_using_shared_memory);
+
+    return buckets;
+}
+
+/**
+ * @brief Creates a new, empty bucket collection of shared-memory strings in the given arena. The collection and any
+ * storage it grows into are freed with the arena, so deleting it only clears it.
+ *
+ * @param arena The arena to allocate from.
+ * @param bucket_capacity The number of buckets to make room for up front.
+ * @param str_capacity The number of strings, across every bucket, to make room for up front.
+ * @return A pointer to the newly created bucket collection.
+ */
+StrBucket* str_bucket_new_in_arena(Arena* arena, int bucket_capacity, int str_capacity) {
+    assert(arena != NULL, "Attempting to create buckets in NULL arena.");
+
+    StrBucket* buckets = (StrBucket*) arena_alloc(arena, sizeof(StrBucket));
+    buckets->arena = arena;
+    init_buckets(buckets, bucket_capacity, str_capacity, true);
 
     return buckets;
 }
@@ -74,6 +154,19 @@ void str_bucket_delete(StrBucket** ptr_buckets) {
     StrBucket* buckets = *ptr_buckets;
     str_bucket_clear(buckets);
 
+    if (buckets->arena != NULL) {
+        *ptr_buckets = NULL;
+        return;
+    }
+
+    if (buckets->strings != buckets->inline_strings) {
+        free(buckets->strings);
+    }
+
+    if (buckets->ranges != buckets->inline_ranges) {
+        free(buckets->ranges);
+    }
+
     free(buckets);
     *ptr_buckets = NULL;
 }
@@ -84,11 +177,27 @@ int str_bucket_get_size(StrBucket* buckets) {
     return buckets->size;
 }
 
-StrList* str_bucket_get_bucket(StrBucket* buckets, int index) {
-    assert(buckets != NULL, "Attempting to get bucket from NULL buckets.");
-    assert(index >= 0 && index < buckets->size, "Attempting to get bucket from buckets with invalid index.");
+/**
+ * @brief Returns the number of strings in the bucket with the given index.
+ */
+int str_bucket_get_bucket_size(StrBucket* buckets, int bucket_idx) {
+    assert(buckets != NULL, "Attempting to get bucket size from NULL buckets.");
+    assert(bucket_idx >= 0 && bucket_idx < buckets->size, "Attempting to get bucket size with invalid index.");
 
-    return buckets->buckets[index];
+    return buckets->ranges[bucket_idx].size;
+}
+
+/**
+ * @brief Fetches the string at the given index of the bucket with the given index.
+ */
+char* str_bucket_get_str(StrBucket* buckets, int bucket_idx, int str_idx) {
+    assert(buckets != NULL, "Attempting to get string from NULL buckets.");
+    assert(bucket_idx >= 0 && bucket_idx < buckets->size, "Attempting to get string from bucket with invalid index.");
+
+    const StrBucketRange* range = &buckets->ranges[bucket_idx];
+    assert(str_idx >= 0 && str_idx < range->size, "Attempting to get string from bucket with invalid string index.");
+
+    return buckets->strings[range->start + str_idx];
 }
 
 bool str_bucket_is_using_shared_memory(StrBucket *buckets) {
@@ -98,64 +207,94 @@ bool str_bucket_is_using_shared_memory(StrBucket *buckets) {
 }
 
 /**
- * @brief Adds resize_value number of buckets to the bucket collection if is full or null.
+ * @brief Joins the strings of a bucket into one string separated by `separator`, without allocating. The strings must
+ * be shared and lie in one buffer in increasing order with at least one character between each, as the lexer leaves
+ * the tokens of a line; each string is moved down in place to follow the previous one. The bucket is left holding only
+ * the joined string, so joining it again returns the same string.
+ * @return The joined string, which starts where the first string did.
  */
-static void add_buckets_if_necessary(StrBucket* buckets) {
-    const bool is_bucket_null = buckets->size == 0;
-    if (is_bucket_null) {
-        buckets->capacity = buckets->resize_value;
-        buckets->buckets = (StrList**) malloc(sizeof(StrList*) * buckets->capacity);
-        assert(buckets->buckets != NULL, "Failed to allocate memory for buckets->bucket_ids.");
-    }
+char* str_bucket_join_in_place(StrBucket* buckets, int bucket_idx, char separator) {
+    assert(buckets != NULL, "Attempting to join bucket of NULL buckets.");
+    assert(bucket_idx >= 0 && bucket_idx < buckets->size, "Attempting to join bucket with invalid index.");
+    assert(buckets->is_using_shared_memory, "Attempting to join bucket that owns its strings in place.");
 
-    const bool is_bucket_full = buckets->size >= buckets->capacity;
-    if (is_bucket_full) {
-        buckets->capacity += buckets->resize_value;
+    StrBucketRange* range = &buckets->ranges[bucket_idx];
+    assert(range->size > 0, "Attempting to join empty bucket.");
 
-        buckets->buckets = (StrList**) realloc(buckets->buckets, sizeof(StrList*) * buckets->capacity);
-        assert(buckets->buckets != NULL, "Failed to allocate memory for buckets->buckets.");
+    char** strings = buckets->strings + range->start;
+    char* str = strings[0];
+    char* end = str + strlen(str);
 
-        for (int idx_bucket = buckets->size; idx_bucket < buckets->capacity; idx_bucket++) {
-            buckets->buckets[idx_bucket] = NULL;
-        }
+    for (int i = 1; i < range->size; i++) {
+        char* token = strings[i];
+        assert(token > end, "Attempting to join strings that are not in increasing order in one buffer.");
+
+        const size_t token_len = strlen(token);
+        *end = separator;
+        memmove(end + 1, token, token_len + 1);
+        end += token_len + 1;
+
+        strings[i] = NULL;
     }
+
+    range->size = 1;
+    return str;
 }
 
+/**
+ * @brief Inserts a new, empty bucket after the last bucket. Returns the id of the new bucket.
+ */
 int str_bucket_insert_bucket(StrBucket* buckets) {
     assert(buckets != NULL, "Attempting to get bucket from NULL buckets.");
 
-    add_buckets_if_necessary(buckets);
+    if (buckets->size == buckets->capacity) {
+        buckets->ranges = (StrBucketRange*) grow_array(buckets->arena, buckets->ranges, buckets->inline_ranges,
+                                                       &buckets->capacity, buckets->size + 1, sizeof(StrBucketRange));
+    }
 
-    StrList* new_bucket = str_list_new(buckets->bucket_resize_value, buckets->is_using_shared_memory);
-    buckets->buckets[buckets->size] = new_bucket;
+    buckets->ranges[buckets->size] = (StrBucketRange) { buckets->num_strings, 0 };
     buckets->size++;
 
     return buckets->size - 1;
 }
 
+/**
+ * @brief Inserts a string into the bucket with the given id, which must be the last bucket. Deep copies the string if
+ * the buckets are not using shared memory; otherwise, stores a reference to the string.
+ */
 void str_bucket_insert_str(StrBucket* buckets, int bucket_idx, char *item) {
     assert(buckets != NULL, "Attempting to insert item into NULL buckets.");
     assert(bucket_idx >= 0 && bucket_idx < buckets->size, "Attempting to insert item into buckets with invalid index.");
+    assert(bucket_idx == buckets->size - 1, "Attempting to insert item into bucket that is not the last bucket.");
     assert(item != NULL, "Attempting to insert NULL item.");
 
-    StrList* bucket = str_bucket_get_bucket(buckets, bucket_idx);
-    assert(bucket != NULL, "Attempting to insert item into NULL bucket.");
+    if (buckets->num_strings == buckets->str_capacity) {
+        buckets->strings = (char**) grow_array(buckets->arena, buckets->strings, buckets->inline_strings,
+                                               &buckets->str_capacity, buckets->num_strings + 1, sizeof(char*));
+    }
 
-    str_list_insert_str(bucket, item);
+    if (buckets->is_using_shared_memory == false) {
+        item = strdup(item);
+        assert(item != NULL, "Failed to allocate memory for bucket item.");
+    }
+
+    buckets->strings[buckets->num_strings++] = item;
+    buckets->ranges[bucket_idx].size++;
 }
 
+/**
+ * @brief Removes every bucket, freeing the strings if the buckets own them. The storage is kept for reuse.
+ */
 void str_bucket_clear(StrBucket* buckets) {
     assert(buckets != NULL, "Attempting to clear NULL buckets.");
 
-    if (buckets->buckets != NULL) {
-        for (int i = 0; i < buckets->size; i++) {
-            str_list_delete(&buckets->buckets[i]);
+    if (buckets->is_using_shared_memory == false) {
+        for (int i = 0; i < buckets->num_strings; i++) {
+            free(buckets->strings[i]);
         }
-
-        free(buckets->buckets);
-        buckets->buckets = NULL;
     }
 
+    buckets->num_strings = 0;
     buckets->size = 0;
 }
 
@@ -169,10 +308,15 @@ void str_bucket_print(StrBucket* bucket, bool should_format) {
 
     printf("Bucket (%d) {\n", bucket->size);
     for (int i = 0; i < bucket->size; i++) {
-        printf("\tBucket %02d: ", i);
-        str_list_print(bucket->buckets[i], false);
-        printf("\n");
+        printf("\tBucket %02d: [", i);
+
+        const StrBucketRange* range = &bucket->ranges[i];
+        for (int str_idx = 0; str_idx < range->size; str_idx++) {
+            printf(str_idx > 0 ? ", %s" : "%s", bucket->strings[range->start + str_idx]);
+        }
+
+        printf("]\n");
     }
 
     printf("}\n");
-}
\ No newline at end of file
+}
@@ -7,18 +7,21 @@
 #include <string.h>
 
 #include "../main.h"
-#include "str_list.h"
+#include "arena.h"
 
 typedef struct StrBucketStruct StrBucket;
 
 // Constructor and Destructor
-StrBucket*  str_bucket_new(int bucket_resize_value, int group_resize_value, bool is_using_shared_memory);
+StrBucket*  str_bucket_new(int bucket_capacity, int str_capacity, bool is_using_shared_memory);
+StrBucket*  str_bucket_new_in_arena(Arena* arena, int bucket_capacity, int str_capacity);
 void        str_bucket_delete(StrBucket** ptr_buckets);
 
 // Accessor Functions
-int        str_bucket_get_size(StrBucket* buckets);
-StrList*   str_bucket_get_bucket(StrBucket* buckets, int index);
-bool       str_bucket_is_using_shared_memory(StrBucket* buckets);
+int         str_bucket_get_size(StrBucket* buckets);
+int         str_bucket_get_bucket_size(StrBucket* buckets, int bucket_idx);
+char*       str_bucket_get_str(StrBucket* buckets, int bucket_idx, int str_idx);
+bool        str_bucket_is_using_shared_memory(StrBucket* buckets);
+char*       str_bucket_join_in_place(StrBucket* buckets, int bucket_idx, char separator);
 
 // Mutator Functions
 int         str_bucket_insert_bucket(StrBucket* buckets);
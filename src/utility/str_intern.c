@@ -0,0 +1,193 @@
+/**
+ * @file str_intern.c
+ *
+ * A string interning table. Every distinct string interned is copied into the table once and given an atom: a dense
+ * index starting at 0, in the order the strings were first interned. Two strings are equal exactly when their atoms
+ * are, so whoever holds atoms compares names with one integer comparison. The copies never move, so the string of an
+ * atom may be held as a plain pointer for as long as the table lives.
+ *
+ * The copies are packed into an arena (see arena.c) rather than allocated one by one, and the atoms are found with an
+ * open addressing hash of their string.
+ */
+
+#include "str_intern.h"
+
+#define STR_INTERN_BLOCK_SIZE 4096
+#define STR_INTERN_MIN_SLOTS 64
+
+/**
+ * @brief A string interning table.
+ * - strings, hashes: The string and its hash of each atom, by atom.
+ * - size, capacity: The number of atoms and the number strings and hashes have room for.
+ * - slots: The open addressing hash of the atoms; each slot holds an atom, or -1 if it is empty. The number of slots
+ *   is a power of two and at least twice the number of atoms.
+ * - characters: The arena holding the interned characters.
+ */
+struct StrInternTableStruct {
+    char** strings;
+    uint32_t* hashes;
+    int size;
+    int capacity;
+
+    int* slots;
+    int num_slots;
+
+    Arena* characters;
+};
+
+/**
+ * Returns the FNV-1a hash of the string.
+ */
+static uint32_t hash_str(const char* str) {
+    uint32_t hash = 2166136261u;
+
+    for (const char* character = str; *character != '\0'; character++) {
+        hash ^= (unsigned char) *character;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void allocate_slots(StrInternTable* table, int num_slots) {
+    table->slots = (int*) malloc(sizeof(int) * num_slots);
+    assert(table->slots != NULL, "Failed to allocate memory for string intern slots.");
+
+    memset(table->slots, -1, sizeof(int) * num_slots);
+    table->num_slots = num_slots;
+}
+
+/**
+ * Returns the slot holding the string, or the empty slot it would be placed in if it has not been interned.
+ */
+static int find_slot(StrInternTable* table, const char* str, uint32_t hash) {
+    const int mask = table->num_slots - 1;
+    int slot = (int) (hash & (uint32_t) mask);
+
+    while (table->slots[slot] != -1) {
+        const int atom = table->slots[slot];
+        if (table->hashes[atom] == hash && strcmp(table->strings[atom], str) == 0) {
+            return slot;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/**
+ * Doubles the number of slots and places every atom again.
+ */
+static void grow_slots(StrInternTable* table) {
+    int* old_slots = table->slots;
+    allocate_slots(table, table->num_slots * 2);
+    free(old_slots);
+
+    const int mask = table->num_slots - 1;
+    for (int atom = 0; atom < table->size; atom++) {
+        int slot = (int) (table->hashes[atom] & (uint32_t) mask);
+        while (table->slots[slot] != -1) {
+            slot = (slot + 1) & mask;
+        }
+
+        table->slots[slot] = atom;
+    }
+}
+
+/**
+ * @brief Creates an empty string interning table.
+ */
+StrInternTable* str_intern_table_new() {
+    StrInternTable* table = (StrInternTable*) malloc(sizeof(StrInternTable));
+    assert(table != NULL, "Failed to allocate memory for string intern table.");
+
+    table->strings = NULL;
+    table->hashes = NULL;
+    table->size = 0;
+    table->capacity = 0;
+    table->characters = arena_new(STR_INTERN_BLOCK_SIZE);
+    allocate_slots(table, STR_INTERN_MIN_SLOTS);
+
+    return table;
+}
+
+/**
+ * @brief Deletes the table and every interned string.
+ */
+void str_intern_table_delete(StrInternTable** ptr_table) {
+    assert(ptr_table != NULL, "Attempting to delete string intern table behind NULL pointer.");
+    assert(*ptr_table != NULL, "Attempting to delete NULL string intern table.");
+
+    StrInternTable* table = *ptr_table;
+
+    arena_delete(&table->characters);
+    free(table->strings);
+    free(table->hashes);
+    free(table->slots);
+    free(table);
+    *ptr_table = NULL;
+}
+
+/**
+ * @brief Returns the number of distinct strings interned.
+ */
+int str_intern_table_get_size(StrInternTable* table) {
+    assert(table != NULL, "Attempting to get size of NULL string intern table.");
+
+    return table->size;
+}
+
+/**
+ * @brief Returns the atom of the string, or -1 if it has not been interned.
+ */
+int str_intern_table_find(StrInternTable* table, const char* str) {
+    assert(table != NULL, "Attempting to find string in NULL string intern table.");
+    assert(str != NULL, "Attempting to find NULL string in string intern table.");
+
+    return table->slots[find_slot(table, str, hash_str(str))];
+}
+
+/**
+ * @brief Returns the interned string of the atom. The string lives as long as the table.
+ */
+const char* str_intern_table_get_str(StrInternTable* table, int atom) {
+    assert(table != NULL, "Attempting to get string from NULL string intern table.");
+    assert(atom >= 0 && atom < table->size, "Attempting to get string of invalid atom %d.", atom);
+
+    return table->strings[atom];
+}
+
+/**
+ * @brief Returns the atom of the string, interning a copy of it first if it has not been interned.
+ */
+int str_intern_table_intern(StrInternTable* table, const char* str) {
+    assert(table != NULL, "Attempting to intern string into NULL string intern table.");
+    assert(str != NULL, "Attempting to intern NULL string.");
+
+    const uint32_t hash = hash_str(str);
+    int slot = find_slot(table, str, hash);
+    if (table->slots[slot] != -1) {
+        return table->slots[slot];
+    }
+
+    if (table->size == table->capacity) {
+        table->capacity = table->capacity > 0 ? 2 * table->capacity : 64;
+
+        table->strings = (char**) realloc(table->strings, sizeof(char*) * table->capacity);
+        table->hashes = (uint32_t*) realloc(table->hashes, sizeof(uint32_t) * table->capacity);
+        assert(table->strings != NULL && table->hashes != NULL, "Failed to allocate memory for interned strings.");
+    }
+
+    const int atom = table->size++;
+    table->strings[atom] = arena_strdup(table->characters, str);
+    table->hashes[atom] = hash;
+    table->slots[slot] = atom;
+
+    // Keep at most half of the slots in use, so probes stay short.
+    if (2 * table->size > table->num_slots) {
+        grow_slots(table);
+    }
+
+    return atom;
+}
@@ -0,0 +1,27 @@
+#ifndef BEANSCRIPT_STR_INTERN_H
+#define BEANSCRIPT_STR_INTERN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/main.h"
+#include "src/utility/arena.h"
+
+typedef struct StrInternTableStruct StrInternTable;
+
+// Constructor and Destructor
+StrInternTable* str_intern_table_new();
+void            str_intern_table_delete(StrInternTable** ptr_table);
+
+// Accessor Functions
+int             str_intern_table_get_size(StrInternTable* table);
+int             str_intern_table_find(StrInternTable* table, const char* str);
+const char*     str_intern_table_get_str(StrInternTable* table, int atom);
+
+// Mutator Functions
+int             str_intern_table_intern(StrInternTable* table, const char* str);
+
+#endif //BEANSCRIPT_STR_INTERN_H
@@ -3,37 +3,45 @@
  * @brief A dynamic list of strings. The list is implemented as an array of strings and is dynamically resized. The user
  * has the choice of using shared memory for the value strings. If the user chooses to use shared memory, it is the
  * callers responsibility to free the value strings when the queue is deleted.
+ *
+ * The first few strings are held inside the list itself, which is all most lists ever hold; past that the array moves
+ * to the heap and doubles whenever it fills, so inserting n strings reallocates O(log n) times.
  */
 
 #include "str_list.h"
 
+#define STR_LIST_INLINE_CAPACITY 4
+
 /**
  * @brief A dynamic list of strings.
- * - resize_value: The value at which the list grows or shrinks when strings are added or removed.
+ * - strings: The strings, either inline_strings or an array on the heap.
+ * - reserved_capacity: The capacity the list grows to at least once it outgrows inline_strings.
  * - is_using_shared_memory: True if the list owns the strings; otherwise, false.
  */
 struct StrListStruct {
     char**  strings;
     int     size;
     int     capacity;
-    int     resize_value;
+    int     reserved_capacity;
     bool    is_using_shared_memory;
+    char*   inline_strings[STR_LIST_INLINE_CAPACITY];
 };
 
 /**
  * @brief Initializes a new string list.
- * @param resize_value The value at which the list grows or shrinks when strings are added or removed.
+ * @param reserved_capacity The number of strings the list is expected to hold. The first growth past the inline
+ * storage makes room for at least this many.
  * @param is_using_shared_memory True if the list owns the strings; otherwise, false.
  * @return The newly created string list.
  */
-StrList* str_list_new(int resize_value, bool is_using_shared_memory) {
+StrList* str_list_new(int reserved_capacity, bool is_using_shared_memory) {
     StrList* list = (StrList*) malloc(sizeof(StrList));
     assert(list != NULL, "Could not allocate memory for string list.");
 
-    list->strings = NULL;
+    list->strings = list->inline_strings;
     list->size = 0;
-    list->capacity = 0;
-    list->resize_value = resize_value;
+    list->capacity = STR_LIST_INLINE_CAPACITY;
+    list->reserved_capacity = reserved_capacity;
     list->is_using_shared_memory = is_using_shared_memory;
 
     return list;
@@ -45,7 +53,7 @@ StrList* str_list_new(int resize_value, bool is_using_shared_memory) {
 StrList* str_list_copy(StrList* ref_list) {
     assert(ref_list != NULL, "Attempting to copy NULL string list.");
 
-    StrList* list = str_list_new(ref_list->resize_value, ref_list->is_using_shared_memory);
+    StrList* list = str_list_new(ref_list->size, ref_list->is_using_shared_memory);
 
     for (int i = 0; i < ref_list->size; i++) {
         str_list_insert_str(list, ref_list->strings[i]);
@@ -65,6 +73,10 @@ void str_list_delete(StrList** ptr_list) {
     StrList* list = *ptr_list;
     str_list_clear(list);
 
+    if (list->strings != list->inline_strings) {
+        free(list->strings);
+    }
+
     free(list);
     *ptr_list = NULL;
 }
@@ -151,28 +163,59 @@ char* str_list_concatenate(StrList* list, const char* split_str) {
 }
 
 /**
- * @brief Expands the list by resize_value if it is full or null.
+ * @brief Joins the strings of a shared-memory list into one string separated by `separator`, without allocating. The
+ * strings must lie in one buffer in increasing order with at least one character between each, as the lexer leaves
+ * the tokens of a line; each string is moved down in place to follow the previous one. The list is left holding only
+ * the joined string, so joining it again returns the same string.
+ * @return The joined string, which starts where the first string did.
+ */
+char* str_list_join_in_place(StrList* list, char separator) {
+    assert(list != NULL, "Attempting to join NULL string list.");
+    assert(list->size > 0, "Attempting to join empty string list.");
+    assert(list->is_using_shared_memory, "Attempting to join string list that owns its strings in place.");
+
+    char* str = list->strings[0];
+    char* end = str + strlen(str);
+
+    for (int i = 1; i < list->size; i++) {
+        char* token = list->strings[i];
+        assert(token > end, "Attempting to join strings that are not in increasing order in one buffer.");
+
+        const size_t token_len = strlen(token);
+        *end = separator;
+        memmove(end + 1, token, token_len + 1);
+        end += token_len + 1;
+
+        list->strings[i] = NULL;
+    }
+
+    list->size = 1;
+    return str;
+}
+
+/**
+ * @brief Doubles the capacity of the list if it is full, moving the strings out of the inline storage the first time.
  */
 static void expand_list_if_necessary(StrList* list) {
-    const bool is_list_null = list->size == 0;
-    if (is_list_null) {
-        list->capacity = list->resize_value;
-        list->strings = (char**) malloc(list->capacity * sizeof(char*));
-        assert(list->strings != NULL, "Could not allocate memory for string list strings.");
+    if (list->size < list->capacity) {
+        return;
     }
 
-    const bool is_list_full = list->size >= list->capacity;
-    if (is_list_full) {
-        list->capacity += list->resize_value;
-        list->strings = (char**) realloc(list->strings, sizeof(char*) * list->capacity);
-        assert(list->strings != NULL, "Could not allocate memory for string list strings.");
+    int new_capacity = list->capacity * 2;
+    if (new_capacity < list->reserved_capacity) {
+        new_capacity = list->reserved_capacity;
     }
 
-    if (is_list_null || is_list_full) {
-        for(int idx_str = list->size; idx_str < list->capacity; idx_str++) {
-            list->strings[idx_str] = NULL;
-        }
+    if (list->strings == list->inline_strings) {
+        list->strings = (char**) malloc(sizeof(char*) * new_capacity);
+        assert(list->strings != NULL, "Could not allocate memory for string list strings.");
+        memcpy(list->strings, list->inline_strings, sizeof(char*) * list->size);
+    } else {
+        list->strings = (char**) realloc(list->strings, sizeof(char*) * new_capacity);
+        assert(list->strings != NULL, "Could not allocate memory for string list strings.");
     }
+
+    list->capacity = new_capacity;
 }
 
 /**
@@ -197,28 +240,17 @@ void str_list_insert_str(StrList* list, char* str) {
 }
 
 /**
- * @brief Clears the list, freeing memory if it owns the strings.
+ * @brief Clears the list, freeing memory if it owns the strings. The capacity is kept for reuse.
  */
 void str_list_clear(StrList* list) {
     assert(list != NULL, "Attempting to clear NULL string list.");
 
-    if (list->size == 0) {
-        assert(list->strings == NULL, "String list size is 0 but string list strings is not NULL.");
-        return;
-    }
-
-    if (list->is_using_shared_memory) {
-        for (int i = 0; i < list->size; i++) {
-            list->strings[i] = NULL;
-        }
-    } else {
+    if (list->is_using_shared_memory == false) {
         for (int i = 0; i < list->size; i++) {
             free(list->strings[i]);
         }
     }
 
-    free(list->strings);
-    list->strings = NULL;
     list->size = 0;
 }
 
@@ -13,7 +13,7 @@
 typedef struct StrListStruct StrList;
 
 // Constructor and Destructor
-StrList*    str_list_new(int resize_value, bool is_using_shared_memory);
+StrList*    str_list_new(int reserved_capacity, bool is_using_shared_memory);
 StrList*    str_list_copy(StrList* ref_list);
 void        str_list_delete(StrList** ptr_list);
 
@@ -22,6 +22,7 @@ int         str_list_get_size(StrList* list);
 char*       str_list_get_str(StrList* list, int index);
 int         str_list_get_index(StrList* list, const char* str);
 char*       str_list_concatenate(StrList* list, const char* split_str);
+char*       str_list_join_in_place(StrList* list, char separator);
 
 // Mutator Functions
 void        str_list_insert_str(StrList* list, char* str);
@@ -0,0 +1,430 @@
+/**
+ * @file timestamp_queue.c
+ *
+ * TimestampQueue is a min priority queue that stores a timestamp and an associated handle. When a value is popped from
+ * the queue, the timestamp is updated to the given timestamp and the queue is heapified. Handles are small dense
+ * indices chosen by the owner of the queue, such as the position of each instruction in a waitlist, so the queue never
+ * stores or compares strings.
+ *
+ * The queue is a 4-ary heap stored inline in one array, so a sift touches a few adjacent cache lines instead of chasing
+ * a pointer per comparison, and the tree is half as deep as a binary heap. Entries with the same timestamp are ordered
+ * by handle, which is script order. A second array maps every handle to its position in the heap, so a handle can be
+ * found, rescheduled or removed in O(1) plus one sift. A handle can be in the queue at most once.
+ */
+
+#include "timestamp_queue.h"
+
+#define TIMESTAMP_QUEUE_ARITY 4
+
+typedef struct {
+    time_t timestamp;
+    int handle;
+} TimestampNode;
+
+/**
+ * @brief
+ * - nodes: The heap. The children of the node at index i are at TIMESTAMP_QUEUE_ARITY * i + 1 onwards.
+ * - positions: The index in nodes of every handle, or -1 if the handle is not queued. Grows to the largest handle
+ *   pushed.
+ */
+typedef struct TimestampQueueStruct {
+    int size;
+    int capacity;
+    TimestampNode* nodes;
+    int* positions;
+    int num_positions;
+} TimestampQueue;
+
+static bool node_is_less(const TimestampNode* a, const TimestampNode* b) {
+    if (a->timestamp != b->timestamp) {
+        return a->timestamp < b->timestamp;
+    }
+
+    return a->handle < b->handle;
+}
+
+/**
+ * Places the node at the given index and records its position.
+ */
+static void place_node(TimestampQueue* timestamp_queue, int idx, TimestampNode node) {
+    timestamp_queue->nodes[idx] = node;
+    timestamp_queue->positions[node.handle] = idx;
+}
+
+/**
+ * Moves the node at the given index towards the root until its parent is not greater. The node is held aside and
+ * every parent it passes is shifted down one level, so each level costs one write.
+ */
+static void sift_up(TimestampQueue* timestamp_queue, int idx) {
+    TimestampNode* nodes = timestamp_queue->nodes;
+    const TimestampNode node = nodes[idx];
+
+    while (idx > 0) {
+        const int parent_idx = (idx - 1) / TIMESTAMP_QUEUE_ARITY;
+        if (node_is_less(&node, &nodes[parent_idx]) == false) {
+            break;
+        }
+
+        place_node(timestamp_queue, idx, nodes[parent_idx]);
+        idx = parent_idx;
+    }
+
+    place_node(timestamp_queue, idx, node);
+}
+
+/**
+ * Moves the node at the given index towards the leaves until none of its children is smaller.
+ */
+static void sift_down(TimestampQueue* timestamp_queue, int idx) {
+    TimestampNode* nodes = timestamp_queue->nodes;
+    const TimestampNode node = nodes[idx];
+    const int size = timestamp_queue->size;
+
+    while (true) {
+        const int first_child_idx = TIMESTAMP_QUEUE_ARITY * idx + 1;
+        if (first_child_idx >= size) {
+            break;
+        }
+
+        const int last_child_idx = first_child_idx + TIMESTAMP_QUEUE_ARITY < size
+                                   ? first_child_idx + TIMESTAMP_QUEUE_ARITY
+                                   : size;
+
+        int min_idx = first_child_idx;
+        for (int child_idx = first_child_idx + 1; child_idx < last_child_idx; child_idx++) {
+            if (node_is_less(&nodes[child_idx], &nodes[min_idx])) {
+                min_idx = child_idx;
+            }
+        }
+
+        if (node_is_less(&nodes[min_idx], &node) == false) {
+            break;
+        }
+
+        place_node(timestamp_queue, idx, nodes[min_idx]);
+        idx = min_idx;
+    }
+
+    place_node(timestamp_queue, idx, node);
+}
+
+/**
+ * Restores the heap after the node at the given index changed.
+ */
+static void sift(TimestampQueue* timestamp_queue, int idx) {
+    if (idx > 0 && node_is_less(&timestamp_queue->nodes[idx], &timestamp_queue->nodes[(idx - 1) / TIMESTAMP_QUEUE_ARITY])) {
+        sift_up(timestamp_queue, idx);
+    } else {
+        sift_down(timestamp_queue, idx);
+    }
+}
+
+/**
+ * Removes the node at the given index.
+ */
+static void remove_at(TimestampQueue* timestamp_queue, int idx) {
+    timestamp_queue->positions[timestamp_queue->nodes[idx].handle] = -1;
+    timestamp_queue->size--;
+
+    if (idx == timestamp_queue->size) {
+        return;
+    }
+
+    place_node(timestamp_queue, idx, timestamp_queue->nodes[timestamp_queue->size]);
+    sift(timestamp_queue, idx);
+}
+
+/**
+ * Makes room in the position index for the given handle.
+ */
+static void reserve_position(TimestampQueue* timestamp_queue, int handle) {
+    if (handle < timestamp_queue->num_positions) {
+        return;
+    }
+
+    int num_positions = timestamp_queue->num_positions > 0 ? timestamp_queue->num_positions : 16;
+    while (num_positions <= handle) {
+        num_positions *= 2;
+    }
+
+    timestamp_queue->positions = (int*) realloc(timestamp_queue->positions, sizeof(int) * num_positions);
+    assert(timestamp_queue->positions != NULL, "Failed to allocate memory for timestamp_queue positions.");
+
+    for (int idx = timestamp_queue->num_positions; idx < num_positions; idx++) {
+        timestamp_queue->positions[idx] = -1;
+    }
+
+    timestamp_queue->num_positions = num_positions;
+}
+
+static int get_position(TimestampQueue* timestamp_queue, int handle) {
+    if (handle < 0 || handle >= timestamp_queue->num_positions) {
+        return -1;
+    }
+
+    return timestamp_queue->positions[handle];
+}
+
+// Constructor and Destructor
+/**
+ * Creates a new timestamp queue.
+ *
+ * @param capacity
+ * @return
+ */
+TimestampQueue* timestamp_queue_new(int capacity) {
+    assert(capacity > 0, "Attempting to create timestamp_queue with capacity less than 1.");
+
+    TimestampQueue* timestamp_queue = (TimestampQueue*) malloc(sizeof(TimestampQueue));
+    assert(timestamp_queue != NULL, "Failed to allocate memory for timestamp_queue.");
+
+    timestamp_queue->size = 0;
+    timestamp_queue->capacity = capacity;
+
+    timestamp_queue->nodes = (TimestampNode*) malloc(sizeof(TimestampNode) * capacity);
+    assert(timestamp_queue->nodes != NULL, "Failed to allocate memory for timestamp_queue nodes.");
+
+    timestamp_queue->positions = NULL;
+    timestamp_queue->num_positions = 0;
+
+    return timestamp_queue;
+}
+
+/**
+ * Deletes the timestamp queue.
+ *
+ * @param ptr_timestamp_queue
+ */
+void timestamp_queue_delete(TimestampQueue** ptr_timestamp_queue) {
+    assert(ptr_timestamp_queue != NULL, "Attempting to delete NULL ptr_timestamp_queue.");
+    assert(*ptr_timestamp_queue != NULL, "Attempting to delete NULL timestamp_queue.");
+
+    TimestampQueue* timestamp_queue = *ptr_timestamp_queue;
+
+    free(timestamp_queue->nodes);
+    free(timestamp_queue->positions);
+    free(timestamp_queue);
+    *ptr_timestamp_queue = NULL;
+}
+
+// Accessor Functions
+/**
+ * Returns true if the timestamp queue contains the given handle, otherwise false.
+ *
+ * @param timestamp_queue
+ * @param handle
+ * @return
+ */
+bool timestamp_queue_contains(TimestampQueue* timestamp_queue, int handle) {
+    assert(timestamp_queue != NULL, "Attempting to check if NULL timestamp_queue contains handle.");
+
+    return get_position(timestamp_queue, handle) >= 0;
+}
+
+/**
+ * Returns the current number of elements in the timestamp queue.
+ *
+ * @param timestamp_queue
+ * @return
+ */
+int timestamp_queue_get_size(TimestampQueue* timestamp_queue) {
+    assert(timestamp_queue != NULL, "Attempting to get size of NULL timestamp_queue.");
+    return timestamp_queue->size;
+}
+
+int timestamp_queue_peek_handle(TimestampQueue* timestamp_queue) {
+    assert(timestamp_queue != NULL, "Attempting to peek handle of NULL timestamp_queue.");
+    assert(timestamp_queue->size > 0, "Attempting to peek handle of empty timestamp_queue.");
+
+    return timestamp_queue->nodes[0].handle;
+}
+
+time_t timestamp_queue_peek_timestamp(TimestampQueue* timestamp_queue) {
+    assert(timestamp_queue != NULL, "Attempting to peek timestamp of NULL timestamp_queue.");
+    assert(timestamp_queue->size > 0, "Attempting to peek timestamp of empty timestamp_queue.");
+
+    return timestamp_queue->nodes[0].timestamp;
+}
+
+/**
+ * Returns the timestamp the given handle is queued with. The handle must be queued.
+ *
+ * @param timestamp_queue
+ * @param handle
+ * @return
+ */
+time_t timestamp_queue_get_timestamp(TimestampQueue* timestamp_queue, int handle) {
+    assert(timestamp_queue != NULL, "Attempting to get timestamp from NULL timestamp_queue.");
+
+    const int idx = get_position(timestamp_queue, handle);
+    assert(idx >= 0, "Attempting to get timestamp of handle %d, which is not in the timestamp_queue.", handle);
+
+    return timestamp_queue->nodes[idx].timestamp;
+}
+
+/**
+ * Returns true if the minimum element is due at the given time. The caller supplies the time so that one clock read
+ * can be shared across every queue checked in a scheduler tick.
+ *
+ * @param timestamp_queue
+ * @param current_timestamp
+ * @return
+ */
+bool timestamp_queue_can_pop(TimestampQueue* timestamp_queue, time_t current_timestamp) {
+    assert(timestamp_queue != NULL, "Attempting to get size of NULL timestamp_queue.");
+
+    if (timestamp_queue->size == 0) {
+        return false;
+    }
+
+    return timestamp_queue->nodes[0].timestamp <= current_timestamp;
+}
+
+static int count_ready_from(TimestampQueue* timestamp_queue, int idx, time_t current_timestamp) {
+    if (idx >= timestamp_queue->size || timestamp_queue->nodes[idx].timestamp > current_timestamp) {
+        return 0;
+    }
+
+    int num_ready = 1;
+    const int first_child_idx = TIMESTAMP_QUEUE_ARITY * idx + 1;
+    for (int child_idx = first_child_idx; child_idx < first_child_idx + TIMESTAMP_QUEUE_ARITY; child_idx++) {
+        num_ready += count_ready_from(timestamp_queue, child_idx, current_timestamp);
+    }
+
+    return num_ready;
+}
+
+/**
+ * Returns the number of elements due at the given time, without removing any. Only the due elements and their
+ * children are visited, since no element is due before its parent.
+ *
+ * @param timestamp_queue
+ * @param current_timestamp
+ * @return
+ */
+int timestamp_queue_count_ready(TimestampQueue* timestamp_queue, time_t current_timestamp) {
+    assert(timestamp_queue != NULL, "Attempting to count ready elements of NULL timestamp_queue.");
+
+    return count_ready_from(timestamp_queue, 0, current_timestamp);
+}
+
+/**
+ * Pops the minimum handle from the timestamp queue. The timestamp of the popped element is updated to the parameter
+ * updated_timestamp and the queue is heapified.
+ * @param timestamp_queue
+ * @param updated_timestamp
+ * @return
+ */
+int timestamp_queue_pop(TimestampQueue* timestamp_queue, time_t updated_timestamp) {
+    assert(timestamp_queue != NULL, "Attempting to get size of NULL timestamp_queue.");
+    assert(timestamp_queue->size > 0, "Attempting to pop from empty timestamp_queue.");
+
+    const int min_handle = timestamp_queue->nodes[0].handle;
+
+    timestamp_queue->nodes[0].timestamp = updated_timestamp;
+    sift_down(timestamp_queue, 0);
+
+    return min_handle;
+}
+
+/**
+ * Removes every element due at the given time and writes their handles to the given array in timestamp order, up to
+ * max_handles of them. Returns the number removed. The caller pushes back whichever handles should run again.
+ *
+ * @param timestamp_queue
+ * @param current_timestamp
+ * @param handles
+ * @param max_handles
+ * @return
+ */
+int timestamp_queue_pop_ready(TimestampQueue* timestamp_queue, time_t current_timestamp, int* handles, int max_handles) {
+    assert(timestamp_queue != NULL, "Attempting to pop from NULL timestamp_queue.");
+    assert(handles != NULL || max_handles == 0, "Attempting to pop into NULL handles.");
+
+    int num_popped = 0;
+    while (num_popped < max_handles && timestamp_queue_can_pop(timestamp_queue, current_timestamp)) {
+        handles[num_popped++] = timestamp_queue->nodes[0].handle;
+        remove_at(timestamp_queue, 0);
+    }
+
+    return num_popped;
+}
+
+// Mutator Functions
+/**
+ * Pushes a new handle to the timestamp queue. The handle must not already be queued.
+ *
+ * @param timestamp_queue
+ * @param timestamp
+ * @param handle
+ */
+void timestamp_queue_push(TimestampQueue* timestamp_queue, time_t timestamp, int handle) {
+    assert(timestamp_queue != NULL, "Attempting to push to NULL timestamp_queue.");
+    assert(handle >= 0, "Attempting to push invalid handle %d to timestamp_queue.", handle);
+
+    const int size = timestamp_queue->size;
+    assert(size < timestamp_queue->capacity, "Attempting to push to full timestamp_queue.");
+
+    reserve_position(timestamp_queue, handle);
+    assert(timestamp_queue->positions[handle] < 0, "Attempting to push handle %d, which is already in the timestamp_queue.", handle);
+
+    timestamp_queue->nodes[size] = (TimestampNode) { .timestamp = timestamp, .handle = handle };
+    timestamp_queue->size = size + 1;
+
+    sift_up(timestamp_queue, size);
+}
+
+/**
+ * Changes the timestamp of a queued handle, moving it earlier or later in the queue. The handle must be queued.
+ *
+ * @param timestamp_queue
+ * @param handle
+ * @param timestamp
+ */
+void timestamp_queue_update(TimestampQueue* timestamp_queue, int handle, time_t timestamp) {
+    assert(timestamp_queue != NULL, "Attempting to update NULL timestamp_queue.");
+
+    const int idx = get_position(timestamp_queue, handle);
+    assert(idx >= 0, "Attempting to update handle %d, which is not in the timestamp_queue.", handle);
+
+    timestamp_queue->nodes[idx].timestamp = timestamp;
+    sift(timestamp_queue, idx);
+}
+
+/**
+ * Removes the given handle from the queue. Returns false if it was not queued.
+ *
+ * @param timestamp_queue
+ * @param handle
+ * @return
+ */
+bool timestamp_queue_remove(TimestampQueue* timestamp_queue, int handle) {
+    assert(timestamp_queue != NULL, "Attempting to remove from NULL timestamp_queue.");
+
+    const int idx = get_position(timestamp_queue, handle);
+    if (idx < 0) {
+        return false;
+    }
+
+    remove_at(timestamp_queue, idx);
+    return true;
+}
+
+// Utility Functions
+/**
+ * Prints every element in heap order, as "(timestamp, handle)" pairs, one per line if should_format is true.
+ *
+ * @param timestamp_queue
+ * @param should_format
+ */
+void timestamp_queue_print(TimestampQueue* timestamp_queue, bool should_format) {
+    assert(timestamp_queue != NULL, "Attempting to print NULL timestamp_queue.");
+
+    printf("[");
+    for (int idx = 0; idx < timestamp_queue->size; idx++) {
+        const TimestampNode* node = &timestamp_queue->nodes[idx];
+        printf("%s%s(%lld, %d)", idx > 0 ? "," : "", should_format ? "\n    " : (idx > 0 ? " " : ""),
+               (long long) node->timestamp, node->handle);
+    }
+    printf("%s]", should_format && timestamp_queue->size > 0 ? "\n" : "");
+}
@@ -0,0 +1,37 @@
+#ifndef BEANSCRIPT_TIMESTAMP_QUEUE_H
+#define BEANSCRIPT_TIMESTAMP_QUEUE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "../utility/utility.h"
+
+#include "../main.h"
+
+typedef struct TimestampQueueStruct TimestampQueue;
+
+// Constructor and Destructor
+TimestampQueue* timestamp_queue_new(int capacity);
+void timestamp_queue_delete(TimestampQueue** ptr_timestamp_queue);
+
+// Accessor Functions
+bool timestamp_queue_contains(TimestampQueue* timestamp_queue, int handle);
+int timestamp_queue_get_size(TimestampQueue* timestamp_queue);
+int timestamp_queue_peek_handle(TimestampQueue* timestamp_queue);
+time_t timestamp_queue_peek_timestamp(TimestampQueue* timestamp_queue);
+time_t timestamp_queue_get_timestamp(TimestampQueue* timestamp_queue, int handle);
+bool timestamp_queue_can_pop(TimestampQueue* timestamp_queue, time_t current_timestamp);
+int timestamp_queue_count_ready(TimestampQueue* timestamp_queue, time_t current_timestamp);
+int timestamp_queue_pop(TimestampQueue* timestamp_queue, time_t updated_timestamp);
+int timestamp_queue_pop_ready(TimestampQueue* timestamp_queue, time_t current_timestamp, int* handles, int max_handles);
+
+// Mutator Functions
+void timestamp_queue_push(TimestampQueue* timestamp_queue, time_t timestamp, int handle);
+void timestamp_queue_update(TimestampQueue* timestamp_queue, int handle, time_t timestamp);
+bool timestamp_queue_remove(TimestampQueue* timestamp_queue, int handle);
+
+// Utility Functions
+void timestamp_queue_print(TimestampQueue* timestamp_queue, bool should_format);
+
+#endif //BEANSCRIPT_TIMESTAMP_QUEUE_H
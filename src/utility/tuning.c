@@ -0,0 +1,385 @@
+/**
+ * @file tuning.c
+ *
+ * How the OS schedules the interpreter while a pool runs: the resolution of the system timer, the priority of the
+ * emitter thread and the cores the emitter and the workers are pinned to. An interval the OS sleeps is rounded up to
+ * the timer resolution, and a thread that is ready to run may still wait behind others at its priority, so both bound
+ * how close to its due time a stroke can be sent (see clock.c and emitter.c).
+ *
+ * The settings come from the command line and from the header of each script (see script_header.c), and apply to the
+ * whole process from tuning_open to tuning_close. Each thread tunes itself once it starts. A setting the OS refuses is
+ * not fatal: the interpreter runs as it would without it, and the timer resolution it reports is the one in effect.
+ *
+ * On Windows the timer resolution is asked for from NtSetTimerResolution, which takes steps finer than a millisecond,
+ * or else from timeBeginPeriod. Linux has no system-wide timer resolution; the closest setting is the timer slack of
+ * each thread, by which the kernel may delay a wakeup to batch it with others, so that is set instead and is inherited
+ * by every thread started afterwards.
+ */
+
+#ifdef __linux__
+    #define _GNU_SOURCE
+#endif
+
+#include "tuning.h"
+
+#ifdef _WIN32
+    typedef LONG (NTAPI* NtSetTimerResolutionFunction)(ULONG desired_resolution, BOOLEAN is_set, PULONG resolution);
+    typedef LONG (NTAPI* NtQueryTimerResolutionFunction)(PULONG coarsest, PULONG finest, PULONG resolution);
+#endif
+
+static const char* TuningPriorityLookupArray[] = {
+        "normal",
+        "high",
+        "mmcss",
+};
+
+static const int NUM_TUNING_PRIORITIES = sizeof(TuningPriorityLookupArray) / sizeof(TuningPriorityLookupArray[0]);
+
+// The settings in effect. Without tuning_open, the emitter is raised as it always has been and nothing else changes.
+static TuningConfig config = { .timer_resolution_us = 0, .priority = TUNING_PRIORITY_HIGH, .num_cores = 0 };
+static bool is_open = false;
+
+#ifdef _WIN32
+static ULONG nt_timer_resolution = 0;
+static UINT timer_period_ms = 0;
+static _Thread_local HANDLE mmcss_task = NULL;
+#elif defined(__linux__)
+static int previous_timer_slack_ns = -1;
+#endif
+
+/**
+ * Resets the configuration to nothing being set.
+ *
+ * @param tuning_config
+ */
+void tuning_config_init(TuningConfig* tuning_config) {
+    assert(tuning_config != NULL, "Attempting to initialize NULL tuning config.");
+
+    tuning_config->timer_resolution_us = 0;
+    tuning_config->is_timer_resolution_set = false;
+    tuning_config->priority = TUNING_PRIORITY_HIGH;
+    tuning_config->is_priority_set = false;
+    tuning_config->num_cores = 0;
+}
+
+/**
+ * Returns true if the name is one of the settings a script header can hold: `resolution`, `priority` or `cores`.
+ *
+ * @param str_name
+ * @return
+ */
+bool tuning_is_parameter(const char* str_name) {
+    assert(str_name != NULL, "Attempting to check NULL tuning parameter.");
+
+    return strcmp(str_name, "resolution") == 0 || strcmp(str_name, "priority") == 0 || strcmp(str_name, "cores") == 0;
+}
+
+static int parse_non_negative(const char* str_value, const char* str_name) {
+    char* str_end = NULL;
+    const long value = strtol(str_value, &str_end, 10);
+    assert(*str_value != '\0' && *str_end == '\0' && value >= 0 && value <= 1000000,
+           "Expected a non-negative number for %s, got %s.", str_name, str_value);
+
+    return (int) value;
+}
+
+/**
+ * Sets the named setting from its values, if the name is a setting (see tuning_is_parameter), and returns whether it
+ * was. The values are those that follow the name in a script header:
+ * - resolution <us>: The system timer resolution to ask for, in microseconds.
+ * - priority <normal|high|mmcss>: How the emitter thread is scheduled (see TuningPriority).
+ * - cores <core> [core ...]: The cores to pin the emitter and then the workers to (see TuningConfig).
+ *
+ * @param tuning_config
+ * @param str_name
+ * @param values
+ * @param num_values
+ * @return
+ */
+bool tuning_config_set_parameter(TuningConfig* tuning_config, const char* str_name, char** values, int num_values) {
+    assert(tuning_config != NULL, "Attempting to set parameter of NULL tuning config.");
+    assert(values != NULL || num_values == 0, "Attempting to set tuning parameter from NULL values.");
+
+    if (tuning_is_parameter(str_name) == false) {
+        return false;
+    }
+
+    assert(num_values >= 1, "Expected a value for %s.", str_name);
+
+    if (strcmp(str_name, "resolution") == 0) {
+        assert(num_values == 1, "Expected one value for resolution, got %d.", num_values);
+
+        const int resolution_us = parse_non_negative(values[0], str_name);
+        assert(resolution_us > 0, "Expected a positive timer resolution, got %s.", values[0]);
+
+        tuning_config->timer_resolution_us = (time_t) resolution_us;
+        tuning_config->is_timer_resolution_set = true;
+    } else if (strcmp(str_name, "priority") == 0) {
+        assert(num_values == 1, "Expected one value for priority, got %d.", num_values);
+
+        int priority = 0;
+        while (priority < NUM_TUNING_PRIORITIES && strcmp(TuningPriorityLookupArray[priority], values[0]) != 0) {
+            priority++;
+        }
+
+        assert(priority < NUM_TUNING_PRIORITIES, "Expected normal, high or mmcss for priority, got %s.", values[0]);
+
+        tuning_config->priority = (TuningPriority) priority;
+        tuning_config->is_priority_set = true;
+    } else {
+        assert(num_values <= TUNING_MAX_CORES, "Expected at most %d cores, got %d.", TUNING_MAX_CORES, num_values);
+
+        for (int idx = 0; idx < num_values; idx++) {
+            const int core = parse_non_negative(values[idx], str_name);
+            assert(core < TUNING_MAX_CORES, "Expected a core below %d, got %s.", TUNING_MAX_CORES, values[idx]);
+
+            tuning_config->cores[idx] = core;
+        }
+
+        tuning_config->num_cores = num_values;
+    }
+
+    return true;
+}
+
+/**
+ * Takes every setting that is not set in the configuration from the other one.
+ *
+ * @param tuning_config
+ * @param other
+ */
+void tuning_config_merge(TuningConfig* tuning_config, const TuningConfig* other) {
+    assert(tuning_config != NULL && other != NULL, "Attempting to merge NULL tuning config.");
+
+    if (tuning_config->is_timer_resolution_set == false && other->is_timer_resolution_set) {
+        tuning_config->timer_resolution_us = other->timer_resolution_us;
+        tuning_config->is_timer_resolution_set = true;
+    }
+
+    if (tuning_config->is_priority_set == false && other->is_priority_set) {
+        tuning_config->priority = other->priority;
+        tuning_config->is_priority_set = true;
+    }
+
+    if (tuning_config->num_cores == 0) {
+        memcpy(tuning_config->cores, other->cores, sizeof(int) * other->num_cores);
+        tuning_config->num_cores = other->num_cores;
+    }
+}
+
+#ifdef _WIN32
+/**
+ * Returns the native function with the given name, or NULL if this version of Windows has none. The timer resolution
+ * functions are not part of the documented API, so they are looked up rather than linked.
+ */
+static void* get_ntdll_function(const char* str_name) {
+    const HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+    return ntdll != NULL ? (void*) GetProcAddress(ntdll, str_name) : NULL;
+}
+#endif
+
+/**
+ * Asks the OS for the configured timer resolution.
+ */
+static void set_timer_resolution(time_t resolution_us) {
+#ifdef _WIN32
+    const NtSetTimerResolutionFunction nt_set_timer_resolution =
+        (NtSetTimerResolutionFunction) get_ntdll_function("NtSetTimerResolution");
+
+    // The native call takes 100 ns units.
+    const ULONG desired_resolution = (ULONG) (resolution_us * 10);
+    ULONG resolution = 0;
+    if (nt_set_timer_resolution != NULL && nt_set_timer_resolution(desired_resolution, TRUE, &resolution) == 0) {
+        nt_timer_resolution = desired_resolution;
+        return;
+    }
+
+    const UINT period_ms = resolution_us >= 1000 ? (UINT) ((resolution_us + 999) / 1000) : 1;
+    if (timeBeginPeriod(period_ms) == TIMERR_NOERROR) {
+        timer_period_ms = period_ms;
+    }
+#elif defined(__linux__)
+    previous_timer_slack_ns = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    prctl(PR_SET_TIMERSLACK, (unsigned long) resolution_us * 1000UL, 0, 0, 0);
+#else
+    (void) resolution_us;
+#endif
+}
+
+static void restore_timer_resolution() {
+#ifdef _WIN32
+    if (nt_timer_resolution != 0) {
+        const NtSetTimerResolutionFunction nt_set_timer_resolution =
+            (NtSetTimerResolutionFunction) get_ntdll_function("NtSetTimerResolution");
+
+        ULONG resolution = 0;
+        nt_set_timer_resolution(nt_timer_resolution, FALSE, &resolution);
+        nt_timer_resolution = 0;
+    }
+
+    if (timer_period_ms != 0) {
+        timeEndPeriod(timer_period_ms);
+        timer_period_ms = 0;
+    }
+#elif defined(__linux__)
+    if (previous_timer_slack_ns > 0) {
+        prctl(PR_SET_TIMERSLACK, (unsigned long) previous_timer_slack_ns, 0, 0, 0);
+        previous_timer_slack_ns = -1;
+    }
+#endif
+}
+
+/**
+ * Applies the configuration to the process until tuning_close: asks for the timer resolution and keeps the rest for
+ * the threads to tune themselves with. Must be called before the emitter and the workers start. If a timer resolution
+ * is asked for, the one granted is written to stderr.
+ *
+ * @param tuning_config
+ */
+void tuning_open(const TuningConfig* tuning_config) {
+    assert(is_open == false, "Attempting to open tuning that is already open.");
+    assert(tuning_config != NULL, "Attempting to open tuning with NULL config.");
+
+    config = *tuning_config;
+    is_open = true;
+
+    if (config.is_timer_resolution_set) {
+        set_timer_resolution(config.timer_resolution_us);
+        fprintf(stderr, "Timer resolution is %lld us (asked for %lld us).\n",
+                (long long) tuning_get_timer_resolution_us(), (long long) config.timer_resolution_us);
+    }
+}
+
+/**
+ * Gives the timer resolution back and forgets the configuration. Must be called after every tuned thread has finished.
+ */
+void tuning_close() {
+    if (is_open == false) {
+        return;
+    }
+
+    restore_timer_resolution();
+    tuning_config_init(&config);
+    is_open = false;
+}
+
+/**
+ * Returns the timer resolution (us) in effect for the calling thread, or -1 if it cannot be read. On Linux this is the
+ * thread's timer slack (see the file comment).
+ *
+ * @return
+ */
+time_t tuning_get_timer_resolution_us() {
+#ifdef _WIN32
+    const NtQueryTimerResolutionFunction nt_query_timer_resolution =
+        (NtQueryTimerResolutionFunction) get_ntdll_function("NtQueryTimerResolution");
+
+    ULONG coarsest = 0;
+    ULONG finest = 0;
+    ULONG resolution = 0;
+    if (nt_query_timer_resolution != NULL && nt_query_timer_resolution(&coarsest, &finest, &resolution) == 0) {
+        return (time_t) ((resolution + 9) / 10);
+    }
+
+    return timer_period_ms != 0 ? (time_t) timer_period_ms * 1000 : -1;
+#elif defined(__linux__)
+    const int timer_slack_ns = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    return timer_slack_ns >= 0 ? (time_t) ((timer_slack_ns + 999) / 1000) : -1;
+#else
+    struct timespec resolution;
+    if (clock_getres(CLOCK_MONOTONIC, &resolution) != 0) {
+        return -1;
+    }
+
+    return (time_t) resolution.tv_sec * 1000000 + (resolution.tv_nsec + 999) / 1000;
+#endif
+}
+
+/**
+ * Raises the priority of the calling thread so driver submissions are not preempted by ordinary work.
+ */
+static void raise_thread_priority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+#else
+    struct sched_param param = { .sched_priority = sched_get_priority_min(SCHED_FIFO) };
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+/**
+ * Registers the calling thread with the multimedia class scheduler, which runs it ahead of ordinary threads however
+ * loaded the machine is. Returns false if it cannot be registered.
+ */
+static bool register_thread_with_mmcss() {
+#ifdef _WIN32
+    DWORD task_index = 0;
+    mmcss_task = AvSetMmThreadCharacteristicsA("Pro Audio", &task_index);
+    if (mmcss_task == NULL) {
+        return false;
+    }
+
+    AvSetMmThreadPriority(mmcss_task, AVRT_PRIORITY_CRITICAL);
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void pin_thread(int core) {
+#ifdef _WIN32
+    const bool is_pinned = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << core) != 0;
+#elif defined(__linux__)
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(core, &cores);
+    const bool is_pinned = pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores) == 0;
+#else
+    const bool is_pinned = false;
+#endif
+
+    if (is_pinned == false) {
+        fprintf(stderr, "Failed to pin thread to core %d.\n", core);
+    }
+}
+
+/**
+ * Schedules the calling thread as the emitter: at the configured priority, and on the first configured core. Failing
+ * to raise the priority is not fatal; the emitter then runs at normal priority.
+ */
+void tuning_tune_emitter_thread() {
+    if (config.priority == TUNING_PRIORITY_MMCSS && register_thread_with_mmcss() == false) {
+        raise_thread_priority();
+    } else if (config.priority == TUNING_PRIORITY_HIGH) {
+        raise_thread_priority();
+    }
+
+    if (config.num_cores > 0) {
+        pin_thread(config.cores[0]);
+    }
+}
+
+/**
+ * Pins the calling thread, the given worker of the pool, to its configured core, if any.
+ *
+ * @param worker_idx
+ */
+void tuning_tune_worker_thread(int worker_idx) {
+    if (config.num_cores == 1) {
+        pin_thread(config.cores[0]);
+    } else if (config.num_cores > 1) {
+        pin_thread(config.cores[1 + worker_idx % (config.num_cores - 1)]);
+    }
+}
+
+/**
+ * Undoes what tuning the calling thread registered with the OS. Must be called by every tuned thread before it exits.
+ */
+void tuning_release_thread() {
+#ifdef _WIN32
+    if (mmcss_task != NULL) {
+        AvRevertMmThreadCharacteristics(mmcss_task);
+        mmcss_task = NULL;
+    }
+#endif
+}
@@ -0,0 +1,75 @@
+#ifndef BEANSCRIPT_TUNING_H
+#define BEANSCRIPT_TUNING_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <avrt.h>
+    #include <mmsystem.h>
+#else
+    #include <sched.h>
+#endif
+
+#ifdef __linux__
+    #include <sys/prctl.h>
+#endif
+
+#include "src/main.h"
+
+// The most cores the threads of a pool can be pinned to.
+#define TUNING_MAX_CORES 64
+
+/**
+ * @brief How the emitter thread is scheduled.
+ * - TUNING_PRIORITY_NORMAL: Like every other thread.
+ * - TUNING_PRIORITY_HIGH: At a raised priority; a real-time priority where the OS allows it.
+ * - TUNING_PRIORITY_MMCSS: Registered with the multimedia class scheduler (Windows). Elsewhere the same as HIGH.
+ */
+typedef enum {
+    TUNING_PRIORITY_NORMAL,
+    TUNING_PRIORITY_HIGH,
+    TUNING_PRIORITY_MMCSS,
+} TuningPriority;
+
+/**
+ * @brief How the process and the threads of a pool are scheduled while it runs. A field that is not set is left to
+ * the first script header that sets it, or else to its default.
+ * - timer_resolution_us: The system timer resolution (us) to ask for, or 0 to leave it alone.
+ * - priority: How the emitter thread is scheduled. Defaults to TUNING_PRIORITY_HIGH.
+ * - cores: The cores to pin to, or none to leave the threads unpinned. The emitter runs on the first core; the workers
+ *   are dealt the rest round-robin, or share the first if it is the only one.
+ */
+typedef struct {
+    time_t timer_resolution_us;
+    bool is_timer_resolution_set;
+    TuningPriority priority;
+    bool is_priority_set;
+    int cores[TUNING_MAX_CORES];
+    int num_cores;
+} TuningConfig;
+
+// Constructor and Destructor
+void    tuning_open(const TuningConfig* config);
+void    tuning_close();
+
+// Mutator Functions
+void    tuning_config_init(TuningConfig* config);
+bool    tuning_config_set_parameter(TuningConfig* config, const char* str_name, char** values, int num_values);
+void    tuning_config_merge(TuningConfig* config, const TuningConfig* other);
+
+// Accessor Functions
+bool    tuning_is_parameter(const char* str_name);
+time_t  tuning_get_timer_resolution_us();
+
+// Executors
+void    tuning_tune_emitter_thread();
+void    tuning_tune_worker_thread(int worker_idx);
+void    tuning_release_thread();
+
+#endif //BEANSCRIPT_TUNING_H
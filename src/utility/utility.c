@@ -82,16 +82,69 @@ int int_array_get_or_default(int* int_array, int int_array_len, int idx, int def
 }
 
 /**
- * Returns the current time in ms since epoch.
- *
+ * Returns the earlier of two deadlines, where -1 means no deadline.
+ * @param deadline_a
+ * @param deadline_b
  * @return
  */
-time_t get_current_time() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
+time_t time_get_earliest_deadline(time_t deadline_a, time_t deadline_b) {
+    if (deadline_a < 0) {
+        return deadline_b;
+    }
+
+    if (deadline_b < 0) {
+        return deadline_a;
+    }
+
+    return deadline_a < deadline_b ? deadline_a : deadline_b;
+}
+
+/**
+ * Allocates size bytes aligned to the given alignment, which must be a power of two. The size is rounded up to a
+ * multiple of the alignment, as C11 aligned_alloc requires. MSVCRT and UCRT do not provide aligned_alloc, so
+ * _aligned_malloc is used on Windows instead. The memory must be released with mem_aligned_free, never with free.
+ * @param alignment
+ * @param size
+ * @return The memory, or NULL if it could not be allocated.
+ */
+void* mem_aligned_alloc(size_t alignment, size_t size) {
+    const size_t rounded_size = (size + alignment - 1) / alignment * alignment;
+
+#ifdef _WIN32
+    return _aligned_malloc(rounded_size, alignment);
+#else
+    return aligned_alloc(alignment, rounded_size);
+#endif
+}
+
+/**
+ * Releases memory allocated with mem_aligned_alloc. Does nothing if ptr is NULL.
+ * @param ptr
+ */
+void mem_aligned_free(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
 
-    // Convert timeval to milliseconds and store in time_t
-    time_t milliseconds = (time_t)(tv.tv_sec) * 1000 + (tv.tv_usec) / 1000;
+/**
+ * Prints the string to the file as a JSON string, quoted and with its quotes and backslashes escaped. Prints an empty
+ * string if it is NULL.
+ * @param file
+ * @param str
+ */
+void str_print_json(FILE* file, const char* str) {
+    fputc('"', file);
+
+    for (const char* character = str; character != NULL && *character != '\0'; character++) {
+        if (*character == '"' || *character == '\\') {
+            fputc('\\', file);
+        }
+
+        fputc(*character, file);
+    }
 
-    return milliseconds;
+    fputc('"', file);
 }
@@ -5,17 +5,26 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <sys/time.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <malloc.h>
+#endif
 
 #include "src/main.h"
+#include "src/utility/clock.h"
 
 int str_array_find(const char** array, int size, const char* target);
 int str_remove_trailing_delimiters(char *S, const char *delimiters);
 int str_remove_leading_ignored_chars(char *S, const char *delimiters);
+void str_print_json(FILE* file, const char* str);
 
 int int_array_get_or_default(int* int_array, int int_array_len, int idx, int default_value);
 int get_min_int_3(int a, int b, int c);
 
-time_t get_current_time();
+time_t time_get_earliest_deadline(time_t deadline_a, time_t deadline_b);
+
+void* mem_aligned_alloc(size_t alignment, size_t size);
+void mem_aligned_free(void* ptr);
 
 #endif //BEANSCRIPT_UTILITY_H
\ No newline at end of file
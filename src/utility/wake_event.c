@@ -0,0 +1,119 @@
+/**
+ * @file wake_event.c
+ *
+ * A sleep that another thread can cut short. A thread that would otherwise sleep until a monotonic deadline (see
+ * clock.h) waits on its wake event instead, and any thread may signal the event to wake it at once. A signal that
+ * arrives while nobody is waiting is kept, so the next wait returns immediately.
+ *
+ * The wait is a timed wait on a condition variable. Where the condition variable can be put on the monotonic clock,
+ * the deadline is used as is; on Windows the remaining time is converted to a wall-clock deadline, which only matters
+ * if the wall clock jumps during the wait.
+ */
+
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "wake_event.h"
+
+#ifdef _WIN32
+    #define WAKE_EVENT_CLOCK CLOCK_REALTIME
+#else
+    #define WAKE_EVENT_CLOCK CLOCK_MONOTONIC
+#endif
+
+/**
+ * @brief A wake event.
+ * - is_signaled: Set by a signal and cleared by the wait it ends. Guarded by mutex.
+ */
+struct WakeEventStruct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool is_signaled;
+};
+
+WakeEvent* wake_event_new() {
+    WakeEvent* event = (WakeEvent*) malloc(sizeof(WakeEvent));
+    assert(event != NULL, "Failed to allocate memory for wake event.");
+
+    pthread_condattr_t cond_attributes;
+    pthread_condattr_init(&cond_attributes);
+#ifndef _WIN32
+    pthread_condattr_setclock(&cond_attributes, WAKE_EVENT_CLOCK);
+#endif
+
+    pthread_mutex_init(&event->mutex, NULL);
+    pthread_cond_init(&event->cond, &cond_attributes);
+    pthread_condattr_destroy(&cond_attributes);
+
+    event->is_signaled = false;
+
+    return event;
+}
+
+void wake_event_delete(WakeEvent** ptr_event) {
+    assert(ptr_event != NULL, "Attempting to delete wake event behind NULL pointer.");
+    assert(*ptr_event != NULL, "Attempting to delete NULL wake event.");
+
+    WakeEvent* event = *ptr_event;
+    pthread_cond_destroy(&event->cond);
+    pthread_mutex_destroy(&event->mutex);
+
+    free(event);
+    *ptr_event = NULL;
+}
+
+/**
+ * Wakes the thread waiting on the event, or the next thread to wait on it.
+ *
+ * @param event
+ */
+void wake_event_signal(WakeEvent* event) {
+    assert(event != NULL, "Attempting to signal NULL wake event.");
+
+    pthread_mutex_lock(&event->mutex);
+    event->is_signaled = true;
+    pthread_cond_signal(&event->cond);
+    pthread_mutex_unlock(&event->mutex);
+}
+
+/**
+ * Sleeps until the given monotonic time (us) or until the event is signaled, whichever comes first. A negative deadline
+ * waits for a signal only. Returns true if the wait was ended by a signal.
+ *
+ * @param event
+ * @param deadline_us
+ * @return
+ */
+bool wake_event_wait_until_us(WakeEvent* event, time_t deadline_us) {
+    assert(event != NULL, "Attempting to wait on NULL wake event.");
+
+    pthread_mutex_lock(&event->mutex);
+
+    while (event->is_signaled == false) {
+        if (deadline_us < 0) {
+            pthread_cond_wait(&event->cond, &event->mutex);
+            continue;
+        }
+
+        const time_t remaining_us = deadline_us - clock_get_time_us();
+        if (remaining_us <= 0) {
+            break;
+        }
+
+        struct timespec wake_time;
+        clock_gettime(WAKE_EVENT_CLOCK, &wake_time);
+
+        const long long wake_time_ns = (long long) wake_time.tv_nsec + (long long) (remaining_us % 1000000) * 1000;
+        wake_time.tv_sec += (time_t) (remaining_us / 1000000) + (time_t) (wake_time_ns / 1000000000);
+        wake_time.tv_nsec = (long) (wake_time_ns % 1000000000);
+
+        pthread_cond_timedwait(&event->cond, &event->mutex, &wake_time);
+    }
+
+    const bool was_signaled = event->is_signaled;
+    event->is_signaled = false;
+
+    pthread_mutex_unlock(&event->mutex);
+    return was_signaled;
+}
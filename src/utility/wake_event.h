@@ -0,0 +1,24 @@
+#ifndef BEANSCRIPT_WAKE_EVENT_H
+#define BEANSCRIPT_WAKE_EVENT_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "src/utility/clock.h"
+#include "src/main.h"
+
+typedef struct WakeEventStruct WakeEvent;
+
+// Constructor and Destructor
+WakeEvent*  wake_event_new();
+void        wake_event_delete(WakeEvent** ptr_event);
+
+// Producer Functions
+void        wake_event_signal(WakeEvent* event);
+
+// Consumer Functions
+bool        wake_event_wait_until_us(WakeEvent* event, time_t deadline_us);
+
+#endif //BEANSCRIPT_WAKE_EVENT_H